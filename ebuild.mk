@@ -20,9 +20,21 @@ headers      = $(PACKAGE)/cdefs.h $(PACKAGE)/codec.h
 headers     += $(call kconf_enabled,DPACK_SCALAR,$(PACKAGE)/scalar.h)
 headers     += $(call kconf_enabled,DPACK_STRING,$(PACKAGE)/string.h)
 headers     += $(call kconf_enabled,DPACK_LVSTR,$(PACKAGE)/lvstr.h)
+headers     += $(call kconf_enabled,DPACK_INTERN,$(PACKAGE)/intern.h)
 headers     += $(call kconf_enabled,DPACK_BIN,$(PACKAGE)/bin.h)
 headers     += $(call kconf_enabled,DPACK_MAP,$(PACKAGE)/map.h)
 headers     += $(call kconf_enabled,DPACK_ARRAY,$(PACKAGE)/array.h)
+headers     += $(call kconf_enabled,DPACK_JOURNAL,$(PACKAGE)/journal.h)
+headers     += $(call kconf_enabled,DPACK_RING,$(PACKAGE)/ring.h)
+headers     += $(call kconf_enabled,DPACK_RPC,$(PACKAGE)/rpc.h)
+headers     += $(call kconf_enabled,DPACK_UDP,$(PACKAGE)/udp.h)
+headers     += $(call kconf_enabled,DPACK_TMPL,$(PACKAGE)/tmpl.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_MEMFD,$(PACKAGE)/memfd.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_MPBUFFER,$(PACKAGE)/mpbuffer.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_SOCKET,$(PACKAGE)/socket.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_FD,$(PACKAGE)/fd.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_FILTER,$(PACKAGE)/filter.h)
+headers     += $(call kconf_enabled,DPACK_CODEC_ZSTD,$(PACKAGE)/zstd.h)
 
 subdirs     := src
 
@@ -45,9 +57,16 @@ includedir=$${prefix}/include
 Name: libdpack
 Description: dpack library
 Version: $(VERSION)
-Requires.private: libstroll $(call kconf_enabled,DPACK_CODEC_FILE,libutils)
+Requires.private: libstroll $(if $(filter y,$(CONFIG_DPACK_CODEC_FILE) \
+                                           $(CONFIG_DPACK_JOURNAL)),libutils) \
+                  $(call kconf_enabled,DPACK_CODEC_ZSTD,libzstd)
 Cflags: -I$${includedir}
 Libs: -L$${libdir} -ldpack
+Libs.private: $(if $(filter y,$(CONFIG_DPACK_ARRAY_PARALLEL) \
+                                $(CONFIG_DPACK_CODEC_FILE_PARALLEL) \
+                                $(CONFIG_DPACK_JOURNAL) \
+                                $(CONFIG_DPACK_INTERN) \
+                                $(CONFIG_DPACK_CODEC_MPBUFFER)),-pthread)
 endef
 
 pkgconfigs       := libdpack.pc
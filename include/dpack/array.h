@@ -23,13 +23,21 @@
 
 /**
  * Maximum number of elements of a dpack array
+ *
+ * Set at build time using the #CONFIG_DPACK_ARRAY_ELMNR_MAX build
+ * configuration parameter.
+ *
+ * @see dpack_decoder_limit_array()
  */
-#define DPACK_ARRAY_ELMNR_MAX (1024U)
+#define DPACK_ARRAY_ELMNR_MAX STROLL_CONCAT(CONFIG_DPACK_ARRAY_ELMNR_MAX, U)
 
 /**
  * Maximum size of a dpack array element
+ *
+ * Set at build time using the #CONFIG_DPACK_ARRAY_ELMSZ_MAX build
+ * configuration parameter.
  */
-#define DPACK_ARRAY_ELMSZ_MAX (1024U)
+#define DPACK_ARRAY_ELMSZ_MAX STROLL_CONCAT(CONFIG_DPACK_ARRAY_ELMSZ_MAX, U)
 
 #if defined(CONFIG_DPACK_SCALAR)
 
@@ -90,8 +98,8 @@
 #define _DPACK_ARRAY32_ELMNR_MAX  UINT32_MAX
 
 /* Check DPACK_ARRAY_ELMNR_MAX definition is sensible. */
-#if DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY32_ELMNR_MAX
-#error MsgPack cannot encode arrays containing more that UINT32_MAX elements !
+#if DPACK_ARRAY_ELMNR_MAX > (_DPACK_ARRAY32_ELMNR_MAX / 2)
+#error DPack cannot encode arrays holding more than (UINT32_MAX / 2) items !
 #elif DPACK_ARRAY_ELMNR_MAX < 4U
 #error Huh ?!
 #endif
@@ -149,7 +157,7 @@
  * Maximum size of a dpack array data block
  */
 #define DPACK_ARRAY_DATA_SIZE_MAX \
-	(DPACK_ARRAY_ELMNR_MAX * DPACK_ARRAY_ELMSZ_MAX)
+	(1UL * DPACK_ARRAY_ELMNR_MAX * DPACK_ARRAY_ELMSZ_MAX)
 
 /**
  * Maximum size of a dpack array
@@ -158,9 +166,13 @@
 	(__DPACK_ARRAY_HEAD_SIZE(DPACK_ARRAY_ELMNR_MAX) + \
 	 DPACK_ARRAY_DATA_SIZE_MAX)
 
-#if DPACK_ARRAY_SIZE_MAX > (128U * 1024 * 1024)
-#error DPack cannot encode arrays which overall size > 128 MB !
-#endif /* DPACK_ARRAY_SIZE_MAX > (128U * 1024 * 1024) */
+/*
+ * Array sizes are computed using size_t and returned using ssize_t by multiple
+ * dpack functions: ensure the largest array size is still representable.
+ */
+#if DPACK_ARRAY_SIZE_MAX > (SIZE_MAX / 2)
+#error DPack cannot encode arrays which overall size > (SIZE_MAX / 2) !
+#endif /* DPACK_ARRAY_SIZE_MAX > (SIZE_MAX / 2) */
 
 #define _DPACK_ARRAY_HEAD_SIZE(_elm_nr) \
 	compile_eval(((_elm_nr) > 0) && \
@@ -911,10 +923,191 @@ dpack_array_end_encode(struct dpack_encoder * __restrict encoder __unused)
 	dpack_encoder_assert_api(encoder);
 }
 
+#if DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX
+#define _DPACK_ARRAY_OPEN_HEAD_SIZE DPACK_ARRAY32_TAG_SIZE
+#elif DPACK_ARRAY_ELMNR_MAX > _DPACK_FIXARRAY_ELMNR_MAX
+#define _DPACK_ARRAY_OPEN_HEAD_SIZE DPACK_ARRAY16_TAG_SIZE
+#else
+#define _DPACK_ARRAY_OPEN_HEAD_SIZE DPACK_FIXARRAY_TAG_SIZE
+#endif
+
+/**
+ * Size of the widest header reserved by array open-ended encoding.
+ *
+ * Size in bytes of the array header reserved by
+ * dpack_array_begin_encode_open() when given #DPACK_ARRAY_ELMNR_MAX as maximum
+ * number of elements.
+ *
+ * @see dpack_array_begin_encode_open()
+ */
+#define DPACK_ARRAY_OPEN_HEAD_SIZE _DPACK_ARRAY_OPEN_HEAD_SIZE
+
+/**
+ * Start encoding an array which number of elements is not known in advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    max_nr  maximum number of elements
+ * @param[out]   mark    location where to store reserved header mark
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOTSUP  @p encoder cannot patch already encoded data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ *
+ * Start encoding an array containing an arbitrary number of elements, up to
+ * @p max_nr. The header width is chosen as the smallest one able to encode
+ * @p max_nr elements, i.e. 1, 3 or 5 bytes. Give #DPACK_ARRAY_ELMNR_MAX to
+ * reserve the widest header, #DPACK_ARRAY_OPEN_HEAD_SIZE bytes. The header is
+ * reserved and its location returned via the @p mark argument.
+ *
+ * Call to this function must be followed by the elements to encode. Encoding
+ * must be completed either by a call to dpack_array_end_encode_open() given
+ * @p mark and the number of elements actually encoded so that the reserved
+ * header is patched in place, or by a call to
+ * dpack_array_cancel_encode_open() to drop everything encoded since
+ * @p mark.
+ *
+ * This requires @p encoder to support patching of already encoded data, which
+ * is the case of encoders initialized using dpack_encoder_init_buffer().
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is in error state before calling this function, or @p max_nr is
+ * greater than #DPACK_ARRAY_ELMNR_MAX, result is undefined. An assertion is
+ * triggered otherwise.
+ *
+ * @see
+ * - dpack_array_end_encode_open()
+ * - dpack_array_cancel_encode_open()
+ * - dpack_array_begin_encode()
+ */
+extern int
+dpack_array_begin_encode_open(struct dpack_encoder * __restrict      encoder,
+                              unsigned int                           max_nr,
+                              struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Complete encoding of an array which number of elements was not known in
+ * advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    mark    reserved header mark
+ * @param[in]    nr      number of elements encoded
+ * @param[in]    compact shrink header to its minimal width
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOTSUP  @p encoder cannot patch already encoded data
+ * @retval -ERANGE   @p mark is out of encoded data range
+ * @retval -EMSGSIZE @p nr does not fit into reserved header
+ *
+ * Complete encoding of an array started using
+ * dpack_array_begin_encode_open() by patching the header reserved at
+ * @p mark with the @p nr number of elements. @p nr may be zero, in which case
+ * an empty array is encoded.
+ *
+ * When @p compact is ``true`` and @p encoder supports it, the header is
+ * shrunk to the minimal width required to encode @p nr and encoded elements
+ * are moved backward accordingly. Otherwise, the reserved header width is
+ * kept, which is a valid albeit non minimal MessagePack encoding.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p encoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p nr is greater than #DPACK_ARRAY_ELMNR_MAX, result is undefined. An
+ *   assertion is triggered otherwise.
+ * - Compacting the header moves data encoded after @p mark backward. Complete
+ *   nested open-ended containers before enclosing ones.
+ *
+ * @see
+ * - dpack_array_begin_encode_open()
+ * - dpack_array_cancel_encode_open()
+ */
+extern int
+dpack_array_end_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark,
+	unsigned int                                 nr,
+	bool                                         compact)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Cancel encoding of an array which number of elements was not known in
+ * advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    mark    reserved header mark
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -ENOTSUP @p encoder cannot remove already encoded data
+ * @retval -ERANGE  @p mark is out of encoded data range
+ *
+ * Abort encoding of an array started using dpack_array_begin_encode_open() by
+ * removing the header reserved at @p mark as well as all data encoded after
+ * it, so that no dangling header is left behind, e.g. when a filtered
+ * iterator turns out to yield nothing worth encoding.
+ *
+ * This requires @p encoder to support removal of already encoded data, which
+ * is the case of encoders initialized using dpack_encoder_init_buffer().
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is in error state before calling this function, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_array_begin_encode_open()
+ * - dpack_array_end_encode_open()
+ */
+extern int
+dpack_array_cancel_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
 /******************************************************************************
  * Basic array decoding
  ******************************************************************************/
 
+/**
+ * Restrict the number of array elements a decoder accepts.
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    nr      maximum number of elements
+ *
+ * Lower the maximum number of elements of arrays @p decoder accepts below the
+ * #DPACK_ARRAY_ELMNR_MAX build time limit. Decoding an array which header
+ * announces more than @p nr elements fails with ``-EMSGSIZE`` error code
+ * before any element is processed and without discarding the array content.
+ *
+ * This allows to bound resources consumed while decoding untrusted input on a
+ * per-decoder basis without rebuilding dpack.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p nr is zero or greater than #DPACK_ARRAY_ELMNR_MAX, result is undefined.
+ *   An assertion is triggered otherwise.
+ *
+ * @see
+ * - DPACK_ARRAY_ELMNR_MAX
+ * - dpack_decoder_limit_map()
+ */
+static inline __dpack_nonull(1) __dpack_nothrow
+void
+dpack_decoder_limit_array(struct dpack_decoder * __restrict decoder,
+                          unsigned int                      nr)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_ARRAY_ELMNR_MAX);
+
+	decoder->elm_max = nr;
+}
+
 extern int
 dpack_array_decode_count(struct dpack_decoder * __restrict decoder,
                          unsigned int * __restrict         count)
@@ -1036,4 +1229,247 @@ dpack_array_decode_range(struct dpack_decoder * __restrict decoder,
                          void * __restrict                 data)
 	__dpack_nonull(1, 4) __warn_result __dpack_export;
 
+#if defined(CONFIG_DPACK_STRING)
+
+/******************************************************************************
+ * Array of strings decoding
+ ******************************************************************************/
+
+/**
+ * Decode an array of strings encoded according to the MessagePack format into
+ * a single string table
+ *
+ * @param[inout] decoder decoder
+ * @param[out]   table   location where to store pointer to allocated table
+ *
+ * @return number of decoded strings when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize an array of strings encoded according to the
+ * @rstsubst{MessagePack array format} and @rstsubst{MessagePack string format}
+ * from buffer assigned to @p decoder at initialization time.
+ *
+ * All decoded strings are stored into a single memory block allocated using
+ * @man{malloc(3)}. The block starts with a table of pointers to decoded strings
+ * followed by a terminating ``NULL`` pointer, then by the decoded ``NULL``
+ * terminated strings, stored contiguously in array order. A pointer to the
+ * table is returned via the @p table argument. Release the whole table using a
+ * single call to @man{free(3)} once no longer needed.
+ *
+ * This is meant to replace the combination of dpack_array_decode() and
+ * dpack_decode_strdup() which requires one allocation per string and scatters
+ * strings all over the heap.
+ *
+ * Decoding an array containing more than #DPACK_ARRAY_ELMNR_MAX strings or
+ * strings longer than #DPACK_STRLEN_MAX will cause a ``-EMSGSIZE`` error code
+ * to be returned.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p decoder is in error state before calling this function, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_array_decode_strtab_range()
+ * - dpack_array_decode()
+ * - dpack_decode_strdup()
+ */
+extern int
+dpack_array_decode_strtab(struct dpack_decoder * __restrict decoder,
+                          char *** __restrict               table)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Decode an array of strings encoded according to the MessagePack format into
+ * a single string table with requested minimum and maximum number of strings
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    min_nr  minimum number of strings
+ * @param[in]    max_nr  maximum number of strings
+ * @param[out]   table   location where to store pointer to allocated table
+ *
+ * @return number of decoded strings when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Just as dpack_array_decode_strtab() but fails with a ``-EMSGSIZE`` error code
+ * when the number of encoded strings is smaller than @p min_nr or larger than
+ * @p max_nr.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p min_nr is zero or greater than @p max_nr, or @p max_nr is greater than
+ *   #DPACK_ARRAY_ELMNR_MAX, result is undefined. An assertion is triggered
+ *   otherwise.
+ *
+ * @see
+ * - dpack_array_decode_strtab()
+ */
+extern int
+dpack_array_decode_strtab_range(struct dpack_decoder * __restrict decoder,
+                                unsigned int                      min_nr,
+                                unsigned int                      max_nr,
+                                char *** __restrict               table)
+	__dpack_nonull(1, 4) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_STRING) */
+
+#if defined(CONFIG_DPACK_ARRAY_PARALLEL)
+
+#include <sys/uio.h>
+
+/******************************************************************************
+ * Parallel array encoding
+ ******************************************************************************/
+
+/**
+ * Array encoded in parallel as a sequence of separately allocated slices.
+ *
+ * Serialized array is made of the @p nr first entries of the @p iov vector:
+ * the first one points to the array header while subsequent ones point to
+ * encoded slices of elements, in order.
+ *
+ * @see
+ * - dpack_array_encode_parallel()
+ * - dpack_array_slices_writev()
+ * - dpack_array_slices_copy()
+ * - dpack_array_slices_fini()
+ */
+struct dpack_array_slices {
+	/** Number of entries of @p iov, header included. */
+	unsigned int   nr;
+	/** Vector of header and encoded slices. */
+	struct iovec * iov;
+	/** Overall size of serialized array. */
+	size_t         size;
+	/** Serialized array header storage. */
+	uint8_t        head[DPACK_ARRAY32_TAG_SIZE];
+};
+
+/**
+ * Encode an array in parallel.
+ *
+ * @param[out]   slices    encoded array slices
+ * @param[in]    elm_nr    number of array elements
+ * @param[in]    encode    element encoding callback
+ * @param[inout] data      optional arbitrary user data given to @p encode
+ * @param[in]    thread_nr number of threads to use
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Oversized encoded elements
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Split the range of @p elm_nr array elements into slices and encode them
+ * using up to @p thread_nr threads, the calling thread included. Each slice is
+ * encoded into its own buffer which is grown on demand. The resulting slices
+ * are laid out behind a single array header sized according to @p elm_nr.
+ *
+ * @p encode is called from an arbitrary thread and *MUST* be safe to call
+ * concurrently for distinct element indices. It is called once per element,
+ * except for an element which encoding overflows its slice buffer: it is
+ * called once again for this element after the buffer has been grown and
+ * *MUST* then produce identical output. Apart from ``-EMSGSIZE`` returned
+ * while space was short, any error returned by @p encode interrupts encoding
+ * of all slices and is returned to the caller.
+ *
+ * Once successfully encoded, the array may be emitted using
+ * dpack_array_slices_writev() without any additional copy, or using
+ * dpack_array_slices_copy() to embed it within data encoded thanks to an
+ * existing encoder. @p slices *MUST* be released using
+ * dpack_array_slices_fini() afterwards.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p elm_nr is zero or greater than #DPACK_ARRAY_ELMNR_MAX, or @p thread_nr is
+ * zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_array_slices_writev()
+ * - dpack_array_slices_copy()
+ * - dpack_array_slices_fini()
+ * - dpack_array_begin_encode()
+ */
+extern int
+dpack_array_encode_parallel(struct dpack_array_slices * __restrict slices,
+                            unsigned int                           elm_nr,
+                            dpack_encode_item_fn *                 encode,
+                            void * __restrict                      data,
+                            unsigned int                           thread_nr)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Write an array encoded in parallel to a file descriptor.
+ *
+ * @param[in] slices encoded array slices
+ * @param[in] fd     file descriptor to write to
+ *
+ * @return an errno like error code
+ * @retval 0    Success
+ * @retval <0   @man{writev(2)} error code
+ *
+ * Write the serialized array described by @p slices to @p fd using
+ * @man{writev(2)} so that no copy of encoded data is required. Partial writes
+ * and interruptions by signals are handled transparently.
+ *
+ * @see
+ * - dpack_array_encode_parallel()
+ */
+extern int
+dpack_array_slices_writev(const struct dpack_array_slices * __restrict slices,
+                          int                                          fd)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Copy an array encoded in parallel into an encoder.
+ *
+ * @param[in]    slices  encoded array slices
+ * @param[inout] encoder encoder
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ *
+ * Append the serialized array described by @p slices to data already encoded
+ * using @p encoder. This allows to embed an array encoded in parallel into an
+ * enclosing collection.
+ *
+ * @see
+ * - dpack_array_encode_parallel()
+ */
+extern int
+dpack_array_slices_copy(const struct dpack_array_slices * __restrict slices,
+                        struct dpack_encoder * __restrict            encoder)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Release resources allocated for an array encoded in parallel.
+ *
+ * @param[inout] slices encoded array slices
+ *
+ * @see
+ * - dpack_array_encode_parallel()
+ */
+extern void
+dpack_array_slices_fini(struct dpack_array_slices * __restrict slices)
+	__dpack_nonull(1) __dpack_nothrow __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_ARRAY_PARALLEL) */
+
 #endif /* _DPACK_ARRAY_H */
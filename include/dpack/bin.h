@@ -24,6 +24,7 @@
 
 struct dpack_encoder;
 struct dpack_decoder;
+struct dpack_backing;
 
 /**
  * Maximum size of a bin
@@ -556,4 +557,56 @@ dpack_decode_bincpy_range(struct dpack_decoder * __restrict decoder,
                           uint8_t * __restrict              value)
 	__dpack_nonull(1, 4) __warn_result __dpack_export;
 
+/**
+ * Decode a bin encoded according to the MessagePack format without copying it
+ * when possible
+ *
+ * @param[inout] decoder decoder
+ * @param[out]   value   location where to store pointer to decoded bin
+ * @param[out]   backing location where to store decoder backing storage
+ *                       reference
+ *
+ * @return size of decoded bin when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize data item encoded according to the
+ * @rstsubst{MessagePack bin format} from buffer assigned to @p decoder at
+ * initialization time.
+ *
+ * When @p decoder is able to lend the encoded bin, i.e., when it was
+ * initialized using dpack_decoder_init_backed_buffer() or
+ * dpack_decoder_init_file(), @p value points right into @p decoder backing
+ * storage and a reference to the latter is returned via the @p backing
+ * argument. Release it using dpack_backing_put() once @p value is no longer
+ * needed.
+ *
+ * Otherwise, the decoded bin is allocated using @man{malloc(3)} and ``NULL`` is
+ * returned via the @p backing argument. Release @p value using @man{free(3)}
+ * once no longer needed in this case.
+ *
+ * Decoding a bin larger than #DPACK_BINSZ_MAX will cause a ``-EMSGSIZE`` error
+ * code to be returned.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p decoder is in error state before calling this function, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_bindup()
+ * - dpack_decoder_init_backed_buffer()
+ * - dpack_backing_put()
+ */
+extern ssize_t
+dpack_decode_bin_lend(struct dpack_decoder * __restrict  decoder,
+                      const uint8_t ** __restrict        value,
+                      struct dpack_backing ** __restrict backing)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
 #endif /* _DPACK_BIN_H */
@@ -22,6 +22,8 @@
 #include <dpack/cdefs.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <sys/types.h>
 #include <errno.h>
 
 /******************************************************************************
@@ -42,11 +44,32 @@ typedef int dpack_encoder_write_fn(struct dpack_encoder * __restrict,
 typedef int dpack_encoder_fini_fn(struct dpack_encoder * __restrict)
 	__dpack_nonull(1);
 
+/*
+ * Overwrite already encoded data at given offset. Optional: encoders that
+ * cannot seek backward leave it NULL.
+ */
+typedef int dpack_encoder_patch_fn(struct dpack_encoder * __restrict,
+                                   size_t,
+                                   const uint8_t * __restrict,
+                                   size_t)
+	__dpack_nonull(1, 3);
+
+/*
+ * Remove already encoded data at given offset, moving subsequent data
+ * backward. Optional.
+ */
+typedef int dpack_encoder_cut_fn(struct dpack_encoder * __restrict,
+                                 size_t,
+                                 size_t)
+	__dpack_nonull(1);
+
 struct dpack_encoder_ops {
 	dpack_encoder_space_fn * left;
 	dpack_encoder_space_fn * used;
 	dpack_encoder_write_fn * write;
 	dpack_encoder_fini_fn *  fini;
+	dpack_encoder_patch_fn * patch;
+	dpack_encoder_cut_fn *   cut;
 };
 
 #define dpack_encoder_assert_ops_api(_ops) \
@@ -73,6 +96,19 @@ struct dpack_encoder {
 	dpack_assert_api(_encoder); \
 	dpack_encoder_assert_ops_api((_encoder)->ops)
 
+/**
+ * Open-ended container encoding mark.
+ *
+ * Records location and width of a container header reserved by
+ * dpack_array_begin_encode_open() or dpack_map_begin_encode_open().
+ */
+struct dpack_encoder_mark {
+	/** Offset of reserved header. */
+	size_t off;
+	/** Size of reserved header in bytes. */
+	size_t size;
+};
+
 /**
  * Return buffer space left for encoding purpose.
  *
@@ -213,6 +249,82 @@ dpack_encoder_init_buffer(struct dpack_encoder_buffer * __restrict encoder,
                           size_t                                   size)
 	__dpack_nonull(1, 2) __dpack_nothrow __leaf __dpack_export;
 
+struct dpack_encoder_count {
+	struct dpack_encoder base;
+	size_t               size;
+};
+
+extern const struct dpack_encoder_ops dpack_encoder_count_ops;
+
+#define DPACK_ENCODER_INIT_COUNT() \
+	{ \
+		.base = DPACK_ENCODER_INIT(&dpack_encoder_count_ops), \
+		.size = 0 \
+	}
+
+/**
+ * Initialize a MessagePack encoder counting encoded bytes
+ *
+ * @param[inout] encoder encoder
+ *
+ * Initialize a @rstsubst{MessagePack} encoder which does not store anything
+ * but accumulates the number of bytes it is requested to encode / pack /
+ * serialize instead.
+ *
+ * This allows to compute the exact packed size of dynamically sized objects by
+ * running existing packing logic once against @p encoder, then retrieving the
+ * result using dpack_encoder_space_used(). The resulting size may be used to
+ * allocate a buffer of exact size or to make size based routing decisions
+ * without having to rely upon worst case size estimations.
+ *
+ * Open-ended containers encoding is supported, including header compaction, so
+ * that counting gives the same result as a real encoding would.
+ *
+ * @see
+ * - dpack_encoder_space_used()
+ * - dpack_encoder_init_buffer()
+ * - dpack_encoder_fini()
+ */
+extern void
+dpack_encoder_init_count(struct dpack_encoder_count * __restrict encoder)
+	__dpack_nonull(1) __dpack_nothrow __leaf __dpack_export;
+
+/**
+ * Splice already encoded MessagePack data into an encoder
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    data    encoded data
+ * @param[in]    size    size of @p data in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval <0        Other encoder specific error code
+ *
+ * Copy @p data as is into @p encoder. @p data is expected to hold exactly one
+ * item encoded according to the @rstsubst{MessagePack format}, e.g. the cached
+ * encoded form of an immutable object produced by a former encoding run. This
+ * allows to insert such objects into messages at the cost of a copy instead of
+ * encoding them again.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ * In addition, when compiled with both #CONFIG_DPACK_ASSERT_API and
+ * #CONFIG_DPACK_CODEC_BUFFER build options enabled, an assertion is triggered
+ * when @p data does not hold exactly one well-formed item, as far as item
+ * types supported by the current build configuration are concerned.
+ *
+ * @see
+ * - dpack_map_encode_raw()
+ * - dpack_decoder_discard()
+ */
+extern int
+dpack_encode_raw(struct dpack_encoder * __restrict encoder,
+                 const uint8_t * __restrict        data,
+                 size_t                            size)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
 /******************************************************************************
  * Decoder / unpacker
  ******************************************************************************/
@@ -257,6 +369,31 @@ typedef int dpack_decode_item_fn(struct dpack_decoder * __restrict,
                                  unsigned int,
                                  void * __restrict);
 
+/**
+ * Collection item encoding callback.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    id      collection item index
+ * @param[inout] data    optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by collection encoding functions such as
+ * dpack_array_encode_parallel() to encode the item located at index @p id of
+ * the collection that is being encoded, starting from zero.
+ *
+ * The callback function should **return** ``0`` in case of success. When
+ * returning a *negative error* code, current collection encoding process is
+ * interrupted and the error code is returned to the caller of the collection
+ * encoding function.
+ *
+ * @see
+ * - dpack_array_encode_parallel()
+ */
+typedef int dpack_encode_item_fn(struct dpack_encoder * __restrict,
+                                 unsigned int,
+                                 void * __restrict);
+
 typedef size_t dpack_decoder_left_fn(const struct dpack_decoder * __restrict)
 	__dpack_nonull(1) __warn_result;
 
@@ -271,11 +408,25 @@ typedef int dpack_decoder_skip_fn(struct dpack_decoder * __restrict, size_t)
 typedef int dpack_decoder_fini_fn(struct dpack_decoder * __restrict)
 	__dpack_nonull(1);
 
+struct dpack_backing;
+
+/*
+ * Lend a contiguous span of encoded data straight from the decoder backing
+ * storage and consume it. Optional: backends that cannot alias their input
+ * leave it NULL.
+ */
+typedef int dpack_decoder_borrow_fn(struct dpack_decoder * __restrict,
+                                    size_t,
+                                    const uint8_t ** __restrict,
+                                    struct dpack_backing ** __restrict)
+	__dpack_nonull(1, 3, 4);
+
 struct dpack_decoder_ops {
-	dpack_decoder_left_fn * left;
-	dpack_decoder_read_fn * read;
-	dpack_decoder_skip_fn * skip;
-	dpack_decoder_fini_fn * fini;
+	dpack_decoder_left_fn *   left;
+	dpack_decoder_read_fn *   read;
+	dpack_decoder_skip_fn *   skip;
+	dpack_decoder_fini_fn *   fini;
+	dpack_decoder_borrow_fn * borrow;
 };
 
 #define DPACK_DECODER_INIT_OPS(_left, _read, _skip, _fini) \
@@ -302,13 +453,20 @@ struct dpack_decoder_ops {
 struct dpack_decoder {
 	const struct dpack_decoder_ops * ops;
 	bool                             disc;
+	unsigned int                     elm_max;
+	unsigned int                     fld_max;
 };
 
 #define DPACK_DECODER_DISC   (true)
 #define DPACK_DECODER_NODISC (false)
 
 #define DPACK_DECODER_INIT(_ops, _disc) \
-	{ .ops = _ops, .disc = _disc }
+	{ \
+		.ops = _ops, \
+		.disc = _disc, \
+		.elm_max = UINT_MAX, \
+		.fld_max = UINT_MAX \
+	}
 
 #define dpack_decoder_assert_api(_decoder) \
 	dpack_assert_api(_decoder); \
@@ -357,6 +515,109 @@ extern int
 dpack_decoder_discard(struct dpack_decoder * __restrict decoder)
 	__dpack_nonull(1) __warn_result __dpack_export;
 
+/**
+ * Extract next encoded item without decoding it, without copying it when
+ * possible
+ *
+ * @param[inout] decoder decoder
+ * @param[out]   data    location where to store pointer to encoded item
+ * @param[out]   backing location where to store decoder backing storage
+ *                       reference
+ *
+ * @return size of encoded item when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENODATA  Truncated MessagePack stream
+ * @retval -EMSGSIZE Encoded item too large
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Consume the next complete item encoded according to the
+ * @rstsubst{MessagePack format}, nested collections included, and return the
+ * span of encoded bytes it is made of. The span may be forwarded as is, using
+ * dpack_encode_raw() for example.
+ *
+ * Item boundaries are computed the same way dpack_decoder_discard() does, hence
+ * extracting items of types not supported by the current build configuration
+ * will cause a ``-ENOTSUP`` error code to be returned.
+ *
+ * When @p decoder was initialized using dpack_decoder_init_buffer() or
+ * dpack_decoder_init_discard_buffer(), @p data points right into the buffer
+ * given at initialization time and ``NULL`` is returned via the @p backing
+ * argument. @p data remains valid as long as this buffer does: there is nothing
+ * to release.
+ *
+ * When @p decoder is able to lend the encoded item as a whole, i.e., when it
+ * was initialized using dpack_decoder_init_backed_buffer(), or using
+ * dpack_decoder_init_file() and the item does not cross a data mapping window
+ * boundary, @p data points right into @p decoder backing storage and a
+ * reference to the latter is returned via the @p backing argument. Release it
+ * using dpack_backing_put() once @p data is no longer needed.
+ *
+ * Otherwise, the encoded item is copied into a buffer allocated using
+ * @man{malloc(3)} and ``NULL`` is returned via the @p backing argument. Release
+ * @p data using @man{free(3)} once no longer needed in this case.
+ *
+ * On error, buffer based decoders are left untouched. Other decoders are left
+ * in the middle of the item and should only be finalized afterwards.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p decoder is in error state before calling this function, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_rawcpy()
+ * - dpack_decoder_discard()
+ * - dpack_encode_raw()
+ * - dpack_backing_put()
+ */
+extern ssize_t
+dpack_decode_raw(struct dpack_decoder * __restrict  decoder,
+                 const uint8_t ** __restrict        data,
+                 struct dpack_backing ** __restrict backing)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
+/**
+ * Extract next encoded item without decoding it into a caller supplied buffer
+ *
+ * @param[inout] decoder decoder
+ * @param[out]   data    buffer where to store encoded item
+ * @param[in]    size    size of @p data buffer in bytes
+ *
+ * @return size of encoded item when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENODATA  Truncated MessagePack stream
+ * @retval -EMSGSIZE Encoded item larger than @p size bytes
+ *
+ * Same as dpack_decode_raw() except that the encoded item is always copied into
+ * the @p data buffer. This works with all decoders, including those which
+ * cannot lend their backing storage, e.g. streaming ones.
+ *
+ * On error, buffer based decoders are left untouched so that a larger @p data
+ * buffer may be supplied upon ``-EMSGSIZE``. Other decoders are left in the
+ * middle of the item and should only be finalized afterwards.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p size is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_raw()
+ */
+extern ssize_t
+dpack_decode_rawcpy(struct dpack_decoder * __restrict decoder,
+                    uint8_t * __restrict              data,
+                    size_t                            size)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
 static inline __dpack_nonull(1, 2) __dpack_nothrow
 void
 dpack_decoder_init(struct dpack_decoder * __restrict           decoder,
@@ -368,6 +629,8 @@ dpack_decoder_init(struct dpack_decoder * __restrict           decoder,
 
 	decoder->ops= ops;
 	decoder->disc = discard;
+	decoder->elm_max = UINT_MAX;
+	decoder->fld_max = UINT_MAX;
 }
 
 /**
@@ -394,13 +657,119 @@ dpack_decoder_fini(struct dpack_decoder * __restrict decoder)
 	return decoder->ops->fini(decoder);
 }
 
+/******************************************************************************
+ * Decoder backing storage
+ ******************************************************************************/
+
+typedef void dpack_backing_release_fn(struct dpack_backing * __restrict)
+	__dpack_nonull(1);
+
+/**
+ * Decoder backing storage.
+ *
+ * A reference counted memory area holding encoded data a decoder operates on.
+ * Decoded strings and bins may alias it instead of being copied as long as a
+ * reference to it is held.
+ *
+ * @see
+ * - dpack_backing_create()
+ * - dpack_backing_get()
+ * - dpack_backing_put()
+ */
+struct dpack_backing {
+	/** @internal */
+	unsigned int               refcnt;
+	/** Whether @p data may be modified in place. */
+	bool                       rdonly;
+	/** Size of @p data in bytes. */
+	size_t                     size;
+	/** Address of backing memory area. */
+	uint8_t *                  data;
+	/** @internal */
+	dpack_backing_release_fn * release;
+};
+
+#define dpack_backing_assert_api(_backing) \
+	dpack_assert_api(_backing); \
+	dpack_assert_api((_backing)->refcnt); \
+	dpack_assert_api((_backing)->size); \
+	dpack_assert_api((_backing)->data); \
+	dpack_assert_api((_backing)->release)
+
+/**
+ * Acquire a reference to a decoder backing storage
+ *
+ * @param[inout] backing backing storage
+ *
+ * @return @p backing
+ *
+ * @see dpack_backing_put()
+ */
+static inline __dpack_nonull(1) __dpack_nothrow
+struct dpack_backing *
+dpack_backing_get(struct dpack_backing * __restrict backing)
+{
+	dpack_backing_assert_api(backing);
+
+	__atomic_add_fetch(&backing->refcnt, 1, __ATOMIC_RELAXED);
+
+	return backing;
+}
+
+/**
+ * Release a reference to a decoder backing storage
+ *
+ * @param[inout] backing backing storage
+ *
+ * Drop a reference to @p backing. Memory backing @p backing is released when
+ * the last reference is dropped.
+ *
+ * @see dpack_backing_get()
+ */
+static inline __dpack_nonull(1)
+void
+dpack_backing_put(struct dpack_backing * __restrict backing)
+{
+	dpack_backing_assert_api(backing);
+
+	if (!__atomic_sub_fetch(&backing->refcnt, 1, __ATOMIC_ACQ_REL))
+		backing->release(backing);
+}
+
 #if defined(CONFIG_DPACK_CODEC_BUFFER)
 
+/**
+ * Allocate a decoder backing storage
+ *
+ * @param[in] size size of backing memory area in bytes
+ *
+ * @return a pointer to backing storage when successful, ``NULL`` otherwise
+ *
+ * Allocate a writable memory area of @p size bytes using @man{malloc(3)} and
+ * return it with a single reference held. Fill the area pointed to by
+ * dpack_backing::data with encoded data and hand it to a decoder using
+ * dpack_decoder_init_backed_buffer(). Then drop the initial reference using
+ * dpack_backing_put() once no longer needed.
+ *
+ * @man{errno(3)} is set to ``ENOMEM`` in case of allocation failure.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_backing_put()
+ * - dpack_decoder_init_backed_buffer()
+ */
+extern struct dpack_backing *
+dpack_backing_create(size_t size) __warn_result __dpack_export;
+
 struct dpack_decoder_buffer {
-	struct dpack_decoder base;
-	size_t               head;
-	size_t               capa;
-	const uint8_t *      buff;
+	struct dpack_decoder   base;
+	size_t                 head;
+	size_t                 capa;
+	const uint8_t *        buff;
+	struct dpack_backing * back;
 };
 
 extern const struct dpack_decoder_ops dpack_decoder_buffer_ops;
@@ -411,7 +780,8 @@ extern const struct dpack_decoder_ops dpack_decoder_buffer_ops;
 		                           DPACK_DECODER_NODISC), \
 		.head = 0, \
 		.capa = _size, \
-		.buff = _buff \
+		.buff = _buff, \
+		.back = NULL \
 	}
 
 extern void
@@ -476,6 +846,51 @@ dpack_decoder_init_discard_buffer(
 	_dpack_decoder_init_buffer(decoder, buffer, size, DPACK_DECODER_DISC);
 }
 
+extern void
+_dpack_decoder_init_backed_buffer(
+	struct dpack_decoder_buffer * __restrict decoder,
+	struct dpack_backing * __restrict        backing,
+	size_t                                   size,
+	bool                                     discard)
+	__dpack_nonull(1, 2) __dpack_nothrow __leaf __dpack_export;
+
+/**
+ * Initialize a MessagePack decoder with backing storage
+ *
+ * @param[inout] decoder decoder
+ * @param[inout] backing backing storage
+ * @param[in]    size    size of encoded data
+ *
+ * Initialize a @rstsubst{MessagePack} decoder for decoding / unpacking /
+ * deserialization of the first @p size bytes of @p backing storage.
+ *
+ * @p decoder holds a reference to @p backing until dpack_decoder_fini() is
+ * called. In addition, strings and bins decoded using dpack_decode_lvstr_lend()
+ * and dpack_decode_bin_lend() alias @p backing memory area and hold their own
+ * reference, allowing them to outlive @p decoder.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero or greater than @p backing size, result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_backing_create()
+ * - dpack_decoder_fini()
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_decoder_init_backed_buffer(
+	struct dpack_decoder_buffer * __restrict decoder,
+	struct dpack_backing * __restrict        backing,
+	size_t                                   size)
+{
+	_dpack_decoder_init_backed_buffer(decoder,
+	                                  backing,
+	                                  size,
+	                                  DPACK_DECODER_NODISC);
+}
+
 #endif /* defined(CONFIG_DPACK_CODEC_BUFFER) */
 
 #if defined(CONFIG_DPACK_CODEC_FILE)
@@ -484,19 +899,21 @@ dpack_decoder_init_discard_buffer(
 #include <sys/types.h>
 
 struct dpack_decoder_file {
-	struct dpack_decoder base;
+	struct dpack_decoder   base;
 	/* Current offset from start of file. */
-	off_t                foff;
+	off_t                  foff;
 	/* Current offset of data mapping window base from start of file. */
-	off_t                moff;
+	off_t                  moff;
 	/* Size of file. */
-	off_t                fsize;
+	off_t                  fsize;
 	/* Size of data mapping window in bytes. */
-	size_t               msize;
+	size_t                 msize;
 	/* Address of data mapping window. */
-	const uint8_t *      map;
+	const uint8_t *        map;
+	/* Data mapping window backing storage. */
+	struct dpack_backing * win;
 	/* File descriptor. */
-	int                  fd;
+	int                    fd;
 };
 
 #define DPACK_DECODER_FILE_MSIZE_MAX \
@@ -545,6 +962,116 @@ dpack_decoder_init_file(struct dpack_decoder_file * __restrict decoder,
 	                                   discard);
 }
 
+#if defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+
+/**
+ * File message decoding callback.
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    offset  offset of message from start of file
+ * @param[inout] data    optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_decode_file_parallel() to decode a single message
+ * located at offset @p offset from the start of the file being decoded.
+ * @p decoder starts at this message and extends up to the end of the range of
+ * messages it belongs to.
+ *
+ * Size of the message is given by the amount of data consumed from
+ * @p decoder: the callback *MUST* therefore decode the whole message, using
+ * dpack_decoder_discard() to skip over parts it is not interested in. A
+ * message left untouched is skipped over.
+ *
+ * The callback function should **return** ``0`` in case of success. When
+ * returning a *negative error* code, decoding is interrupted and the error
+ * code is returned to the caller of dpack_decode_file_parallel().
+ *
+ * @see
+ * - dpack_decode_file_parallel()
+ */
+typedef int dpack_decode_file_fn(struct dpack_decoder * __restrict,
+                                 off_t,
+                                 void * __restrict);
+
+/**
+ * Decode a file of concatenated messages in parallel.
+ *
+ * @param[in]    dir       directory file descriptor
+ * @param[in]    path      pathname of file to decode
+ * @param[in]    decode    message decoding callback
+ * @param[inout] data      optional arbitrary user data given to @p decode
+ * @param[in]    thread_nr number of threads to use
+ *
+ * @return an errno like error code
+ * @retval 0          Success
+ * @retval -EBADMSG   Invalid MessagePack data
+ * @retval -ENODATA   Empty file or truncated last message
+ * @retval -ENOMEM    Memory allocation failure
+ * @retval -EOVERFLOW File too large to be mapped
+ * @retval <0         @man{open(2)} or @man{mmap(2)} error code
+ *
+ * Decode the file located at @p path, relative to @p dir when not absolute,
+ * and made of back-to-back dpack messages using up to @p thread_nr threads,
+ * the calling thread included.
+ *
+ * The whole file is mapped into memory and split into ranges of similar sizes
+ * starting at sampled offsets. Threads concurrently scan ranges from these
+ * offsets by skipping over encoded data without decoding it. Range starts are
+ * then resynchronized forward to the first message boundary reached by the
+ * scan of the previous range, which is found among boundaries recorded while
+ * scanning and requires no further walk unless the scan could not lock onto
+ * message boundaries in time.
+ *
+ * Ranges are finally handed to threads. Each thread walks its range using its
+ * own decoder and calls @p decode once per message in a single pass.
+ *
+ * Messages belonging to the same range are handed to @p decode in file order
+ * while messages of distinct ranges are handed concurrently and in no
+ * particular order. @p decode *MUST* therefore be safe to call concurrently.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p thread_nr is zero, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_decode_file_fn
+ * - dpack_decoder_init_file_at()
+ */
+extern int
+dpack_decode_file_parallel_at(int                     dir,
+                              const char * __restrict path,
+                              dpack_decode_file_fn *  decode,
+                              void * __restrict       data,
+                              unsigned int            thread_nr)
+	__dpack_nonull(2, 3) __warn_result __dpack_export;
+
+/**
+ * Decode a file of concatenated messages in parallel.
+ *
+ * Just as dpack_decode_file_parallel_at() with @p path relative to the current
+ * working directory when not absolute.
+ *
+ * @see
+ * - dpack_decode_file_parallel_at()
+ */
+static inline __dpack_nonull(1, 2) __warn_result
+int
+dpack_decode_file_parallel(const char * __restrict path,
+                           dpack_decode_file_fn *  decode,
+                           void * __restrict       data,
+                           unsigned int            thread_nr)
+{
+	return dpack_decode_file_parallel_at(AT_FDCWD,
+	                                     path,
+	                                     decode,
+	                                     data,
+	                                     thread_nr);
+}
+
+#endif /* defined(CONFIG_DPACK_CODEC_FILE_PARALLEL) */
+
 #endif /* defined(CONFIG_DPACK_CODEC_FILE) */
 
 #endif /* _DPACK_CODEC_H */
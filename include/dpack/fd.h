@@ -0,0 +1,212 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Buffered file descriptor encoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_FD_H
+#define _DPACK_FD_H
+
+#include <dpack/codec.h>
+
+/**
+ * Maximum number of buffered file descriptor encoder chunks.
+ *
+ * Matches the maximum number of vectors a single @man{writev(2)} call may
+ * be given.
+ */
+#define DPACK_ENCODER_FD_CHUNK_NR_MAX (1024U)
+
+struct dpack_fd_chunk;
+
+/**
+ * Buffered file descriptor encoder
+ *
+ * An encoder packing data into a chain of fixed size chunks which are written
+ * to a file descriptor using a single @man{writev(2)} call once enough data
+ * is pending or pending data has been waiting for too long.
+ *
+ * @see
+ * - dpack_encoder_init_fd()
+ * - dpack_encoder_flush_fd()
+ * - dpack_encoder_fd_timeout()
+ */
+struct dpack_encoder_fd {
+	struct dpack_encoder    base;
+	/* Number of bytes written so far. */
+	size_t                  done;
+	/* Number of bytes pending for write. */
+	size_t                  pend;
+	/* Number of pending bytes triggering a write. */
+	size_t                  thres;
+	/* Size of a chunk in bytes. */
+	size_t                  csize;
+	/* Chunks memory area. */
+	uint8_t *               mem;
+	/* Per chunk pending data location. */
+	struct dpack_fd_chunk * chunks;
+	/* Write vectors given to writev(2). */
+	struct iovec *          iovs;
+	/* Monotonic time pending data must be written at, in nanoseconds. */
+	uint64_t                due;
+	/* Maximum time pending data may wait for, in nanoseconds. */
+	uint64_t                delay;
+	/* Number of chunks. */
+	unsigned int            nr;
+	/* Index of oldest chunk holding pending data. */
+	unsigned int            first;
+	/* Number of chunks holding pending data. */
+	unsigned int            cnt;
+	/* Error that broke encoding, if any. */
+	int                     err;
+	/* File descriptor. */
+	int                     fd;
+};
+
+/**
+ * Initialize a MessagePack encoder with a file descriptor
+ *
+ * @param[out] encoder encoder
+ * @param[in]  fd      file descriptor to write to
+ * @param[in]  size    size of a chunk in bytes
+ * @param[in]  nr      number of chunks
+ * @param[in]  thres   number of pending bytes triggering a write
+ * @param[in]  delay   maximum time pending data may wait for, in milliseconds
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Initialize a @rstsubst{MessagePack} encoder packing data into a chain of
+ * @p nr chunks of @p size bytes, then streaming them to @p fd, so that
+ * messages may be written without holding them entirely in memory.
+ *
+ * Pending chunks are written at once using a single @man{writev(2)} call as
+ * soon as either:
+ * - at least @p thres bytes are pending, or
+ * - the oldest pending byte has been waiting for at least @p delay
+ *   milliseconds, or
+ * - chunks are all full.
+ *
+ * To keep encoding cheap, the clock is sampled once per write cycle only, when
+ * data is first left pending, and expiry of @p delay is not checked when
+ * encoding: callers should bound their wait for events using
+ * dpack_encoder_fd_timeout() and call dpack_encoder_flush_fd() on timeout.
+ *
+ * @p fd may be in non-blocking mode. When it cannot accept more data, pending
+ * data is kept and encoding proceeds until all chunks are full. Encoding then
+ * fails with ``-EAGAIN``, possibly in the middle of an object, e.g. right after
+ * a string header. To encode messages atomically, compute their size using
+ * dpack_encoder_init_count() and make sure dpack_encoder_fd_avail() reports
+ * enough room beforehand, calling dpack_encoder_flush_fd() otherwise.
+ *
+ * When all chunks are full and @p fd cannot accept more data, data given to
+ * the encoder is left unconsumed and encoding may be retried once
+ * dpack_encoder_flush_fd() has made room.
+ *
+ * @warning
+ * A failure happening once data given to the encoder has been partially
+ * consumed cannot be recovered from: the stream is dead and all further
+ * encoding fails with the same error code, ``-EAGAIN`` included.
+ * dpack_encoder_fini() still writes data encoded so far, trailing partial
+ * object included, then returns that error code.
+ *
+ * @p fd is owned by the caller and must be kept open until
+ * dpack_encoder_fini() has been called.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p fd is invalid, @p size is zero, @p nr is zero or greater than
+ * #DPACK_ENCODER_FD_CHUNK_NR_MAX or @p thres is zero, result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_flush_fd()
+ * - dpack_encoder_fd_avail()
+ * - dpack_encoder_fd_timeout()
+ * - dpack_encoder_fini()
+ */
+extern int
+dpack_encoder_init_fd(struct dpack_encoder_fd * __restrict encoder,
+                      int                                  fd,
+                      size_t                               size,
+                      unsigned int                         nr,
+                      size_t                               thres,
+                      unsigned int                         delay)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Write data pending into a buffered file descriptor encoder
+ *
+ * @param[inout] encoder encoder
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -EAGAIN File descriptor cannot accept more data for now
+ * @retval <0      Other @man{writev(2)} error codes
+ *
+ * Write all pending chunks using as few @man{writev(2)} calls as possible.
+ * Short writes are resumed from where they stopped. When ``-EAGAIN`` is
+ * returned, data not written yet is kept pending: wait for the file descriptor
+ * to become writable and retry.
+ *
+ * dpack_encoder_fini() writes pending data, waiting for the file descriptor
+ * to become writable if needed, before releasing @p encoder.
+ *
+ * @see
+ * - dpack_encoder_init_fd()
+ * - dpack_encoder_fd_timeout()
+ */
+extern int
+dpack_encoder_flush_fd(struct dpack_encoder_fd * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Return time left before pending data of a buffered file descriptor encoder
+ * must be written
+ *
+ * @param[in] encoder encoder
+ *
+ * @return time left in milliseconds, rounded up, or -1 when no data is pending
+ *
+ * Returned value is suitable for use as @man{poll(2)} timeout argument.
+ *
+ * @see
+ * - dpack_encoder_flush_fd()
+ */
+extern int
+dpack_encoder_fd_timeout(const struct dpack_encoder_fd * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Return room left into buffered file descriptor encoder chunks
+ *
+ * @param[in] encoder encoder
+ *
+ * @return number of bytes that may be encoded without writing
+ *
+ * Data up to the returned size may be encoded without blocking nor failing
+ * with ``-EAGAIN``, whatever the file descriptor state is.
+ *
+ * @see
+ * - dpack_encoder_flush_fd()
+ * - dpack_encoder_init_count()
+ */
+extern size_t
+dpack_encoder_fd_avail(const struct dpack_encoder_fd * __restrict encoder)
+	__dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+	__dpack_export;
+
+#endif /* _DPACK_FD_H */
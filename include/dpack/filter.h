@@ -0,0 +1,231 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Filtering encoding / decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_FILTER_H
+#define _DPACK_FILTER_H
+
+#include <dpack/codec.h>
+
+/******************************************************************************
+ * Filtering encoder
+ ******************************************************************************/
+
+/**
+ * Codec filter callback.
+ *
+ * @param[inout] block block of encoded data
+ * @param[in]    size  size of @p block in bytes
+ * @param[inout] data  optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by filtering encoders and decoders for each block of encoded
+ * data passed through them, in stream order. It may inspect @p block, e.g. to
+ * update a running checksum, count bytes or copy them to a secondary sink, or
+ * throttle the stream by sleeping. It may also transform @p block content in
+ * place as long as its size is preserved.
+ *
+ * The callback function should **return** ``0`` in case of success. When
+ * returning a *negative error* code, current encoding / decoding operation is
+ * interrupted and the error code is returned to the caller.
+ *
+ * @see
+ * - dpack_encoder_init_filter()
+ * - dpack_decoder_init_filter()
+ */
+typedef int dpack_filter_fn(uint8_t * __restrict,
+                            size_t,
+                            void * __restrict);
+
+/**
+ * Filtering encoder
+ *
+ * An encoder stacked on top of another one, accumulating encoded data into a
+ * staging block which is handed to a filter callback, then to the underlying
+ * encoder once full.
+ *
+ * @see
+ * - dpack_encoder_init_filter()
+ * - dpack_encoder_flush_filter()
+ */
+struct dpack_encoder_filter {
+	struct dpack_encoder   base;
+	/* Underlying encoder filtered data is written to. */
+	struct dpack_encoder * next;
+	/* Filter callback. */
+	dpack_filter_fn *      filter;
+	/* Filter callback user data. */
+	void *                 data;
+	/* Staging block. */
+	uint8_t *              block;
+	/* Size of staging block in bytes. */
+	size_t                 capa;
+	/* Number of bytes pending into staging block. */
+	size_t                 tail;
+	/* Number of bytes written to underlying encoder so far. */
+	size_t                 done;
+};
+
+/**
+ * Initialize a filtering MessagePack encoder
+ *
+ * @param[out]   encoder encoder
+ * @param[inout] next    underlying encoder
+ * @param[in]    size    size of staging block in bytes
+ * @param[in]    filter  filter callback
+ * @param[inout] data    optional arbitrary user data given to @p filter
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Initialize a @rstsubst{MessagePack} encoder passing encoded data through
+ * @p filter on its way to @p next, so that checksums, statistics or copies
+ * may be computed in a single pass while encoding.
+ *
+ * Data is accumulated into a staging block of @p size bytes. Once full, the
+ * block is given to @p filter then written to @p next using a single write
+ * operation, whatever the number of items it holds.
+ * dpack_encoder_flush_filter() and dpack_encoder_fini() do so for partially
+ * filled blocks.
+ *
+ * Since @p next is an encoder, filtering encoders may be stacked. @p next is
+ * owned by the caller: it is not finalized by dpack_encoder_fini() and must be
+ * kept around until then.
+ *
+ * Data may be patched or cut as long as it has not left the staging block
+ * yet. Open-ended @rstref{sect-api-array} or @rstref{sect-api-map} encoding
+ * is therefore supported for containers fitting into a single block.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_filter_fn
+ * - dpack_encoder_flush_filter()
+ * - dpack_encoder_fini()
+ */
+extern int
+dpack_encoder_init_filter(struct dpack_encoder_filter * __restrict encoder,
+                          struct dpack_encoder * __restrict        next,
+                          size_t                                   size,
+                          dpack_filter_fn *                        filter,
+                          void * __restrict                        data)
+	__dpack_nonull(1, 2, 4) __warn_result __dpack_export;
+
+/**
+ * Hand data pending into a filtering encoder over to its underlying encoder
+ *
+ * @param[inout] encoder encoder
+ *
+ * @return an errno like error code
+ * @retval 0  Success
+ * @retval <0 Filter callback or underlying encoder error code
+ *
+ * Give content of the staging block to the filter callback, then write it to
+ * the underlying encoder. Call this once a message is complete to make sure
+ * the filter callback has seen all of it, e.g. before retrieving a checksum.
+ *
+ * @see
+ * - dpack_encoder_init_filter()
+ */
+extern int
+dpack_encoder_flush_filter(struct dpack_encoder_filter * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/******************************************************************************
+ * Filtering decoder
+ ******************************************************************************/
+
+/**
+ * Filtering decoder
+ *
+ * A decoder stacked on top of another one, reading encoded data of a message by
+ * blocks which are handed to a filter callback before being decoded.
+ *
+ * @see
+ * - dpack_decoder_init_filter()
+ */
+struct dpack_decoder_filter {
+	struct dpack_decoder   base;
+	/* Underlying decoder data is read from. */
+	struct dpack_decoder * next;
+	/* Filter callback. */
+	dpack_filter_fn *      filter;
+	/* Filter callback user data. */
+	void *                 data;
+	/* Staging block. */
+	uint8_t *              block;
+	/* Size of staging block in bytes. */
+	size_t                 capa;
+	/* Offset of first staged byte not consumed yet. */
+	size_t                 head;
+	/* Number of bytes staged. */
+	size_t                 tail;
+	/* Number of message bytes not read out of underlying decoder yet. */
+	size_t                 left;
+};
+
+/**
+ * Initialize a filtering MessagePack decoder
+ *
+ * @param[out]   decoder decoder
+ * @param[inout] next    underlying decoder
+ * @param[in]    size    size of staging block in bytes
+ * @param[in]    len     length of message to decode in bytes
+ * @param[in]    filter  filter callback
+ * @param[inout] data    optional arbitrary user data given to @p filter
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Initialize a @rstsubst{MessagePack} decoder reading a message of @p len bytes
+ * out of @p next by blocks of up to @p size bytes, and giving each of them to
+ * @p filter before decoding.
+ *
+ * Skipped data is handed to @p filter as well so that it sees the whole
+ * message. Data is read ahead, up to the end of message but never past it:
+ * once the message has been fully decoded, @p next is positioned right after
+ * it so that the next message may be decoded out of @p next, directly or
+ * through another filtering decoder. Pass dpack_decoder_data_left() of @p next
+ * as @p len when @p next holds a single message. @p next should not be used
+ * directly while @p decoder is in use. @p next is owned by the caller: it is
+ * not finalized by dpack_decoder_fini().
+ *
+ * @p decoder inherits discard mode from @p next.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_filter_fn
+ * - dpack_decoder_fini()
+ */
+extern int
+dpack_decoder_init_filter(struct dpack_decoder_filter * __restrict decoder,
+                          struct dpack_decoder * __restrict        next,
+                          size_t                                   size,
+                          size_t                                   len,
+                          dpack_filter_fn *                        filter,
+                          void * __restrict                        data)
+	__dpack_nonull(1, 2, 5) __warn_result __dpack_export;
+
+#endif /* _DPACK_FILTER_H */
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2023-2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Interned string decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2026
+ * @copyright Copyright (C) 2023-2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_INTERN_H
+#define _DPACK_INTERN_H
+
+#include <dpack/string.h>
+#include <pthread.h>
+
+#if defined(CONFIG_DPACK_LVSTR)
+#include <dpack/lvstr.h>
+#endif /* defined(CONFIG_DPACK_LVSTR) */
+
+/**
+ * Maximum number of buckets of an intern table
+ *
+ * Maximum number of hash buckets an intern table may be initialized with.
+ *
+ * @see dpack_intern_init()
+ */
+#define DPACK_INTERN_NR_MAX  (1U << 24)
+
+/* Number of locks serializing insertions into intern table buckets. */
+#define DPACK_INTERN_LOCK_NR (32U)
+
+struct dpack_intern_entry;
+
+/**
+ * String intern table
+ *
+ * A table of unique immutable strings shared by all string decoding operations
+ * performed with it. Lookups are lock free whereas insertions of new strings
+ * are serialized per group of hash buckets, allowing multiple threads to decode
+ * concurrently using the same table.
+ *
+ * Strings registered into the table are only released at dpack_intern_fini()
+ * time.
+ *
+ * @see
+ * - dpack_intern_init()
+ * - dpack_intern_fini()
+ */
+struct dpack_intern {
+	/** @internal */
+	unsigned int                 mask;
+	/** @internal */
+	struct dpack_intern_entry ** buckets;
+	/** @internal */
+	pthread_mutex_t              locks[DPACK_INTERN_LOCK_NR];
+};
+
+/**
+ * Decode a string encoded according to the MessagePack format into an intern
+ * table
+ *
+ * @param[inout] decoder decoder
+ * @param[inout] intern  intern table
+ * @param[out]   value   location where to store pointer to interned string
+ *
+ * @return length of decoded string when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize data item encoded according to the
+ * @rstsubst{MessagePack string format} from buffer assigned to @p decoder at
+ * initialization time and return a pointer to the unique copy of the decoded
+ * string registered into @p intern table.
+ *
+ * When the decoded string is not yet registered into @p intern, it is
+ * allocated using @man{malloc(3)} and inserted into @p intern. Otherwise, the
+ * existing copy is returned and no allocation happens for strings shorter than
+ * 256 bytes.
+ *
+ * The returned string is shared and *MUST NOT* be modified nor released. It
+ * remains valid until @p intern is finalized using dpack_intern_fini(). It is
+ * guaranteed to be ``NULL`` terminated.
+ *
+ * Decoding a string longer than #DPACK_STRLEN_MAX will cause a ``-EMSGSIZE``
+ * error code to be returned.
+ *
+ * @warning
+ * - @p decoder *MUST* have been initialized using dpack_decoder_init_buffer()
+ *   or dpack_decoder_init_skip_buffer() before calling this function. Result is
+ *   undefined otherwise.
+ * - @p intern *MUST* have been initialized using dpack_intern_init() before
+ *   calling this function. Result is undefined otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_strdup()
+ * - dpack_intern_init()
+ * - dpack_decoder_init_buffer()
+ * - dpack_decoder_init_skip_buffer()
+ */
+extern ssize_t
+dpack_decode_str_intern(struct dpack_decoder * __restrict decoder,
+                        struct dpack_intern * __restrict  intern,
+                        const char ** __restrict          value)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
+#if defined(CONFIG_DPACK_LVSTR)
+
+/**
+ * Decode a string encoded according to the MessagePack format into an intern
+ * table and lend it to a lvstr
+ *
+ * @param[inout] decoder decoder
+ * @param[inout] intern  intern table
+ * @param[out]   value   lvstr where to store decoded string
+ *
+ * @return length of decoded string when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Behaves just like dpack_decode_str_intern() but lends the interned string to
+ * the @rstlnk{lvstr} @p value. @p value may be released using
+ * @rstsubst{stroll_lvstr_fini} or @rstsubst{stroll_lvstr_drop} at any time
+ * without affecting @p intern table content.
+ *
+ * Decoding a string longer than #DPACK_LVSTRLEN_MAX will cause a ``-EMSGSIZE``
+ * error code to be returned.
+ *
+ * @warning
+ * - @p decoder *MUST* have been initialized using dpack_decoder_init_buffer()
+ *   or dpack_decoder_init_skip_buffer() before calling this function. Result is
+ *   undefined otherwise.
+ * - @p intern *MUST* have been initialized using dpack_intern_init() before
+ *   calling this function. Result is undefined otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p value @rstsubst{lvstr} is not initialized, result is undefined. An
+ *   assertion *MAY* be triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_lvstr()
+ * - dpack_decode_str_intern()
+ * - dpack_intern_init()
+ */
+extern ssize_t
+dpack_decode_lvstr_intern(struct dpack_decoder * __restrict decoder,
+                          struct dpack_intern * __restrict  intern,
+                          struct stroll_lvstr * __restrict  value)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_LVSTR) */
+
+/**
+ * Initialize a string intern table
+ *
+ * @param[out] intern intern table
+ * @param[in]  nr     expected number of distinct strings
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Initialize @p intern table with a number of hash buckets equal to @p nr
+ * rounded up to the next power of 2. Since the table is never resized, @p nr
+ * should be given the expected number of distinct strings to keep lookups
+ * fast.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p nr is zero or greater than #DPACK_INTERN_NR_MAX, result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_intern_fini()
+ * - dpack_decode_str_intern()
+ */
+extern int
+dpack_intern_init(struct dpack_intern * __restrict intern, unsigned int nr)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Finalize a string intern table
+ *
+ * @param[inout] intern intern table
+ *
+ * Release all strings registered into @p intern as well as resources allocated
+ * at dpack_intern_init() time.
+ *
+ * @warning
+ * Strings previously returned by dpack_decode_str_intern() and
+ * dpack_decode_lvstr_intern() *MUST NOT* be used once this function has been
+ * called.
+ *
+ * @see dpack_intern_init()
+ */
+extern void
+dpack_intern_fini(struct dpack_intern * __restrict intern)
+	__dpack_nonull(1) __dpack_export;
+
+#endif /* _DPACK_INTERN_H */
@@ -0,0 +1,279 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Append-only journal interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_JOURNAL_H
+#define _DPACK_JOURNAL_H
+
+#include <dpack/codec.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+/**
+ * Size of journal record framing header in bytes.
+ *
+ * Each record stored into a journal is prefixed by a header made of a 32-bit
+ * little-endian record size followed by a 32-bit little-endian CRC32C
+ * checksum computed over the size field and record content.
+ */
+#define DPACK_JOURNAL_HEAD_SIZE (8U)
+
+/**
+ * Maximum size of a journal record content in bytes.
+ *
+ * Set at build time using the #CONFIG_DPACK_JOURNAL_RECORD_SIZE_MAX build
+ * configuration parameter.
+ */
+#define DPACK_JOURNAL_RECORD_SIZE_MAX \
+	STROLL_CONCAT(CONFIG_DPACK_JOURNAL_RECORD_SIZE_MAX, U)
+
+/**
+ * Journal record encoding callback.
+ *
+ * @param[inout] encoder encoder
+ * @param[inout] data    optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_journal_append() to encode the content of a
+ * journal record into a scratch area owned by the calling thread. It may be
+ * called more than once for the same record when the scratch area has to be
+ * grown, in which case it *MUST* produce the same output.
+ *
+ * The callback function should **return** ``0`` in case of success. When
+ * returning a *negative error* code, record is not appended and the error code
+ * is returned to the caller of dpack_journal_append().
+ *
+ * @see
+ * - dpack_journal_append()
+ */
+typedef int dpack_journal_encode_fn(struct dpack_encoder * __restrict,
+                                    void * __restrict);
+
+/**
+ * Journal record replay callback.
+ *
+ * @param[inout] decoder decoder
+ * @param[inout] data    optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_journal_open_at() to decode the content of each
+ * valid record found into the journal, in append order. @p decoder is bounded
+ * to the record content.
+ *
+ * The callback function should **return** ``0`` in case of success. When
+ * returning a *negative error* code, journal opening process is interrupted
+ * and the error code is returned to the caller of dpack_journal_open_at().
+ *
+ * @see
+ * - dpack_journal_open_at()
+ */
+typedef int dpack_journal_replay_fn(struct dpack_decoder * __restrict,
+                                    void * __restrict);
+
+struct dpack_journal_batch {
+	/* Size of data queued for commit in bytes. */
+	size_t    size;
+	/* Size of allocated data area. */
+	size_t    capa;
+	/* Framed records queued for commit. */
+	uint8_t * data;
+};
+
+/**
+ * Append-only journal
+ *
+ * A file holding a sequence of framed dpack encoded records where concurrent
+ * appenders are coalesced into a single write and flush operation.
+ *
+ * @see
+ * - dpack_journal_open_at()
+ * - dpack_journal_append()
+ * - dpack_journal_close()
+ */
+struct dpack_journal {
+	/* Serializes access to the fields below. */
+	pthread_mutex_t              lock;
+	/* Signaled each time a group commit completes. */
+	pthread_cond_t               cond;
+	/* Batch records are currently appended to. */
+	struct dpack_journal_batch * curr;
+	/* Double buffered batches: one filled while the other is committed. */
+	struct dpack_journal_batch   batch[2];
+	/* Sequence number of last queued record. */
+	uint64_t                     queued;
+	/* Sequence number of last durable record. */
+	uint64_t                     synced;
+	/* Size of durable journal content. */
+	off_t                        tail;
+	/* Whether a group commit is in progress. */
+	bool                         syncing;
+	/* Sticky error of last failed group commit. */
+	int                          err;
+	/* File descriptor. */
+	int                          fd;
+};
+
+/**
+ * Open a journal and replay its content.
+ *
+ * @param[out]   journal journal
+ * @param[in]    dir     directory file descriptor
+ * @param[in]    path    pathname of journal file
+ * @param[in]    mode    file mode bits used when creating journal file
+ * @param[in]    replay  optional record replay callback
+ * @param[inout] data    optional arbitrary user data given to @p replay
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -EBADMSG Corrupted record followed by other content
+ * @retval -EIO     Input / output error
+ * @retval -ENOMEM  Memory allocation failure
+ * @retval <0       Other @man{openat(2)} or @p replay error codes
+ *
+ * Open the journal file located at @p path, relative to @p dir when not
+ * absolute, creating it when it does not exist.
+ *
+ * Existing content is then scanned sequentially and @p replay is called for
+ * each valid record found. Scanning stops at the first invalid record, i.e.
+ * whose header is incomplete, whose size is zero, exceeds
+ * #DPACK_JOURNAL_RECORD_SIZE_MAX or the end of file, or whose CRC32C checksum
+ * does not match.
+ *
+ * When this record is torn, i.e. it is the remainder of an interrupted append
+ * (incomplete header or record, last record with mismatching checksum, or
+ * zero filled area up to the end of file), it is truncated so that subsequent
+ * appends start right after the last valid record. Otherwise, committed
+ * records are corrupted: the file is left intact and -EBADMSG is returned
+ * once @p replay has been called for the valid records preceding corruption.
+ *
+ * When a journal file is created, it is the responsibility of the caller to
+ * flush the directory entry of @p dir to make its creation durable.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p dir is an invalid file descriptor or @p path is invalid, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_journal_open()
+ * - dpack_journal_append()
+ * - dpack_journal_close()
+ * - dpack_journal_replay_fn
+ */
+extern int
+dpack_journal_open_at(struct dpack_journal * __restrict journal,
+                      int                               dir,
+                      const char * __restrict           path,
+                      mode_t                            mode,
+                      dpack_journal_replay_fn *         replay,
+                      void * __restrict                 data)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Open a journal and replay its content.
+ *
+ * Just as dpack_journal_open_at() with @p path relative to the current working
+ * directory.
+ *
+ * @see
+ * - dpack_journal_open_at()
+ */
+static inline __dpack_nonull(1, 2) __warn_result
+int
+dpack_journal_open(struct dpack_journal * __restrict journal,
+                   const char * __restrict           path,
+                   mode_t                            mode,
+                   dpack_journal_replay_fn *         replay,
+                   void * __restrict                 data)
+{
+	return dpack_journal_open_at(journal, AT_FDCWD, path, mode, replay, data);
+}
+
+/**
+ * Append a record to a journal.
+ *
+ * @param[inout] journal journal
+ * @param[in]    encode  record encoding callback
+ * @param[inout] data    optional arbitrary user data given to @p encode
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Record is empty or larger than
+ *                   #DPACK_JOURNAL_RECORD_SIZE_MAX
+ * @retval -ENOMEM   Memory allocation failure
+ * @retval -EIO      Input / output error
+ * @retval <0        Other @man{pwrite(2)}, @man{fdatasync(2)} or @p encode
+ *                   error codes
+ *
+ * Frame the record encoded by @p encode and wait until it is durably stored.
+ *
+ * Records appended concurrently by multiple threads are committed together
+ * (group commit): the first appender finding no commit in progress becomes
+ * leader and writes all records queued so far using a single @man{pwrite(2)}
+ * followed by a single @man{fdatasync(2)} call. Records appended meanwhile
+ * are queued into a second batch committed by the next leader.
+ *
+ * @p encode is run without holding the @p journal lock: the record is encoded
+ * and framed into a per-thread scratch area which is then copied into the
+ * current batch under lock.
+ *
+ * Once a commit fails, the content of the journal file is unknown and @p
+ * journal is left in an error state: all subsequent appends fail with the
+ * same error code. Close and reopen the journal to recover.
+ *
+ * Thread-safe.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p journal is not open or @p encode is ``NULL``, result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_journal_open_at()
+ * - dpack_journal_encode_fn
+ */
+extern int
+dpack_journal_append(struct dpack_journal * __restrict journal,
+                     dpack_journal_encode_fn *         encode,
+                     void * __restrict                 data)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Close a journal.
+ *
+ * @param[inout] journal journal
+ *
+ * @return an errno like error code
+ *
+ * Release resources allocated for @p journal. No append may be in progress.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p journal is not open, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_journal_open_at()
+ */
+extern int
+dpack_journal_close(struct dpack_journal * __restrict journal)
+	__dpack_nonull(1) __dpack_export;
+
+#endif /* _DPACK_JOURNAL_H */
@@ -22,6 +22,8 @@
 #include <dpack/string.h>
 #include <stroll/lvstr.h>
 
+struct dpack_backing;
+
 /**
  * Maximum length of a lvstr
  *
@@ -418,4 +420,213 @@ dpack_decode_lvstr_range(struct dpack_decoder * __restrict decoder,
                          struct stroll_lvstr * __restrict  value)
 	__dpack_nonull(1, 4) __warn_result __dpack_export;
 
+/**
+ * Decode a string encoded according to the MessagePack format into a lvstr
+ * using caller provided storage for short strings
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    size    size of @p buffer in bytes
+ * @param[out]   buffer  storage where to store short decoded strings
+ * @param[out]   value   lvstr where to store decoded string
+ *
+ * @return length of decoded string when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize data item encoded according to the
+ * @rstsubst{MessagePack string format} into @p value @rstlnk{lvstr} from buffer
+ * assigned to @p decoder at initialization time.
+ *
+ * When the decoded string length is smaller than @p size, i.e., when the
+ * decoded string and its terminating ``NULL`` byte fit into @p buffer, it is
+ * copied into @p buffer and lent to the @rstlnk{lvstr} @p value. No memory
+ * allocation is performed in this case and @p buffer *MUST* outlive @p value.
+ * @p buffer would typically be embedded into the same structure as @p value.
+ *
+ * Otherwise, the decoded string is allocated using @man{malloc(3)} and
+ * @p value behaves just as with dpack_decode_lvstr(), i.e., it is given
+ * ownership of the allocated string.
+ *
+ * In both cases, the string should be released thanks to
+ * @rstsubst{stroll_lvstr_fini} or @rstsubst{stroll_lvstr_drop} once no longer
+ * needed.
+ *
+ * The @p value @rstlnk{lvstr} should have been previously initialized using one
+ * of the @rstsubst{lvstr} initialization primitives described into
+ * @rstsubst{lvstr} section of @rstsubst{Stroll's API guide}.
+ * The decoded string is guaranteed to be ``NULL`` terminated.
+ *
+ * Decoding a string longer than #DPACK_LVSTRLEN_MAX will cause a ``-EMSGSIZE``
+ * error code to be returned.
+ *
+ * @warning
+ * - @p decoder *MUST* have been initialized using dpack_decoder_init_buffer()
+ *   or dpack_decoder_init_skip_buffer() before calling this function. Result is
+ *   undefined otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p size is zero or @p buffer is ``NULL``, result is undefined. An
+ *   assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p value @rstsubst{lvstr} is not initialized, result is undefined. An
+ *   assertion *MAY* be triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_lvstr()
+ * - dpack_decode_lvstr_sso_range()
+ * - dpack_decoder_init_buffer()
+ * - dpack_decoder_init_skip_buffer()
+ */
+extern ssize_t
+dpack_decode_lvstr_sso(struct dpack_decoder * __restrict decoder,
+                       size_t                            size,
+                       char * __restrict                 buffer,
+                       struct stroll_lvstr * __restrict  value)
+	__dpack_nonull(1, 3, 4) __warn_result __dpack_export;
+
+/**
+ * Decode a string encoded according to the MessagePack format into a lvstr
+ * with requested minimum and maximum length using caller provided storage for
+ * short strings
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    min_len minimum length of decoded string
+ * @param[in]    max_len maximum length of decoded string
+ * @param[in]    size    size of @p buffer in bytes
+ * @param[out]   buffer  storage where to store short decoded strings
+ * @param[out]   value   lvstr where to store decoded string
+ *
+ * @return length of decoded string when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize data item encoded according to the
+ * @rstsubst{MessagePack string format} into @p value @rstlnk{lvstr} from buffer
+ * assigned to @p decoder at initialization time.
+ *
+ * Decoding fails with a ``-EMSGSIZE`` error code when length of the decoded
+ * string:
+ * - is smaller than the specified @p min_len value,
+ * - or larger than the specified @p max_len value.
+ *
+ * Storage of decoded string is managed as described for
+ * dpack_decode_lvstr_sso(). Passing a @p size value greater than @p max_len
+ * ensures that no memory allocation will ever be performed.
+ *
+ * @warning
+ * - @p decoder *MUST* have been initialized using dpack_decoder_init_buffer()
+ *   or dpack_decoder_init_skip_buffer() before calling this function. Result is
+ *   undefined otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p min_len value is zero or greater than @p max_len, result is undefined.
+ *   An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p max_len value is greater than #DPACK_LVSTRLEN_MAX, result is undefined.
+ *   An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p size is zero or @p buffer is ``NULL``, result is undefined. An
+ *   assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p value @rstsubst{lvstr} is not initialized, result is undefined. An
+ *   assertion *MAY* be triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_lvstr_range()
+ * - dpack_decode_lvstr_sso()
+ * - dpack_decoder_init_buffer()
+ * - dpack_decoder_init_skip_buffer()
+ */
+extern ssize_t
+dpack_decode_lvstr_sso_range(struct dpack_decoder * __restrict decoder,
+                             size_t                            min_len,
+                             size_t                            max_len,
+                             size_t                            size,
+                             char * __restrict                 buffer,
+                             struct stroll_lvstr * __restrict  value)
+	__dpack_nonull(1, 5, 6) __warn_result __dpack_export;
+
+/**
+ * Decode a string encoded according to the MessagePack format into a lvstr
+ * without copying it when possible
+ *
+ * @param[inout] decoder decoder
+ * @param[out]   value   lvstr where to store decoded string
+ * @param[out]   backing location where to store decoder backing storage
+ *                       reference
+ *
+ * @return length of decoded string when successful, an errno like error code
+ *         otherwise
+ * @retval >0        Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -EBADMSG  Invalid MessagePack string data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOMEM   Memory allocation failure
+ *
+ * Decode / unpack / deserialize data item encoded according to the
+ * @rstsubst{MessagePack string format} into @p value @rstlnk{lvstr} from buffer
+ * assigned to @p decoder at initialization time.
+ *
+ * When @p decoder is able to lend the encoded string from its backing
+ * storage, i.e., when it was initialized using
+ * dpack_decoder_init_backed_buffer() or when decoding from a file, and the
+ * encoded string is immediately followed by a ``NULL`` byte which is part of
+ * the data left to decode and lies within this backing storage, the string is
+ * lent to the @rstlnk{lvstr} @p value as is. A
+ * reference to @p decoder backing storage is returned via the @p backing
+ * argument. Release it using dpack_backing_put() once @p value is no longer
+ * needed.
+ *
+ * Backing storage content is never modified so that it may safely be shared
+ * with other borrowers or decoded a second time. Since
+ * @rstsubst{MessagePack} strings are not ``NULL`` terminated, a following
+ * ``NULL`` byte may only come from the next item, a positive fixint ``0`` for
+ * instance. Strings are therefore copied in most cases: use dpack_decode_raw()
+ * to access encoded strings without copying them whatever the next item is.
+ *
+ * Otherwise, the decoded string is allocated using @man{malloc(3)}, @p value
+ * behaves just as with dpack_decode_lvstr() and ``NULL`` is returned via the
+ * @p backing argument.
+ *
+ * In both cases, the string should be released thanks to
+ * @rstsubst{stroll_lvstr_fini} or @rstsubst{stroll_lvstr_drop} once no longer
+ * needed.
+ *
+ * Decoding a string longer than #DPACK_LVSTRLEN_MAX will cause a ``-EMSGSIZE``
+ * error code to be returned.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p value @rstsubst{lvstr} is not initialized, result is undefined. An
+ *   assertion *MAY* be triggered otherwise.
+ *
+ * @see
+ * - dpack_decode_lvstr()
+ * - dpack_decoder_init_backed_buffer()
+ * - dpack_backing_put()
+ */
+extern ssize_t
+dpack_decode_lvstr_lend(struct dpack_decoder * __restrict  decoder,
+                        struct stroll_lvstr * __restrict   value,
+                        struct dpack_backing ** __restrict backing)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
 #endif /* _DPACK_LVSTR_H */
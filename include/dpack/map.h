@@ -24,13 +24,21 @@
 
 /**
  * Maximum number of fields of a dpack map
+ *
+ * Set at build time using the #CONFIG_DPACK_MAP_FLDNR_MAX build configuration
+ * parameter.
+ *
+ * @see dpack_decoder_limit_map()
  */
-#define DPACK_MAP_FLDNR_MAX (128U)
+#define DPACK_MAP_FLDNR_MAX STROLL_CONCAT(CONFIG_DPACK_MAP_FLDNR_MAX, U)
 
 /**
  * Maximum size of a dpack map field
+ *
+ * Set at build time using the #CONFIG_DPACK_MAP_FLDSZ_MAX build configuration
+ * parameter.
  */
-#define DPACK_MAP_FLDSZ_MAX (1024U)
+#define DPACK_MAP_FLDSZ_MAX STROLL_CONCAT(CONFIG_DPACK_MAP_FLDSZ_MAX, U)
 
 #if DPACK_STDINT_SIZE_MAX > DPACK_MAP_FLDSZ_MAX
 #error DPack map field cannot hold a single scalar element, \
@@ -192,7 +200,8 @@
  * - dpack_map_size()
  */
 #define DPACK_MAP_DATA_SIZE_MAX \
-	(DPACK_MAP_FLDNR_MAX * (DPACK_MAP_FLDID_SIZE_MAX + DPACK_MAP_FLDSZ_MAX))
+	(1UL * DPACK_MAP_FLDNR_MAX * \
+	 (DPACK_MAP_FLDID_SIZE_MAX + DPACK_MAP_FLDSZ_MAX))
 
 /**
  * Maximum size of a dpack map
@@ -210,9 +219,9 @@
 #define DPACK_MAP_SIZE_MAX \
 	(__DPACK_MAP_HEAD_SIZE(DPACK_MAP_FLDNR_MAX) + DPACK_MAP_DATA_SIZE_MAX)
 
-#if DPACK_MAP_SIZE_MAX > (128U * 1024 * 1024)
-#error DPack cannot encode maps which overall size > 128 MB !
-#endif /* DPACK_MAP_SIZE_MAX > (128U * 1024 * 1024) */
+#if DPACK_MAP_SIZE_MAX > (SIZE_MAX / 2)
+#error DPack cannot encode maps which overall size > (SIZE_MAX / 2) !
+#endif /* DPACK_MAP_SIZE_MAX > (SIZE_MAX / 2) */
 
 #define _DPACK_MAP_HEAD_SIZE(_fld_nr) \
 	compile_eval(((_fld_nr) > 0) && \
@@ -387,6 +396,153 @@ dpack_map_end_encode(struct dpack_encoder * __restrict encoder __unused)
 	dpack_encoder_assert_api(encoder);
 }
 
+#if DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX
+#define _DPACK_MAP_OPEN_HEAD_SIZE DPACK_MAP32_TAG_SIZE
+#elif DPACK_MAP_FLDNR_MAX > _DPACK_FIXMAP_FLDNR_MAX
+#define _DPACK_MAP_OPEN_HEAD_SIZE DPACK_MAP16_TAG_SIZE
+#else
+#define _DPACK_MAP_OPEN_HEAD_SIZE DPACK_FIXMAP_TAG_SIZE
+#endif
+
+/**
+ * Size of the widest header reserved by map open-ended encoding.
+ *
+ * Size in bytes of the map header reserved by
+ * dpack_map_begin_encode_open() when given #DPACK_MAP_FLDNR_MAX as maximum
+ * number of fields.
+ *
+ * @see dpack_map_begin_encode_open()
+ */
+#define DPACK_MAP_OPEN_HEAD_SIZE _DPACK_MAP_OPEN_HEAD_SIZE
+
+/**
+ * Start encoding a @rstlnk{map} which number of fields is not known in advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    max_nr  maximum number of fields
+ * @param[out]   mark    location where to store reserved header mark
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOTSUP  @p encoder cannot patch already encoded data
+ * @retval -EMSGSIZE Not enough space to complete operation
+ *
+ * Start encoding a @rstlnk{map} containing an arbitrary number of fields, up to
+ * @p max_nr. The header width is chosen as the smallest one able to encode
+ * @p max_nr fields, i.e. 1, 3 or 5 bytes. Give #DPACK_MAP_FLDNR_MAX to
+ * reserve the widest header, #DPACK_MAP_OPEN_HEAD_SIZE bytes. The header is
+ * reserved and its location returned via the @p mark argument.
+ *
+ * Call to this function must be followed by the fields to encode. Encoding
+ * must be completed either by a call to dpack_map_end_encode_open() given
+ * @p mark and the number of fields actually encoded so that the reserved
+ * header is patched in place, or by a call to
+ * dpack_map_cancel_encode_open() to drop everything encoded since
+ * @p mark.
+ *
+ * This requires @p encoder to support patching of already encoded data, which
+ * is the case of encoders initialized using dpack_encoder_init_buffer().
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is in error state before calling this function, or @p max_nr is
+ * greater than #DPACK_MAP_FLDNR_MAX, result is undefined. An assertion is
+ * triggered otherwise.
+ *
+ * @see
+ * - dpack_map_end_encode_open()
+ * - dpack_map_cancel_encode_open()
+ * - dpack_map_begin_encode()
+ */
+extern int
+dpack_map_begin_encode_open(struct dpack_encoder * __restrict      encoder,
+                            unsigned int                           max_nr,
+                            struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Complete encoding of a @rstlnk{map} which number of fields was not known in
+ * advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    mark    reserved header mark
+ * @param[in]    nr      number of fields encoded
+ * @param[in]    compact shrink header to its minimal width
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOTSUP  @p encoder cannot patch already encoded data
+ * @retval -ERANGE   @p mark is out of encoded data range
+ * @retval -EMSGSIZE @p nr does not fit into reserved header
+ *
+ * Complete encoding of a @rstlnk{map} started using
+ * dpack_map_begin_encode_open() by patching the header reserved at
+ * @p mark with the @p nr number of fields. @p nr may be zero, in which case
+ * an empty map is encoded.
+ *
+ * When @p compact is ``true`` and @p encoder supports it, the header is
+ * shrunk to the minimal width required to encode @p nr and encoded fields
+ * are moved backward accordingly. Otherwise, the reserved header width is
+ * kept, which is a valid albeit non minimal MessagePack encoding.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p encoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p nr is greater than #DPACK_MAP_FLDNR_MAX, result is undefined. An
+ *   assertion is triggered otherwise.
+ * - Compacting the header moves data encoded after @p mark backward. Complete
+ *   nested open-ended containers before enclosing ones.
+ *
+ * @see
+ * - dpack_map_begin_encode_open()
+ * - dpack_map_cancel_encode_open()
+ */
+extern int
+dpack_map_end_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark,
+	unsigned int                                 nr,
+	bool                                         compact)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Cancel encoding of a @rstlnk{map} which number of fields was not known in
+ * advance.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    mark    reserved header mark
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -ENOTSUP @p encoder cannot remove already encoded data
+ * @retval -ERANGE  @p mark is out of encoded data range
+ *
+ * Abort encoding of a @rstlnk{map} started using
+ * dpack_map_begin_encode_open() by removing the header reserved at @p mark as
+ * well as all data encoded after it, so that no dangling header is left
+ * behind, e.g. when a filtered iterator turns out to yield nothing worth
+ * encoding.
+ *
+ * This requires @p encoder to support removal of already encoded data, which
+ * is the case of encoders initialized using dpack_encoder_init_buffer().
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is in error state before calling this function, result is
+ * undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_map_begin_encode_open()
+ * - dpack_map_end_encode_open()
+ */
+extern int
+dpack_map_cancel_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
 /******************************************************************************
  * Map field identifiers encoding
  ******************************************************************************/
@@ -1328,6 +1484,58 @@ dpack_map_encode_nil(struct dpack_encoder * __restrict encoder,
                      unsigned int                      id)
 	__dpack_nonull(1) __warn_result __dpack_export;
 
+/******************************************************************************
+ * Map raw encoding
+ ******************************************************************************/
+
+/**
+ * Size of a raw dpack map field.
+ *
+ * @param[in] _size size of encoded field value
+ *
+ * Compute the maximum size of a @rstlnk{map} field which value is already
+ * encoded according to the @rstsubst{MessagePack format} into @p _size bytes.
+ */
+#define DPACK_MAP_RAW_SIZE(_size) \
+	(DPACK_MAP_FLDID_SIZE_MAX + (_size))
+
+/**
+ * Encode a dpack map field holding an already encoded value.
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    id      field identifier to encode
+ * @param[in]    data    encoded field value
+ * @param[in]    size    size of @p data in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ *
+ * Encode / pack / serialize the @p id @rstlnk{map} field identifier into the
+ * buffer assigned to @p encoder at initialization time, then splice @p data
+ * as is right after it (see dpack_encode_raw()).
+ *
+ * @warning
+ * - @p encoder *MUST* have been initialized using dpack_encoder_init_buffer()
+ *   before calling this function. Result is undefined otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p encoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p size is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - DPACK_MAP_RAW_SIZE()
+ * - dpack_encode_raw()
+ * - dpack_encoder_init_buffer()
+ */
+extern int
+dpack_map_encode_raw(struct dpack_encoder * __restrict encoder,
+                     unsigned int                      id,
+                     const uint8_t * __restrict        data,
+                     size_t                            size)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
 /******************************************************************************
  * Nested collections encoding
  ******************************************************************************/
@@ -1459,6 +1667,38 @@ dpack_map_begin_encode_nest_array(struct dpack_encoder * __restrict encoder,
  * Map decoding
  ******************************************************************************/
 
+/**
+ * Restrict the number of map fields a decoder accepts.
+ *
+ * @param[inout] decoder decoder
+ * @param[in]    nr      maximum number of fields
+ *
+ * Lower the maximum number of fields of maps @p decoder accepts below the
+ * #DPACK_MAP_FLDNR_MAX build time limit. Decoding a map which header announces
+ * more than @p nr fields fails with ``-EMSGSIZE`` error code before any field
+ * is processed and without discarding the map content.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p nr is zero or greater than #DPACK_MAP_FLDNR_MAX, result is undefined.
+ *   An assertion is triggered otherwise.
+ *
+ * @see
+ * - DPACK_MAP_FLDNR_MAX
+ * - dpack_decoder_limit_array()
+ */
+static inline __dpack_nonull(1) __dpack_nothrow
+void
+dpack_decoder_limit_map(struct dpack_decoder * __restrict decoder,
+                        unsigned int                      nr)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_MAP_FLDNR_MAX);
+
+	decoder->fld_max = nr;
+}
+
 extern int
 dpack_map_decode(struct dpack_decoder * __restrict decoder,
                  dpack_decode_item_fn *            decode,
@@ -1494,4 +1734,353 @@ dpack_map_decode_range(struct dpack_decoder * __restrict decoder,
                        void * __restrict      data)
 	__dpack_nonull(1, 4) __warn_result __dpack_export;
 
+#if defined(CONFIG_DPACK_ARRAY)
+
+/******************************************************************************
+ * Columnar decoding of arrays of maps
+ ******************************************************************************/
+
+/**
+ * Type of values stored into a dpack_column.
+ *
+ * @see
+ * - dpack_column
+ * - dpack_map_decode_columns()
+ */
+enum dpack_column_type {
+	/** Array of ``bool``. */
+	DPACK_COLUMN_BOOL,
+	/** Array of ``int8_t``. */
+	DPACK_COLUMN_INT8,
+	/** Array of ``uint8_t``. */
+	DPACK_COLUMN_UINT8,
+	/** Array of ``int16_t``. */
+	DPACK_COLUMN_INT16,
+	/** Array of ``uint16_t``. */
+	DPACK_COLUMN_UINT16,
+	/** Array of ``int32_t``. */
+	DPACK_COLUMN_INT32,
+	/** Array of ``uint32_t``. */
+	DPACK_COLUMN_UINT32,
+	/** Array of ``int64_t``. */
+	DPACK_COLUMN_INT64,
+	/** Array of ``uint64_t``. */
+	DPACK_COLUMN_UINT64,
+#if defined(CONFIG_DPACK_FLOAT)
+	/** Array of ``float``. */
+	DPACK_COLUMN_FLOAT,
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+#if defined(CONFIG_DPACK_DOUBLE)
+	/** Array of ``double``. */
+	DPACK_COLUMN_DOUBLE,
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+};
+
+/**
+ * Column of values gathered from a dpack map field.
+ *
+ * Describes where values of the map field identified by @p fid must be stored
+ * when decoding an array of maps using dpack_map_decode_columns().
+ *
+ * @see
+ * - dpack_map_decode_columns()
+ */
+struct dpack_column {
+	/** Identifier of map field to gather values from. */
+	unsigned int           fid;
+	/** Type of values stored into @p values. */
+	enum dpack_column_type type;
+	/** Contiguous array of values, one entry per array element (row). */
+	void *                 values;
+	/**
+	 * Presence bitmap, one bit per row, set when the map of the
+	 * corresponding row holds field @p fid.
+	 */
+	uint64_t *             present;
+};
+
+/**
+ * Number of 64 bits words required by a dpack_column presence bitmap.
+ *
+ * @param[in] _row_nr maximum number of rows
+ *
+ * @see
+ * - dpack_column
+ */
+#define DPACK_COLUMN_PRESENT_NR(_row_nr) \
+	(((size_t)(_row_nr) + 63U) / 64U)
+
+/**
+ * Decode an array of maps into columns.
+ *
+ * @param[inout] decoder decoder
+ * @param[inout] columns array of column descriptors
+ * @param[in]    col_nr  number of @p columns entries
+ * @param[in]    row_max maximum number of rows
+ * @param[out]   row_nr  location where to store number of decoded rows
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EBADMSG  Invalid MessagePack data
+ * @retval -EMSGSIZE Array holds more than @p row_max elements
+ * @retval -ENOMSG   Array, map or field value type mismatch
+ * @retval -ENODATA  Not enough data left to complete operation
+ * @retval -ERANGE   Field value out of column type range
+ *
+ * Decode an array of at most @p row_max maps and, instead of materializing
+ * one structure per map, store the value of each field listed into
+ * @p columns straight into the contiguous typed array of the corresponding
+ * column (a.k.a. *Structure of Arrays* layout). The value held by the map of
+ * array element ``r`` for field @p columns[c].fid is stored at index ``r`` of
+ * @p columns[c].values.
+ *
+ * Bit ``r`` of each column's presence bitmap is set when the map of array
+ * element ``r`` holds the column's field, and cleared otherwise. Values of
+ * absent fields are zeroed so that aggregations may run over value arrays
+ * directly. Map fields not listed into @p columns are skipped.
+ *
+ * Each column's @p values array *MUST* be able to hold @p row_max entries of
+ * the column's type and its presence bitmap *MUST* be
+ * DPACK_COLUMN_PRESENT_NR(@p row_max) words long.
+ *
+ * Columns are looked up assuming maps encode fields in the same order as
+ * @p columns, which speeds up decoding of regular data. Other orders remain
+ * supported at the cost of a linear search.
+ *
+ * When @p decoder has been initialized in discard mode and a row fails to
+ * decode, the rest of the array is skipped so that @p decoder is left past
+ * it.
+ *
+ * @warning
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p decoder is in error state before calling this function, result is
+ *   undefined. An assertion is triggered otherwise.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p col_nr is zero, or @p row_max is zero or greater than
+ *   #DPACK_ARRAY_ELMNR_MAX, result is undefined. An assertion is triggered
+ *   otherwise.
+ *
+ * @see
+ * - dpack_column
+ * - dpack_map_decode()
+ * - dpack_array_decode()
+ */
+extern int
+dpack_map_decode_columns(struct dpack_decoder * __restrict decoder,
+                         struct dpack_column * __restrict  columns,
+                         unsigned int                      col_nr,
+                         unsigned int                      row_max,
+                         unsigned int * __restrict         row_nr)
+	__dpack_nonull(1, 2, 5) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_ARRAY) */
+
+/******************************************************************************
+ * In-place map editing
+ ******************************************************************************/
+
+#if defined(CONFIG_DPACK_CODEC_BUFFER)
+
+/**
+ * In-place dpack map editor.
+ *
+ * Allows to update, insert and delete fields of a @rstlnk{map} right into the
+ * buffer holding its encoded form, without decoding and encoding it again.
+ *
+ * @see
+ * - dpack_map_editor_init()
+ * - dpack_map_edit_update()
+ * - dpack_map_edit_insert()
+ * - dpack_map_edit_delete()
+ */
+struct dpack_map_editor {
+	/* Buffer holding encoded map. */
+	uint8_t *    buff;
+	/* Size of encoded data held by buff in bytes. */
+	size_t       size;
+	/* Size of buff in bytes. */
+	size_t       capa;
+	/* Size of encoded map header in bytes. */
+	size_t       head;
+	/* Number of map fields. */
+	unsigned int nr;
+};
+
+#define dpack_map_editor_assert_api(_editor) \
+	dpack_assert_api(_editor); \
+	dpack_assert_api((_editor)->buff); \
+	dpack_assert_api((_editor)->head); \
+	dpack_assert_api((_editor)->head <= (_editor)->size); \
+	dpack_assert_api((_editor)->size <= (_editor)->capa); \
+	dpack_assert_api((_editor)->nr <= DPACK_MAP_FLDNR_MAX)
+
+/**
+ * Initialize a dpack map editor.
+ *
+ * @param[out]   editor editor
+ * @param[inout] buffer buffer holding encoded map
+ * @param[in]    size   size of encoded data held by @p buffer in bytes
+ * @param[in]    capa   size of @p buffer in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -ENODATA  Truncated MessagePack stream
+ * @retval -EMSGSIZE Too many map fields
+ *
+ * Setup @p editor so that the @rstlnk{map} encoded at the start of @p buffer
+ * may be modified in place. Encoded data following the map, if any, is
+ * preserved. @p buffer may grow up to @p capa bytes as fields are modified or
+ * inserted.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero or greater than @p capa, result is undefined. An assertion
+ * is triggered otherwise.
+ *
+ * @see
+ * - dpack_map_editor_size()
+ */
+extern int
+dpack_map_editor_init(struct dpack_map_editor * __restrict editor,
+                      uint8_t * __restrict                 buffer,
+                      size_t                               size,
+                      size_t                               capa)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Return size of encoded data held by a dpack map editor.
+ *
+ * @param[in] editor editor
+ *
+ * @return Size of encoded data in bytes
+ *
+ * @see
+ * - dpack_map_editor_init()
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_map_editor_size(const struct dpack_map_editor * __restrict editor)
+{
+	dpack_map_editor_assert_api(editor);
+
+	return editor->size;
+}
+
+/**
+ * Update value of a dpack map field in place.
+ *
+ * @param[inout] editor editor
+ * @param[in]    id     identifier of field to update
+ * @param[in]    value  new encoded field value
+ * @param[in]    size   size of @p value in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOENT   No such field
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -ENODATA  Truncated MessagePack stream
+ * @retval -EMSGSIZE Not enough space to complete operation
+ *
+ * Replace value of the first @rstlnk{map} field identified by @p id with
+ * @p value, an item already encoded according to the
+ * @rstsubst{MessagePack format}.
+ *
+ * When @p value is as large as the current field value, it is overwritten in
+ * place. Otherwise, encoded data following the field is moved once to make
+ * room for @p value.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ * In addition, when compiled with the #CONFIG_DPACK_ASSERT_API build option
+ * enabled, an assertion is triggered when @p value does not hold exactly one
+ * well-formed item, as far as item types supported by the current build
+ * configuration are concerned.
+ *
+ * @see
+ * - dpack_map_edit_insert()
+ * - dpack_map_edit_delete()
+ * - dpack_encode_raw()
+ */
+extern int
+dpack_map_edit_update(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id,
+                      const uint8_t * __restrict           value,
+                      size_t                               size)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Insert a dpack map field in place.
+ *
+ * @param[inout] editor editor
+ * @param[in]    id     identifier of field to insert
+ * @param[in]    value  encoded field value
+ * @param[in]    size   size of @p value in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EEXIST   Field already exists
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -ENODATA  Truncated MessagePack stream
+ * @retval -EMSGSIZE Not enough space to complete operation or too many fields
+ *
+ * Append a @rstlnk{map} field identified by @p id which value is @p value, an
+ * item already encoded according to the @rstsubst{MessagePack format}, and
+ * update map header field count accordingly.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is zero, result is undefined. An assertion is triggered otherwise.
+ * In addition, when compiled with the #CONFIG_DPACK_ASSERT_API build option
+ * enabled, an assertion is triggered when @p value does not hold exactly one
+ * well-formed item, as far as item types supported by the current build
+ * configuration are concerned.
+ *
+ * @see
+ * - dpack_map_edit_update()
+ * - dpack_map_edit_delete()
+ * - dpack_encode_raw()
+ */
+extern int
+dpack_map_edit_insert(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id,
+                      const uint8_t * __restrict           value,
+                      size_t                               size)
+	__dpack_nonull(1, 3) __warn_result __dpack_export;
+
+/**
+ * Delete a dpack map field in place.
+ *
+ * @param[inout] editor editor
+ * @param[in]    id     identifier of field to delete
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOENT   No such field
+ * @retval -EPROTO   Not a valid MessagePack stream
+ * @retval -ENOTSUP  Unsupported MessagePack stream data
+ * @retval -ENOMSG   Invalid MessagePack stream data type
+ * @retval -ENODATA  Truncated MessagePack stream
+ *
+ * Remove the first @rstlnk{map} field identified by @p id and update map
+ * header field count accordingly.
+ *
+ * @see
+ * - dpack_map_edit_update()
+ * - dpack_map_edit_insert()
+ */
+extern int
+dpack_map_edit_delete(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_CODEC_BUFFER) */
+
 #endif /* _DPACK_MAP_H */
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Sealed memory file encoding / decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_MEMFD_H
+#define _DPACK_MEMFD_H
+
+#include <dpack/codec.h>
+
+/**
+ * Sealed memory file encoder
+ *
+ * An encoder packing data into an anonymous memory file created using
+ * @man{memfd_create(2)} which grows on demand.
+ *
+ * @see
+ * - dpack_encoder_init_memfd()
+ * - dpack_encoder_seal_memfd()
+ */
+struct dpack_encoder_memfd {
+	struct dpack_encoder base;
+	/* Size of encoded data in bytes. */
+	size_t               tail;
+	/* Size of memory file / mapping in bytes. */
+	size_t               capa;
+	/* Address of memory file mapping. */
+	uint8_t *            map;
+	/* Memory file descriptor. */
+	int                  fd;
+};
+
+/**
+ * Initialize a MessagePack encoder with a sealable memory file
+ *
+ * @param[out] encoder encoder
+ * @param[in]  name    name of memory file, for debugging purposes only
+ * @param[in]  size    initial size of memory file in bytes
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ * @retval <0      Other @man{memfd_create(2)} or @man{mmap(2)} error codes
+ *
+ * Initialize a @rstsubst{MessagePack} encoder packing data into a new
+ * anonymous memory file. The memory file is grown as needed so that @p size
+ * is an allocation hint only.
+ *
+ * Once done encoding, call dpack_encoder_seal_memfd() to seal the memory file
+ * and retrieve its file descriptor. Alternatively, call dpack_encoder_fini()
+ * to drop encoded data.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p name is invalid, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_seal_memfd()
+ * - dpack_decoder_init_memfd()
+ */
+extern int
+dpack_encoder_init_memfd(struct dpack_encoder_memfd * __restrict encoder,
+                         const char * __restrict                 name,
+                         size_t                                  size)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Seal a memory file encoder content.
+ *
+ * @param[inout] encoder encoder
+ *
+ * @return a file descriptor when successful, an errno like error code
+ *         otherwise
+ * @retval >=0      Sealed memory file descriptor
+ * @retval -ENODATA Nothing was encoded
+ * @retval <0       Other @man{ftruncate(2)} or @man{fcntl(2)} error codes
+ *
+ * Trim the memory file @p encoder packed data into to the size of encoded
+ * data, then seal it against writing, shrinking and growing. @p encoder is
+ * released in any case.
+ *
+ * The returned file descriptor is owned by the caller. It may be handed over
+ * to another process using ``SCM_RIGHTS`` ancillary data, which may then
+ * decode it using dpack_decoder_init_memfd(). Since content of the memory file
+ * can no longer be modified, it is safely shared without copying.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is not initialized, result is undefined. An assertion is
+ * triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_init_memfd()
+ * - dpack_decoder_init_memfd()
+ */
+extern int
+dpack_encoder_seal_memfd(struct dpack_encoder_memfd * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+extern int
+_dpack_decoder_init_memfd(struct dpack_decoder_file * __restrict decoder,
+                          int                                    fd,
+                          size_t                                 map_size,
+                          bool                                   discard)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Initialize a MessagePack decoder with a sealed memory file
+ *
+ * @param[out] decoder decoder
+ * @param[in]  fd      memory file descriptor
+ * @param[in]  discard whether to initialize decoder in discard mode
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -EPERM   Memory file is not sealed against writing, shrinking and
+ *                  growing
+ * @retval -ENODATA Empty memory file
+ * @retval -ENOMEM  Memory allocation failure
+ * @retval <0       Other @man{fcntl(2)} or @man{mmap(2)} error codes
+ *
+ * Initialize @p decoder so that it decodes the content of the memory file
+ * referred to by @p fd, typically produced by a peer process using
+ * dpack_encoder_seal_memfd(). Memory file is mapped read-only using the file
+ * decoder data mapping window logic.
+ *
+ * The memory file is rejected unless sealed so that the sender cannot modify
+ * nor truncate it while it is being decoded.
+ *
+ * @p decoder takes ownership of @p fd in case of success only: @p fd is then
+ * closed by dpack_decoder_fini().
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p fd is invalid, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_seal_memfd()
+ * - dpack_decoder_fini()
+ */
+static inline __dpack_nonull(1) __warn_result
+int
+dpack_decoder_init_memfd(struct dpack_decoder_file * __restrict decoder,
+                         int                                    fd,
+                         bool                                   discard)
+{
+	return _dpack_decoder_init_memfd(decoder,
+	                                 fd,
+	                                 DPACK_DECODER_FILE_MSIZE_DFLT,
+	                                 discard);
+}
+
+#endif /* _DPACK_MEMFD_H */
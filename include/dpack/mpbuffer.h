@@ -0,0 +1,218 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Multi-producer buffer encoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_MPBUFFER_H
+#define _DPACK_MPBUFFER_H
+
+#include <dpack/codec.h>
+
+/**
+ * Size of multi-producer buffer record header in bytes.
+ */
+#define DPACK_MPBUFFER_HEAD_SIZE (8U)
+
+/**
+ * Multi-producer buffer
+ *
+ * A circular memory buffer into which multiple threads encode messages
+ * concurrently without locking, while a single flusher thread drains them in
+ * reservation order.
+ *
+ * @see
+ * - dpack_mpbuffer_init()
+ * - dpack_encoder_init_mpbuffer()
+ * - dpack_mpbuffer_drain()
+ */
+struct dpack_mpbuffer {
+	/* Memory area records are stored into. */
+	uint8_t * buff;
+	/* Size of memory area in bytes. */
+	size_t    capa;
+	/*
+	 * Position of end of last reserved record, shared by producers.
+	 * Positions run modulo twice the buffer size.
+	 */
+	size_t    tail;
+	/*
+	 * Position of first record not drained yet, updated by flusher and
+	 * read by producers.
+	 */
+	size_t    head;
+};
+
+/**
+ * Initialize a multi-producer buffer
+ *
+ * @param[out]   mpbuffer multi-producer buffer
+ * @param[inout] buffer   memory area
+ * @param[in]    size     size of @p buffer in bytes
+ *
+ * @p buffer is a previously allocated memory area owned by the caller. It is
+ * zeroed at initialization time and must be kept around until no more
+ * producers nor flusher access @p mpbuffer.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p size is too small to hold a single record or is not a multiple of
+ * #DPACK_MPBUFFER_HEAD_SIZE, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_encoder_init_mpbuffer()
+ * - dpack_mpbuffer_drain()
+ */
+extern void
+dpack_mpbuffer_init(struct dpack_mpbuffer * __restrict mpbuffer,
+                    uint8_t * __restrict               buffer,
+                    size_t                             size)
+	__dpack_nonull(1, 2) __dpack_nothrow __leaf __dpack_export;
+
+/**
+ * Multi-producer buffer encoder
+ *
+ * @see
+ * - dpack_encoder_init_mpbuffer()
+ */
+struct dpack_encoder_mpbuffer {
+	/** Encoder to pack message with. */
+	struct dpack_encoder_buffer buff;
+	/* Buffer the message is being encoded into. */
+	struct dpack_mpbuffer *     mpbuffer;
+	/* Offset of record header. */
+	size_t                      head;
+};
+
+/**
+ * Initialize a MessagePack encoder with a multi-producer buffer span
+ *
+ * @param[out]   encoder  encoder
+ * @param[inout] mpbuffer multi-producer buffer
+ * @param[in]    size     maximum size of message in bytes
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENOSPC   Not enough space left into @p mpbuffer
+ * @retval -EMSGSIZE @p size larger than @p mpbuffer
+ *
+ * Atomically reserve a span of @p mpbuffer large enough to hold a message of
+ * up to @p size bytes and initialize @p encoder so that message is packed
+ * right into it through @p encoder dpack_encoder_mpbuffer::buff base encoder.
+ * Reservation is the only operation shared by producers: encoding itself
+ * proceeds without any synchronization. Use dpack_encoder_init_count() to
+ * compute the exact size of the message beforehand.
+ *
+ * When @p mpbuffer is full, wait for the flusher to drain it and retry.
+ *
+ * Finally, call either dpack_encoder_commit_mpbuffer() or
+ * dpack_encoder_drop_mpbuffer(). Since records are drained in reservation
+ * order, the flusher cannot proceed past a span that is neither committed nor
+ * dropped.
+ *
+ * Thread-safe.
+ *
+ * @see
+ * - dpack_encoder_commit_mpbuffer()
+ * - dpack_encoder_drop_mpbuffer()
+ */
+extern int
+dpack_encoder_init_mpbuffer(struct dpack_encoder_mpbuffer * __restrict encoder,
+                            struct dpack_mpbuffer * __restrict         mpbuffer,
+                            size_t                                     size)
+	__dpack_nonull(1, 2) __dpack_nothrow __warn_result __dpack_export;
+
+/**
+ * Publish a message encoded into a multi-producer buffer span
+ *
+ * @param[inout] encoder encoder
+ *
+ * Mark the message encoded into @p encoder as complete so that the flusher
+ * may drain it. @p encoder is released.
+ *
+ * @see
+ * - dpack_encoder_init_mpbuffer()
+ */
+extern void
+dpack_encoder_commit_mpbuffer(
+	struct dpack_encoder_mpbuffer * __restrict encoder)
+	__dpack_nonull(1) __dpack_nothrow __dpack_export;
+
+/**
+ * Drop a message encoded into a multi-producer buffer span
+ *
+ * @param[inout] encoder encoder
+ *
+ * Release the span reserved by @p encoder without publishing its content:
+ * the flusher skips it. @p encoder is released.
+ *
+ * @see
+ * - dpack_encoder_init_mpbuffer()
+ */
+extern void
+dpack_encoder_drop_mpbuffer(
+	struct dpack_encoder_mpbuffer * __restrict encoder)
+	__dpack_nonull(1) __dpack_nothrow __dpack_export;
+
+/**
+ * Multi-producer buffer drain callback.
+ *
+ * @param[in]    msg  message content
+ * @param[in]    size size of message content in bytes
+ * @param[inout] data optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_mpbuffer_drain() for each committed message. When
+ * returning a *negative error* code, draining is interrupted: the message is
+ * kept and handed again at next dpack_mpbuffer_drain() call.
+ *
+ * @see
+ * - dpack_mpbuffer_drain()
+ */
+typedef int dpack_mpbuffer_drain_fn(const uint8_t * __restrict,
+                                    size_t,
+                                    void * __restrict);
+
+/**
+ * Drain committed messages out of a multi-producer buffer
+ *
+ * @param[inout] mpbuffer multi-producer buffer
+ * @param[in]    drain    drain callback
+ * @param[inout] data     optional arbitrary user data given to @p drain
+ *
+ * @return an errno like error code
+ * @retval 0  Success
+ * @retval <0 @p drain error code
+ *
+ * Hand messages to @p drain in reservation order, up to the first span that
+ * is still being encoded. Space of drained spans is handed back to producers
+ * right away, which keep reserving spans past the ones still being encoded by
+ * wrapping around the end of buffer.
+ *
+ * Must be called by a single flusher thread at a time.
+ *
+ * @see
+ * - dpack_mpbuffer_drain_fn
+ * - dpack_encoder_commit_mpbuffer()
+ */
+extern int
+dpack_mpbuffer_drain(struct dpack_mpbuffer * __restrict mpbuffer,
+                     dpack_mpbuffer_drain_fn *          drain,
+                     void * __restrict                  data)
+	__dpack_nonull(1, 2) __dpack_export;
+
+#endif /* _DPACK_MPBUFFER_H */
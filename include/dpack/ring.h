@@ -0,0 +1,347 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Shared memory ring encoding / decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_RING_H
+#define _DPACK_RING_H
+
+#include <dpack/codec.h>
+
+/**
+ * Maximum number of slots of a shared memory ring.
+ */
+#define DPACK_RING_SLOT_NR_MAX (1U << 20)
+
+struct dpack_ring_shm;
+
+/**
+ * Shared memory ring
+ *
+ * A single producer / single consumer ring of fixed size message slots
+ * hosted into a memory file shared between processes, the producer encoding
+ * messages right into ring slots and the consumer decoding them in place.
+ *
+ * Each end of the ring holds its own dpack_ring, the first one being created
+ * using dpack_ring_create() and the other one attached to the same memory
+ * file using dpack_ring_attach().
+ *
+ * @see
+ * - dpack_ring_create()
+ * - dpack_ring_attach()
+ * - dpack_encoder_init_ring()
+ * - dpack_decoder_init_ring()
+ */
+struct dpack_ring {
+	/* Shared memory area. */
+	struct dpack_ring_shm * shm;
+	/* Size of shared memory area in bytes. */
+	size_t                  size;
+	/* Distance between consecutive slots in bytes. */
+	size_t                  stride;
+	/* Maximum size of a message in bytes. */
+	size_t                  msg_max;
+	/* Number of slots minus one. */
+	uint32_t                mask;
+	/* Producer's cached copy of consumer index. */
+	uint32_t                prod_cache;
+	/* Consumer's cached copy of producer index. */
+	uint32_t                cons_cache;
+	/* Shared memory file descriptor. */
+	int                     mfd;
+	/* Consumer wakeup eventfd file descriptor. */
+	int                     efd;
+};
+
+/**
+ * Return file descriptor of shared memory ring memory file.
+ *
+ * @param[in] ring shared memory ring
+ *
+ * @return file descriptor
+ *
+ * Pass the returned file descriptor along with the one returned by
+ * dpack_ring_event_fd() to the peer process (using ``SCM_RIGHTS`` ancillary
+ * data for example) so that it may attach to @p ring using
+ * dpack_ring_attach().
+ *
+ * @see
+ * - dpack_ring_event_fd()
+ * - dpack_ring_attach()
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_ring_mem_fd(const struct dpack_ring * __restrict ring)
+{
+	dpack_assert_api(ring);
+	dpack_assert_api(ring->mfd >= 0);
+
+	return ring->mfd;
+}
+
+/**
+ * Return file descriptor of shared memory ring wakeup event.
+ *
+ * @param[in] ring shared memory ring
+ *
+ * @return file descriptor
+ *
+ * @see
+ * - dpack_ring_mem_fd()
+ * - dpack_ring_attach()
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_ring_event_fd(const struct dpack_ring * __restrict ring)
+{
+	dpack_assert_api(ring);
+	dpack_assert_api(ring->efd >= 0);
+
+	return ring->efd;
+}
+
+/**
+ * Wait for a message to be available from a shared memory ring.
+ *
+ * @param[inout] ring shared memory ring
+ *
+ * @return an errno like error code
+ * @retval 0      Success
+ * @retval -EINTR Interrupted by a signal
+ *
+ * Block the calling consumer until at least one message is available for
+ * decoding. The producer signals the wakeup eventfd only when the consumer
+ * is actually sleeping so that the fast path of both ends does not involve
+ * any system call.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p ring is not initialized, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_decoder_init_ring()
+ */
+extern int
+dpack_ring_wait(struct dpack_ring * __restrict ring)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Create a shared memory ring.
+ *
+ * @param[out] ring    shared memory ring
+ * @param[in]  slot_nr number of message slots
+ * @param[in]  msg_max maximum size of a message in bytes
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ * @retval <0      Other @man{memfd_create(2)}, @man{eventfd(2)} or
+ *                 @man{mmap(2)} error codes
+ *
+ * Create a ring of @p slot_nr slots able to hold messages up to @p msg_max
+ * bytes long into a sealed memory file. The memory file is sealed against
+ * shrinking and growing so that the peer process may safely map it.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot_nr is not a power of 2 in the [2:#DPACK_RING_SLOT_NR_MAX] range or
+ * @p msg_max is zero, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_ring_attach()
+ * - dpack_ring_fini()
+ */
+extern int
+dpack_ring_create(struct dpack_ring * __restrict ring,
+                  unsigned int                   slot_nr,
+                  size_t                         msg_max)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Attach to a shared memory ring.
+ *
+ * @param[out] ring shared memory ring
+ * @param[in]  mfd  shared memory ring memory file descriptor
+ * @param[in]  efd  shared memory ring wakeup event file descriptor
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -EBADMSG Invalid ring geometry
+ * @retval -EPERM   Memory file is not sealed against shrinking
+ * @retval <0       Other @man{mmap(2)} error codes
+ *
+ * Attach @p ring to a ring created by a peer process using
+ * dpack_ring_create(). @p ring takes ownership of both @p mfd and @p efd that
+ * are closed by dpack_ring_fini().
+ *
+ * @see
+ * - dpack_ring_create()
+ * - dpack_ring_mem_fd()
+ * - dpack_ring_event_fd()
+ * - dpack_ring_fini()
+ */
+extern int
+dpack_ring_attach(struct dpack_ring * __restrict ring, int mfd, int efd)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Release resources allocated for a shared memory ring.
+ *
+ * @param[inout] ring shared memory ring
+ *
+ * @see
+ * - dpack_ring_create()
+ * - dpack_ring_attach()
+ */
+extern void
+dpack_ring_fini(struct dpack_ring * __restrict ring)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Shared memory ring encoder
+ *
+ * @see
+ * - dpack_encoder_init_ring()
+ */
+struct dpack_encoder_ring {
+	/** Encoder to pack message with. */
+	struct dpack_encoder_buffer buff;
+	/* Ring the message is being encoded into. */
+	struct dpack_ring *         ring;
+	/* Producer index of slot the message is being encoded into. */
+	uint32_t                    head;
+};
+
+/**
+ * Initialize a MessagePack encoder with shared memory ring slot
+ *
+ * @param[out]   encoder encoder
+ * @param[inout] ring    shared memory ring
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -EAGAIN Ring is full
+ *
+ * Reserve the next free slot of @p ring and initialize @p encoder so that
+ * message is packed right into it through @p encoder dpack_encoder_ring::buff
+ * base encoder. Messages larger than dpack_ring::msg_max fail to encode with
+ * ``-EMSGSIZE``.
+ *
+ * Publish the message to the consumer using dpack_encoder_commit_ring().
+ * Alternatively, call dpack_encoder_fini() onto dpack_encoder_ring::buff base
+ * encoder to drop it.
+ *
+ * Must be called by the producer end only.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p ring is not initialized, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_encoder_commit_ring()
+ */
+extern int
+dpack_encoder_init_ring(struct dpack_encoder_ring * __restrict encoder,
+                        struct dpack_ring * __restrict         ring)
+	__dpack_nonull(1, 2) __dpack_nothrow __warn_result __dpack_export;
+
+/**
+ * Publish a message encoded into a shared memory ring slot
+ *
+ * @param[inout] encoder encoder
+ *
+ * Make the message encoded into @p encoder visible to the consumer and wake it
+ * up when it is waiting for messages. @p encoder is released.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p encoder is not initialized or no data was encoded, result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_init_ring()
+ */
+extern void
+dpack_encoder_commit_ring(struct dpack_encoder_ring * __restrict encoder)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Shared memory ring decoder
+ *
+ * @see
+ * - dpack_decoder_init_ring()
+ */
+struct dpack_decoder_ring {
+	/** Decoder to unpack message with. */
+	struct dpack_decoder_buffer buff;
+	/* Ring the message is being decoded from. */
+	struct dpack_ring *         ring;
+	/* Consumer index of slot the message is being decoded from. */
+	uint32_t                    tail;
+};
+
+/**
+ * Initialize a MessagePack decoder with shared memory ring slot
+ *
+ * @param[out]   decoder decoder
+ * @param[inout] ring    shared memory ring
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -EAGAIN  Ring is empty
+ * @retval -EBADMSG Invalid message size found into slot
+ *
+ * Initialize @p decoder so that the oldest message published into @p ring is
+ * unpacked in place, i.e. without copying, through @p decoder
+ * dpack_decoder_ring::buff base decoder.
+ *
+ * Release the slot back to the producer using dpack_decoder_release_ring()
+ * once done.
+ *
+ * Must be called by the consumer end only.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p ring is not initialized, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_decoder_release_ring()
+ * - dpack_ring_wait()
+ */
+extern int
+dpack_decoder_init_ring(struct dpack_decoder_ring * __restrict decoder,
+                        struct dpack_ring * __restrict         ring)
+	__dpack_nonull(1, 2) __dpack_nothrow __warn_result __dpack_export;
+
+/**
+ * Release a shared memory ring slot
+ *
+ * @param[inout] decoder decoder
+ *
+ * Release @p decoder and hand the slot it was decoding from back to the
+ * producer. Data decoded in place *MUST NOT* be accessed anymore.
+ *
+ * @see
+ * - dpack_decoder_init_ring()
+ */
+extern void
+dpack_decoder_release_ring(struct dpack_decoder_ring * __restrict decoder)
+	__dpack_nonull(1) __dpack_nothrow __dpack_export;
+
+#endif /* _DPACK_RING_H */
@@ -0,0 +1,488 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * MessagePack-RPC interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_RPC_H
+#define _DPACK_RPC_H
+
+#include <dpack/codec.h>
+#include <dpack/string.h>
+
+/**
+ * Maximum length of a MessagePack-RPC method name in bytes, excluding the
+ * terminating ``NULL`` byte.
+ */
+#if DPACK_STRLEN_MAX >= 63U
+#define DPACK_RPC_METHOD_LEN_MAX (63U)
+#else
+#define DPACK_RPC_METHOD_LEN_MAX DPACK_STRLEN_MAX
+#endif
+
+/**
+ * Maximum size of a MessagePack-RPC message in bytes.
+ *
+ * Size of connection receive buffers. A connection also buffers up to twice
+ * this size of outgoing messages before transmitting them.
+ */
+#define DPACK_RPC_MSG_SIZE_MAX \
+	STROLL_CONCAT(CONFIG_DPACK_RPC_MSG_SIZE_MAX, U)
+
+/**
+ * MessagePack-RPC parameters / result encoding callback.
+ *
+ * @param[inout] encoder encoder
+ * @param[inout] data    optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_rpc_call() and dpack_rpc_notify() to encode
+ * request parameters. It *MUST* encode a single array.
+ *
+ * @see
+ * - dpack_rpc_call()
+ * - dpack_rpc_notify()
+ */
+typedef int dpack_rpc_encode_fn(struct dpack_encoder * __restrict,
+                                void * __restrict);
+
+/**
+ * MessagePack-RPC method handler.
+ *
+ * @param[inout] params decoder holding request parameters array
+ * @param[inout] result encoder to pack result into
+ * @param[inout] data   optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by the server for each request or notification invoking
+ * the method it is registered for.
+ *
+ * @p params is positioned right at the start of the parameters array. Parts
+ * of it the handler leaves undecoded are skipped.
+ *
+ * When returning ``0``, the handler *MUST* have encoded a single object into
+ * @p result. When returning a *negative error* code, whatever was encoded
+ * into @p result is discarded and the error code is sent back to the client
+ * instead. A reply that would exceed #DPACK_RPC_MSG_SIZE_MAX is replaced
+ * by a ``-EMSGSIZE`` error the same way.
+ *
+ * For notifications, @p result is a counting encoder: whatever is encoded into
+ * it is discarded.
+ *
+ * @see
+ * - dpack_rpc_method
+ * - dpack_rpc_server_init()
+ */
+typedef int dpack_rpc_handler_fn(struct dpack_decoder * __restrict,
+                                 struct dpack_encoder * __restrict,
+                                 void * __restrict);
+
+/**
+ * MessagePack-RPC method
+ *
+ * @see
+ * - dpack_rpc_server_init()
+ */
+struct dpack_rpc_method {
+	/** Method name. */
+	const char *           name;
+	/** Method handler. */
+	dpack_rpc_handler_fn * handler;
+};
+
+/*
+ * Connection to a MessagePack-RPC peer.
+ *
+ * Incoming messages are accumulated into rx until complete. Outgoing messages
+ * are encoded back to back into tx and transmitted at once so that pipelined
+ * requests / replies cost a single system call. Bytes the socket does not
+ * accept yet are kept at the start of tx until it drains.
+ */
+struct dpack_rpc_conn {
+	struct dpack_rpc_conn *     next;
+	struct dpack_rpc_conn *     prev;
+	/* Offset of first message not processed yet. */
+	size_t                      head;
+	/* Offset of end of received data. */
+	size_t                      tail;
+	uint8_t *                   rx;
+	struct dpack_encoder_buffer tx;
+	/* epoll events watched by server. */
+	uint32_t                    events;
+	int                         fd;
+};
+
+/* Method table displacement of a hash bucket. */
+struct dpack_rpc_disp {
+	uint32_t d0;
+	uint32_t d1;
+};
+
+/**
+ * MessagePack-RPC server
+ *
+ * Dispatch incoming requests and notifications to registered methods
+ * through a minimal perfect hash table indexed by method name, serving
+ * multiple connections out of a single thread using @man{epoll(7)}.
+ *
+ * @see
+ * - dpack_rpc_server_init()
+ * - dpack_rpc_server_run()
+ */
+struct dpack_rpc_server {
+	/* Method minimal perfect hash table, one slot per method. */
+	const struct dpack_rpc_method ** slots;
+	/* Per hash bucket displacements. */
+	struct dpack_rpc_disp *          disps;
+	/* Number of slots. */
+	uint32_t                         slot_nr;
+	/* Number of hash buckets. */
+	uint32_t                         bucket_nr;
+	/* Method name hashing seed. */
+	uint32_t                         seed;
+	/* List of connections. */
+	struct dpack_rpc_conn *          conns;
+	/* Data given to method handlers. */
+	void *                           data;
+	/* Listening socket file descriptor. */
+	int                              lfd;
+	/* epoll file descriptor. */
+	int                              efd;
+};
+
+/**
+ * Initialize a MessagePack-RPC server
+ *
+ * @param[out] server  server
+ * @param[in]  methods array of methods to serve
+ * @param[in]  nr      number of @p methods entries
+ * @param[in]  data    optional arbitrary user data given to method handlers
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -EEXIST Duplicate method names
+ * @retval -ENOMEM Memory allocation failure
+ * @retval <0      @man{epoll_create1(2)} error code
+ *
+ * @p methods *MUST* be kept around until @p server is no longer used.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p nr is zero or a method name is empty or longer than
+ * #DPACK_RPC_METHOD_LEN_MAX, result is undefined. An assertion is triggered
+ * otherwise.
+ *
+ * @see
+ * - dpack_rpc_server_listen()
+ * - dpack_rpc_server_attach()
+ * - dpack_rpc_server_run()
+ * - dpack_rpc_server_fini()
+ */
+extern int
+dpack_rpc_server_init(struct dpack_rpc_server * __restrict       server,
+                      const struct dpack_rpc_method * __restrict methods,
+                      unsigned int                               nr,
+                      void * __restrict                          data)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Listen for MessagePack-RPC connections onto a Unix socket
+ *
+ * @param[inout] server server
+ * @param[in]    path   Unix socket pathname
+ *
+ * @return an errno like error code
+ * @retval 0            Success
+ * @retval -ENAMETOOLONG @p path too long
+ * @retval <0           @man{socket(2)}, @man{bind(2)} or @man{listen(2)} error
+ *                      code
+ *
+ * Connections are accepted by dpack_rpc_server_run().
+ *
+ * @see
+ * - dpack_rpc_server_run()
+ */
+extern int
+dpack_rpc_server_listen(struct dpack_rpc_server * __restrict server,
+                        const char * __restrict              path)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Serve MessagePack-RPC requests over an already connected socket
+ *
+ * @param[inout] server server
+ * @param[in]    fd     connected stream socket file descriptor
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ * @retval <0      @man{epoll_ctl(2)} error code
+ *
+ * @p server takes ownership of @p fd, which is closed when the peer
+ * disconnects or at dpack_rpc_server_fini() time.
+ *
+ * @see
+ * - dpack_rpc_server_run()
+ */
+extern int
+dpack_rpc_server_attach(struct dpack_rpc_server * __restrict server, int fd)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Process pending MessagePack-RPC server events
+ *
+ * @param[inout] server server
+ * @param[in]    tmout  maximum time to wait for events in milliseconds, ``-1``
+ *                      meaning infinite
+ *
+ * @return an errno like error code
+ * @retval 0   Success
+ * @retval <0  @man{epoll_wait(2)} error code
+ *
+ * Wait for @man{epoll(7)} events, accept incoming connections and process
+ * all complete messages received so far. Replies to requests pipelined onto
+ * the same connection are transmitted using a single system call.
+ *
+ * Transmission never blocks: when a connection socket is full, the server
+ * stops reading requests from it and keeps unsent replies around until the
+ * peer drains the socket.
+ *
+ * Connections failing or carrying malformed messages are closed.
+ *
+ * @see
+ * - dpack_rpc_server_init()
+ */
+extern int
+dpack_rpc_server_run(struct dpack_rpc_server * __restrict server, int tmout)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Release resources allocated by a MessagePack-RPC server
+ *
+ * @param[inout] server server
+ *
+ * Close all connections and the listening socket if any.
+ *
+ * @see
+ * - dpack_rpc_server_init()
+ */
+extern void
+dpack_rpc_server_fini(struct dpack_rpc_server * __restrict server)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * MessagePack-RPC client
+ *
+ * @see
+ * - dpack_rpc_client_init()
+ * - dpack_rpc_call()
+ */
+struct dpack_rpc_client {
+	struct dpack_rpc_conn conn;
+	/* Identifier of next request. */
+	uint32_t              msgid;
+};
+
+/**
+ * MessagePack-RPC reply callback.
+ *
+ * @param[in]    msgid  identifier of request replied to
+ * @param[in]    error  error code returned by method handler
+ * @param[inout] result decoder holding result
+ * @param[inout] data   optional arbitrary user data
+ *
+ * @return an errno like error code
+ *
+ * Function called by dpack_rpc_client_recv() for each reply received.
+ *
+ * @p error is ``0`` when the request succeeded. It is set to the negative
+ * errno like error code returned by the remote method handler otherwise, or
+ * to ``-EREMOTEIO`` when the server replied with an error object that is not
+ * an integer.
+ *
+ * @p result is positioned right at the start of the result object. Parts of
+ * it the callback leaves undecoded are skipped.
+ *
+ * When returning a *negative error* code, reply processing is interrupted and
+ * the error code is returned to the caller of dpack_rpc_client_recv().
+ *
+ * @see
+ * - dpack_rpc_client_recv()
+ */
+typedef int dpack_rpc_reply_fn(uint32_t,
+                               int,
+                               struct dpack_decoder * __restrict,
+                               void * __restrict);
+
+/**
+ * Initialize a MessagePack-RPC client
+ *
+ * @param[out] client client
+ * @param[in]  fd     connected stream socket file descriptor
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * @p client takes ownership of @p fd, which is closed at
+ * dpack_rpc_client_fini() time.
+ *
+ * @see
+ * - dpack_rpc_client_connect()
+ * - dpack_rpc_client_fini()
+ */
+extern int
+dpack_rpc_client_init(struct dpack_rpc_client * __restrict client, int fd)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Connect a MessagePack-RPC client to a server Unix socket
+ *
+ * @param[out] client client
+ * @param[in]  path   server Unix socket pathname
+ *
+ * @return an errno like error code
+ * @retval 0             Success
+ * @retval -ENAMETOOLONG @p path too long
+ * @retval -ENOMEM       Memory allocation failure
+ * @retval <0            @man{socket(2)} or @man{connect(2)} error code
+ *
+ * @see
+ * - dpack_rpc_client_init()
+ * - dpack_rpc_server_listen()
+ */
+extern int
+dpack_rpc_client_connect(struct dpack_rpc_client * __restrict client,
+                         const char * __restrict              path)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Release resources allocated by a MessagePack-RPC client
+ *
+ * @param[inout] client client
+ *
+ * Queued requests not flushed yet are discarded.
+ *
+ * @see
+ * - dpack_rpc_client_init()
+ */
+extern void
+dpack_rpc_client_fini(struct dpack_rpc_client * __restrict client)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Queue a MessagePack-RPC request
+ *
+ * @param[inout] client client
+ * @param[in]    method name of method to invoke
+ * @param[in]    encode request parameters encoding callback
+ * @param[inout] data   optional arbitrary user data given to @p encode
+ *
+ * @return identifier of request when successful, an errno like error code
+ *         otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Request larger than #DPACK_RPC_MSG_SIZE_MAX
+ * @retval <0        @p encode or @man{write(2)} error code
+ *
+ * Encode a request into @p client transmit buffer without sending it so that
+ * multiple requests may be pipelined and transmitted at once using
+ * dpack_rpc_client_flush(). Queued requests are flushed automatically when
+ * transmit buffer runs out of space.
+ *
+ * Request identifiers wrap around within the ``[0:INT_MAX]`` range.
+ *
+ * @see
+ * - dpack_rpc_client_flush()
+ * - dpack_rpc_client_recv()
+ */
+extern int
+dpack_rpc_call(struct dpack_rpc_client * __restrict client,
+               const char * __restrict              method,
+               dpack_rpc_encode_fn *                encode,
+               void * __restrict                    data)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
+/**
+ * Queue a MessagePack-RPC notification
+ *
+ * @param[inout] client client
+ * @param[in]    method name of method to invoke
+ * @param[in]    encode notification parameters encoding callback
+ * @param[inout] data   optional arbitrary user data given to @p encode
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EMSGSIZE Notification larger than #DPACK_RPC_MSG_SIZE_MAX
+ * @retval <0        @p encode or @man{write(2)} error code
+ *
+ * Same as dpack_rpc_call() except that server sends no reply back.
+ *
+ * @see
+ * - dpack_rpc_call()
+ */
+extern int
+dpack_rpc_notify(struct dpack_rpc_client * __restrict client,
+                 const char * __restrict              method,
+                 dpack_rpc_encode_fn *                encode,
+                 void * __restrict                    data)
+	__dpack_nonull(1, 2, 3) __warn_result __dpack_export;
+
+/**
+ * Transmit queued MessagePack-RPC requests
+ *
+ * @param[inout] client client
+ *
+ * @return an errno like error code
+ * @retval 0  Success
+ * @retval <0 @man{write(2)} error code
+ *
+ * @see
+ * - dpack_rpc_call()
+ */
+extern int
+dpack_rpc_client_flush(struct dpack_rpc_client * __restrict client)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Receive MessagePack-RPC replies
+ *
+ * @param[inout] client client
+ * @param[in]    reply  reply callback
+ * @param[inout] data   optional arbitrary user data given to @p reply
+ *
+ * @return number of replies processed when successful, an errno like error
+ *         code otherwise
+ * @retval >0          Success
+ * @retval -ECONNRESET Server closed connection
+ * @retval -EMSGSIZE   Reply larger than #DPACK_RPC_MSG_SIZE_MAX
+ * @retval -EPROTO     Malformed reply
+ * @retval <0          @p reply or @man{read(2)} error code
+ *
+ * Flush queued requests, wait for replies then hand all complete replies
+ * received so far to @p reply.
+ *
+ * @see
+ * - dpack_rpc_call()
+ * - dpack_rpc_reply_fn
+ */
+extern int
+dpack_rpc_client_recv(struct dpack_rpc_client * __restrict client,
+                      dpack_rpc_reply_fn *                 reply,
+                      void * __restrict                    data)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+#endif /* _DPACK_RPC_H */
@@ -0,0 +1,174 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Zero-copy socket encoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_SOCKET_H
+#define _DPACK_SOCKET_H
+
+#include <dpack/codec.h>
+#include <poll.h>
+
+/**
+ * Default socket encoder zero-copy threshold in bytes.
+ *
+ * Below this size, the cost of pinning pages and processing the completion
+ * notification exceeds the cost of copying data into the kernel.
+ *
+ * @see
+ * - dpack_encoder_init_socket()
+ */
+#define DPACK_ENCODER_SOCKET_ZCOPY_DFLT (16384U)
+
+/**
+ * Maximum number of socket encoder chunks.
+ */
+#define DPACK_ENCODER_SOCKET_CHUNK_NR_MAX (256U)
+
+struct dpack_socket_chunk;
+
+/**
+ * Zero-copy socket encoder
+ *
+ * An encoder packing data into a pool of fixed size chunks which are sent to a
+ * stream socket as soon as they fill up, using ``MSG_ZEROCOPY`` when possible.
+ *
+ * @see
+ * - dpack_encoder_init_socket()
+ * - dpack_encoder_flush_socket()
+ */
+struct dpack_encoder_socket {
+	struct dpack_encoder        base;
+	/* Number of bytes sent so far. */
+	size_t                      sent;
+	/* Number of bytes encoded into current chunk. */
+	size_t                      tail;
+	/* Size of a chunk in bytes. */
+	size_t                      csize;
+	/* Minimum number of bytes to send using MSG_ZEROCOPY. */
+	size_t                      zcopy;
+	/* Chunks memory area. */
+	uint8_t *                   mem;
+	/* Per chunk zero-copy completion tracking. */
+	struct dpack_socket_chunk * chunks;
+	/* Number of chunks. */
+	unsigned int                nr;
+	/* Index of chunk being encoded into. */
+	unsigned int                head;
+	/* Identifier of next zero-copy send. */
+	uint32_t                    next;
+	/* Identifier of first zero-copy send not completed yet. */
+	uint32_t                    done;
+	/* Function waiting for socket events, poll(2) by default. */
+	int                      (* poll)(struct pollfd *, nfds_t, int);
+	/* Error that broke encoding, if any. */
+	int                         err;
+	/* Socket file descriptor. */
+	int                         fd;
+};
+
+/**
+ * Initialize a MessagePack encoder with a stream socket
+ *
+ * @param[out] encoder encoder
+ * @param[in]  fd      connected stream socket file descriptor
+ * @param[in]  size    size of a chunk in bytes
+ * @param[in]  nr      number of chunks
+ * @param[in]  zcopy   minimum number of bytes to send using ``MSG_ZEROCOPY``
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ * @retval <0      Other @man{setsockopt(2)} error codes
+ *
+ * Initialize a @rstsubst{MessagePack} encoder packing data into a pool of
+ * @p nr chunks of @p size bytes, rounded up to a multiple of the system page
+ * size. Each chunk is sent to @p fd as soon as it is full so that messages of
+ * arbitrary size may be streamed without holding them entirely in memory.
+ *
+ * Chunks holding at least @p zcopy bytes are sent using @man{send(2)}
+ * ``MSG_ZEROCOPY`` flag: the kernel then transmits data straight out of chunk
+ * pages and the chunk is recycled only once the completion notification has
+ * been received from the socket error queue. Smaller chunks are copied into
+ * the kernel using a regular @man{send(2)} call. Pass
+ * #DPACK_ENCODER_SOCKET_ZCOPY_DFLT as @p zcopy unless a better value is known
+ * for the target system.
+ *
+ * When @p fd does not support zero-copy transmission, e.g. because it is not
+ * a TCP socket, all chunks are sent using regular @man{send(2)} calls.
+ *
+ * @p fd is owned by the caller and must not have been used to send data with
+ * ``MSG_ZEROCOPY`` flag before.
+ *
+ * Waiting for socket events goes through the @p encoder poll field, set to
+ * @man{poll(2)} at initialization time. It may be overridden afterwards, e.g.
+ * to inject socket events for testing purposes.
+ *
+ * Call dpack_encoder_flush_socket() to send data encoded so far, e.g. at
+ * message boundaries, then dpack_encoder_fini() once done.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p fd is invalid, @p size is zero or @p nr is zero or greater than
+ * #DPACK_ENCODER_SOCKET_CHUNK_NR_MAX, result is undefined. An assertion is
+ * triggered otherwise.
+ *
+ * @see
+ * - dpack_encoder_flush_socket()
+ * - dpack_encoder_fini()
+ */
+extern int
+dpack_encoder_init_socket(struct dpack_encoder_socket * __restrict encoder,
+                          int                                      fd,
+                          size_t                                   size,
+                          unsigned int                             nr,
+                          size_t                                   zcopy)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Send data encoded into a socket encoder so far.
+ *
+ * @param[inout] encoder encoder
+ *
+ * @return an errno like error code
+ * @retval 0      Success
+ * @retval -EPIPE Connection hung up while waiting for a chunk release
+ * @retval <0     @man{send(2)}, @man{poll(2)} or pending socket error codes
+ *
+ * Send content of the chunk currently being encoded into, if any. Sending
+ * may complete asynchronously when the chunk is sent using ``MSG_ZEROCOPY``.
+ *
+ * Waiting for the kernel to release a chunk gives up when the socket reports
+ * an error or a hang up: the encoder then fails with the same error code.
+ *
+ * @warning
+ * A sending failure cannot be recovered from since the chunk being sent may
+ * have been partially transmitted: the stream is dead and all further
+ * encoding and flushing fail with the same error code. dpack_encoder_fini()
+ * then returns that error code.
+ *
+ * dpack_encoder_fini() flushes pending data and waits for all zero-copy sends
+ * to complete before releasing @p encoder.
+ *
+ * @see
+ * - dpack_encoder_init_socket()
+ * - dpack_encoder_fini()
+ */
+extern int
+dpack_encoder_flush_socket(struct dpack_encoder_socket * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+#endif /* _DPACK_SOCKET_H */
@@ -0,0 +1,557 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Message template interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_TMPL_H
+#define _DPACK_TMPL_H
+
+#include <dpack/codec.h>
+#include <endian.h>
+#include <string.h>
+
+/**
+ * Message template slot
+ *
+ * Location of a variable template value.
+ */
+struct dpack_tmpl_slot {
+	/* Offset of value bytes from start of template. */
+	size_t  off;
+	/* Size of value bytes. */
+	size_t  size;
+	/* MessagePack tag slot was encoded with. */
+	uint8_t tag;
+};
+
+/**
+ * Message template
+ *
+ * A message encoded once according to the @rstsubst{MessagePack format} where
+ * variable values, i.e. slots, are packed using fixed-width encodings so that
+ * their location does not depend on their value.
+ *
+ * Subsequent messages are built by copying the template then storing new
+ * values right into slots, at the cost of little more than a @man{memcpy(3)}.
+ *
+ * @see
+ * - dpack_tmpl_init()
+ * - dpack_tmpl_copy()
+ */
+struct dpack_tmpl {
+	/** Encoder to pack template with. */
+	struct dpack_encoder_buffer buff;
+	/* Slots table. */
+	struct dpack_tmpl_slot *    slots;
+	/* Number of slots recorded. */
+	unsigned int                nr;
+	/* Size of slots table. */
+	unsigned int                max;
+};
+
+#define dpack_tmpl_assert_api(_tmpl) \
+	dpack_assert_api(_tmpl); \
+	dpack_assert_api((_tmpl)->buff.buff); \
+	dpack_assert_api((_tmpl)->slots); \
+	dpack_assert_api((_tmpl)->max); \
+	dpack_assert_api((_tmpl)->nr <= (_tmpl)->max)
+
+#define dpack_tmpl_assert_slot_api(_tmpl, _slot, _size) \
+	dpack_tmpl_assert_api(_tmpl); \
+	dpack_assert_api((_slot) < (_tmpl)->nr); \
+	dpack_assert_api((_tmpl)->slots[_slot].size == (_size)); \
+	dpack_assert_api(((_tmpl)->slots[_slot].off + (_size)) <= \
+	                 (_tmpl)->buff.tail)
+
+#define dpack_tmpl_assert_slot_tag_api(_tmpl, _slot, _tag, _size) \
+	dpack_tmpl_assert_slot_api(_tmpl, _slot, _size); \
+	dpack_assert_api((_tmpl)->slots[_slot].tag == (_tag))
+
+/**
+ * Initialize a message template
+ *
+ * @param[out] tmpl template
+ * @param[in]  size maximum size of template in bytes
+ * @param[in]  nr   maximum number of template slots
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Once initialized, encode the template message content using the encoder
+ * returned by dpack_tmpl_encoder() and regular encoding functions for
+ * constant parts, and dpack_tmpl_encode_uint32() and friends for variable
+ * values.
+ *
+ * @warning
+ * - Since slots are located by offset, the open-ended collection encoding
+ *   interface, which moves already encoded data when closing collections, *MUST
+ *   NOT* be used to encode templates.
+ * - When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ *   @p size or @p nr is zero, result is undefined. An assertion is triggered
+ *   otherwise.
+ *
+ * @see
+ * - dpack_tmpl_fini()
+ * - dpack_tmpl_encoder()
+ */
+extern int
+dpack_tmpl_init(struct dpack_tmpl * __restrict tmpl,
+                size_t                         size,
+                unsigned int                   nr)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Release resources allocated by a message template
+ *
+ * @param[inout] tmpl template
+ *
+ * @see
+ * - dpack_tmpl_init()
+ */
+extern void
+dpack_tmpl_fini(struct dpack_tmpl * __restrict tmpl)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * Return encoder to pack template with
+ *
+ * @param[inout] tmpl template
+ *
+ * @return encoder
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+struct dpack_encoder *
+dpack_tmpl_encoder(struct dpack_tmpl * __restrict tmpl)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	return &tmpl->buff.base;
+}
+
+/**
+ * Return size of a message template
+ *
+ * @param[in] tmpl template
+ *
+ * @return size of encoded template in bytes
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_tmpl_size(const struct dpack_tmpl * __restrict tmpl)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	return tmpl->buff.tail;
+}
+
+/**
+ * Encode a boolean template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @see
+ * - dpack_tmpl_store_bool()
+ */
+extern int
+dpack_tmpl_encode_bool(struct dpack_tmpl * __restrict tmpl, bool value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Encode a 32-bits unsigned integer template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @p value is always encoded as a 32-bits unsigned integer according to the
+ * @rstsubst{MessagePack int format}, whatever its magnitude.
+ *
+ * @see
+ * - dpack_tmpl_store_uint32()
+ */
+extern int
+dpack_tmpl_encode_uint32(struct dpack_tmpl * __restrict tmpl, uint32_t value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Encode a 32-bits signed integer template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @p value is always encoded as a 32-bits signed integer according to the
+ * @rstsubst{MessagePack int format}, whatever its magnitude.
+ *
+ * @see
+ * - dpack_tmpl_store_int32()
+ */
+extern int
+dpack_tmpl_encode_int32(struct dpack_tmpl * __restrict tmpl, int32_t value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Encode a 64-bits unsigned integer template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @p value is always encoded as a 64-bits unsigned integer according to the
+ * @rstsubst{MessagePack int format}, whatever its magnitude.
+ *
+ * @see
+ * - dpack_tmpl_store_uint64()
+ */
+extern int
+dpack_tmpl_encode_uint64(struct dpack_tmpl * __restrict tmpl, uint64_t value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Encode a 64-bits signed integer template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @p value is always encoded as a 64-bits signed integer according to the
+ * @rstsubst{MessagePack int format}, whatever its magnitude.
+ *
+ * @see
+ * - dpack_tmpl_store_int64()
+ */
+extern int
+dpack_tmpl_encode_int64(struct dpack_tmpl * __restrict tmpl, int64_t value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+#if defined(CONFIG_DPACK_FLOAT)
+
+/**
+ * Encode a single precision floating point number template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p value is NaN, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_tmpl_store_float()
+ */
+extern int
+dpack_tmpl_encode_float(struct dpack_tmpl * __restrict tmpl, float value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+
+#if defined(CONFIG_DPACK_DOUBLE)
+
+/**
+ * Encode a double precision floating point number template slot
+ *
+ * @param[inout] tmpl  template
+ * @param[in]    value initial slot value
+ *
+ * @return slot identifier when successful, an errno like error code otherwise
+ * @retval >=0       Success
+ * @retval -EMSGSIZE Not enough space to complete operation
+ * @retval -ENOSPC   No slot left
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p value is NaN, result is undefined. An assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_tmpl_store_double()
+ */
+extern int
+dpack_tmpl_encode_double(struct dpack_tmpl * __restrict tmpl, double value)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+
+/**
+ * Build a message out of a template
+ *
+ * @param[in]  tmpl template
+ * @param[out] msg  buffer where to store message
+ *
+ * @return size of message in bytes
+ *
+ * Copy @p tmpl content into @p msg which *MUST* be at least dpack_tmpl_size()
+ * bytes large. Then use dpack_tmpl_store_uint32() and friends to update slots
+ * values.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+size_t
+dpack_tmpl_copy(const struct dpack_tmpl * __restrict tmpl,
+                uint8_t * __restrict                 msg)
+{
+	dpack_tmpl_assert_api(tmpl);
+	dpack_assert_api(msg);
+
+	memcpy(msg, tmpl->buff.buff, tmpl->buff.tail);
+
+	return tmpl->buff.tail;
+}
+
+/**
+ * Store a boolean into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_bool(), result is undefined. An
+ * assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_bool(const struct dpack_tmpl * __restrict tmpl,
+                      uint8_t * __restrict                 msg,
+                      unsigned int                         slot,
+                      bool                                 value)
+{
+	dpack_tmpl_assert_slot_api(tmpl, slot, sizeof(uint8_t));
+	dpack_assert_api((tmpl->slots[slot].tag == 0xc2U) ||
+	                 (tmpl->slots[slot].tag == 0xc3U));
+	dpack_assert_api(msg);
+
+	/* Boolean values are carried by MessagePack true / false tags. */
+	msg[tmpl->slots[slot].off] = value ? 0xc3U : 0xc2U;
+}
+
+/*
+ * Store a big-endian value into a slot which must have been encoded with the
+ * given MessagePack tag.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+_dpack_tmpl_store_be32(const struct dpack_tmpl * __restrict tmpl,
+                       uint8_t * __restrict                 msg,
+                       unsigned int                         slot,
+                       uint8_t                              tag,
+                       uint32_t                             value)
+{
+	dpack_tmpl_assert_slot_tag_api(tmpl, slot, tag, sizeof(value));
+	dpack_assert_api(msg);
+
+	value = htobe32(value);
+	memcpy(&msg[tmpl->slots[slot].off], &value, sizeof(value));
+}
+
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+_dpack_tmpl_store_be64(const struct dpack_tmpl * __restrict tmpl,
+                       uint8_t * __restrict                 msg,
+                       unsigned int                         slot,
+                       uint8_t                              tag,
+                       uint64_t                             value)
+{
+	dpack_tmpl_assert_slot_tag_api(tmpl, slot, tag, sizeof(value));
+	dpack_assert_api(msg);
+
+	value = htobe64(value);
+	memcpy(&msg[tmpl->slots[slot].off], &value, sizeof(value));
+}
+
+/**
+ * Store a 32-bits unsigned integer into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_uint32(), result is undefined.
+ * An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_uint32(const struct dpack_tmpl * __restrict tmpl,
+                        uint8_t * __restrict                 msg,
+                        unsigned int                         slot,
+                        uint32_t                             value)
+{
+	_dpack_tmpl_store_be32(tmpl, msg, slot, 0xceU, value);
+}
+
+/**
+ * Store a 32-bits signed integer into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_int32(), result is undefined.
+ * An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_int32(const struct dpack_tmpl * __restrict tmpl,
+                       uint8_t * __restrict                 msg,
+                       unsigned int                         slot,
+                       int32_t                              value)
+{
+	_dpack_tmpl_store_be32(tmpl, msg, slot, 0xd2U, (uint32_t)value);
+}
+
+/**
+ * Store a 64-bits unsigned integer into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_uint64(), result is undefined.
+ * An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_uint64(const struct dpack_tmpl * __restrict tmpl,
+                        uint8_t * __restrict                 msg,
+                        unsigned int                         slot,
+                        uint64_t                             value)
+{
+	_dpack_tmpl_store_be64(tmpl, msg, slot, 0xcfU, value);
+}
+
+/**
+ * Store a 64-bits signed integer into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_int64(), result is undefined.
+ * An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_int64(const struct dpack_tmpl * __restrict tmpl,
+                       uint8_t * __restrict                 msg,
+                       unsigned int                         slot,
+                       int64_t                              value)
+{
+	_dpack_tmpl_store_be64(tmpl, msg, slot, 0xd3U, (uint64_t)value);
+}
+
+#if defined(CONFIG_DPACK_FLOAT)
+
+/**
+ * Store a single precision floating point number into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_float() or @p value is NaN,
+ * result is undefined. An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_float(const struct dpack_tmpl * __restrict tmpl,
+                       uint8_t * __restrict                 msg,
+                       unsigned int                         slot,
+                       float                                value)
+{
+	dpack_assert_api(!__builtin_isnan(value));
+
+	union { float f; uint32_t u; } val = { .f = value };
+
+	_dpack_tmpl_store_be32(tmpl, msg, slot, 0xcaU, val.u);
+}
+
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+
+#if defined(CONFIG_DPACK_DOUBLE)
+
+/**
+ * Store a double precision floating point number into a message template slot
+ *
+ * @param[in]    tmpl  template
+ * @param[inout] msg   message built using dpack_tmpl_copy()
+ * @param[in]    slot  slot identifier
+ * @param[in]    value value to store
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p slot was not returned by dpack_tmpl_encode_double() or @p value is NaN,
+ * result is undefined. An assertion is triggered otherwise.
+ */
+static inline __dpack_nonull(1, 2) __dpack_nothrow
+void
+dpack_tmpl_store_double(const struct dpack_tmpl * __restrict tmpl,
+                        uint8_t * __restrict                 msg,
+                        unsigned int                         slot,
+                        double                               value)
+{
+	dpack_assert_api(!__builtin_isnan(value));
+
+	union { double d; uint64_t u; } val = { .d = value };
+
+	_dpack_tmpl_store_be64(tmpl, msg, slot, 0xcbU, val.u);
+}
+
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+
+#endif /* _DPACK_TMPL_H */
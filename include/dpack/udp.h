@@ -0,0 +1,337 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * UDP batch encoding / decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_UDP_H
+#define _DPACK_UDP_H
+
+#include <dpack/codec.h>
+#include <sys/socket.h>
+
+/**
+ * Maximum size of a UDP batch message in bytes.
+ *
+ * Largest UDP over IPv4 payload.
+ */
+#define DPACK_UDP_MSG_SIZE_MAX (65507U)
+
+/**
+ * Maximum number of messages of a UDP batch.
+ */
+#define DPACK_UDP_BATCH_NR_MAX (1024U)
+
+/**
+ * UDP batch
+ *
+ * An arena of fixed size message slots along with the @man{sendmmsg(2)} /
+ * @man{recvmmsg(2)} vectors describing them, allowing to transmit or receive
+ * multiple datagrams using a single system call.
+ *
+ * Though primarily meant for UDP sockets, any datagram socket may be used.
+ *
+ * @see
+ * - dpack_udp_batch_init()
+ * - dpack_encoder_init_udp()
+ * - dpack_udp_batch_send()
+ * - dpack_udp_batch_recv()
+ * - dpack_decoder_init_udp()
+ */
+struct dpack_udp_batch {
+	/* Message vector given to sendmmsg(2) / recvmmsg(2). */
+	struct mmsghdr *          hdrs;
+	/* Per message data location. */
+	struct iovec *            iovs;
+	/* Per message peer address. */
+	struct sockaddr_storage * addrs;
+	/* Message slots. */
+	uint8_t *                 arena;
+	/* Size of a message slot in bytes. */
+	size_t                    msg_max;
+	/* Number of message slots. */
+	unsigned int              nr;
+	/* Index of first message slot not sent yet. */
+	unsigned int              head;
+	/* Number of message slots in use. */
+	unsigned int              cnt;
+	/* Socket file descriptor. */
+	int                       fd;
+};
+
+/**
+ * Return number of messages held by a UDP batch
+ *
+ * @param[in] batch UDP batch
+ *
+ * @return number of messages
+ *
+ * Return number of messages committed and not sent yet when encoding, or
+ * number of messages received by the last dpack_udp_batch_recv() call when
+ * decoding.
+ *
+ * @see
+ * - dpack_encoder_commit_udp()
+ * - dpack_udp_batch_recv()
+ */
+static inline __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+unsigned int
+dpack_udp_batch_count(const struct dpack_udp_batch * __restrict batch)
+{
+	dpack_assert_api(batch);
+	dpack_assert_api(batch->head <= batch->cnt);
+	dpack_assert_api(batch->cnt <= batch->nr);
+
+	return batch->cnt - batch->head;
+}
+
+/**
+ * Drop all messages queued into a UDP batch
+ *
+ * @param[inout] batch UDP batch
+ *
+ * Discard messages committed and not sent yet, typically those left over by
+ * a dpack_udp_batch_send() call that failed.
+ *
+ * @see
+ * - dpack_udp_batch_send()
+ */
+static inline __dpack_nonull(1) __dpack_nothrow
+void
+dpack_udp_batch_drop(struct dpack_udp_batch * __restrict batch)
+{
+	dpack_assert_api(batch);
+	dpack_assert_api(batch->head <= batch->cnt);
+	dpack_assert_api(batch->cnt <= batch->nr);
+
+	batch->head = 0;
+	batch->cnt = 0;
+}
+
+/**
+ * Initialize a UDP batch
+ *
+ * @param[out] batch   UDP batch
+ * @param[in]  fd      datagram socket file descriptor
+ * @param[in]  nr      number of message slots
+ * @param[in]  msg_max maximum size of a message in bytes
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * @p fd is owned by the caller and must be kept open until @p batch is no
+ * longer used.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p nr is zero or greater than #DPACK_UDP_BATCH_NR_MAX, or @p msg_max is zero
+ * or greater than #DPACK_UDP_MSG_SIZE_MAX, result is undefined. An assertion is
+ * triggered otherwise.
+ *
+ * @see
+ * - dpack_udp_batch_fini()
+ */
+extern int
+dpack_udp_batch_init(struct dpack_udp_batch * __restrict batch,
+                     int                                 fd,
+                     unsigned int                        nr,
+                     size_t                              msg_max)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Release resources allocated by a UDP batch
+ *
+ * @param[inout] batch UDP batch
+ *
+ * Messages not sent yet are dropped. Socket is not closed.
+ *
+ * @see
+ * - dpack_udp_batch_init()
+ */
+extern void
+dpack_udp_batch_fini(struct dpack_udp_batch * __restrict batch)
+	__dpack_nonull(1) __dpack_export;
+
+/**
+ * UDP batch encoder
+ *
+ * @see
+ * - dpack_encoder_init_udp()
+ */
+struct dpack_encoder_udp {
+	/** Encoder to pack message with. */
+	struct dpack_encoder_buffer buff;
+	/* Batch the message is being encoded into. */
+	struct dpack_udp_batch *    batch;
+};
+
+/**
+ * Initialize a MessagePack encoder with next UDP batch message slot
+ *
+ * @param[out]   encoder encoder
+ * @param[inout] batch   UDP batch
+ *
+ * @return an errno like error code
+ * @retval 0        Success
+ * @retval -ENOBUFS No message slot left
+ *
+ * Initialize @p encoder so that the next message is packed right into a
+ * @p batch message slot through @p encoder dpack_encoder_udp::buff base
+ * encoder.
+ *
+ * When @p batch is full, call dpack_udp_batch_send() and retry. Message slots
+ * are given back only once all queued messages have been sent.
+ *
+ * Once done, either call dpack_encoder_commit_udp() to queue the message for
+ * transmission, or dpack_encoder_fini() onto @p encoder base encoder to
+ * drop it.
+ *
+ * @see
+ * - dpack_encoder_commit_udp()
+ * - dpack_udp_batch_send()
+ */
+extern int
+dpack_encoder_init_udp(struct dpack_encoder_udp * __restrict encoder,
+                       struct dpack_udp_batch * __restrict   batch)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Queue a message encoded into a UDP batch for transmission
+ *
+ * @param[inout] encoder encoder
+ * @param[in]    addr    optional destination address
+ * @param[in]    size    size of @p addr in bytes
+ *
+ * Message is sent to @p addr, or to the socket peer address when @p addr is
+ * ``NULL``, at next dpack_udp_batch_send() call. @p encoder is released.
+ *
+ * @see
+ * - dpack_encoder_init_udp()
+ * - dpack_udp_batch_send()
+ */
+extern void
+dpack_encoder_commit_udp(struct dpack_encoder_udp * __restrict encoder,
+                         const struct sockaddr * __restrict    addr,
+                         socklen_t                             size)
+	__dpack_nonull(1) __dpack_nothrow __dpack_export;
+
+/**
+ * Transmit all messages queued into a UDP batch
+ *
+ * @param[inout] batch UDP batch
+ *
+ * @return number of messages sent when successful, an errno like error code
+ *         otherwise
+ * @retval >=0 Success
+ * @retval <0  @man{sendmmsg(2)} error code, no message sent
+ *
+ * Send all queued messages using as few @man{sendmmsg(2)} calls as
+ * possible.
+ *
+ * When an error happens after some messages went out, their number is
+ * returned. Whether some were sent or not, messages left over are kept queued
+ * in order: dpack_udp_batch_count() tells how many. Call
+ * dpack_udp_batch_send() again to retry transmitting them, e.g. once a
+ * non-blocking socket is writable again after a ``-EAGAIN`` error, or
+ * dpack_udp_batch_drop() to discard them.
+ *
+ * @see
+ * - dpack_encoder_commit_udp()
+ * - dpack_udp_batch_count()
+ * - dpack_udp_batch_drop()
+ */
+extern int
+dpack_udp_batch_send(struct dpack_udp_batch * __restrict batch)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Receive messages into a UDP batch
+ *
+ * @param[inout] batch UDP batch
+ * @param[in]    flags @man{recvmmsg(2)} flags
+ *
+ * @return number of messages received when successful, an errno like error
+ *         code otherwise
+ * @retval >0 Success
+ * @retval <0 @man{recvmmsg(2)} error code
+ *
+ * Receive up to the number of @p batch message slots datagrams using a single
+ * @man{recvmmsg(2)} call, replacing previously received ones. Pass
+ * ``MSG_WAITFORONE`` into @p flags to return as soon as at least one datagram
+ * is available.
+ *
+ * @see
+ * - dpack_decoder_init_udp()
+ */
+extern int
+dpack_udp_batch_recv(struct dpack_udp_batch * __restrict batch, int flags)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/**
+ * Initialize a MessagePack decoder with a message received into a UDP batch
+ *
+ * @param[out] decoder decoder
+ * @param[in]  batch   UDP batch
+ * @param[in]  index   index of message within @p batch
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -ENODATA  Empty message
+ * @retval -EMSGSIZE Message truncated
+ *
+ * Message is decoded in place, straight out of @p batch message slot, which
+ * remains valid until next dpack_udp_batch_recv() call.
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p index is not lower than dpack_udp_batch_count(), result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_udp_batch_recv()
+ * - dpack_udp_batch_peer()
+ */
+extern int
+dpack_decoder_init_udp(struct dpack_decoder_buffer * __restrict decoder,
+                       const struct dpack_udp_batch * __restrict batch,
+                       unsigned int                              index)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Return source address of a message received into a UDP batch
+ *
+ * @param[in]  batch UDP batch
+ * @param[in]  index index of message within @p batch
+ * @param[out] size  location where to store size of address in bytes
+ *
+ * @return source address
+ *
+ * @warning
+ * When compiled with the #CONFIG_DPACK_ASSERT_API build option disabled and
+ * @p index is not lower than dpack_udp_batch_count(), result is undefined. An
+ * assertion is triggered otherwise.
+ *
+ * @see
+ * - dpack_udp_batch_recv()
+ */
+extern const struct sockaddr *
+dpack_udp_batch_peer(const struct dpack_udp_batch * __restrict batch,
+                     unsigned int                              index,
+                     socklen_t * __restrict                    size)
+	__dpack_nonull(1, 3) __dpack_pure __dpack_nothrow __warn_result
+	__dpack_export;
+
+#endif /* _DPACK_UDP_H */
@@ -0,0 +1,209 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/**
+ * @file
+ * Zstandard compressing encoding / decoding interface
+ *
+ * @author    Grégor Boirie <gregor.boirie@free.fr>
+ * @date      19 Oct 2024
+ * @copyright Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ * @license   [GNU Lesser General Public License (LGPL) v3]
+ *            (https://www.gnu.org/licenses/lgpl+gpl-3.0.txt)
+ */
+
+#ifndef _DPACK_ZSTD_H
+#define _DPACK_ZSTD_H
+
+#include <dpack/codec.h>
+
+/******************************************************************************
+ * Compressing encoder
+ ******************************************************************************/
+
+struct ZSTD_CCtx_s;
+
+/**
+ * Compressing encoder
+ *
+ * An encoder stacked on top of another one, compressing encoded data into a
+ * Zstandard stream on its way to the underlying encoder.
+ *
+ * @see
+ * - dpack_encoder_init_zstd()
+ * - dpack_encoder_flush_zstd()
+ */
+struct dpack_encoder_zstd {
+	struct dpack_encoder   base;
+	/* Underlying encoder compressed data is written to. */
+	struct dpack_encoder * next;
+	/* Zstandard compression context. */
+	struct ZSTD_CCtx_s *   cctx;
+	/* Compressed data staging block. */
+	uint8_t *              block;
+	/* Size of staging block in bytes. */
+	size_t                 capa;
+	/* Number of bytes compressed so far. */
+	size_t                 done;
+};
+
+/**
+ * Initialize a compressing MessagePack encoder
+ *
+ * @param[out]   encoder encoder
+ * @param[inout] next    underlying encoder
+ * @param[in]    level   compression level
+ * @param[in]    wlog    base 2 logarithm of window size
+ *
+ * @return an errno like error code
+ * @retval 0       Success
+ * @retval -EINVAL Invalid compression level or window size
+ * @retval -ENOMEM Memory allocation failure
+ *
+ * Initialize a @rstsubst{MessagePack} encoder compressing encoded data using
+ * the Zstandard streaming compressor, then writing compressed data to @p next
+ * by blocks. @p next may be a buffer encoder or a buffered file descriptor
+ * encoder so that messages may be compressed to memory or files without
+ * intermediate copy.
+ *
+ * @p level selects the Zstandard compression level. Give ``0`` to use the
+ * default level. @p wlog is the base 2 logarithm of the compression window
+ * size, i.e. the maximum distance back references may reach. Larger windows
+ * improve compression ratio at the expense of memory usage at both ends of the
+ * stream. Give ``0`` to use the default window size for @p level.
+ *
+ * Compressed data is terminated and handed over to @p next by
+ * dpack_encoder_fini(). @p next is owned by the caller: it is not finalized by
+ * dpack_encoder_fini() and must be kept around until then.
+ *
+ * Since data cannot be modified once compressed, open-ended
+ * @rstref{sect-api-array} or @rstref{sect-api-map} encoding is not supported.
+ *
+ * dpack_encoder_space_used() returns the number of uncompressed bytes encoded
+ * so far.
+ *
+ * @see
+ * - dpack_encoder_flush_zstd()
+ * - dpack_decoder_init_zstd()
+ * - dpack_encoder_fini()
+ */
+extern int
+dpack_encoder_init_zstd(struct dpack_encoder_zstd * __restrict encoder,
+                        struct dpack_encoder * __restrict      next,
+                        int                                    level,
+                        unsigned int                           wlog)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+/**
+ * Hand data pending into a compressing encoder over to its underlying encoder
+ *
+ * @param[inout] encoder encoder
+ *
+ * @return an errno like error code
+ * @retval 0  Success
+ * @retval <0 Compression or underlying encoder error code
+ *
+ * Compress all data encoded so far and write it to the underlying encoder so
+ * that a decoder reading it may decompress all of it, e.g. once a message is
+ * complete when streaming messages over a connection. Flushing degrades
+ * compression ratio: call it sparingly.
+ *
+ * @see
+ * - dpack_encoder_init_zstd()
+ */
+extern int
+dpack_encoder_flush_zstd(struct dpack_encoder_zstd * __restrict encoder)
+	__dpack_nonull(1) __warn_result __dpack_export;
+
+/******************************************************************************
+ * Decompressing decoder
+ ******************************************************************************/
+
+struct ZSTD_DCtx_s;
+
+/**
+ * Decompressing decoder
+ *
+ * A decoder stacked on top of another one, decompressing Zstandard compressed
+ * data read from the underlying decoder before decoding.
+ *
+ * @see
+ * - dpack_decoder_init_zstd()
+ */
+struct dpack_decoder_zstd {
+	struct dpack_decoder   base;
+	/* Underlying decoder compressed data is read from. */
+	struct dpack_decoder * next;
+	/* Zstandard decompression context. */
+	struct ZSTD_DCtx_s *   dctx;
+	/* Compressed data staging block. */
+	uint8_t *              in;
+	/* Size of compressed data staging block in bytes. */
+	size_t                 in_capa;
+	/* Offset of first compressed byte not consumed yet. */
+	size_t                 in_head;
+	/* Number of compressed bytes staged. */
+	size_t                 in_tail;
+	/* Decompressed data staging block. */
+	uint8_t *              out;
+	/* Size of decompressed data staging block in bytes. */
+	size_t                 out_capa;
+	/* Offset of first decompressed byte not consumed yet. */
+	size_t                 out_head;
+	/* Number of decompressed bytes staged. */
+	size_t                 out_tail;
+	/* Number of decompressed bytes consumed so far. */
+	size_t                 done;
+	/* Whether last compressed frame has been completely decoded. */
+	bool                   idle;
+};
+
+/**
+ * Initialize a decompressing MessagePack decoder
+ *
+ * @param[out]   decoder decoder
+ * @param[inout] next    underlying decoder
+ * @param[in]    wlog    base 2 logarithm of maximum window size
+ *
+ * @return an errno like error code
+ * @retval 0         Success
+ * @retval -EINVAL   Invalid window size
+ * @retval -ENOMEM   Memory allocation failure
+ * @retval -EBADMSG  Corrupted compressed data
+ * @retval -EMSGSIZE Compressed data window larger than allowed
+ * @retval -ENODATA  Truncated compressed data
+ * @retval <0        Underlying decoder error code
+ *
+ * Initialize a @rstsubst{MessagePack} decoder decompressing data read out of
+ * @p next by blocks using the Zstandard streaming decompressor, e.g. from a
+ * file decoder so that compressed archives may be decoded without being
+ * decompressed to temporary files first.
+ *
+ * @p wlog is the base 2 logarithm of the largest compression window @p decoder
+ * accepts to allocate memory for. Give ``0`` to use the default limit.
+ *
+ * Skipping data decompresses and discards it. Since data is read ahead,
+ * @p next should not be used directly while @p decoder is in use. @p next is
+ * owned by the caller: it is not finalized by dpack_decoder_fini().
+ *
+ * dpack_decoder_data_left() returns the exact number of decompressed bytes
+ * left once all compressed data has been consumed only. Until then, it returns
+ * an upper bound which is zero at end of stream only.
+ *
+ * @p decoder inherits discard mode from @p next.
+ *
+ * @see
+ * - dpack_encoder_init_zstd()
+ * - dpack_decoder_fini()
+ */
+extern int
+dpack_decoder_init_zstd(struct dpack_decoder_zstd * __restrict decoder,
+                        struct dpack_decoder * __restrict      next,
+                        unsigned int                           wlog)
+	__dpack_nonull(1, 2) __warn_result __dpack_export;
+
+#endif /* _DPACK_ZSTD_H */
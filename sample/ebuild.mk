@@ -50,4 +50,10 @@ test-map_sample-cflags           := $(sample-cflags)
 test-map_sample-ldflags          := $(sample-ldflags) -l:builtin.a -ldpack
 test-map_sample-pkgconf          := libstroll
 
+bins                             += $(call kconf_enabled,DPACK_RPC,rpc_bench)
+rpc_bench-objs                   := rpc_bench.o
+rpc_bench-cflags                 := $(sample-cflags)
+rpc_bench-ldflags                := $(sample-ldflags) -ldpack
+rpc_bench-pkgconf                := libstroll
+
 # ex: filetype=make :
@@ -130,7 +130,10 @@ map_sample_unpack_astring(struct dpack_decoder * decoder,
 		return -EEXIST;
 	}
 
-	ret = dpack_decode_lvstr(decoder, &sample->astring);
+	ret = dpack_decode_lvstr_sso(decoder,
+	                             sizeof(sample->astring_buff),
+	                             sample->astring_buff,
+	                             &sample->astring);
 	if (ret < 0)
 		return (int)ret;
 
@@ -33,10 +33,15 @@ enum map_sample_field {
 	MAP_SAMPLE_FLD_NR
 };
 
+#define MAP_SAMPLE_ASTRING_LEN_MIN (4U)
+#define MAP_SAMPLE_ASTRING_LEN_MAX (23U)
+
 struct map_sample {
 	uint32_t            filled;
 	int16_t             ashort;
 	struct stroll_lvstr astring;
+	/* Inline storage for decoded astring: spares a malloc(3) per unpack. */
+	char                astring_buff[MAP_SAMPLE_ASTRING_LEN_MAX + 1];
 	bool                abool;
 	uint32_t            anuint;
 };
@@ -49,9 +54,6 @@ struct map_sample {
 #define MAP_SAMPLE_ASHORT_MIN      (INT16_MIN + 2)
 #define MAP_SAMPLE_ASHORT_MAX      (INT16_MAX - 2)
 
-#define MAP_SAMPLE_ASTRING_LEN_MIN (4U)
-#define MAP_SAMPLE_ASTRING_LEN_MAX (23U)
-
 #define MAP_SAMPLE_INIT \
 	{ \
 		.filled = STROLL_BMAP_INIT_CLEAR32, \
@@ -0,0 +1,318 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+/*
+ * MessagePack-RPC loopback benchmark.
+ *
+ * Fork a server process serving an "add" method over a Unix socket pair, then
+ * issue requests keeping up to a given number of them in flight. Report
+ * throughput and latency percentiles measured from request queuing to reply
+ * processing.
+ */
+
+#include <dpack/rpc.h>
+#include <dpack/array.h>
+#include <dpack/scalar.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_REQ_NR_DFLT (1000000U)
+#define BENCH_DEPTH_DFLT  (64U)
+
+static bool bench_done;
+
+static int
+bench_add(struct dpack_decoder * __restrict params,
+          struct dpack_encoder * __restrict result,
+          void * __restrict                 data __unused)
+{
+	uint32_t a;
+	uint32_t b;
+	int      err;
+
+	err = dpack_array_decode_count_equ(params, 2);
+	if (!err)
+		err = dpack_decode_uint32(params, &a);
+	if (!err)
+		err = dpack_decode_uint32(params, &b);
+	if (err)
+		return -EINVAL;
+
+	return dpack_encode_uint32(result, a + b);
+}
+
+static int
+bench_quit(struct dpack_decoder * __restrict params __unused,
+           struct dpack_encoder * __restrict result __unused,
+           void * __restrict                 data __unused)
+{
+	bench_done = true;
+
+	return 0;
+}
+
+static const struct dpack_rpc_method bench_methods[] = {
+	{ .name = "add",  .handler = bench_add },
+	{ .name = "quit", .handler = bench_quit }
+};
+
+static int
+bench_serve(int fd)
+{
+	struct dpack_rpc_server srv;
+	int                     err;
+
+	err = dpack_rpc_server_init(&srv,
+	                            bench_methods,
+	                            stroll_array_nr(bench_methods),
+	                            NULL);
+	if (err)
+		goto err;
+
+	err = dpack_rpc_server_attach(&srv, fd);
+	if (err)
+		goto fini;
+
+	while (!bench_done) {
+		err = dpack_rpc_server_run(&srv, -1);
+		if (err)
+			goto fini;
+	}
+
+	dpack_rpc_server_fini(&srv);
+
+	return EXIT_SUCCESS;
+
+fini:
+	dpack_rpc_server_fini(&srv);
+err:
+	fprintf(stderr, "server: %s (%d).\n", strerror(-err), -err);
+
+	return EXIT_FAILURE;
+}
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+struct bench_stats {
+	uint64_t *   sent;
+	uint64_t *   lat;
+	unsigned int nr;
+};
+
+static int
+bench_encode_add(struct dpack_encoder * __restrict encoder,
+                 void * __restrict                 data __unused)
+{
+	int err;
+
+	err = dpack_array_begin_encode(encoder, 2);
+	if (!err)
+		err = dpack_encode_uint32(encoder, 40);
+	if (!err)
+		err = dpack_encode_uint32(encoder, 2);
+	if (!err)
+		dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+static int
+bench_encode_quit(struct dpack_encoder * __restrict encoder,
+                  void * __restrict                 data __unused)
+{
+	int err;
+
+	err = dpack_array_begin_encode(encoder, 1);
+	if (!err)
+		err = dpack_encode_nil(encoder);
+	if (!err)
+		dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+static int
+bench_reply(uint32_t                          msgid,
+            int                               error,
+            struct dpack_decoder * __restrict result,
+            void * __restrict                 data)
+{
+	struct bench_stats * stats = data;
+	uint32_t             sum;
+	int                  err;
+
+	if (error)
+		return error;
+
+	err = dpack_decode_uint32(result, &sum);
+	if (err)
+		return err;
+	if (sum != 42)
+		return -EBADMSG;
+
+	stats->lat[stats->nr++] = bench_now() - stats->sent[msgid];
+
+	return 0;
+}
+
+static int
+bench_cmp(const void * first, const void * second)
+{
+	uint64_t a = *(const uint64_t *)first;
+	uint64_t b = *(const uint64_t *)second;
+
+	return (a > b) - (a < b);
+}
+
+static int
+bench_issue(int fd, unsigned int req_nr, unsigned int depth)
+{
+	struct dpack_rpc_client clnt;
+	struct bench_stats      stats = { .nr = 0 };
+	unsigned int            issued = 0;
+	uint64_t                start;
+	uint64_t                elapsed;
+	int                     ret;
+
+	stats.sent = malloc(req_nr * sizeof(stats.sent[0]));
+	stats.lat = malloc(req_nr * sizeof(stats.lat[0]));
+	if (!stats.sent || !stats.lat) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	ret = dpack_rpc_client_init(&clnt, fd);
+	if (ret)
+		goto free;
+
+	start = bench_now();
+	while (stats.nr < req_nr) {
+		/* Keep up to depth requests in flight... */
+		while ((issued < req_nr) && ((issued - stats.nr) < depth)) {
+			stats.sent[issued] = bench_now();
+			ret = dpack_rpc_call(&clnt,
+			                     "add",
+			                     bench_encode_add,
+			                     NULL);
+			if (ret < 0)
+				goto fini;
+			issued++;
+		}
+
+		/* ...sent at once along with waiting for their replies. */
+		ret = dpack_rpc_client_recv(&clnt, bench_reply, &stats);
+		if (ret < 0)
+			goto fini;
+	}
+	elapsed = bench_now() - start;
+
+	ret = dpack_rpc_notify(&clnt, "quit", bench_encode_quit, NULL);
+	if (!ret)
+		ret = dpack_rpc_client_flush(&clnt);
+	if (ret)
+		goto fini;
+
+	qsort(stats.lat, req_nr, sizeof(stats.lat[0]), bench_cmp);
+
+	printf("requests   : %u\n", req_nr);
+	printf("depth      : %u\n", depth);
+	printf("requests/s : %.0f\n",
+	       (double)req_nr * 1e9 / (double)elapsed);
+	printf("p50 (us)   : %.1f\n",
+	       (double)stats.lat[req_nr / 2] / 1e3);
+	printf("p99 (us)   : %.1f\n",
+	       (double)stats.lat[(req_nr / 100) * 99] / 1e3);
+	printf("p99.9 (us) : %.1f\n",
+	       (double)stats.lat[(req_nr / 1000) * 999] / 1e3);
+	printf("max (us)   : %.1f\n",
+	       (double)stats.lat[req_nr - 1] / 1e3);
+
+fini:
+	dpack_rpc_client_fini(&clnt);
+free:
+	free(stats.lat);
+	free(stats.sent);
+
+	if (ret) {
+		fprintf(stderr, "client: %s (%d).\n", strerror(-ret), -ret);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void
+usage(const char * me)
+{
+	fprintf(stderr, "Usage: %s [REQUEST_COUNT [DEPTH]]\n", me);
+}
+
+int
+main(int argc, char * const argv[])
+{
+	unsigned long req_nr = BENCH_REQ_NR_DFLT;
+	unsigned long depth = BENCH_DEPTH_DFLT;
+	int           fds[2];
+	pid_t         pid;
+	int           ret;
+
+	if (argc > 3) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		req_nr = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		depth = strtoul(argv[2], NULL, 0);
+	if ((req_nr < 1000) || (req_nr > (1UL << 28)) ||
+	    !depth || (depth > req_nr)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+		perror("socketpair");
+		return EXIT_FAILURE;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return EXIT_FAILURE;
+	}
+
+	if (!pid) {
+		close(fds[1]);
+		return bench_serve(fds[0]);
+	}
+
+	close(fds[0]);
+	ret = bench_issue(fds[1], (unsigned int)req_nr, (unsigned int)depth);
+	if (ret != EXIT_SUCCESS)
+		/* Server would otherwise wait for the quit notification forever. */
+		kill(pid, SIGTERM);
+
+	waitpid(pid, NULL, 0);
+
+	return ret;
+}
@@ -67,17 +67,38 @@ err:
 static int
 pack_to_file(const char * path, const struct test_ops * ops)
 {
+	struct dpack_encoder_count  cnt;
+	size_t                      size;
 	uint8_t *                   buff;
 	struct dpack_encoder_buffer enc;
 	int                         err;
 
-	buff = malloc(ops->max_size);
+	/*
+	 * Run packing logic a first time to compute the exact size of packed
+	 * data so that the buffer may be allocated without relying upon worst
+	 * case estimation.
+	 */
+	dpack_encoder_init_count(&cnt);
+	err = ops->pack(&cnt.base);
+	size = dpack_encoder_space_used(&cnt.base);
+	dpack_encoder_fini(&cnt.base);
+	if (err) {
+		test_show_error("packing failed: %s (%d).\n",
+		                strerror(-err),
+		                -err);
+		return EXIT_FAILURE;
+	}
+
+	sample_assert(size >= ops->min_size);
+	sample_assert(size <= ops->max_size);
+
+	buff = malloc(size);
 	if (!buff) {
 		test_show_error("buffer allocation failed.\n");
 		return EXIT_FAILURE;
 	}
 
-	dpack_encoder_init_buffer(&enc, buff, ops->max_size);
+	dpack_encoder_init_buffer(&enc, buff, size);
 
 	err = ops->pack(&enc.base);
 	if (err)
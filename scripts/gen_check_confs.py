@@ -71,6 +71,99 @@ conf_syms = frozenset({
 })
 
 
+# Optional modules and container size limits are not combined exhaustively with
+# the core symbols above since the configuration count would then explode.
+# Instead, each core configuration is given one of the following profiles in a
+# round-robin fashion. As the profile count is prime with the size of every
+# core group, each profile is still combined with every core symbol value.
+opt_mods = (
+    'CONFIG_DPACK_INTERN',
+    'CONFIG_DPACK_CODEC_FILE',
+    'CONFIG_DPACK_CODEC_MEMFD',
+    'CONFIG_DPACK_CODEC_FILE_PARALLEL',
+    'CONFIG_DPACK_CODEC_MPBUFFER',
+    'CONFIG_DPACK_CODEC_SOCKET',
+    'CONFIG_DPACK_CODEC_FD',
+    'CONFIG_DPACK_CODEC_FILTER',
+    'CONFIG_DPACK_CODEC_ZSTD',
+    'CONFIG_DPACK_ARRAY_PARALLEL',
+    'CONFIG_DPACK_JOURNAL',
+    'CONFIG_DPACK_RING',
+    'CONFIG_DPACK_RPC',
+    'CONFIG_DPACK_UDP',
+    'CONFIG_DPACK_TMPL'
+)
+
+opt_codecs = frozenset({
+    'CONFIG_DPACK_CODEC_FILE',
+    'CONFIG_DPACK_CODEC_MEMFD',
+    'CONFIG_DPACK_CODEC_MPBUFFER',
+    'CONFIG_DPACK_CODEC_SOCKET',
+    'CONFIG_DPACK_CODEC_FD',
+    'CONFIG_DPACK_CODEC_FILTER',
+    'CONFIG_DPACK_CODEC_ZSTD'
+})
+
+
+# Dependencies of optional modules upon core symbols and other optional
+# modules, as expressed by 'depends on' statements of Config.in.
+# CONFIG_DPACK_CODEC_BUFFER is enabled by default and never disabled here.
+opt_deps = {
+    'CONFIG_DPACK_INTERN': frozenset({ 'CONFIG_DPACK_STRING' }),
+    'CONFIG_DPACK_CODEC_MEMFD': frozenset({ 'CONFIG_DPACK_CODEC_FILE' }),
+    'CONFIG_DPACK_CODEC_FILE_PARALLEL':
+        frozenset({ 'CONFIG_DPACK_CODEC_FILE' }),
+    'CONFIG_DPACK_ARRAY_PARALLEL': frozenset({ 'CONFIG_DPACK_ARRAY' }),
+    'CONFIG_DPACK_RPC': frozenset({ 'CONFIG_DPACK_ARRAY',
+                                    'CONFIG_DPACK_STRING',
+                                    'CONFIG_DPACK_SCALAR' }),
+    'CONFIG_DPACK_TMPL': frozenset({ 'CONFIG_DPACK_SCALAR' })
+}
+
+# Core symbols forcibly enabled by others through 'select' statements of
+# Config.in.
+core_selects = {
+    'CONFIG_DPACK_LVSTR': frozenset({ 'CONFIG_DPACK_STRING' }),
+    'CONFIG_DPACK_SAMPLE': frozenset({ 'CONFIG_DPACK_MAP',
+                                       'CONFIG_DPACK_ARRAY',
+                                       'CONFIG_DPACK_STRING',
+                                       'CONFIG_DPACK_LVSTR',
+                                       'CONFIG_DPACK_FLOAT' })
+}
+
+
+def opt_profile(enabled, *extra):
+    return tuple(sorted(frozenset(['{}={}'.format(mod,
+                                                  'y' if mod in enabled
+                                                  else 'n')
+                                   for mod in opt_mods] + list(extra))))
+
+
+opt_syms = (
+    # All optional modules disabled.
+    opt_profile(frozenset()),
+    # All optional modules enabled with default limits.
+    opt_profile(frozenset(opt_mods)),
+    # All optional modules enabled with smallest limits.
+    opt_profile(frozenset(opt_mods),
+                'CONFIG_DPACK_ARRAY_ELMNR_MAX=15',
+                'CONFIG_DPACK_ARRAY_ELMSZ_MAX=18',
+                'CONFIG_DPACK_MAP_FLDNR_MAX=15',
+                'CONFIG_DPACK_JOURNAL_RECORD_SIZE_MAX=16'),
+    # All optional modules enabled with medium limits.
+    opt_profile(frozenset(opt_mods),
+                'CONFIG_DPACK_ARRAY_ELMNR_MAX=65536'),
+    # All optional modules enabled with largest limits.
+    opt_profile(frozenset(opt_mods),
+                'CONFIG_DPACK_ARRAY_ELMNR_MAX=2147483647',
+                'CONFIG_DPACK_MAP_FLDNR_MAX=2147483647'),
+    # Optional codecs only.
+    opt_profile(opt_codecs),
+    # Optional services only.
+    opt_profile(frozenset(opt_mods) - opt_codecs)
+)
+
+
 def sort_uniq(collection):
     return sorted(tuple(frozenset(collection)))
 
@@ -86,10 +179,34 @@ def make_conf(syms):
     return tuple(sorted(frozenset(flatten(syms))))
 
 
+def fix_profile(core, prof):
+    # Disable optional modules which dependencies are not met by the given
+    # core configuration so that only valid combinations are generated.
+    enabled = set([sym[:-len('=y')] for sym in core if sym.endswith('=y')])
+    for sym, sel in core_selects.items():
+        if sym in enabled:
+            enabled |= sel
+    enabled |= set([sym[:-len('=y')] for sym in prof if sym.endswith('=y')])
+
+    def fix(sym):
+        mod, val = sym.split('=', 1)
+        if val == 'y' and not opt_deps.get(mod, frozenset()) <= enabled:
+            return mod + '=n'
+        return sym
+
+    return tuple(fix(sym) for sym in prof)
+
+
 def conf_db():
+    # Iterate over core groups in a stable order so that profiles are given
+    # to the same core configurations from one run to another.
+    grps = sorted([sorted([make_conf(syms) for syms in grp])
+                   for grp in conf_syms])
     lst = []
-    for cfg in itertools.product(*conf_syms):
-        lst.append(make_conf(cfg))
+    for idx, cfg in enumerate(itertools.product(*grps)):
+        core = make_conf(cfg)
+        prof = fix_profile(core, opt_syms[idx % len(opt_syms)])
+        lst.append(make_conf((core, prof)))
     return sort_uniq(lst)
 
 
@@ -8,6 +8,8 @@
 #include "dpack/array.h"
 #include "dpack/codec.h"
 #include "common.h"
+#include <stdlib.h>
+#include <string.h>
 
 size_t
 dpack_array_mixed_size(unsigned int elm_nr, size_t data_size)
@@ -92,6 +94,52 @@ dpack_array_begin_encode(struct dpack_encoder * __restrict encoder,
 	return err;
 }
 
+int
+dpack_array_begin_encode_open(struct dpack_encoder * __restrict      encoder,
+                              unsigned int                           max_nr,
+                              struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(max_nr <= DPACK_ARRAY_ELMNR_MAX);
+	dpack_assert_api(mark);
+
+	return dpack_begin_open_encode(encoder,
+	                               _DPACK_FIXARRAY_TAG,
+	                               DPACK_ARRAY16_TAG,
+	                               max_nr,
+	                               mark);
+}
+
+int
+dpack_array_end_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark,
+	unsigned int                                 nr,
+	bool                                         compact)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(mark);
+	dpack_assert_api(nr <= DPACK_ARRAY_ELMNR_MAX);
+
+	return dpack_end_open_encode(encoder,
+	                             mark,
+	                             _DPACK_FIXARRAY_TAG,
+	                             DPACK_ARRAY16_TAG,
+	                             nr,
+	                             compact);
+}
+
+int
+dpack_array_cancel_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(mark);
+
+	return dpack_cancel_open_encode(encoder, mark);
+}
+
 /******************************************************************************
  * Basic array decoding
  ******************************************************************************/
@@ -108,27 +156,37 @@ dpack_load_array_tag(struct dpack_decoder * __restrict decoder,
 	int     err;
 
 	err = dpack_read_tag(decoder, &tag);
-	if (!err) {
-		switch (tag) {
-		case DPACK_FIXARRAY_TAG:
-			dpack_fixcnt(tag, _DPACK_FIXARRAY_ELMNR_MAX, nr);
-			return 0;
+	if (err)
+		return err;
+
+	switch (tag) {
+	case DPACK_FIXARRAY_TAG:
+		dpack_fixcnt(tag, _DPACK_FIXARRAY_ELMNR_MAX, nr);
+		break;
 #if DPACK_ARRAY_ELMNR_MAX > _DPACK_FIXARRAY_ELMNR_MAX
-		case DPACK_ARRAY16_TAG:
-			return dpack_read_cnt16(decoder, nr);
+	case DPACK_ARRAY16_TAG:
+		err = dpack_read_cnt16(decoder, nr);
+		break;
 #endif
 #if DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX
-		case DPACK_ARRAY32_TAG:
-			return dpack_read_cnt32(decoder, nr);
+	case DPACK_ARRAY32_TAG:
+		err = dpack_read_cnt32(decoder, nr);
+		break;
 #endif
-		default:
-			err = dpack_maybe_discard(decoder, tag);
-			if (!err)
-				err = -ENOMSG;
-		}
+	default:
+		err = dpack_maybe_discard(decoder, tag);
+		return (!err) ? -ENOMSG : err;
 	}
 
-	return err;
+	if (err)
+		return err;
+
+	/*
+	 * Enforce the runtime limit the decoder may have been restricted to.
+	 * Do not attempt to discard content since the whole point is to prevent
+	 * from processing oversized input.
+	 */
+	return (*nr <= decoder->elm_max) ? 0 : -EMSGSIZE;
 }
 
 static __dpack_nonull(1) __warn_result
@@ -432,3 +490,202 @@ dpack_array_decode_range(struct dpack_decoder * __restrict decoder,
 
 	return dpack_array_xtract_range(decoder, min_nr, max_nr, decode, data);
 }
+
+#if defined(CONFIG_DPACK_STRING)
+
+/******************************************************************************
+ * Array of strings decoding
+ ******************************************************************************/
+
+/*
+ * Initial guess of average string length used to size string table storage.
+ */
+#define DPACK_ARRAY_STRTAB_LEN_HINT (32U)
+
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_array_xtract_strtab(struct dpack_decoder * __restrict decoder,
+                          unsigned int                      nr,
+                          char *** __restrict               table)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(nr);
+	dpack_assert_intern(nr <= DPACK_ARRAY_ELMNR_MAX);
+	dpack_assert_intern(table);
+
+	/*
+	 * Each encoded string is at least one byte longer than its content.
+	 * Hence, the encoded data left is an upper bound of the space required
+	 * to hold all NULL terminated strings.
+	 */
+	size_t       bound = dpack_decoder_data_left(decoder);
+	size_t       tsz;
+	size_t       capa;
+	size_t       used = 0;
+	char **      tab;
+	char *       strs;
+	unsigned int idx;
+	int          err;
+
+	/*
+	 * Reject counts that cannot be returned or that the encoded data left
+	 * cannot hold before sizing storage according to them.
+	 */
+	if (nr > INT_MAX)
+		return -EMSGSIZE;
+	if (nr > bound)
+		return -ENODATA;
+
+	/*
+	 * String storage never grows beyond bound: ensure the largest
+	 * allocation size cannot overflow.
+	 */
+	if (__builtin_mul_overflow((size_t)nr + 1, sizeof(char *), &tsz) ||
+	    __builtin_add_overflow(tsz, bound, &capa))
+		return -ENOMEM;
+	if (__builtin_mul_overflow((size_t)nr,
+	                           (size_t)DPACK_ARRAY_STRTAB_LEN_HINT + 1,
+	                           &capa))
+		capa = bound;
+	else
+		capa = stroll_min(bound, capa);
+
+	tab = malloc(tsz + capa);
+	if (!tab)
+		return -errno;
+
+	for (idx = 0; idx < nr; idx++) {
+		ssize_t len;
+		char *  str;
+
+		len = dpack_decode_str_tag(decoder, 1, DPACK_STRLEN_MAX);
+		dpack_assert_intern(len);
+		if (len < 0) {
+			err = (int)len;
+			goto discard;
+		}
+
+		if ((used + (size_t)len + 1) > capa) {
+			char ** tmp;
+
+			capa = stroll_max(used + (size_t)len + 1,
+			                  stroll_min(2 * capa, bound));
+			tmp = realloc(tab, tsz + capa);
+			if (!tmp) {
+				int ret;
+
+				err = -errno;
+
+				/*
+				 * Skip pending string payload so that remaining
+				 * items are discarded starting from the next
+				 * item boundary.
+				 */
+				ret = dpack_decoder_skip(decoder, (size_t)len);
+				if (ret) {
+					free(tab);
+					return ret;
+				}
+
+				goto discard;
+			}
+
+			tab = tmp;
+		}
+
+		str = &((char *)&tab[(size_t)nr + 1])[used];
+		err = dpack_decoder_read(decoder, (uint8_t *)str, (size_t)len);
+		if (err)
+			goto discard;
+
+		/*
+		 * Ensure the read string contains no NULL byte since msgpack do
+		 * not serialize terminating NULL byte.
+		 */
+		if (memchr(str, 0, (size_t)len)) {
+			err = -EBADMSG;
+			goto discard;
+		}
+		str[len] = '\0';
+
+		/*
+		 * Record string offset only since storage may be moved by
+		 * subsequent reallocations.
+		 */
+		tab[idx] = (char *)(uintptr_t)used;
+		used += (size_t)len + 1;
+	}
+
+	if (used < capa) {
+		/* Give back unused space. */
+		char ** tmp;
+
+		tmp = realloc(tab, tsz + used);
+		if (tmp)
+			tab = tmp;
+	}
+
+	strs = (char *)&tab[(size_t)nr + 1];
+	for (idx = 0; idx < nr; idx++)
+		tab[idx] = &strs[(uintptr_t)tab[idx]];
+	tab[nr] = NULL;
+
+	*table = tab;
+
+	return (int)nr;
+
+discard:
+	free(tab);
+
+	if (++idx < nr) {
+		int ret;
+
+		ret = dpack_maybe_discard_items(decoder,
+		                                nr - idx,
+		                                DPACK_ARRAY_ELMNR_MAX);
+		if (ret)
+			err = ret;
+	}
+
+	return err;
+}
+
+int
+dpack_array_decode_strtab(struct dpack_decoder * __restrict decoder,
+                          char *** __restrict               table)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(table);
+
+	return dpack_array_decode_strtab_range(decoder,
+	                                       1,
+	                                       DPACK_ARRAY_ELMNR_MAX,
+	                                       table);
+}
+
+int
+dpack_array_decode_strtab_range(struct dpack_decoder * __restrict decoder,
+                                unsigned int                      min_nr,
+                                unsigned int                      max_nr,
+                                char *** __restrict               table)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(min_nr);
+	dpack_assert_api(min_nr <= max_nr);
+	dpack_assert_api(max_nr <= DPACK_ARRAY_ELMNR_MAX);
+	dpack_assert_api(table);
+
+	unsigned int nr;
+	int          err;
+
+	err = dpack_load_array_tag(decoder, &nr);
+	if (!err) {
+		if ((nr >= min_nr) && (nr <= max_nr))
+			return dpack_array_xtract_strtab(decoder, nr, table);
+		err = dpack_array_maybe_discard_left(decoder, nr);
+	}
+
+	return err;
+}
+
+#endif /* defined(CONFIG_DPACK_STRING) */
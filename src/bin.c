@@ -408,3 +408,37 @@ dpack_decode_bincpy_range(struct dpack_decoder * __restrict decoder,
 	return (sz > 0) ? dpack_xtract_bincpy(decoder, value, (size_t)sz)
 	                : sz;
 }
+
+ssize_t
+dpack_decode_bin_lend(struct dpack_decoder * __restrict  decoder,
+                      const uint8_t ** __restrict        value,
+                      struct dpack_backing ** __restrict backing)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(value);
+	dpack_assert_api(backing);
+
+	ssize_t   sz;
+	int       err;
+	uint8_t * bin;
+
+	sz = dpack_decode_bin_tag(decoder, 1, DPACK_BINSZ_MAX);
+	dpack_assert_intern(sz);
+	if (sz < 0)
+		return sz;
+
+	err = dpack_decoder_borrow(decoder, (size_t)sz, value, backing);
+	if (!err)
+		return sz;
+	else if (err != -EAGAIN)
+		return err;
+
+	/* Decoder cannot lend its backing storage: fallback to copy. */
+	sz = dpack_xtract_bindup(decoder, &bin, (size_t)sz);
+	if (sz > 0) {
+		*value = bin;
+		*backing = NULL;
+	}
+
+	return sz;
+}
@@ -8,6 +8,41 @@
 #include "dpack/codec.h"
 #include "common.h"
 #include <string.h>
+#include <stdlib.h>
+
+/******************************************************************************
+ * Decoder backing storage
+ ******************************************************************************/
+
+static __dpack_nonull(1)
+void
+dpack_backing_free(struct dpack_backing * __restrict backing)
+{
+	dpack_assert_intern(backing);
+	dpack_assert_intern(!backing->refcnt);
+
+	free(backing);
+}
+
+struct dpack_backing *
+dpack_backing_create(size_t size)
+{
+	dpack_assert_api(size);
+
+	struct dpack_backing * back;
+
+	back = malloc(sizeof(*back) + size);
+	if (!back)
+		return NULL;
+
+	back->refcnt = 1;
+	back->rdonly = false;
+	back->size = size;
+	back->data = (uint8_t *)&back[1];
+	back->release = dpack_backing_free;
+
+	return back;
+}
 
 /******************************************************************************
  * Buffer based encoder / packer
@@ -81,11 +116,60 @@ dpack_encoder_buffer_fini(struct dpack_encoder * __restrict encoder __unused)
 	return 0;
 }
 
+static __dpack_nonull(1, 3) __dpack_nothrow __warn_result
+int
+dpack_encoder_buffer_patch(struct dpack_encoder * __restrict encoder,
+                           size_t                            offset,
+                           const uint8_t * __restrict        data,
+                           size_t                            size)
+{
+	dpack_encoder_assert_buffer_api((const struct dpack_encoder_buffer *)
+	                                encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_buffer * enc = (struct dpack_encoder_buffer *)
+	                                    encoder;
+	size_t                        end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->tail)) {
+		memcpy(&enc->buff[offset], data, size);
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_encoder_buffer_cut(struct dpack_encoder * __restrict encoder,
+                         size_t                            offset,
+                         size_t                            size)
+{
+	dpack_encoder_assert_buffer_api((const struct dpack_encoder_buffer *)
+	                                encoder);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_buffer * enc = (struct dpack_encoder_buffer *)
+	                                    encoder;
+	size_t                        end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->tail)) {
+		memmove(&enc->buff[offset], &enc->buff[end], enc->tail - end);
+		enc->tail -= size;
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
 const struct dpack_encoder_ops dpack_encoder_buffer_ops = {
 	.left  = dpack_encoder_buffer_left,
 	.used  = dpack_encoder_buffer_used,
 	.write = dpack_encoder_buffer_write,
-	.fini  = dpack_encoder_buffer_fini
+	.fini  = dpack_encoder_buffer_fini,
+	.patch = dpack_encoder_buffer_patch,
+	.cut   = dpack_encoder_buffer_cut
 };
 
 void
@@ -174,21 +258,62 @@ dpack_decoder_buffer_skip(struct dpack_decoder * __restrict decoder,
 	return -ENODATA;
 }
 
-static __dpack_nonull(1) __dpack_nothrow __dpack_const __warn_result
+static __dpack_nonull(1, 3, 4) __dpack_nothrow __warn_result
 int
-dpack_decoder_buffer_fini(struct dpack_decoder * __restrict decoder __unused)
+dpack_decoder_buffer_borrow(struct dpack_decoder * __restrict  decoder,
+                            size_t                             size,
+                            const uint8_t ** __restrict        data,
+                            struct dpack_backing ** __restrict backing)
 {
 	dpack_decoder_assert_buffer_api((const struct dpack_decoder_buffer *)
 	                                decoder);
+	dpack_assert_intern(size);
+	dpack_assert_intern(data);
+	dpack_assert_intern(backing);
+
+	struct dpack_decoder_buffer * dec = (struct dpack_decoder_buffer *)
+	                                    decoder;
+	size_t                        head;
+
+	if (!dec->back)
+		/* Caller owned buffer: lifetime unknown, cannot lend it. */
+		return -EAGAIN;
+
+	if (!__builtin_add_overflow(dec->head, size, &head) &&
+	    (head <= dec->capa)) {
+		*data = &dec->buff[dec->head];
+		*backing = dpack_backing_get(dec->back);
+		dec->head = head;
+		return 0;
+	}
+
+	return -ENODATA;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_decoder_buffer_fini(struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_buffer_api((const struct dpack_decoder_buffer *)
+	                                decoder);
+
+	struct dpack_decoder_buffer * dec = (struct dpack_decoder_buffer *)
+	                                    decoder;
+
+	if (dec->back) {
+		dpack_backing_put(dec->back);
+		dec->back = NULL;
+	}
 
 	return 0;
 }
 
 const struct dpack_decoder_ops dpack_decoder_buffer_ops = {
-	.left = dpack_decoder_buffer_left,
-	.read = dpack_decoder_buffer_read,
-	.skip = dpack_decoder_buffer_skip,
-	.fini = dpack_decoder_buffer_fini
+	.left   = dpack_decoder_buffer_left,
+	.read   = dpack_decoder_buffer_read,
+	.skip   = dpack_decoder_buffer_skip,
+	.fini   = dpack_decoder_buffer_fini,
+	.borrow = dpack_decoder_buffer_borrow
 };
 
 void
@@ -207,4 +332,26 @@ _dpack_decoder_init_buffer(struct dpack_decoder_buffer * __restrict decoder,
 	decoder->head = 0;
 	decoder->capa = size;
 	decoder->buff = buffer;
+	decoder->back = NULL;
+}
+
+void
+_dpack_decoder_init_backed_buffer(
+	struct dpack_decoder_buffer * __restrict decoder,
+	struct dpack_backing * __restrict        backing,
+	size_t                                   size,
+	bool                                     discard)
+{
+	dpack_assert_api(decoder);
+	dpack_backing_assert_api(backing);
+	dpack_assert_api(size);
+	dpack_assert_api(size <= backing->size);
+
+	dpack_decoder_init(&decoder->base,
+	                   &dpack_decoder_buffer_ops,
+	                   discard);
+	decoder->head = 0;
+	decoder->capa = size;
+	decoder->buff = backing->data;
+	decoder->back = dpack_backing_get(backing);
 }
@@ -16,6 +16,12 @@
 #include "dpack/array.h"
 #endif
 #include <endian.h>
+#include <string.h>
+#include <stdlib.h>
+#if defined(CONFIG_DPACK_ARRAY_PARALLEL) || \
+    defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+#include <pthread.h>
+#endif
 
 static inline __dpack_nonull(1, 2) __warn_result
 int
@@ -176,18 +182,48 @@ dpack_discard_cnt32(struct dpack_decoder * __restrict decoder,
 
 #endif
 
+/*
+ * Record nr more items to discard.
+ *
+ * Containers do not recurse into their content: they push the number of items
+ * they hold onto a pending item counter instead, which dpack_discard_items()
+ * walks iteratively. This way, discarding deeply nested input does not
+ * consume stack space, preventing malicious or unaligned data from exhausting
+ * it.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_discard_push(uint64_t * __restrict pend, uint64_t nr)
+{
+	dpack_assert_intern(pend);
+	dpack_assert_intern(nr);
+
+	return !__builtin_add_overflow(*pend, nr, pend) ? 0 : -EMSGSIZE;
+}
+
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_discard_body(struct dpack_decoder * __restrict decoder,
+                   uint8_t                           tag,
+                   uint64_t * __restrict             pend);
+
 static __dpack_nonull(1) __warn_result
 int
 dpack_discard_items(struct dpack_decoder * __restrict decoder,
-                    unsigned int                      nr)
+                    uint64_t                          nr)
 {
 	dpack_decoder_assert_intern(decoder);
 	dpack_assert_intern(nr);
 
 	do {
-		int err;
+		uint8_t tag;
+		int     err;
+
+		err = dpack_read_tag(decoder, &tag);
+		if (err)
+			return err;
 
-		err = dpack_decoder_discard(decoder);
+		err = dpack_discard_body(decoder, tag, &nr);
 		if (err)
 			return err;
 	} while (--nr);
@@ -197,20 +233,22 @@ dpack_discard_items(struct dpack_decoder * __restrict decoder,
 
 #if defined(CONFIG_DPACK_ARRAY)
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 3) __warn_result
 int
-dpack_discard_fixarray(struct dpack_decoder * __restrict decoder,
-                       uint8_t                           tag __unused)
+dpack_discard_fixarray(struct dpack_decoder * __restrict decoder __unused,
+                       uint8_t                           tag,
+                       uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
 	dpack_assert_intern(((unsigned int)tag & ~_DPACK_FIXARRAY_ELMNR_MAX) ==
 	                    _DPACK_FIXARRAY_TAG);
+	dpack_assert_intern(pend);
 
 	unsigned int nr = (unsigned int)(tag & _DPACK_FIXARRAY_ELMNR_MAX);
 
 	if (nr) {
 		if (nr <= DPACK_ARRAY_ELMNR_MAX)
-			return dpack_discard_items(decoder, nr);
+			return dpack_discard_push(pend, nr);
 		return -ENOTSUP;
 	}
 
@@ -219,10 +257,11 @@ dpack_discard_fixarray(struct dpack_decoder * __restrict decoder,
 
 #else  /* !defined(CONFIG_DPACK_ARRAY) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 3) __warn_result
 int
 dpack_discard_fixarray(struct dpack_decoder * __restrict decoder __unused,
-                       uint8_t                           tag __unused)
+                       uint8_t                           tag __unused,
+                       uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -234,11 +273,13 @@ dpack_discard_fixarray(struct dpack_decoder * __restrict decoder __unused,
 #if defined(CONFIG_DPACK_ARRAY) && \
     (DPACK_ARRAY_ELMNR_MAX > _DPACK_FIXARRAY_ELMNR_MAX)
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_array16(struct dpack_decoder * __restrict decoder)
+dpack_discard_array16(struct dpack_decoder * __restrict decoder,
+                       uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(pend);
 
 	unsigned nr;
 	int      err;
@@ -246,7 +287,7 @@ dpack_discard_array16(struct dpack_decoder * __restrict decoder)
 	err = dpack_read_cnt16(decoder, &nr);
 	if (!err) {
 		if (nr <= DPACK_ARRAY_ELMNR_MAX)
-			return nr ? dpack_discard_items(decoder, nr) : 0;
+			return nr ? dpack_discard_push(pend, nr) : 0;
 		err = -ENOTSUP;
 	}
 
@@ -256,9 +297,10 @@ dpack_discard_array16(struct dpack_decoder * __restrict decoder)
 #else  /* !(defined(CONFIG_DPACK_ARRAY) && \
             (DPACK_ARRAY_ELMNR_MAX > _DPACK_FIXARRAY_ELMNR_MAX)) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_array16(struct dpack_decoder * __restrict decoder __unused)
+dpack_discard_array16(struct dpack_decoder * __restrict decoder __unused,
+                       uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -271,11 +313,13 @@ dpack_discard_array16(struct dpack_decoder * __restrict decoder __unused)
 #if defined(CONFIG_DPACK_ARRAY) && \
     (DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX)
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_array32(struct dpack_decoder * __restrict decoder)
+dpack_discard_array32(struct dpack_decoder * __restrict decoder,
+                       uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(pend);
 
 	unsigned int nr;
 	int          err;
@@ -283,7 +327,7 @@ dpack_discard_array32(struct dpack_decoder * __restrict decoder)
 	err = dpack_read_cnt32(decoder, &nr);
 	if (!err) {
 		if (nr <= DPACK_ARRAY_ELMNR_MAX)
-			return nr ? dpack_discard_items(decoder, nr) : 0;
+			return nr ? dpack_discard_push(pend, nr) : 0;
 		err = -ENOTSUP;
 	}
 
@@ -293,9 +337,10 @@ dpack_discard_array32(struct dpack_decoder * __restrict decoder)
 #else  /* !(defined(CONFIG_DPACK_ARRAY) && \
             (DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX)) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_array32(struct dpack_decoder * __restrict decoder __unused)
+dpack_discard_array32(struct dpack_decoder * __restrict decoder __unused,
+                       uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -309,20 +354,22 @@ dpack_discard_array32(struct dpack_decoder * __restrict decoder __unused)
 
 #include "dpack/map.h"
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 3) __warn_result
 int
-dpack_discard_fixmap(struct dpack_decoder * __restrict decoder,
-                     uint8_t                           tag)
+dpack_discard_fixmap(struct dpack_decoder * __restrict decoder __unused,
+                     uint8_t                           tag,
+                     uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
 	dpack_assert_intern(((unsigned int)tag & ~_DPACK_FIXMAP_FLDNR_MAX) ==
 	                    _DPACK_FIXMAP_TAG);
+	dpack_assert_intern(pend);
 
 	unsigned int nr = (unsigned int)(tag & _DPACK_FIXMAP_FLDNR_MAX);
 
 	if (nr) {
 		if (nr <= DPACK_MAP_FLDNR_MAX)
-			return dpack_discard_items(decoder, 2 * nr);
+			return dpack_discard_push(pend, 2 * (uint64_t)nr);
 		return -ENOTSUP;
 	}
 
@@ -331,10 +378,11 @@ dpack_discard_fixmap(struct dpack_decoder * __restrict decoder,
 
 #else  /* !defined(CONFIG_DPACK_MAP) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 3) __warn_result
 int
 dpack_discard_fixmap(struct dpack_decoder * __restrict decoder __unused,
-                     uint8_t                           tag __unused)
+                     uint8_t                           tag __unused,
+                     uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -346,11 +394,13 @@ dpack_discard_fixmap(struct dpack_decoder * __restrict decoder __unused,
 #if defined(CONFIG_DPACK_MAP) && \
     (DPACK_MAP_FLDNR_MAX > _DPACK_FIXMAP_FLDNR_MAX)
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_map16(struct dpack_decoder * __restrict decoder)
+dpack_discard_map16(struct dpack_decoder * __restrict decoder,
+                     uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(pend);
 
 	unsigned int nr;
 	int          err;
@@ -358,7 +408,8 @@ dpack_discard_map16(struct dpack_decoder * __restrict decoder)
 	err = dpack_read_cnt16(decoder, &nr);
 	if (!err) {
 		if (nr <= DPACK_MAP_FLDNR_MAX)
-			return nr ? dpack_discard_items(decoder, 2 * nr) : 0;
+			return nr ? dpack_discard_push(pend, 2 * (uint64_t)nr)
+			          : 0;
 		err = -ENOTSUP;
 	}
 
@@ -368,9 +419,10 @@ dpack_discard_map16(struct dpack_decoder * __restrict decoder)
 #else  /* !(defined(CONFIG_DPACK_MAP) && \
             (DPACK_MAP_FLDNR_MAX > _DPACK_FIXMAP_FLDNR_MAX)) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_map16(struct dpack_decoder * __restrict decoder __unused)
+dpack_discard_map16(struct dpack_decoder * __restrict decoder __unused,
+                     uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -383,11 +435,13 @@ dpack_discard_map16(struct dpack_decoder * __restrict decoder __unused)
 #if defined(CONFIG_DPACK_MAP) && \
     (DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX)
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_map32(struct dpack_decoder * __restrict decoder)
+dpack_discard_map32(struct dpack_decoder * __restrict decoder,
+                     uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(pend);
 
 	unsigned int nr;
 	int          err;
@@ -395,7 +449,8 @@ dpack_discard_map32(struct dpack_decoder * __restrict decoder)
 	err = dpack_read_cnt32(decoder, &nr);
 	if (!err) {
 		if (nr <= DPACK_MAP_FLDNR_MAX)
-			return nr ? dpack_discard_items(decoder, 2 * nr) : 0;
+			return nr ? dpack_discard_push(pend, 2 * (uint64_t)nr)
+			          : 0;
 		err = -ENOTSUP;
 	}
 
@@ -405,9 +460,10 @@ dpack_discard_map32(struct dpack_decoder * __restrict decoder)
 #else  /* !(defined(CONFIG_DPACK_MAP) && \
             (DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX)) */
 
-static __dpack_nonull(1) __warn_result
+static __dpack_nonull(1, 2) __warn_result
 int
-dpack_discard_map32(struct dpack_decoder * __restrict decoder __unused)
+dpack_discard_map32(struct dpack_decoder * __restrict decoder __unused,
+                     uint64_t * __restrict             pend __unused)
 {
 	dpack_decoder_assert_intern(decoder);
 
@@ -417,11 +473,19 @@ dpack_discard_map32(struct dpack_decoder * __restrict decoder __unused)
 #endif /* defined(CONFIG_DPACK_MAP) && \
           (DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX) */
 
-static __dpack_nonull(1) __warn_result
+/*
+ * Discard body of item which tag has just been read. When item is a container,
+ * pend is incremented by the number of items it holds so that the caller may
+ * discard them afterwards.
+ */
+static __dpack_nonull(1, 3) __warn_result
 int
-dpack_discard_body(struct dpack_decoder * __restrict decoder, uint8_t tag)
+dpack_discard_body(struct dpack_decoder * __restrict decoder,
+                   uint8_t                           tag,
+                   uint64_t * __restrict             pend)
 {
 	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(pend);
 
 	switch (tag) {
 #if defined(CONFIG_DPACK_SCALAR)
@@ -492,18 +556,18 @@ dpack_discard_body(struct dpack_decoder * __restrict decoder, uint8_t tag)
 #endif /* defined(CONFIG_DPACK_BIN) */
 
 	case DPACK_FIXARRAY_TAG:
-		return dpack_discard_fixarray(decoder, tag);
+		return dpack_discard_fixarray(decoder, tag, pend);
 	case DPACK_ARRAY16_TAG:
-		return dpack_discard_array16(decoder);
+		return dpack_discard_array16(decoder, pend);
 	case DPACK_ARRAY32_TAG:
-		return dpack_discard_array32(decoder);
+		return dpack_discard_array32(decoder, pend);
 
 	case DPACK_FIXMAP_TAG:
-		return dpack_discard_fixmap(decoder, tag);
+		return dpack_discard_fixmap(decoder, tag, pend);
 	case DPACK_MAP16_TAG:
-		return dpack_discard_map16(decoder);
+		return dpack_discard_map16(decoder, pend);
 	case DPACK_MAP32_TAG:
-		return dpack_discard_map32(decoder);
+		return dpack_discard_map32(decoder, pend);
 
 	case DPACK_UNUSED_TAG:
 		return 0;
@@ -564,7 +628,17 @@ dpack_maybe_discard(struct dpack_decoder * __restrict decoder, uint8_t tag)
 {
 	dpack_decoder_assert_intern(decoder);
 
-	return (!decoder->disc) ? 0 : dpack_discard_body(decoder, tag);
+	uint64_t pend = 0;
+	int      err;
+
+	if (!decoder->disc)
+		return 0;
+
+	err = dpack_discard_body(decoder, tag, &pend);
+	if (err)
+		return err;
+
+	return pend ? dpack_discard_items(decoder, pend) : 0;
 }
 
 int
@@ -572,12 +646,814 @@ dpack_decoder_discard(struct dpack_decoder * __restrict decoder)
 {
 	dpack_decoder_assert_api(decoder);
 
-	uint8_t tag;
+	return dpack_discard_items(decoder, 1);
+}
+
+/******************************************************************************
+ * Raw decoding
+ ******************************************************************************/
+
+/*
+ * Decoder wrapping the one raw items are extracted from. It records encoded
+ * bytes the discard walker goes through, lending them from the wrapped decoder
+ * backing storage as long as possible, copying them otherwise.
+ */
+struct dpack_decoder_raw {
+	struct dpack_decoder   base;
+	/* Wrapped decoder. */
+	struct dpack_decoder * src;
+	/* Start of span lent by the wrapped decoder, if any. */
+	const uint8_t *        lent;
+	/* Reference to backing storage of lent span. */
+	struct dpack_backing * back;
+	/* Copy buffer. */
+	uint8_t *              buff;
+	/* Size of copy buffer. */
+	size_t                 capa;
+	/* Number of bytes recorded so far. */
+	size_t                 size;
+	/* Whether to try lending encoded bytes. */
+	bool                   lend;
+	/* Whether copy buffer is allocated on demand. */
+	bool                   grow;
+};
+
+#define dpack_decoder_assert_raw_intern(_dec) \
+	dpack_assert_intern(_dec); \
+	dpack_decoder_assert_intern((_dec)->src); \
+	dpack_assert_intern(!(_dec)->lent || (_dec)->back); \
+	dpack_assert_intern(!(_dec)->lent || (_dec)->lend); \
+	dpack_assert_intern(!(_dec)->buff || !(_dec)->lent); \
+	dpack_assert_intern((_dec)->size <= (size_t)SSIZE_MAX); \
+	dpack_assert_intern(!(_dec)->buff || ((_dec)->size <= (_dec)->capa))
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_decoder_raw_left(const struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_raw_intern((const struct dpack_decoder_raw *)
+	                                decoder);
+
+	return dpack_decoder_data_left(
+		((const struct dpack_decoder_raw *)decoder)->src);
+}
+
+/* Make room for size more bytes into the copy buffer. */
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_raw_reserve(struct dpack_decoder_raw * __restrict decoder,
+                          size_t                                size)
+{
+	dpack_decoder_assert_raw_intern(decoder);
+	dpack_assert_intern(!decoder->lent);
+	dpack_assert_intern(size);
+
+	size_t    need;
+	size_t    capa;
+	uint8_t * buff;
+
+	if (__builtin_add_overflow(decoder->size, size, &need) ||
+	    (need > (size_t)SSIZE_MAX))
+		return -EMSGSIZE;
+
+	if (decoder->buff && (need <= decoder->capa))
+		return 0;
+
+	if (!decoder->grow)
+		return -EMSGSIZE;
+
+	capa = stroll_max(decoder->capa, (size_t)64);
+	while (capa < need)
+		capa = (capa <= ((size_t)SSIZE_MAX / 2)) ? (2 * capa)
+		                                         : (size_t)SSIZE_MAX;
+
+	buff = realloc(decoder->buff, capa);
+	if (!buff)
+		return -ENOMEM;
+
+	decoder->buff = buff;
+	decoder->capa = capa;
+
+	return 0;
+}
+
+/*
+ * Stop lending: move the span lent so far into the copy buffer and release the
+ * wrapped decoder backing storage.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_raw_spill(struct dpack_decoder_raw * __restrict decoder)
+{
+	dpack_decoder_assert_raw_intern(decoder);
+	dpack_assert_intern(decoder->lend);
+
+	const uint8_t * lent = decoder->lent;
+	size_t          size = decoder->size;
+
+	decoder->lend = false;
+	if (!lent)
+		return 0;
+
+	decoder->lent = NULL;
+	decoder->size = 0;
+	if (!dpack_decoder_raw_reserve(decoder, size)) {
+		memcpy(decoder->buff, lent, size);
+		decoder->size = size;
+		dpack_backing_put(decoder->back);
+		decoder->back = NULL;
+		return 0;
+	}
+
+	dpack_backing_put(decoder->back);
+	decoder->back = NULL;
+
+	return -ENOMEM;
+}
+
+/* Record next size bytes, lending them from the wrapped decoder if possible. */
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_decoder_raw_fetch(struct dpack_decoder_raw * __restrict decoder,
+                        size_t                                size,
+                        const uint8_t ** __restrict           data)
+{
+	dpack_decoder_assert_raw_intern(decoder);
+	dpack_assert_intern(size);
+	dpack_assert_intern(data);
+
+	int err;
+
+	if (decoder->lend) {
+		const uint8_t *        span;
+		struct dpack_backing * back;
+
+		if (((size_t)SSIZE_MAX - decoder->size) < size)
+			return -EMSGSIZE;
+
+		err = dpack_decoder_borrow(decoder->src, size, &span, &back);
+		if (!err) {
+			if (!decoder->lent) {
+				decoder->lent = span;
+				decoder->back = back;
+			}
+			else if ((span == &decoder->lent[decoder->size]) &&
+			         (back == decoder->back))
+				/* Span extends the one lent so far. */
+				dpack_backing_put(back);
+			else {
+				/*
+				 * Span not contiguous with the one lent so
+				 * far: record both into the copy buffer.
+				 */
+				err = dpack_decoder_raw_spill(decoder);
+				if (!err)
+					err = dpack_decoder_raw_reserve(decoder,
+					                                size);
+				if (!err) {
+					memcpy(&decoder->buff[decoder->size],
+					       span,
+					       size);
+					*data = &decoder->buff[decoder->size];
+					decoder->size += size;
+				}
+
+				dpack_backing_put(back);
+
+				return err;
+			}
+
+			*data = span;
+			decoder->size += size;
+
+			return 0;
+		}
+		else if (err != -EAGAIN)
+			return err;
+
+		/* Decoder cannot lend its backing storage: fallback to copy. */
+		err = dpack_decoder_raw_spill(decoder);
+		if (err)
+			return err;
+	}
+
+	err = dpack_decoder_raw_reserve(decoder, size);
+	if (err)
+		return err;
+
+	err = dpack_decoder_read(decoder->src,
+	                         &decoder->buff[decoder->size],
+	                         size);
+	if (err)
+		return err;
+
+	*data = &decoder->buff[decoder->size];
+	decoder->size += size;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_decoder_raw_read(struct dpack_decoder * __restrict decoder,
+                       uint8_t * __restrict              data,
+                       size_t                            size)
+{
+	dpack_decoder_assert_raw_intern((const struct dpack_decoder_raw *)
+	                                decoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	const uint8_t * span;
+	int             err;
+
+	err = dpack_decoder_raw_fetch((struct dpack_decoder_raw *)decoder,
+	                              size,
+	                              &span);
+	if (err)
+		return err;
+
+	memcpy(data, span, size);
+
+	return 0;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_raw_skip(struct dpack_decoder * __restrict decoder,
+                       size_t                            size)
+{
+	dpack_decoder_assert_raw_intern((const struct dpack_decoder_raw *)
+	                                decoder);
+	dpack_assert_intern(size);
+
+	const uint8_t * span;
+
+	return dpack_decoder_raw_fetch((struct dpack_decoder_raw *)decoder,
+	                               size,
+	                               &span);
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_decoder_raw_fini(struct dpack_decoder * __restrict decoder __unused)
+{
+	return 0;
+}
+
+static const struct dpack_decoder_ops dpack_decoder_raw_ops = {
+	.left = dpack_decoder_raw_left,
+	.read = dpack_decoder_raw_read,
+	.skip = dpack_decoder_raw_skip,
+	.fini = dpack_decoder_raw_fini
+};
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_decoder_raw_walk(struct dpack_decoder_raw * __restrict decoder,
+                       struct dpack_decoder * __restrict     source)
+{
+	dpack_assert_intern(decoder);
+	dpack_decoder_assert_intern(source);
+
+	dpack_decoder_init(&decoder->base,
+	                   &dpack_decoder_raw_ops,
+	                   DPACK_DECODER_DISC);
+	decoder->src = source;
+
+	return dpack_decoder_discard(&decoder->base);
+}
+
+#if defined(CONFIG_DPACK_CODEC_BUFFER)
+
+/*
+ * Compute size of next encoded item held by given buffer decoder without
+ * consuming it, i.e. discard it through a copy of the decoder cursor.
+ */
+static __dpack_nonull(1) __warn_result
+ssize_t
+dpack_decoder_buffer_extent(
+	const struct dpack_decoder_buffer * __restrict decoder)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(decoder->base.ops == &dpack_decoder_buffer_ops);
+
+	struct dpack_decoder_buffer probe = *decoder;
+	size_t                      size;
+	int                         err;
+
+	err = dpack_decoder_discard(&probe.base);
+	if (err)
+		return err;
+
+	size = probe.head - decoder->head;
+	dpack_assert_intern(size);
+	if (size > (size_t)SSIZE_MAX)
+		return -EMSGSIZE;
+
+	return (ssize_t)size;
+}
+
+static __dpack_nonull(1, 2, 3) __warn_result
+ssize_t
+dpack_decode_buffer_raw(struct dpack_decoder_buffer * __restrict decoder,
+                        const uint8_t ** __restrict              data,
+                        struct dpack_backing ** __restrict       backing)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(backing);
+
+	ssize_t size;
+
+	size = dpack_decoder_buffer_extent(decoder);
+	if (size < 0)
+		return size;
+
+	/* Lend item straight from the buffer, even if caller owned. */
+	*data = &decoder->buff[decoder->head];
+	*backing = decoder->back ? dpack_backing_get(decoder->back) : NULL;
+	decoder->head += (size_t)size;
+
+	return size;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+ssize_t
+dpack_decode_buffer_rawcpy(struct dpack_decoder_buffer * __restrict decoder,
+                           uint8_t * __restrict                     data,
+                           size_t                                   size)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	ssize_t bytes;
+
+	/* Decoder is left untouched unless the item fits. */
+	bytes = dpack_decoder_buffer_extent(decoder);
+	if (bytes < 0)
+		return bytes;
+	if ((size_t)bytes > size)
+		return -EMSGSIZE;
+
+	memcpy(data, &decoder->buff[decoder->head], (size_t)bytes);
+	decoder->head += (size_t)bytes;
+
+	return bytes;
+}
+
+#define dpack_decoder_is_buffer(_dec) \
+	((_dec)->ops == &dpack_decoder_buffer_ops)
+
+#else  /* !defined(CONFIG_DPACK_CODEC_BUFFER) */
+
+#define dpack_decoder_is_buffer(_dec) \
+	(false)
+
+#define dpack_decode_buffer_raw(_dec, _data, _backing) \
+	(-ENOTSUP)
+
+#define dpack_decode_buffer_rawcpy(_dec, _data, _size) \
+	(-ENOTSUP)
+
+#endif /* defined(CONFIG_DPACK_CODEC_BUFFER) */
+
+ssize_t
+dpack_decode_raw(struct dpack_decoder * __restrict  decoder,
+                 const uint8_t ** __restrict        data,
+                 struct dpack_backing ** __restrict backing)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(data);
+	dpack_assert_api(backing);
+
+	struct dpack_decoder_raw raw = {
+		.lent = NULL,
+		.back = NULL,
+		.buff = NULL,
+		.capa = 0,
+		.size = 0,
+		.lend = true,
+		.grow = true
+	};
+	int                      err;
+
+	if (dpack_decoder_is_buffer(decoder))
+		return dpack_decode_buffer_raw(
+			(struct dpack_decoder_buffer *)decoder,
+			data,
+			backing);
+
+	err = dpack_decoder_raw_walk(&raw, decoder);
+	if (err) {
+		if (raw.back)
+			dpack_backing_put(raw.back);
+		free(raw.buff);
+		return err;
+	}
+
+	dpack_assert_intern(raw.size);
+	if (raw.lent) {
+		*data = raw.lent;
+		*backing = raw.back;
+	}
+	else {
+		*data = raw.buff;
+		*backing = NULL;
+	}
+
+	return (ssize_t)raw.size;
+}
+
+ssize_t
+dpack_decode_rawcpy(struct dpack_decoder * __restrict decoder,
+                    uint8_t * __restrict              data,
+                    size_t                            size)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_decoder_raw raw = {
+		.lent = NULL,
+		.back = NULL,
+		.buff = data,
+		.capa = size,
+		.size = 0,
+		.lend = false,
+		.grow = false
+	};
+	int                      err;
+
+	if (dpack_decoder_is_buffer(decoder))
+		return dpack_decode_buffer_rawcpy(
+			(struct dpack_decoder_buffer *)decoder,
+			data,
+			size);
+
+	err = dpack_decoder_raw_walk(&raw, decoder);
+	if (err)
+		return err;
+
+	dpack_assert_intern(raw.size);
+
+	return (ssize_t)raw.size;
+}
+
+#if defined(CONFIG_DPACK_ARRAY) || defined(CONFIG_DPACK_MAP)
+
+/******************************************************************************
+ * Open-ended container encoding
+ ******************************************************************************/
+
+/* Largest container header: 1 tag byte + 32-bit count. */
+#define DPACK_OPEN_HEAD_SIZE_MAX (5U)
+
+/* Return size of the smallest container header able to hold nr items. */
+static __dpack_const __dpack_nothrow __warn_result
+size_t
+dpack_open_head_size(unsigned int nr)
+{
+	if (nr <= 15U)
+		return 1;
+	else if (nr <= UINT16_MAX)
+		return 3;
+	else
+		return 5;
+}
+
+static __dpack_nonull(1) __dpack_nothrow
+void
+dpack_open_head_fill(uint8_t * __restrict head,
+                     size_t               width,
+                     uint8_t              fixtag,
+                     uint8_t              tag16,
+                     unsigned int         nr)
+{
+	dpack_assert_intern(head);
+	dpack_assert_intern(dpack_open_head_size(nr) <= width);
+
+	switch (width) {
+	case 1:
+		head[0] = (uint8_t)(fixtag | nr);
+		break;
+	case 3:
+		{
+			uint16_t val = htobe16((uint16_t)nr);
+
+			head[0] = tag16;
+			memcpy(&head[1], &val, sizeof(val));
+			break;
+		}
+	case 5:
+		{
+			uint32_t val = htobe32((uint32_t)nr);
+
+			/* 32-bit count tags immediately follow 16-bit ones. */
+			head[0] = (uint8_t)(tag16 + 1);
+			memcpy(&head[1], &val, sizeof(val));
+			break;
+		}
+	default:
+		dpack_assert_intern(0);
+	}
+}
+
+int
+dpack_begin_open_encode(struct dpack_encoder * __restrict      encoder,
+                        uint8_t                                fixtag,
+                        uint8_t                                tag16,
+                        unsigned int                           max_nr,
+                        struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_intern(encoder);
+	dpack_assert_intern(mark);
+
+	uint8_t head[DPACK_OPEN_HEAD_SIZE_MAX];
+	size_t  width = dpack_open_head_size(max_nr);
+
+	if (!encoder->ops->patch)
+		return -ENOTSUP;
+
+	/* Placeholder header: a valid empty container until patched. */
+	dpack_open_head_fill(head, width, fixtag, tag16, 0);
+
+	mark->off = dpack_encoder_space_used(encoder);
+	mark->size = width;
+
+	return dpack_encoder_write(encoder, head, width);
+}
+
+int
+dpack_end_open_encode(struct dpack_encoder * __restrict            encoder,
+                      const struct dpack_encoder_mark * __restrict mark,
+                      uint8_t                                      fixtag,
+                      uint8_t                                      tag16,
+                      unsigned int                                 nr,
+                      bool                                         compact)
+{
+	dpack_encoder_assert_intern(encoder);
+	dpack_assert_intern(mark);
+	dpack_assert_intern((mark->size == 1) ||
+	                    (mark->size == 3) ||
+	                    (mark->size == 5));
+
+	uint8_t head[DPACK_OPEN_HEAD_SIZE_MAX];
+	size_t  width = dpack_open_head_size(nr);
 	int     err;
 
-	err = dpack_read_tag(decoder, &tag);
-	if (!err)
-		return dpack_discard_body(decoder, tag);
+	if (width > mark->size)
+		/* Too many items for the reserved header width. */
+		return -EMSGSIZE;
+
+	if (!compact || !encoder->ops->cut)
+		/*
+		 * Keep reserved header width: MessagePack allows non minimal
+		 * count encodings.
+		 */
+		width = mark->size;
+
+	dpack_open_head_fill(head, width, fixtag, tag16, nr);
+
+	err = dpack_encoder_patch(encoder, mark->off, head, width);
+	if (!err && (width < mark->size))
+		err = encoder->ops->cut(encoder,
+		                        mark->off + width,
+		                        mark->size - width);
 
 	return err;
 }
+
+int
+dpack_cancel_open_encode(struct dpack_encoder * __restrict            encoder,
+                         const struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_intern(encoder);
+	dpack_assert_intern(mark);
+	dpack_assert_intern(mark->size);
+
+	size_t used = dpack_encoder_space_used(encoder);
+
+	if (!encoder->ops->cut)
+		return -ENOTSUP;
+
+	if ((mark->off > used) || (mark->size > (used - mark->off)))
+		return -ERANGE;
+
+	return encoder->ops->cut(encoder, mark->off, used - mark->off);
+}
+
+#endif /* defined(CONFIG_DPACK_ARRAY) || defined(CONFIG_DPACK_MAP) */
+
+/******************************************************************************
+ * Raw encoding
+ ******************************************************************************/
+
+#if defined(CONFIG_DPACK_ASSERT_API) && defined(CONFIG_DPACK_CODEC_BUFFER)
+
+void
+dpack_encode_raw_check(const uint8_t * __restrict data, size_t size)
+{
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	struct dpack_decoder_buffer dec;
+	int                         err;
+
+	dpack_decoder_init_discard_buffer(&dec, data, size);
+	err = dpack_decoder_discard(&dec.base);
+
+	/*
+	 * Items of types not supported by the current build configuration
+	 * cannot be walked through: skip check.
+	 */
+	dpack_assert_api((err == -ENOTSUP) ||
+	                 (!err && !dpack_decoder_data_left(&dec.base)));
+
+	dpack_decoder_fini(&dec.base);
+}
+
+#endif /* defined(CONFIG_DPACK_ASSERT_API) && \
+          defined(CONFIG_DPACK_CODEC_BUFFER) */
+
+int
+dpack_encode_raw(struct dpack_encoder * __restrict encoder,
+                 const uint8_t * __restrict        data,
+                 size_t                            size)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	dpack_encode_raw_check(data, size);
+
+	return dpack_encoder_write(encoder, data, size);
+}
+
+/******************************************************************************
+ * Counting encoder
+ ******************************************************************************/
+
+#define dpack_encoder_assert_count_api(_encoder) \
+	dpack_assert_api(_encoder); \
+	dpack_encoder_assert_api(&(_encoder)->base)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_count_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+
+	const struct dpack_encoder_count * enc =
+		(const struct dpack_encoder_count *)encoder;
+
+	return SIZE_MAX - enc->size;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_count_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+
+	return ((const struct dpack_encoder_count *)encoder)->size;
+}
+
+static __dpack_nonull(1, 2) __dpack_nothrow __warn_result
+int
+dpack_encoder_count_write(struct dpack_encoder * __restrict encoder,
+                          const uint8_t * __restrict        data __unused,
+                          size_t                            size)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_count * enc = (struct dpack_encoder_count *)
+	                                   encoder;
+	size_t                       sz;
+
+	/* Leave count untouched on overflow. */
+	if (__builtin_add_overflow(enc->size, size, &sz))
+		return -EMSGSIZE;
+
+	enc->size = sz;
+
+	return 0;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_encoder_count_fini(struct dpack_encoder * __restrict encoder __unused)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 3) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_encoder_count_patch(struct dpack_encoder * __restrict encoder,
+                          size_t                            offset,
+                          const uint8_t * __restrict        data __unused,
+                          size_t                            size)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	const struct dpack_encoder_count * enc =
+		(const struct dpack_encoder_count *)encoder;
+	size_t                             end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->size))
+		return 0;
+
+	return -ERANGE;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_encoder_count_cut(struct dpack_encoder * __restrict encoder,
+                        size_t                            offset,
+                        size_t                            size)
+{
+	dpack_encoder_assert_count_api((const struct dpack_encoder_count *)
+	                               encoder);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_count * enc = (struct dpack_encoder_count *)encoder;
+	size_t                       end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->size)) {
+		enc->size -= size;
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+const struct dpack_encoder_ops dpack_encoder_count_ops = {
+	.left  = dpack_encoder_count_left,
+	.used  = dpack_encoder_count_used,
+	.write = dpack_encoder_count_write,
+	.fini  = dpack_encoder_count_fini,
+	.patch = dpack_encoder_count_patch,
+	.cut   = dpack_encoder_count_cut
+};
+
+void
+dpack_encoder_init_count(struct dpack_encoder_count * __restrict encoder)
+{
+	dpack_assert_api(encoder);
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_count_ops);
+	encoder->size = 0;
+}
+
+#if defined(CONFIG_DPACK_ARRAY_PARALLEL) || \
+    defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+
+/******************************************************************************
+ * Worker threads
+ ******************************************************************************/
+
+void
+dpack_run_workers(void * (* worker)(void *), void * arg, unsigned int thread_nr)
+{
+	dpack_assert_intern(worker);
+	dpack_assert_intern(thread_nr);
+
+	pthread_t *  tids = NULL;
+	unsigned int t = 0;
+
+	if (thread_nr > 1) {
+		tids = malloc((thread_nr - 1) * sizeof(*tids));
+		/*
+		 * Failing to spawn additional threads is not fatal: the calling
+		 * thread processes work left anyway.
+		 */
+		if (tids) {
+			for (t = 0; t < (thread_nr - 1); t++) {
+				if (pthread_create(&tids[t], NULL, worker, arg))
+					break;
+			}
+		}
+	}
+
+	worker(arg);
+
+	while (t--)
+		pthread_join(tids[t], NULL);
+
+	free(tids);
+}
+
+#endif /* defined(CONFIG_DPACK_ARRAY_PARALLEL) || \
+          defined(CONFIG_DPACK_CODEC_FILE_PARALLEL) */
@@ -101,6 +101,50 @@ dpack_write_tag(struct dpack_encoder * __restrict encoder,
 	return dpack_encoder_write(encoder, &tag, sizeof(tag));
 }
 
+static inline __dpack_nonull(1, 3) __warn_result
+int
+dpack_encoder_patch(struct dpack_encoder * __restrict encoder,
+                    size_t                            offset,
+                    const uint8_t * __restrict        data,
+                    size_t                            size)
+{
+	dpack_encoder_assert_intern(encoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	if (!encoder->ops->patch)
+		/* Encoder cannot seek backward. */
+		return -ENOTSUP;
+
+	return encoder->ops->patch(encoder, offset, data, size);
+}
+
+#if defined(CONFIG_DPACK_ARRAY) || defined(CONFIG_DPACK_MAP)
+
+extern int
+dpack_begin_open_encode(struct dpack_encoder * __restrict      encoder,
+                        uint8_t                                fixtag,
+                        uint8_t                                tag16,
+                        unsigned int                           max_nr,
+                        struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 5) __warn_result __export_intern;
+
+extern int
+dpack_end_open_encode(struct dpack_encoder * __restrict            encoder,
+                      const struct dpack_encoder_mark * __restrict mark,
+                      uint8_t                                      fixtag,
+                      uint8_t                                      tag16,
+                      unsigned int                                 nr,
+                      bool                                         compact)
+	__dpack_nonull(1, 2) __warn_result __export_intern;
+
+extern int
+dpack_cancel_open_encode(struct dpack_encoder * __restrict            encoder,
+                         const struct dpack_encoder_mark * __restrict mark)
+	__dpack_nonull(1, 2) __warn_result __export_intern;
+
+#endif /* defined(CONFIG_DPACK_ARRAY) || defined(CONFIG_DPACK_MAP) */
+
 /******************************************************************************
  * Decoding / unpacking
  ******************************************************************************/
@@ -129,6 +173,25 @@ dpack_decoder_read(struct dpack_decoder * __restrict decoder,
 	return decoder->ops->read(decoder, data, size);
 }
 
+static inline __dpack_nonull(1, 3, 4) __warn_result
+int
+dpack_decoder_borrow(struct dpack_decoder * __restrict  decoder,
+                     size_t                             size,
+                     const uint8_t ** __restrict        data,
+                     struct dpack_backing ** __restrict backing)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(size);
+	dpack_assert_intern(data);
+	dpack_assert_intern(backing);
+
+	if (!decoder->ops->borrow)
+		/* Backend cannot lend its backing storage. */
+		return -EAGAIN;
+
+	return decoder->ops->borrow(decoder, size, data, backing);
+}
+
 static inline __dpack_nonull(1, 2) __warn_result
 int
 dpack_read_tag(struct dpack_decoder * __restrict decoder,
@@ -178,4 +241,72 @@ dpack_maybe_discard(struct dpack_decoder * __restrict decoder,
                     uint8_t                           tag)
 	__dpack_nonull(1) __warn_result __export_intern;
 
+#if defined(CONFIG_DPACK_STRING)
+
+extern ssize_t
+dpack_decode_str_tag(struct dpack_decoder * __restrict decoder,
+                     size_t                            min_len,
+                     size_t                            max_len)
+	__dpack_nonull(1) __warn_result __export_intern;
+
+extern ssize_t
+dpack_xtract_strdup(struct dpack_decoder * __restrict decoder,
+                    char ** __restrict                value,
+                    size_t                            length)
+	__dpack_nonull(1, 2) __warn_result __export_intern;
+
+extern ssize_t
+dpack_xtract_strcpy(struct dpack_decoder * __restrict decoder,
+                    char * __restrict                 value,
+                    size_t                            length)
+	__dpack_nonull(1, 2) __warn_result __export_intern;
+
+#endif /* defined(CONFIG_DPACK_STRING) */
+
+#if defined(CONFIG_DPACK_ASSERT_API) && defined(CONFIG_DPACK_CODEC_BUFFER)
+
+/*
+ * Assert that data holds exactly one well-formed item, as far as item types
+ * supported by the current build configuration are concerned.
+ */
+extern void
+dpack_encode_raw_check(const uint8_t * __restrict data, size_t size)
+	__dpack_nonull(1) __export_intern;
+
+#else  /* !(defined(CONFIG_DPACK_ASSERT_API) && \
+            defined(CONFIG_DPACK_CODEC_BUFFER)) */
+
+static inline __dpack_nonull(1)
+void
+dpack_encode_raw_check(const uint8_t * __restrict data __unused,
+                       size_t                     size __unused)
+{
+}
+
+#endif /* defined(CONFIG_DPACK_ASSERT_API) && \
+          defined(CONFIG_DPACK_CODEC_BUFFER) */
+
+#if defined(CONFIG_DPACK_ARRAY_PARALLEL) || \
+    defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+
+/*
+ * Run worker function from up to thread_nr threads, the calling one included,
+ * and wait for all of them to complete.
+ */
+extern void
+dpack_run_workers(void * (* worker)(void *), void * arg, unsigned int thread_nr)
+	__dpack_nonull(1) __export_intern;
+
+#endif /* defined(CONFIG_DPACK_ARRAY_PARALLEL) || \
+          defined(CONFIG_DPACK_CODEC_FILE_PARALLEL) */
+
+#if defined(CONFIG_DPACK_CODEC_MEMFD)
+
+#include <fcntl.h>
+
+/* Seals a memory file must carry to be safely shared with a peer. */
+#define DPACK_MEMFD_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW)
+
+#endif /* defined(CONFIG_DPACK_CODEC_MEMFD) */
+
 #endif /* _DPACK_COMMON_H */
@@ -33,40 +33,103 @@ common-cflags         := $(filter-out -DNDEBUG,$(common-cflags))
 common-ldflags        := $(filter-out -DNDEBUG,$(common-ldflags))
 endif # ($(filter y,$(CONFIG_DPACK_ASSERT_API) $(CONFIG_DPACK_ASSERT_INTERN)),)
 
+# Parallel encoding / decoding, journal and string interning support rely upon
+# POSIX threads. Multi-producer buffers are meant to be shared among threads.
+ifneq ($(filter y,$(CONFIG_DPACK_ARRAY_PARALLEL) \
+                  $(CONFIG_DPACK_CODEC_FILE_PARALLEL) \
+                  $(CONFIG_DPACK_JOURNAL) \
+                  $(CONFIG_DPACK_INTERN) \
+                  $(CONFIG_DPACK_CODEC_MPBUFFER)),)
+common-cflags         += -pthread
+common-ldflags        += -pthread
+endif # ($(filter y,$(CONFIG_DPACK_ARRAY_PARALLEL) \
+       #             $(CONFIG_DPACK_CODEC_FILE_PARALLEL) \
+       #             $(CONFIG_DPACK_JOURNAL) \
+       #             $(CONFIG_DPACK_INTERN) \
+       #             $(CONFIG_DPACK_CODEC_MPBUFFER)),)
+
 solibs                := libdpack.so
 libdpack.so-objs      += shared/common.o
 libdpack.so-objs      += $(call kconf_enabled, \
                                 DPACK_CODEC_BUFFER, \
                                 shared/buffer.o)
+libdpack.so-objs      += $(call kconf_enabled, \
+                                DPACK_CODEC_MPBUFFER, \
+                                shared/mpbuffer.o)
+libdpack.so-objs      += $(call kconf_enabled, \
+                                DPACK_CODEC_SOCKET, \
+                                shared/socket.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_CODEC_FD,shared/fd.o)
+libdpack.so-objs      += $(call kconf_enabled, \
+                                DPACK_CODEC_FILTER, \
+                                shared/filter.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_CODEC_ZSTD,shared/zstd.o)
 libdpack.so-objs      += $(call kconf_enabled, \
                                 DPACK_CODEC_FILE, \
                                 shared/file.o)
+libdpack.so-objs      += $(call kconf_enabled, \
+                                DPACK_CODEC_MEMFD, \
+                                shared/memfd.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_SCALAR,shared/scalar.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_STRING,shared/string.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_LVSTR,shared/lvstr.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_INTERN,shared/intern.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_BIN,shared/bin.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_MAP,shared/map.o)
 libdpack.so-objs      += $(call kconf_enabled,DPACK_ARRAY,shared/array.o)
+libdpack.so-objs      += $(call kconf_enabled, \
+                                DPACK_ARRAY_PARALLEL, \
+                                shared/parallel.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_JOURNAL,shared/journal.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_RING,shared/ring.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_RPC,shared/rpc.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_UDP,shared/udp.o)
+libdpack.so-objs      += $(call kconf_enabled,DPACK_TMPL,shared/tmpl.o)
 libdpack.so-cflags    := $(filter-out -fpie -fPIE,$(common-cflags)) -fpic
 libdpack.so-ldflags   := $(filter-out -fpie -fPIE,$(common-ldflags)) \
                          -shared -fpic -Bsymbolic -Wl,-soname,libdpack.so
 libdpack.so-pkgconf   := libstroll
-libdpack.so-pkgconf   += $(call kconf_enabled,DPACK_CODEC_FILE,libutils)
+libdpack.so-pkgconf   += $(if $(filter y,$(CONFIG_DPACK_CODEC_FILE) \
+                                         $(CONFIG_DPACK_JOURNAL)),libutils)
+libdpack.so-pkgconf   += $(call kconf_enabled,DPACK_CODEC_ZSTD,libzstd)
 
 arlibs                := libdpack.a
 libdpack.a-objs       += static/common.o
 libdpack.a-objs       += $(call kconf_enabled, \
                                 DPACK_CODEC_BUFFER, \
                                 static/buffer.o)
+libdpack.a-objs       += $(call kconf_enabled, \
+                                DPACK_CODEC_MPBUFFER, \
+                                static/mpbuffer.o)
+libdpack.a-objs       += $(call kconf_enabled, \
+                                DPACK_CODEC_SOCKET, \
+                                static/socket.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_CODEC_FD,static/fd.o)
+libdpack.a-objs       += $(call kconf_enabled, \
+                                DPACK_CODEC_FILTER, \
+                                static/filter.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_CODEC_ZSTD,static/zstd.o)
 libdpack.a-objs       += $(call kconf_enabled, \
                                 DPACK_CODEC_FILE, \
                                 static/file.o)
+libdpack.a-objs       += $(call kconf_enabled, \
+                                DPACK_CODEC_MEMFD, \
+                                static/memfd.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_SCALAR,static/scalar.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_STRING,static/string.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_LVSTR,static/lvstr.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_INTERN,static/intern.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_BIN,static/bin.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_MAP,static/map.o)
 libdpack.a-objs       += $(call kconf_enabled,DPACK_ARRAY,static/array.o)
+libdpack.a-objs       += $(call kconf_enabled, \
+                                DPACK_ARRAY_PARALLEL, \
+                                static/parallel.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_JOURNAL,static/journal.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_RING,static/ring.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_RPC,static/rpc.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_UDP,static/udp.o)
+libdpack.a-objs       += $(call kconf_enabled,DPACK_TMPL,static/tmpl.o)
 libdpack.a-cflags     := $(common-cflags)
 
 # vim: filetype=make :
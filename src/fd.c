@@ -0,0 +1,418 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/fd.h"
+#include "common.h"
+#include <sys/uio.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct dpack_fd_chunk {
+	/* Offset of first pending byte. */
+	size_t head;
+	/* Offset of end of pending bytes. */
+	size_t tail;
+};
+
+#define dpack_encoder_assert_fd_api(_enc) \
+	dpack_assert_api(_enc); \
+	dpack_assert_api((_enc)->thres); \
+	dpack_assert_api((_enc)->csize); \
+	dpack_assert_api((_enc)->pend <= ((_enc)->nr * (_enc)->csize)); \
+	dpack_assert_api((_enc)->mem); \
+	dpack_assert_api((_enc)->chunks); \
+	dpack_assert_api((_enc)->iovs); \
+	dpack_assert_api((_enc)->nr); \
+	dpack_assert_api((_enc)->nr <= DPACK_ENCODER_FD_CHUNK_NR_MAX); \
+	dpack_assert_api((_enc)->first < (_enc)->nr); \
+	dpack_assert_api((_enc)->cnt <= (_enc)->nr); \
+	dpack_assert_api(!(_enc)->cnt == !(_enc)->pend); \
+	dpack_assert_api((_enc)->err <= 0); \
+	dpack_assert_api((_enc)->fd >= 0)
+
+static __dpack_nothrow __warn_result
+uint64_t
+dpack_encoder_fd_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * UINT64_C(1000000000)) +
+	       (uint64_t)now.tv_nsec;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+unsigned int
+dpack_encoder_fd_last(const struct dpack_encoder_fd * __restrict encoder)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(encoder->cnt);
+
+	return (encoder->first + encoder->cnt - 1) % encoder->nr;
+}
+
+/* Return number of bytes that may be encoded without writing. */
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_fd_room(const struct dpack_encoder_fd * __restrict encoder)
+{
+	dpack_assert_intern(encoder);
+
+	size_t room = (encoder->nr - encoder->cnt) * encoder->csize;
+
+	if (encoder->cnt)
+		room += encoder->csize -
+		        encoder->chunks[dpack_encoder_fd_last(encoder)].tail;
+
+	return room;
+}
+
+size_t
+dpack_encoder_fd_avail(const struct dpack_encoder_fd * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api(encoder);
+
+	return dpack_encoder_fd_room(encoder);
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_fd_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api((const struct dpack_encoder_fd *)encoder);
+
+	const struct dpack_encoder_fd * enc =
+		(const struct dpack_encoder_fd *)encoder;
+
+	/* Chunks are written as they fill up: stream is unbounded. */
+	return SIZE_MAX - enc->done - enc->pend;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_fd_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api((const struct dpack_encoder_fd *)encoder);
+
+	const struct dpack_encoder_fd * enc =
+		(const struct dpack_encoder_fd *)encoder;
+
+	return enc->done + enc->pend;
+}
+
+/* Release chunks content written by the last writev(2) call. */
+static __dpack_nonull(1) __dpack_nothrow
+void
+dpack_encoder_fd_consume(struct dpack_encoder_fd * __restrict encoder,
+                         size_t                               size)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(size <= encoder->pend);
+
+	encoder->done += size;
+	encoder->pend -= size;
+
+	while (size) {
+		struct dpack_fd_chunk * chunk;
+		size_t                  bytes;
+
+		dpack_assert_intern(encoder->cnt);
+
+		chunk = &encoder->chunks[encoder->first];
+		dpack_assert_intern(chunk->head < chunk->tail);
+
+		bytes = stroll_min(size, chunk->tail - chunk->head);
+		chunk->head += bytes;
+		size -= bytes;
+
+		if (chunk->head == chunk->tail) {
+			chunk->head = 0;
+			chunk->tail = 0;
+			encoder->first = (encoder->first + 1) % encoder->nr;
+			encoder->cnt--;
+		}
+	}
+
+	if (!encoder->cnt) {
+		/* Keep encoding from the start of the chain. */
+		encoder->first = 0;
+		/* Deadline is set again once data is left pending. */
+		encoder->due = 0;
+	}
+}
+
+int
+dpack_encoder_flush_fd(struct dpack_encoder_fd * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api(encoder);
+
+	while (encoder->cnt) {
+		unsigned int c;
+		ssize_t      ret;
+
+		for (c = 0; c < encoder->cnt; c++) {
+			const struct dpack_fd_chunk * chunk =
+				&encoder->chunks[(encoder->first + c) %
+				                 encoder->nr];
+			size_t                        off =
+				(size_t)((encoder->first + c) % encoder->nr) *
+				encoder->csize;
+
+			encoder->iovs[c].iov_base = &encoder->mem[off +
+			                                          chunk->head];
+			encoder->iovs[c].iov_len = chunk->tail - chunk->head;
+		}
+
+		ret = writev(encoder->fd, encoder->iovs, (int)encoder->cnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		/* Short writes are resumed from where they stopped. */
+		dpack_encoder_fd_consume(encoder, (size_t)ret);
+	}
+
+	return 0;
+}
+
+/* Append data to the chain of chunks, up to room left. */
+static __dpack_nonull(1, 2) __dpack_nothrow
+size_t
+dpack_encoder_fd_append(struct dpack_encoder_fd * __restrict encoder,
+                        const uint8_t * __restrict           data,
+                        size_t                               size)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	size_t done = 0;
+
+	while ((done < size) && dpack_encoder_fd_room(encoder)) {
+		unsigned int            last;
+		struct dpack_fd_chunk * chunk;
+		size_t                  bytes;
+
+		if (!encoder->cnt ||
+		    (encoder->chunks[dpack_encoder_fd_last(encoder)].tail ==
+		     encoder->csize))
+			encoder->cnt++;
+
+		last = dpack_encoder_fd_last(encoder);
+		chunk = &encoder->chunks[last];
+		bytes = stroll_min(size - done, encoder->csize - chunk->tail);
+
+		memcpy(&encoder->mem[((size_t)last * encoder->csize) +
+		                     chunk->tail],
+		       &data[done],
+		       bytes);
+		chunk->tail += bytes;
+		done += bytes;
+	}
+
+	encoder->pend += done;
+
+	return done;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_fd_push(struct dpack_encoder_fd * __restrict enc,
+                      const uint8_t * __restrict           data,
+                      size_t                               size)
+{
+	dpack_assert_intern(enc);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+
+	int err;
+
+	if (size > dpack_encoder_fd_left(&enc->base))
+		return -EMSGSIZE;
+
+	if (size > dpack_encoder_fd_room(enc)) {
+		err = dpack_encoder_flush_fd(enc);
+		if (err && (err != -EAGAIN))
+			return err;
+
+		/*
+		 * Backpressure: leave data unconsumed rather than blocking.
+		 * Data larger than all chunks together is streamed through
+		 * below.
+		 */
+		if ((size > dpack_encoder_fd_room(enc)) &&
+		    (size <= (enc->nr * enc->csize)))
+			return -EAGAIN;
+	}
+
+	while (true) {
+		size_t bytes;
+
+		bytes = dpack_encoder_fd_append(enc, data, size);
+		data += bytes;
+		size -= bytes;
+		if (!size)
+			break;
+
+		/* Data larger than all chunks: stream it through. */
+		err = dpack_encoder_flush_fd(enc);
+		if (err)
+			return err;
+	}
+
+	if (enc->pend >= enc->thres) {
+		err = dpack_encoder_flush_fd(enc);
+		if (err && (err != -EAGAIN))
+			return err;
+	}
+
+	/*
+	 * Sample the clock once per flush, when data is first left pending,
+	 * not upon each write: deadline expiry is handled by callers through
+	 * dpack_encoder_fd_timeout().
+	 */
+	if (enc->pend && !enc->due)
+		enc->due = dpack_encoder_fd_now() + enc->delay;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_fd_write(struct dpack_encoder * __restrict encoder,
+                       const uint8_t * __restrict        data,
+                       size_t                            size)
+{
+	dpack_encoder_assert_fd_api((const struct dpack_encoder_fd *)encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_fd * enc = (struct dpack_encoder_fd *)encoder;
+	size_t                    used;
+	int                       err;
+
+	if (enc->err)
+		return enc->err;
+
+	/*
+	 * A failure happening once data has been consumed, even partially,
+	 * leaves the stream in an unknown state and retrying would corrupt it.
+	 * Make such errors sticky. Failures consuming nothing, e.g. -EAGAIN
+	 * upon backpressure, may be retried.
+	 */
+	used = enc->done + enc->pend;
+	err = dpack_encoder_fd_push(enc, data, size);
+	if (err && ((enc->done + enc->pend) != used))
+		enc->err = err;
+
+	return err;
+}
+
+int
+dpack_encoder_fd_timeout(const struct dpack_encoder_fd * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api(encoder);
+
+	uint64_t now;
+	uint64_t left;
+
+	if (!encoder->pend)
+		return -1;
+
+	now = dpack_encoder_fd_now();
+	if (now >= encoder->due)
+		return 0;
+
+	left = (encoder->due - now + UINT64_C(999999)) / UINT64_C(1000000);
+
+	return (int)stroll_min(left, (uint64_t)INT_MAX);
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_fd_fini(struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_fd_api((const struct dpack_encoder_fd *)encoder);
+
+	struct dpack_encoder_fd * enc = (struct dpack_encoder_fd *)encoder;
+	int                       err;
+
+	while (true) {
+		struct pollfd pfd = { .fd = enc->fd, .events = POLLOUT };
+
+		err = dpack_encoder_flush_fd(enc);
+		if (err != -EAGAIN)
+			break;
+
+		if ((poll(&pfd, 1, -1) < 0) && (errno != EINTR)) {
+			err = -errno;
+			break;
+		}
+	}
+
+	free(enc->iovs);
+	free(enc->chunks);
+	free(enc->mem);
+
+	return enc->err ? enc->err : err;
+}
+
+static const struct dpack_encoder_ops dpack_encoder_fd_ops = {
+	.left  = dpack_encoder_fd_left,
+	.used  = dpack_encoder_fd_used,
+	.write = dpack_encoder_fd_write,
+	.fini  = dpack_encoder_fd_fini
+};
+
+int
+dpack_encoder_init_fd(struct dpack_encoder_fd * __restrict encoder,
+                      int                                  fd,
+                      size_t                               size,
+                      unsigned int                         nr,
+                      size_t                               thres,
+                      unsigned int                         delay)
+{
+	dpack_assert_api(encoder);
+	dpack_assert_api(fd >= 0);
+	dpack_assert_api(size);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_ENCODER_FD_CHUNK_NR_MAX);
+	dpack_assert_api(thres);
+
+	if (size > (SIZE_MAX / nr))
+		return -ENOMEM;
+
+	encoder->mem = malloc(nr * size);
+	encoder->chunks = calloc(nr, sizeof(encoder->chunks[0]));
+	encoder->iovs = malloc(nr * sizeof(encoder->iovs[0]));
+	if (!encoder->mem || !encoder->chunks || !encoder->iovs) {
+		free(encoder->iovs);
+		free(encoder->chunks);
+		free(encoder->mem);
+		return -ENOMEM;
+	}
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_fd_ops);
+	encoder->done = 0;
+	encoder->pend = 0;
+	encoder->thres = thres;
+	encoder->csize = size;
+	encoder->due = 0;
+	encoder->delay = (uint64_t)delay * UINT64_C(1000000);
+	encoder->nr = nr;
+	encoder->first = 0;
+	encoder->cnt = 0;
+	encoder->err = 0;
+	encoder->fd = fd;
+
+	return 0;
+}
@@ -7,9 +7,13 @@
 
 #include "dpack/codec.h"
 #include "common.h"
+#if defined(CONFIG_DPACK_CODEC_MEMFD)
+#include "dpack/memfd.h"
+#endif
 #include <stroll/page.h>
 #include <utils/file.h>
 #include <sys/mman.h>
+#include <stdlib.h>
 
 #define dpack_decoder_assert_file_api(_decoder) \
 	dpack_assert_api(_decoder); \
@@ -32,8 +36,58 @@
 	dpack_assert_api((_decoder)->moff <= \
 	                 stroll_align_lower((_decoder)->fsize, \
 	                                    (off_t)(_decoder)->msize)); \
+	dpack_assert_api((_decoder)->win); \
 	dpack_assert_api((_decoder)->fd >= 0)
 
+static __dpack_nonull(1)
+void
+dpack_decoder_file_release_win(struct dpack_backing * __restrict backing)
+{
+	dpack_assert_intern(backing);
+	dpack_assert_intern(!backing->refcnt);
+	dpack_assert_intern(backing->rdonly);
+	dpack_assert_intern(backing->data);
+	dpack_assert_intern(backing->size);
+
+	/*
+	 * Nothing sensible to do on error since the window may be released
+	 * from any context holding a reference to it...
+	 */
+	if (backing->data != MAP_FAILED)
+		munmap(backing->data, backing->size);
+
+	free(backing);
+}
+
+/*
+ * Allocate a backing storage tracking references to a data mapping window so
+ * that decoded data may alias the mapping and outlive the decoder.
+ */
+static __dpack_nonull(1) __warn_result
+struct dpack_backing *
+dpack_decoder_file_alloc_win(const uint8_t * __restrict map, size_t size)
+{
+	dpack_assert_intern(map);
+	dpack_assert_intern(map != MAP_FAILED);
+	dpack_assert_intern(size);
+
+	struct dpack_backing * win;
+
+	win = malloc(sizeof(*win));
+	if (!win)
+		return NULL;
+
+	win->refcnt = 1;
+	win->rdonly = true;
+	win->size = size;
+STROLL_IGNORE_WARN("-Wcast-qual")
+	win->data = (uint8_t *)map;
+STROLL_RESTORE_WARN
+	win->release = dpack_decoder_file_release_win;
+
+	return win;
+}
+
 static __dpack_nonull(1) __dpack_pure __warn_result
 size_t
 dpack_decoder_file_left(const struct dpack_decoder * __restrict decoder)
@@ -72,17 +126,53 @@ dpack_decoder_file_remap(struct dpack_decoder_file * __restrict decoder,
 	dpack_assert_intern(offset <=
 	                    stroll_align_lower(decoder->fsize,
 	                                       (off_t)decoder->msize));
+	dpack_assert_intern(decoder->win);
 
+	if (__atomic_load_n(&decoder->win->refcnt, __ATOMIC_ACQUIRE) == 1) {
+		/*
+		 * Current window is referenced by the decoder only: relocate it
+		 * in place.
+		 */
 STROLL_IGNORE_WARN("-Wcast-qual")
-	decoder->map = mmap((void *)decoder->map,
-	                    decoder->msize,
-	                    PROT_READ,
-	                    MAP_FIXED | MAP_PRIVATE | MAP_POPULATE,
-	                    decoder->fd,
-	                    offset);
+		decoder->map = mmap((void *)decoder->map,
+		                    decoder->msize,
+		                    PROT_READ,
+		                    MAP_FIXED | MAP_PRIVATE | MAP_POPULATE,
+		                    decoder->fd,
+		                    offset);
+		decoder->win->data = (uint8_t *)decoder->map;
 STROLL_RESTORE_WARN
-	if (decoder->map != MAP_FAILED)
-		return 0;
+		if (decoder->map != MAP_FAILED)
+			return 0;
+	}
+	else {
+		/*
+		 * Current window is still aliased by decoded data: leave it
+		 * to its borrowers and map a new one.
+		 */
+		struct dpack_backing * win;
+		void *                 map;
+
+		map = mmap(NULL,
+		           decoder->msize,
+		           PROT_READ,
+		           MAP_PRIVATE | MAP_POPULATE,
+		           decoder->fd,
+		           offset);
+		if (map != MAP_FAILED) {
+			win = dpack_decoder_file_alloc_win(map, decoder->msize);
+			if (win) {
+				dpack_backing_put(decoder->win);
+				decoder->win = win;
+				decoder->map = map;
+				return 0;
+			}
+
+			munmap(map, decoder->msize);
+
+			return -ENOMEM;
+		}
+	}
 
 	dpack_assert_intern(errno != EACCES);
 	dpack_assert_intern(errno != EBADF);
@@ -179,6 +269,56 @@ dpack_decoder_file_skip(struct dpack_decoder * __restrict decoder,
 	return -ENODATA;
 }
 
+static __dpack_nonull(1, 3, 4) __dpack_nothrow __warn_result
+int
+dpack_decoder_file_borrow(struct dpack_decoder * __restrict  decoder,
+                          size_t                             size,
+                          const uint8_t ** __restrict        data,
+                          struct dpack_backing ** __restrict backing)
+{
+	dpack_decoder_assert_file_api((const struct dpack_decoder_file *)
+	                              decoder);
+	dpack_assert_api(((struct dpack_decoder_file *)decoder)->map);
+	dpack_assert_api(((struct dpack_decoder_file *)decoder)->map !=
+	                 MAP_FAILED);
+	dpack_assert_intern(size);
+	dpack_assert_intern(data);
+	dpack_assert_intern(backing);
+
+	struct dpack_decoder_file * dec = (struct dpack_decoder_file *)decoder;
+	off_t                       foff;
+
+	if (!__builtin_add_overflow(dec->foff, (off_t)size, &foff) &&
+	    (foff <= dec->fsize)) {
+		size_t msz = dec->msize;
+		off_t  msk = (off_t)(msz - 1);
+		off_t  moff = dec->foff & ~msk;
+		size_t start = (size_t)(dec->foff & msk);
+
+		if (size > (msz - start))
+			/* Span crosses data mapping window boundary. */
+			return -EAGAIN;
+
+		if (moff != dec->moff) {
+			int err;
+
+			err = dpack_decoder_file_remap(dec, moff);
+			if (err)
+				return err;
+		}
+
+		*data = &dec->map[start];
+		*backing = dpack_backing_get(dec->win);
+
+		dec->foff = foff;
+		dec->moff = moff;
+
+		return 0;
+	}
+
+	return -ENODATA;
+}
+
 static __dpack_nonull(1) __warn_result
 int
 dpack_decoder_file_fini(struct dpack_decoder * __restrict decoder)
@@ -187,44 +327,90 @@ dpack_decoder_file_fini(struct dpack_decoder * __restrict decoder)
 	                              decoder);
 
 	struct dpack_decoder_file * dec = (struct dpack_decoder_file *)decoder;
-	int                         ret;
 
 	/*
 	 * As stated into munmap(2), closing the file descriptor does not unmap
-	 * mappings implicitly.
+	 * mappings implicitly. Current data mapping window is unmapped once
+	 * the last data aliasing it is released.
 	 */
-	if (dec->map) {
-STROLL_IGNORE_WARN("-Wcast-qual")
-		if (munmap((void *)dec->map, dec->msize)) {
-STROLL_RESTORE_WARN
-			dpack_assert_intern(errno != EACCES);
-			dpack_assert_intern(errno != EBADF);
-			dpack_assert_intern(errno != EEXIST);
-			dpack_assert_intern(errno != EINVAL);
-			dpack_assert_intern(errno != ENFILE);
-			dpack_assert_intern(errno != ENODEV);
-			dpack_assert_intern(errno != EOVERFLOW);
-			dpack_assert_intern(errno != ETXTBSY);
-
-			ret = -errno;
-		}
-	}
+	dpack_backing_put(dec->win);
+	dec->win = NULL;
+	dec->map = NULL;
 
-	if (!ret)
-		return ufile_close(dec->fd);
-
-	ufile_close(dec->fd);
-
-	return ret;
+	return ufile_close(dec->fd);
 }
 
 static const struct dpack_decoder_ops dpack_decoder_file_ops = {
-	.left = dpack_decoder_file_left,
-	.read = dpack_decoder_file_read,
-	.skip = dpack_decoder_file_skip,
-	.fini = dpack_decoder_file_fini
+	.left   = dpack_decoder_file_left,
+	.read   = dpack_decoder_file_read,
+	.skip   = dpack_decoder_file_skip,
+	.fini   = dpack_decoder_file_fini,
+	.borrow = dpack_decoder_file_borrow
 };
 
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_file_setup(struct dpack_decoder_file * __restrict decoder,
+                         int                                    fd,
+                         size_t                                 map_size,
+                         bool                                   discard)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(fd >= 0);
+	dpack_assert_intern(map_size);
+	dpack_assert_intern(map_size <= (size_t)DPACK_DECODER_FILE_MSIZE_MAX);
+
+	struct stat            st;
+	int                    err;
+	void *                 map;
+	struct dpack_backing * win;
+
+	err = ufile_fstat(fd, &st);
+	if (err)
+		return err;
+
+	if (!st.st_size)
+		return -ENODATA;
+	else if ((off64_t)st.st_size > (off64_t)SIZE_MAX)
+		/*
+		 *  Do not support files larger than SIZE_MAX since the API
+		 * returns / manipulates size_t arguments...
+		 */
+		return -EOVERFLOW;
+
+	map_size = stroll_min(map_size, (size_t)st.st_size);
+	map_size = stroll_align_upper(map_size, stroll_page_size());
+	map = mmap(0, map_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	if (map == MAP_FAILED) {
+		dpack_assert_intern(errno != EBADF);
+		dpack_assert_intern(errno != EEXIST);
+		dpack_assert_intern(errno != EINVAL);
+		dpack_assert_intern(errno != EOVERFLOW);
+		dpack_assert_intern(errno != ETXTBSY);
+
+		return -errno;
+	}
+
+	win = dpack_decoder_file_alloc_win(map, map_size);
+	if (!win) {
+		munmap(map, map_size);
+		return -ENOMEM;
+	}
+
+	dpack_decoder_init(&decoder->base,
+	                   &dpack_decoder_file_ops,
+	                   discard);
+	decoder->foff = 0;
+	decoder->moff = 0;
+	decoder->fsize = st.st_size;
+	decoder->msize = map_size;
+	decoder->map = map;
+	decoder->win = win;
+	decoder->fd = fd;
+
+	return 0;
+}
+
 int
 _dpack_decoder_init_file_at(struct dpack_decoder_file * __restrict decoder,
                             int                                    dir,
@@ -250,13 +436,426 @@ _dpack_decoder_init_file_at(struct dpack_decoder_file * __restrict decoder,
 	dpack_assert_api(!(flags & O_NONBLOCK));
 	dpack_assert_api(!(flags & O_PATH));
 
-	int         fd;
-	struct stat st;
-	int         err;
-	void *      map;
+	int fd;
+	int err;
 
 	fd = ufile_open_at(dir, path, O_RDONLY | flags);
-	if (fd)
+	if (fd < 0)
+		return fd;
+
+	err = dpack_decoder_file_setup(decoder, fd, map_size, discard);
+	if (err)
+		ufile_close(fd);
+
+	return err;
+}
+
+#if defined(CONFIG_DPACK_CODEC_MEMFD)
+
+int
+_dpack_decoder_init_memfd(struct dpack_decoder_file * __restrict decoder,
+                          int                                    fd,
+                          size_t                                 map_size,
+                          bool                                   discard)
+{
+	dpack_assert_api(decoder);
+	dpack_assert_api(fd >= 0);
+	dpack_assert_api(map_size);
+	dpack_assert_api(map_size <= (size_t)DPACK_DECODER_FILE_MSIZE_MAX);
+
+	int seals;
+
+	/*
+	 * Do not trust the sender: ensure content of memory file cannot be
+	 * modified nor truncated while being decoded.
+	 */
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0)
+		return -errno;
+	if ((seals & DPACK_MEMFD_SEALS) != DPACK_MEMFD_SEALS)
+		return -EPERM;
+
+	return dpack_decoder_file_setup(decoder, fd, map_size, discard);
+}
+
+#endif /* defined(CONFIG_DPACK_CODEC_MEMFD) */
+
+#if defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+
+/******************************************************************************
+ * Parallel file decoding
+ ******************************************************************************/
+
+/*
+ * Number of ranges to split the file into per thread. Using more ranges than
+ * threads balances load when messages decoding cost is not uniform.
+ */
+#define DPACK_FILE_PARALLEL_RANGE_PER_THREAD (4U)
+
+/*
+ * Maximum number of message boundaries recorded at the start of each range
+ * while scanning from its sampled offset. These are used to check that the
+ * speculative walk of a range converges with the true message boundaries.
+ */
+#define DPACK_FILE_PARALLEL_SYNC_NR (32U)
+
+/*
+ * A range of file content.
+ *
+ * Ranges start at sampled offsets located at multiples of the file stride,
+ * i.e. most probably in the middle of a message. The scan pass walks each
+ * range from this offset and records the first message boundaries it meets
+ * into sync[] as well as the first boundary located at or beyond the sampled
+ * start of the next range into end.
+ *
+ * Once the true start of a range is known, i.e. the end of the previous one,
+ * the range walk is valid if it went through this start or any message
+ * boundary that follows it since messages are self-delimiting.
+ */
+struct dpack_file_prange {
+	size_t       start;
+	size_t       end;
+	int          err;
+	unsigned int sync_nr;
+	size_t       sync[DPACK_FILE_PARALLEL_SYNC_NR];
+};
+
+struct dpack_file_pjob {
+	const uint8_t *            map;
+	size_t                     fsize;
+	dpack_decode_file_fn *     decode;
+	void *                     data;
+	struct dpack_file_prange * ranges;
+	unsigned int               range_nr;
+	unsigned int               next;
+	int                        err;
+};
+
+/*
+ * Compute size of the message located at the start of the given memory area
+ * by skipping over it without decoding.
+ */
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_file_msg_size(const uint8_t * __restrict msg,
+                    size_t                     left,
+                    size_t * __restrict        size)
+{
+	dpack_assert_intern(msg);
+	dpack_assert_intern(left);
+	dpack_assert_intern(size);
+
+	struct dpack_decoder_buffer dec;
+	int                         err;
+
+	dpack_decoder_init_buffer(&dec, msg, left);
+	err = dpack_decoder_discard(&dec.base);
+	*size = left - dpack_decoder_data_left(&dec.base);
+	dpack_decoder_fini(&dec.base);
+
+	return err;
+}
+
+/*
+ * Return offset the range located at the given index should be walked up to,
+ * i.e. the sampled start of the next range.
+ */
+static __dpack_nonull(1) __dpack_pure __warn_result
+size_t
+dpack_file_range_limit(const struct dpack_file_pjob * __restrict job,
+                       unsigned int                              idx)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(idx < job->range_nr);
+
+	if ((idx + 1) < job->range_nr)
+		return job->ranges[idx + 1].start;
+
+	return job->fsize;
+}
+
+/*
+ * Speculatively walk a range from its sampled start offset, skipping over
+ * messages without decoding them.
+ */
+static __dpack_nonull(1)
+void
+dpack_file_scan_range(const struct dpack_file_pjob * __restrict job,
+                      unsigned int                              idx)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(idx < job->range_nr);
+
+	struct dpack_file_prange * rng = &job->ranges[idx];
+	size_t                     lim = dpack_file_range_limit(job, idx);
+	size_t                     off = rng->start;
+
+	do {
+		size_t sz;
+		int    err;
+
+		if (rng->sync_nr < DPACK_FILE_PARALLEL_SYNC_NR)
+			rng->sync[rng->sync_nr++] = off;
+
+		err = dpack_file_msg_size(&job->map[off],
+		                          job->fsize - off,
+		                          &sz);
+		if (err) {
+			rng->err = err;
+			return;
+		}
+
+		off += sz;
+	} while (off < lim);
+
+	rng->end = off;
+}
+
+/*
+ * Fix range located at the given index up once the true start of its first
+ * message is known.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_file_sync_range(const struct dpack_file_pjob * __restrict job,
+                      unsigned int                              idx,
+                      size_t                                    start)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(idx);
+	dpack_assert_intern(idx < job->range_nr);
+
+	struct dpack_file_prange * rng = &job->ranges[idx];
+	size_t                     lim = dpack_file_range_limit(job, idx);
+	size_t                     off = start;
+	unsigned int               s = 0;
+
+	rng->start = start;
+	if (!rng->err) {
+		/*
+		 * Walk from the true start until reaching a boundary the
+		 * speculative scan went through: the scan is valid from there
+		 * onwards.
+		 */
+		while ((off < lim) && (s < rng->sync_nr)) {
+			size_t sz;
+			int    err;
+
+			while ((s < rng->sync_nr) && (rng->sync[s] < off))
+				s++;
+			if ((s < rng->sync_nr) && (rng->sync[s] == off))
+				return 0;
+
+			err = dpack_file_msg_size(&job->map[off],
+			                          job->fsize - off,
+			                          &sz);
+			if (err)
+				return err;
+
+			off += sz;
+		}
+	}
+
+	/*
+	 * Speculative scan failed or did not converge within the recorded
+	 * boundaries: walk what is left of the range sequentially.
+	 */
+	while (off < lim) {
+		size_t sz;
+		int    err;
+
+		err = dpack_file_msg_size(&job->map[off],
+		                          job->fsize - off,
+		                          &sz);
+		if (err)
+			return err;
+
+		off += sz;
+	}
+
+	rng->end = off;
+	rng->err = 0;
+
+	return 0;
+}
+
+/*
+ * Decode messages of a range in a single walk: the size of each message is
+ * given by the amount of data consumed by the user callback.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_file_decode_range(const struct dpack_file_pjob * __restrict job,
+                        size_t                                    off,
+                        size_t                                    end)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(off < end);
+
+	do {
+		struct dpack_decoder_buffer dec;
+		size_t                      left;
+		int                         err;
+
+		dpack_decoder_init_buffer(&dec, &job->map[off], end - off);
+		err = job->decode(&dec.base, (off_t)off, job->data);
+		if (!err && (dpack_decoder_data_left(&dec.base) == (end - off)))
+			/* Message left untouched by callback: skip it. */
+			err = dpack_decoder_discard(&dec.base);
+		left = dpack_decoder_data_left(&dec.base);
+		dpack_decoder_fini(&dec.base);
+		if (err)
+			return err;
+
+		off = end - left;
+	} while (off < end);
+
+	return 0;
+}
+
+static __dpack_nonull(1)
+void *
+dpack_file_scan_worker(void * arg)
+{
+	dpack_assert_intern(arg);
+
+	struct dpack_file_pjob * job = arg;
+
+	while (true) {
+		unsigned int idx;
+
+		idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (idx >= job->range_nr)
+			break;
+
+		dpack_file_scan_range(job, idx);
+	}
+
+	return NULL;
+}
+
+static __dpack_nonull(1)
+void *
+dpack_file_decode_worker(void * arg)
+{
+	dpack_assert_intern(arg);
+
+	struct dpack_file_pjob * job = arg;
+
+	while (!__atomic_load_n(&job->err, __ATOMIC_RELAXED)) {
+		const struct dpack_file_prange * rng;
+		unsigned int                     idx;
+		int                              err;
+		int                              none = 0;
+
+		idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (idx >= job->range_nr)
+			break;
+
+		rng = &job->ranges[idx];
+		if (rng->start >= rng->end)
+			/* Covered by a message of a previous range. */
+			continue;
+
+		err = dpack_file_decode_range(job, rng->start, rng->end);
+		if (err)
+			/* Keep the first error reported only. */
+			__atomic_compare_exchange_n(&job->err,
+			                            &none,
+			                            err,
+			                            false,
+			                            __ATOMIC_RELAXED,
+			                            __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/*
+ * Split the file into ranges starting at message boundaries.
+ *
+ * Ranges are first sampled at multiples of the file stride and scanned
+ * concurrently. Each range start is then synchronized to the true message
+ * boundary reached by the scan of the previous range, which mostly comes down
+ * to a lookup into the boundaries recorded by the scan.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_file_split(struct dpack_file_pjob * __restrict job,
+                 unsigned int                        thread_nr)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(job->range_nr);
+	dpack_assert_intern(thread_nr);
+
+	size_t       stride = (job->fsize + job->range_nr - 1) / job->range_nr;
+	unsigned int r;
+	int          err;
+
+	job->range_nr = (unsigned int)((job->fsize + stride - 1) / stride);
+	job->ranges = calloc(job->range_nr, sizeof(job->ranges[0]));
+	if (!job->ranges)
+		return -ENOMEM;
+
+	for (r = 0; r < job->range_nr; r++)
+		job->ranges[r].start = (size_t)r * stride;
+
+	job->next = 0;
+	dpack_run_workers(dpack_file_scan_worker,
+	                  job,
+	                  stroll_min(thread_nr, job->range_nr));
+
+	/* First range starts at a true message boundary. */
+	err = job->ranges[0].err;
+	if (err)
+		goto free;
+
+	for (r = 1; r < job->range_nr; r++) {
+		struct dpack_file_prange * rng = &job->ranges[r];
+		size_t                     start = job->ranges[r - 1].end;
+
+		if (start >= dpack_file_range_limit(job, r)) {
+			/* Covered by a message of a previous range. */
+			rng->start = start;
+			rng->end = start;
+			rng->err = 0;
+			continue;
+		}
+
+		err = dpack_file_sync_range(job, r, start);
+		if (err)
+			goto free;
+	}
+
+	return 0;
+
+free:
+	free(job->ranges);
+
+	return err;
+}
+
+int
+dpack_decode_file_parallel_at(int                     dir,
+                              const char * __restrict path,
+                              dpack_decode_file_fn *  decode,
+                              void * __restrict       data,
+                              unsigned int            thread_nr)
+{
+	dpack_assert_api((dir >= 0) || (dir == AT_FDCWD));
+	dpack_assert_api(upath_validate_path_name(path) > 0);
+	dpack_assert_api(decode);
+	dpack_assert_api(thread_nr);
+
+	int                    fd;
+	struct stat            st;
+	size_t                 fsize;
+	void *                 map;
+	struct dpack_file_pjob job;
+	int                    err;
+
+	fd = ufile_open_at(dir, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 		return fd;
 
 	err = ufile_fstat(fd, &st);
@@ -267,43 +866,51 @@ _dpack_decoder_init_file_at(struct dpack_decoder_file * __restrict decoder,
 		err = -ENODATA;
 		goto close;
 	}
-	else if ((off64_t)st.st_size > (off64_t)SIZE_MAX) {
-		/*
-		 *  Do not support files larger than SIZE_MAX since the API
-		 * returns / manipulates size_t arguments...
-		 */
+	else if ((uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
 		err = -EOVERFLOW;
 		goto close;
 	}
 
-	map_size = stroll_min(map_size, (size_t)st.st_size);
-	map_size = stroll_align_upper(map_size, stroll_page_size());
-	map = mmap(0, map_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	fsize = (size_t)st.st_size;
+	map = mmap(0, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
 	if (map == MAP_FAILED) {
-		dpack_assert_intern(errno != EBADF);
-		dpack_assert_intern(errno != EEXIST);
-		dpack_assert_intern(errno != EINVAL);
-		dpack_assert_intern(errno != EOVERFLOW);
-		dpack_assert_intern(errno != ETXTBSY);
-
 		err = -errno;
 		goto close;
 	}
 
-	dpack_decoder_init(&decoder->base,
-	                   &dpack_decoder_file_ops,
-	                   discard);
-	decoder->foff = 0;
-	decoder->moff = 0;
-	decoder->fsize = st.st_size;
-	decoder->msize = map_size;
-	decoder->map = map;
-	decoder->fd = fd;
+	/*
+	 * Ranges are scanned then decoded concurrently: hint the kernel to
+	 * start reading ahead.
+	 */
+	madvise(map, fsize, MADV_WILLNEED);
 
-	return 0;
+	job.map = map;
+	job.fsize = fsize;
+	job.decode = decode;
+	job.data = data;
+	job.range_nr = thread_nr * DPACK_FILE_PARALLEL_RANGE_PER_THREAD;
+	job.err = 0;
+
+	err = dpack_file_split(&job, thread_nr);
+	if (err)
+		goto unmap;
+
+	job.next = 0;
+	dpack_run_workers(dpack_file_decode_worker,
+	                  &job,
+	                  stroll_min(thread_nr, job.range_nr));
+
+	err = job.err;
+
+	free(job.ranges);
+
+unmap:
+	munmap(map, fsize);
 
 close:
 	ufile_close(fd);
 
 	return err;
 }
+
+#endif /* defined(CONFIG_DPACK_CODEC_FILE_PARALLEL) */
@@ -0,0 +1,458 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/filter.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ * Filtering encoder / packer
+ ******************************************************************************/
+
+#define dpack_encoder_assert_filter_api(_enc) \
+	dpack_assert_api(_enc); \
+	dpack_encoder_assert_api((_enc)->next); \
+	dpack_assert_api((_enc)->filter); \
+	dpack_assert_api((_enc)->block); \
+	dpack_assert_api((_enc)->capa); \
+	dpack_assert_api((_enc)->tail <= (_enc)->capa)
+
+static __dpack_nonull(1) __dpack_pure __warn_result
+size_t
+dpack_encoder_filter_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+
+	const struct dpack_encoder_filter * enc =
+		(const struct dpack_encoder_filter *)encoder;
+	size_t                              left;
+
+	/* Staged data will eventually consume underlying encoder space. */
+	left = dpack_encoder_space_left(enc->next);
+
+	return (left > enc->tail) ? left - enc->tail : 0;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_filter_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+
+	const struct dpack_encoder_filter * enc =
+		(const struct dpack_encoder_filter *)encoder;
+
+	return enc->done + enc->tail;
+}
+
+int
+dpack_encoder_flush_filter(struct dpack_encoder_filter * __restrict encoder)
+{
+	dpack_encoder_assert_filter_api(encoder);
+
+	int err;
+
+	if (!encoder->tail)
+		return 0;
+
+	err = encoder->filter(encoder->block, encoder->tail, encoder->data);
+	if (err)
+		return err;
+
+	err = dpack_encoder_write(encoder->next, encoder->block, encoder->tail);
+	if (err)
+		return err;
+
+	encoder->done += encoder->tail;
+	encoder->tail = 0;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_filter_write(struct dpack_encoder * __restrict encoder,
+                           const uint8_t * __restrict        data,
+                           size_t                            size)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_filter * enc = (struct dpack_encoder_filter *)
+	                                    encoder;
+
+	if (size > dpack_encoder_filter_left(encoder))
+		return -EMSGSIZE;
+
+	do {
+		size_t bytes;
+
+		/*
+		 * Hand full blocks over lazily so that data just encoded may
+		 * still be patched.
+		 */
+		if (enc->tail == enc->capa) {
+			int err;
+
+			err = dpack_encoder_flush_filter(enc);
+			if (err)
+				return err;
+		}
+
+		bytes = stroll_min(size, enc->capa - enc->tail);
+		memcpy(&enc->block[enc->tail], data, bytes);
+		enc->tail += bytes;
+		data += bytes;
+		size -= bytes;
+	} while (size);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 3) __dpack_nothrow __warn_result
+int
+dpack_encoder_filter_patch(struct dpack_encoder * __restrict encoder,
+                           size_t                            offset,
+                           const uint8_t * __restrict        data,
+                           size_t                            size)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_filter * enc = (struct dpack_encoder_filter *)
+	                                    encoder;
+	size_t                        end;
+
+	/* Data already handed over to the filter cannot be modified. */
+	if ((offset >= enc->done) &&
+	    !__builtin_add_overflow(offset, size, &end) &&
+	    (end <= (enc->done + enc->tail))) {
+		memcpy(&enc->block[offset - enc->done], data, size);
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_encoder_filter_cut(struct dpack_encoder * __restrict encoder,
+                         size_t                            offset,
+                         size_t                            size)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_filter * enc = (struct dpack_encoder_filter *)
+	                                    encoder;
+	size_t                        end;
+
+	if ((offset >= enc->done) &&
+	    !__builtin_add_overflow(offset, size, &end) &&
+	    (end <= (enc->done + enc->tail))) {
+		offset -= enc->done;
+		end -= enc->done;
+		memmove(&enc->block[offset], &enc->block[end], enc->tail - end);
+		enc->tail -= size;
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_filter_fini(struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_filter_api((const struct dpack_encoder_filter *)
+	                                encoder);
+
+	struct dpack_encoder_filter * enc = (struct dpack_encoder_filter *)
+	                                    encoder;
+	int                           err;
+
+	/* Underlying encoder is owned by the caller: do not finalize it. */
+	err = dpack_encoder_flush_filter(enc);
+
+	free(enc->block);
+
+	return err;
+}
+
+static const struct dpack_encoder_ops dpack_encoder_filter_ops = {
+	.left  = dpack_encoder_filter_left,
+	.used  = dpack_encoder_filter_used,
+	.write = dpack_encoder_filter_write,
+	.fini  = dpack_encoder_filter_fini,
+	.patch = dpack_encoder_filter_patch,
+	.cut   = dpack_encoder_filter_cut
+};
+
+int
+dpack_encoder_init_filter(struct dpack_encoder_filter * __restrict encoder,
+                          struct dpack_encoder * __restrict        next,
+                          size_t                                   size,
+                          dpack_filter_fn *                        filter,
+                          void * __restrict                        data)
+{
+	dpack_assert_api(encoder);
+	dpack_encoder_assert_api(next);
+	dpack_assert_api(size);
+	dpack_assert_api(filter);
+
+	encoder->block = malloc(size);
+	if (!encoder->block)
+		return -ENOMEM;
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_filter_ops);
+	encoder->next = next;
+	encoder->filter = filter;
+	encoder->data = data;
+	encoder->capa = size;
+	encoder->tail = 0;
+	encoder->done = 0;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Filtering decoder / unpacker
+ ******************************************************************************/
+
+#define dpack_decoder_assert_filter_api(_dec) \
+	dpack_assert_api(_dec); \
+	dpack_decoder_assert_api((_dec)->next); \
+	dpack_assert_api((_dec)->filter); \
+	dpack_assert_api((_dec)->block); \
+	dpack_assert_api((_dec)->capa); \
+	dpack_assert_api((_dec)->tail <= (_dec)->capa); \
+	dpack_assert_api((_dec)->head <= (_dec)->tail)
+
+/* Return number of message bytes that may still be pulled out of next. */
+static __dpack_nonull(1) __dpack_pure __warn_result
+size_t
+dpack_decoder_filter_avail(const struct dpack_decoder_filter * __restrict dec)
+{
+	dpack_assert_intern(dec);
+
+	return stroll_min(dec->left, dpack_decoder_data_left(dec->next));
+}
+
+static __dpack_nonull(1) __dpack_pure __warn_result
+size_t
+dpack_decoder_filter_left(const struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_filter_api((const struct dpack_decoder_filter *)
+	                                decoder);
+
+	const struct dpack_decoder_filter * dec =
+		(const struct dpack_decoder_filter *)decoder;
+
+	return (dec->tail - dec->head) + dpack_decoder_filter_avail(dec);
+}
+
+/*
+ * Read data out of underlying decoder and pass it through the filter into
+ * given location.
+ */
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_decoder_filter_pull(struct dpack_decoder_filter * __restrict decoder,
+                          uint8_t * __restrict                     data,
+                          size_t                                   size)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+	dpack_assert_intern(size <= decoder->left);
+
+	int err;
+
+	err = dpack_decoder_read(decoder->next, data, size);
+	if (err)
+		return err;
+
+	decoder->left -= size;
+
+	return decoder->filter(data, size, decoder->data);
+}
+
+/*
+ * Refill staging block once fully consumed.
+ *
+ * Read-ahead is bounded by message length so that the underlying decoder is
+ * never consumed past the end of message.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_filter_fill(struct dpack_decoder_filter * __restrict decoder)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(decoder->head == decoder->tail);
+
+	size_t size;
+	int    err;
+
+	size = stroll_min(decoder->capa, dpack_decoder_filter_avail(decoder));
+	if (!size)
+		return -ENODATA;
+
+	decoder->head = 0;
+	decoder->tail = 0;
+
+	err = dpack_decoder_filter_pull(decoder, decoder->block, size);
+	if (err)
+		return err;
+
+	decoder->tail = size;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_decoder_filter_read(struct dpack_decoder * __restrict decoder,
+                          uint8_t * __restrict              data,
+                          size_t                            size)
+{
+	dpack_decoder_assert_filter_api((const struct dpack_decoder_filter *)
+	                                decoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_decoder_filter * dec = (struct dpack_decoder_filter *)
+	                                    decoder;
+
+	if (size > dpack_decoder_filter_left(decoder))
+		return -ENODATA;
+
+	do {
+		size_t bytes;
+
+		if (dec->head == dec->tail) {
+			int err;
+
+			if (size >= dec->capa)
+				/*
+				 * Bypass staging block for large spans,
+				 * filtering them in place instead.
+				 */
+				return dpack_decoder_filter_pull(dec,
+				                                 data,
+				                                 size);
+
+			err = dpack_decoder_filter_fill(dec);
+			if (err)
+				return err;
+		}
+
+		bytes = stroll_min(size, dec->tail - dec->head);
+		memcpy(data, &dec->block[dec->head], bytes);
+		dec->head += bytes;
+		data += bytes;
+		size -= bytes;
+	} while (size);
+
+	return 0;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_filter_skip(struct dpack_decoder * __restrict decoder,
+                          size_t                            size)
+{
+	dpack_decoder_assert_filter_api((const struct dpack_decoder_filter *)
+	                                decoder);
+	dpack_assert_api(size);
+
+	struct dpack_decoder_filter * dec = (struct dpack_decoder_filter *)
+	                                    decoder;
+
+	if (size > dpack_decoder_filter_left(decoder))
+		return -ENODATA;
+
+	/* Skipped data goes through the filter as well. */
+	do {
+		size_t bytes;
+
+		if (dec->head == dec->tail) {
+			int err;
+
+			err = dpack_decoder_filter_fill(dec);
+			if (err)
+				return err;
+		}
+
+		bytes = stroll_min(size, dec->tail - dec->head);
+		dec->head += bytes;
+		size -= bytes;
+	} while (size);
+
+	return 0;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_decoder_filter_fini(struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_filter_api((const struct dpack_decoder_filter *)
+	                                decoder);
+
+	struct dpack_decoder_filter * dec = (struct dpack_decoder_filter *)
+	                                    decoder;
+
+	/* Underlying decoder is owned by the caller: do not finalize it. */
+	free(dec->block);
+
+	return 0;
+}
+
+static const struct dpack_decoder_ops dpack_decoder_filter_ops = {
+	.left = dpack_decoder_filter_left,
+	.read = dpack_decoder_filter_read,
+	.skip = dpack_decoder_filter_skip,
+	.fini = dpack_decoder_filter_fini
+};
+
+int
+dpack_decoder_init_filter(struct dpack_decoder_filter * __restrict decoder,
+                          struct dpack_decoder * __restrict        next,
+                          size_t                                   size,
+                          size_t                                   len,
+                          dpack_filter_fn *                        filter,
+                          void * __restrict                        data)
+{
+	dpack_assert_api(decoder);
+	dpack_decoder_assert_api(next);
+	dpack_assert_api(size);
+	dpack_assert_api(filter);
+
+	decoder->block = malloc(size);
+	if (!decoder->block)
+		return -ENOMEM;
+
+	dpack_decoder_init(&decoder->base,
+	                   &dpack_decoder_filter_ops,
+	                   next->disc);
+	decoder->next = next;
+	decoder->filter = filter;
+	decoder->data = data;
+	decoder->capa = size;
+	decoder->head = 0;
+	decoder->tail = 0;
+	decoder->left = len;
+
+	return 0;
+}
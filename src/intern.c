@@ -0,0 +1,323 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2023-2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/intern.h"
+#include "dpack/codec.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Strings up to this length are read onto the stack before looking them up so
+ * that no allocation is required when they are already interned.
+ */
+#define DPACK_INTERN_SCRATCH_LEN (256U)
+
+struct dpack_intern_entry {
+	struct dpack_intern_entry * next;
+	uint32_t                    hash;
+	size_t                      len;
+	char                        str[];
+};
+
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_intern_hash(const char * __restrict str,
+                  size_t                  length,
+                  uint32_t * __restrict   hash)
+{
+	dpack_assert_intern(str);
+	dpack_assert_intern(length);
+	dpack_assert_intern(hash);
+
+	const uint8_t * byte = (const uint8_t *)str;
+	const uint8_t * end = &byte[length];
+	uint32_t        h = UINT32_C(2166136261);
+
+	/*
+	 * FNV-1a hashing. Since msgpack does not serialize terminating NULL
+	 * byte, ensure the string contains no NULL byte within the same pass.
+	 */
+	do {
+		if (!*byte)
+			return -EBADMSG;
+		h = (h ^ *byte) * UINT32_C(16777619);
+	} while (++byte < end);
+
+	*hash = h;
+
+	return 0;
+}
+
+static __dpack_nonull(3) __warn_result
+const struct dpack_intern_entry *
+dpack_intern_lookup(const struct dpack_intern_entry * ent,
+                    uint32_t                          hash,
+                    const char * __restrict           str,
+                    size_t                            length)
+{
+	while (ent) {
+		if ((ent->hash == hash) &&
+		    (ent->len == length) &&
+		    !memcmp(ent->str, str, length))
+			return ent;
+
+		ent = __atomic_load_n(&ent->next, __ATOMIC_ACQUIRE);
+	}
+
+	return NULL;
+}
+
+static __warn_result
+struct dpack_intern_entry *
+dpack_intern_alloc_entry(size_t length)
+{
+	dpack_assert_intern(length);
+	dpack_assert_intern(length <= DPACK_STRLEN_MAX);
+
+	struct dpack_intern_entry * ent;
+
+	ent = malloc(sizeof(*ent) + length + 1);
+	if (!ent)
+		return NULL;
+
+	ent->len = length;
+	ent->str[length] = '\0';
+
+	return ent;
+}
+
+static __dpack_nonull(1, 3, 6) __warn_result
+int
+dpack_intern_insert(struct dpack_intern * __restrict             intern,
+                    uint32_t                                     hash,
+                    const char * __restrict                      str,
+                    size_t                                       length,
+                    struct dpack_intern_entry * __restrict       entry,
+                    const struct dpack_intern_entry ** __restrict found)
+{
+	dpack_assert_intern(intern);
+	dpack_assert_intern(intern->buckets);
+	dpack_assert_intern(str);
+	dpack_assert_intern(length);
+	dpack_assert_intern(found);
+
+	unsigned int                      b = hash & intern->mask;
+	struct dpack_intern_entry **      head = &intern->buckets[b];
+	pthread_mutex_t *                 lock;
+	const struct dpack_intern_entry * ent;
+
+	/* Fast path: lock free lookup. */
+	ent = dpack_intern_lookup(__atomic_load_n(head, __ATOMIC_ACQUIRE),
+	                          hash,
+	                          str,
+	                          length);
+	if (ent)
+		goto found;
+
+	lock = &intern->locks[b % DPACK_INTERN_LOCK_NR];
+	pthread_mutex_lock(lock);
+
+	/* Another thread may have inserted the same string in the meantime. */
+	ent = dpack_intern_lookup(*head, hash, str, length);
+	if (ent) {
+		pthread_mutex_unlock(lock);
+		goto found;
+	}
+
+	if (!entry) {
+		entry = dpack_intern_alloc_entry(length);
+		if (!entry) {
+			int err = -errno;
+
+			pthread_mutex_unlock(lock);
+
+			return err;
+		}
+
+		memcpy(entry->str, str, length);
+	}
+
+	entry->hash = hash;
+	entry->next = *head;
+	/* Publish fully initialized entry to lock free lookups. */
+	__atomic_store_n(head, entry, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(lock);
+
+	*found = entry;
+
+	return 0;
+
+found:
+	/* Release entry allocated by caller since no longer needed. */
+	free(entry);
+
+	*found = ent;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2, 4) __warn_result
+int
+dpack_intern_xtract(struct dpack_decoder * __restrict             decoder,
+                    struct dpack_intern * __restrict              intern,
+                    size_t                                        length,
+                    const struct dpack_intern_entry ** __restrict entry)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(intern);
+	dpack_assert_intern(length);
+	dpack_assert_intern(length <= DPACK_STRLEN_MAX);
+	dpack_assert_intern(entry);
+
+	char                        buff[DPACK_INTERN_SCRATCH_LEN];
+	struct dpack_intern_entry * ent = NULL;
+	char *                      str = buff;
+	uint32_t                    hash;
+	int                         err;
+
+	if (length > sizeof(buff)) {
+		/*
+		 * Read long strings straight into an entry that will be
+		 * inserted as-is when not already interned.
+		 */
+		ent = dpack_intern_alloc_entry(length);
+		if (!ent)
+			return -errno;
+
+		str = ent->str;
+	}
+
+	err = dpack_decoder_read(decoder, (uint8_t *)str, length);
+	if (err)
+		goto free;
+
+	err = dpack_intern_hash(str, length, &hash);
+	if (err)
+		goto free;
+
+	return dpack_intern_insert(intern, hash, str, length, ent, entry);
+
+free:
+	free(ent);
+
+	return err;
+}
+
+ssize_t
+dpack_decode_str_intern(struct dpack_decoder * __restrict decoder,
+                        struct dpack_intern * __restrict  intern,
+                        const char ** __restrict          value)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(intern);
+	dpack_assert_api(intern->buckets);
+	dpack_assert_api(value);
+
+	ssize_t                           len;
+	const struct dpack_intern_entry * ent;
+	int                               err;
+
+	len = dpack_decode_str_tag(decoder, 1, DPACK_STRLEN_MAX);
+	dpack_assert_intern(len);
+	if (len < 0)
+		return len;
+
+	err = dpack_intern_xtract(decoder, intern, (size_t)len, &ent);
+	if (err)
+		return err;
+
+	dpack_assert_intern(ent->len == (size_t)len);
+	*value = ent->str;
+
+	return len;
+}
+
+#if defined(CONFIG_DPACK_LVSTR)
+
+ssize_t
+dpack_decode_lvstr_intern(struct dpack_decoder * __restrict decoder,
+                          struct dpack_intern * __restrict  intern,
+                          struct stroll_lvstr * __restrict  value)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(intern);
+	dpack_assert_api(intern->buckets);
+	dpack_assert_api(value);
+
+	ssize_t                           len;
+	const struct dpack_intern_entry * ent;
+	int                               err;
+
+	len = dpack_decode_str_tag(decoder, 1, DPACK_LVSTRLEN_MAX);
+	dpack_assert_intern(len);
+	if (len < 0)
+		return len;
+
+	err = dpack_intern_xtract(decoder, intern, (size_t)len, &ent);
+	if (err)
+		return err;
+
+	dpack_assert_intern(ent->len == (size_t)len);
+	stroll_lvstr_nlend(value, ent->str, ent->len);
+
+	return len;
+}
+
+#endif /* defined(CONFIG_DPACK_LVSTR) */
+
+int
+dpack_intern_init(struct dpack_intern * __restrict intern, unsigned int nr)
+{
+	dpack_assert_api(intern);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_INTERN_NR_MAX);
+
+	unsigned int l;
+
+	/* Round number of buckets up to the next power of 2. */
+	if (nr > 1)
+		nr = 1U << (sizeof(nr) * 8 - (unsigned int)__builtin_clz(nr - 1));
+
+	intern->buckets = calloc(nr, sizeof(intern->buckets[0]));
+	if (!intern->buckets)
+		return -errno;
+
+	intern->mask = nr - 1;
+
+	for (l = 0; l < DPACK_INTERN_LOCK_NR; l++)
+		pthread_mutex_init(&intern->locks[l], NULL);
+
+	return 0;
+}
+
+void
+dpack_intern_fini(struct dpack_intern * __restrict intern)
+{
+	dpack_assert_api(intern);
+	dpack_assert_api(intern->buckets);
+
+	unsigned int b;
+	unsigned int l;
+
+	for (b = 0; b <= intern->mask; b++) {
+		struct dpack_intern_entry * ent = intern->buckets[b];
+
+		while (ent) {
+			struct dpack_intern_entry * nxt = ent->next;
+
+			free(ent);
+			ent = nxt;
+		}
+	}
+
+	free(intern->buckets);
+
+	for (l = 0; l < DPACK_INTERN_LOCK_NR; l++)
+		pthread_mutex_destroy(&intern->locks[l]);
+}
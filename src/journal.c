@@ -0,0 +1,702 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/journal.h"
+#include "common.h"
+#include <utils/file.h>
+#include <sys/mman.h>
+#include <endian.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define dpack_journal_assert_api(_journal) \
+	dpack_assert_api(_journal); \
+	dpack_assert_api((_journal)->curr); \
+	dpack_assert_api(((_journal)->curr == &(_journal)->batch[0]) || \
+	                 ((_journal)->curr == &(_journal)->batch[1])); \
+	dpack_assert_api((_journal)->synced <= (_journal)->queued); \
+	dpack_assert_api((_journal)->tail >= 0); \
+	dpack_assert_api((_journal)->fd >= 0)
+
+/* Minimum size of batch data area allocations. */
+#define DPACK_JOURNAL_BATCH_SIZE_MIN (4096U)
+
+/* Initial size of per-thread record scratch areas, header included. */
+#define DPACK_JOURNAL_SCRATCH_SIZE_MIN \
+	stroll_min(256U, DPACK_JOURNAL_FRAME_SIZE_MAX)
+
+/* Maximum size of a framed record, header included. */
+#define DPACK_JOURNAL_FRAME_SIZE_MAX \
+	(DPACK_JOURNAL_HEAD_SIZE + DPACK_JOURNAL_RECORD_SIZE_MAX)
+
+/******************************************************************************
+ * CRC32C (Castagnoli) checksum
+ ******************************************************************************/
+
+/* Bit reversed Castagnoli polynomial. */
+#define DPACK_JOURNAL_CRC_POLY (0x82f63b78U)
+
+typedef uint32_t dpack_journal_crc_fn(uint32_t,
+                                      const uint8_t * __restrict,
+                                      size_t);
+
+static uint32_t dpack_journal_crc_table[256];
+
+static __dpack_nonull(2) __dpack_nothrow __dpack_pure __warn_result
+uint32_t
+dpack_journal_crc_soft(uint32_t                   crc,
+                       const uint8_t * __restrict data,
+                       size_t                     size)
+{
+	while (size--)
+		crc = dpack_journal_crc_table[(crc ^ *data++) & 0xffU] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Rely upon the SSE4.2 crc32 instruction which computes CRC32C over 8 bytes
+ * per instruction. Compiled for SSE4.2 whatever the build target is, and
+ * selected at runtime when supported by the CPU.
+ */
+static __dpack_nonull(2) __dpack_nothrow __dpack_pure __warn_result
+__attribute__((target("sse4.2")))
+uint32_t
+dpack_journal_crc_hard(uint32_t                   crc,
+                       const uint8_t * __restrict data,
+                       size_t                     size)
+{
+	uint64_t crc64;
+
+	while (size && ((uintptr_t)data & (sizeof(uint64_t) - 1))) {
+		crc = _mm_crc32_u8(crc, *data++);
+		size--;
+	}
+
+	crc64 = crc;
+	while (size >= sizeof(uint64_t)) {
+		uint64_t word;
+
+		memcpy(&word, data, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		data += sizeof(word);
+		size -= sizeof(word);
+	}
+	crc = (uint32_t)crc64;
+
+	while (size--)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return crc;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+/* Rely upon the ARMv8 CRC32 extension enabled at build time. */
+static __dpack_nonull(2) __dpack_nothrow __dpack_pure __warn_result
+uint32_t
+dpack_journal_crc_hard(uint32_t                   crc,
+                       const uint8_t * __restrict data,
+                       size_t                     size)
+{
+	while (size && ((uintptr_t)data & (sizeof(uint64_t) - 1))) {
+		crc = __crc32cb(crc, *data++);
+		size--;
+	}
+
+	while (size >= sizeof(uint64_t)) {
+		uint64_t word;
+
+		memcpy(&word, data, sizeof(word));
+		crc = __crc32cd(crc, word);
+		data += sizeof(word);
+		size -= sizeof(word);
+	}
+
+	while (size--)
+		crc = __crc32cb(crc, *data++);
+
+	return crc;
+}
+
+#endif
+
+static dpack_journal_crc_fn * dpack_journal_crc_impl;
+
+static
+void
+dpack_journal_crc_init(void)
+{
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2")) {
+		dpack_journal_crc_impl = dpack_journal_crc_hard;
+		return;
+	}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+	dpack_journal_crc_impl = dpack_journal_crc_hard;
+	return;
+#endif
+
+	unsigned int b;
+
+	for (b = 0; b < stroll_array_nr(dpack_journal_crc_table); b++) {
+		uint32_t     crc = b;
+		unsigned int k;
+
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (DPACK_JOURNAL_CRC_POLY & (0U - (crc & 1)));
+
+		dpack_journal_crc_table[b] = crc;
+	}
+
+	dpack_journal_crc_impl = dpack_journal_crc_soft;
+}
+
+/*
+ * Compute checksum of a record, covering both size field of its header and
+ * its content so that a corrupted size field cannot go unnoticed.
+ */
+static __dpack_nonull(1, 2) __dpack_nothrow __warn_result
+uint32_t
+dpack_journal_crc(const uint8_t * __restrict head,
+                  const uint8_t * __restrict record,
+                  size_t                     size)
+{
+	dpack_assert_intern(dpack_journal_crc_impl);
+	dpack_assert_intern(head);
+	dpack_assert_intern(record);
+	dpack_assert_intern(size);
+
+	uint32_t crc = ~0U;
+
+	crc = dpack_journal_crc_impl(crc, head, sizeof(uint32_t));
+	crc = dpack_journal_crc_impl(crc, record, size);
+
+	return ~crc;
+}
+
+/******************************************************************************
+ * Per-thread record scratch area
+ ******************************************************************************/
+
+/*
+ * Records are framed into a scratch area owned by the appending thread before
+ * being copied into the current batch so that the encoding callback is run
+ * without holding the journal lock. Scratch areas grow on demand up to the
+ * maximum framed record size and are released at thread exit.
+ */
+struct dpack_journal_scratch {
+	size_t  capa;
+	uint8_t data[];
+};
+
+static pthread_key_t  dpack_journal_scratch_key;
+static int            dpack_journal_init_err;
+static pthread_once_t dpack_journal_once = PTHREAD_ONCE_INIT;
+
+static
+void
+dpack_journal_init(void)
+{
+	dpack_journal_crc_init();
+
+	dpack_journal_init_err = -pthread_key_create(&dpack_journal_scratch_key,
+	                                             free);
+}
+
+static __warn_result
+struct dpack_journal_scratch *
+dpack_journal_grow_scratch(struct dpack_journal_scratch * scratch,
+                           size_t                         capa)
+{
+	dpack_assert_intern(capa <= DPACK_JOURNAL_FRAME_SIZE_MAX);
+
+	struct dpack_journal_scratch * scr;
+
+	scr = realloc(scratch, sizeof(*scr) + capa);
+	if (!scr)
+		return NULL;
+
+	if ((scr != scratch) &&
+	    pthread_setspecific(dpack_journal_scratch_key, scr)) {
+		/*
+		 * Cannot fail once the calling thread slot has been allocated,
+		 * i.e. when growing an existing scratch area.
+		 */
+		dpack_assert_intern(!scratch);
+		free(scr);
+		return NULL;
+	}
+
+	scr->capa = capa;
+
+	return scr;
+}
+
+/*
+ * Encode and frame a record into the calling thread's scratch area, growing
+ * it as long as the record does not fit.
+ */
+static __dpack_nonull(1, 3, 4) __warn_result
+int
+dpack_journal_frame(dpack_journal_encode_fn *                encode,
+                    void * __restrict                        data,
+                    struct dpack_journal_scratch ** __restrict scratch,
+                    size_t * __restrict                      size)
+{
+	dpack_assert_intern(encode);
+	dpack_assert_intern(scratch);
+	dpack_assert_intern(size);
+
+	struct dpack_journal_scratch * scr;
+	size_t                         sz;
+	uint32_t                       val;
+	int                            err;
+
+	scr = pthread_getspecific(dpack_journal_scratch_key);
+	if (!scr) {
+		sz = DPACK_JOURNAL_SCRATCH_SIZE_MIN;
+		scr = dpack_journal_grow_scratch(NULL, sz);
+		if (!scr)
+			return -ENOMEM;
+	}
+
+	while (true) {
+		struct dpack_encoder_buffer enc;
+
+		dpack_encoder_init_buffer(&enc,
+		                          &scr->data[DPACK_JOURNAL_HEAD_SIZE],
+		                          scr->capa - DPACK_JOURNAL_HEAD_SIZE);
+		err = encode(&enc.base, data);
+		sz = dpack_encoder_space_used(&enc.base);
+		dpack_encoder_fini(&enc.base);
+
+		if ((err != -EMSGSIZE) ||
+		    (scr->capa >= DPACK_JOURNAL_FRAME_SIZE_MAX))
+			break;
+
+		/* Record does not fit: grow scratch area and encode again. */
+		sz = stroll_min(2 * scr->capa,
+		                (size_t)DPACK_JOURNAL_FRAME_SIZE_MAX);
+		scr = dpack_journal_grow_scratch(scr, sz);
+		if (!scr)
+			return -ENOMEM;
+	}
+
+	if (err)
+		return err;
+	if (!sz)
+		return -EMSGSIZE;
+
+	val = htole32((uint32_t)sz);
+	memcpy(scr->data, &val, sizeof(val));
+	val = htole32(dpack_journal_crc(scr->data,
+	                                &scr->data[DPACK_JOURNAL_HEAD_SIZE],
+	                                sz));
+	memcpy(&scr->data[sizeof(val)], &val, sizeof(val));
+
+	*scratch = scr;
+	*size = DPACK_JOURNAL_HEAD_SIZE + sz;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Journal
+ ******************************************************************************/
+
+/*
+ * Tell whether the invalid record located at the start of the given area is
+ * the remainder of an interrupted append, i.e. whether nothing past it may
+ * hold a valid record.
+ *
+ * Appends write whole records at the end of file: an interrupted append
+ * leaves either an incomplete header, a record running past the end of file,
+ * a last record which content does not match its checksum or a zero filled
+ * area. Anything else denotes corruption of committed records.
+ */
+static __dpack_nonull(1) __dpack_pure __warn_result
+bool
+dpack_journal_is_torn(const uint8_t * __restrict head, size_t left)
+{
+	dpack_assert_intern(head);
+
+	uint32_t size;
+	size_t   off;
+
+	if (left < DPACK_JOURNAL_HEAD_SIZE)
+		return true;
+
+	memcpy(&size, head, sizeof(size));
+	size = le32toh(size);
+	if (size) {
+		left -= DPACK_JOURNAL_HEAD_SIZE;
+		return (size_t)size >= left;
+	}
+
+	for (off = 0; off < left; off++)
+		if (head[off])
+			return false;
+
+	return true;
+}
+
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_journal_scan(const uint8_t * __restrict map,
+                   size_t                     fsize,
+                   size_t * __restrict        valid,
+                   dpack_journal_replay_fn *  replay,
+                   void * __restrict          data)
+{
+	dpack_assert_intern(map);
+	dpack_assert_intern(fsize);
+	dpack_assert_intern(valid);
+
+	size_t off = 0;
+
+	while ((fsize - off) >= DPACK_JOURNAL_HEAD_SIZE) {
+		const uint8_t * head = &map[off];
+		uint32_t        size;
+		uint32_t        crc;
+
+		memcpy(&size, head, sizeof(size));
+		size = le32toh(size);
+		memcpy(&crc, &head[sizeof(size)], sizeof(crc));
+		crc = le32toh(crc);
+
+		/* Stop at the first invalid record. */
+		if (!size ||
+		    (size > DPACK_JOURNAL_RECORD_SIZE_MAX) ||
+		    (size > (fsize - off - DPACK_JOURNAL_HEAD_SIZE)))
+			break;
+		if (crc != dpack_journal_crc(head,
+		                             &head[DPACK_JOURNAL_HEAD_SIZE],
+		                             size))
+			break;
+
+		if (replay) {
+			struct dpack_decoder_buffer dec;
+			int                         err;
+
+			dpack_decoder_init_buffer(&dec,
+			                          &head[DPACK_JOURNAL_HEAD_SIZE],
+			                          size);
+			err = replay(&dec.base, data);
+			dpack_decoder_fini(&dec.base);
+			if (err)
+				return err;
+		}
+
+		off += DPACK_JOURNAL_HEAD_SIZE + size;
+	}
+
+	if ((off < fsize) && !dpack_journal_is_torn(&map[off], fsize - off))
+		return -EBADMSG;
+
+	*valid = off;
+
+	return 0;
+}
+
+static __dpack_nonull(3) __warn_result
+int
+dpack_journal_recover(int                       fd,
+                      off_t                     fsize,
+                      off_t * __restrict        tail,
+                      dpack_journal_replay_fn * replay,
+                      void * __restrict         data)
+{
+	dpack_assert_intern(fd >= 0);
+	dpack_assert_intern(fsize > 0);
+	dpack_assert_intern(tail);
+
+	void * map;
+	size_t valid;
+	int    err;
+
+	if ((uint64_t)fsize > (uint64_t)SIZE_MAX)
+		return -EOVERFLOW;
+
+	map = mmap(NULL, (size_t)fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	madvise(map, (size_t)fsize, MADV_SEQUENTIAL);
+
+	err = dpack_journal_scan(map, (size_t)fsize, &valid, replay, data);
+
+	munmap(map, (size_t)fsize);
+
+	if (err)
+		return err;
+
+	if ((off_t)valid < fsize) {
+		/* Discard torn record left by an interrupted append. */
+		if (ftruncate(fd, (off_t)valid) || fdatasync(fd))
+			return -errno;
+	}
+
+	*tail = (off_t)valid;
+
+	return 0;
+}
+
+int
+dpack_journal_open_at(struct dpack_journal * __restrict journal,
+                      int                               dir,
+                      const char * __restrict           path,
+                      mode_t                            mode,
+                      dpack_journal_replay_fn *         replay,
+                      void * __restrict                 data)
+{
+	dpack_assert_api(journal);
+	dpack_assert_api((dir >= 0) || (dir == AT_FDCWD));
+	dpack_assert_api(upath_validate_path_name(path) > 0);
+
+	int         fd;
+	struct stat st;
+	off_t       tail = 0;
+	int         err;
+
+	pthread_once(&dpack_journal_once, dpack_journal_init);
+	if (dpack_journal_init_err)
+		return dpack_journal_init_err;
+
+	fd = ufile_new_at(dir, path, O_RDWR | O_CLOEXEC, mode);
+	if (fd < 0)
+		return fd;
+
+	err = ufile_fstat(fd, &st);
+	if (err)
+		goto close;
+
+	if (st.st_size) {
+		err = dpack_journal_recover(fd, st.st_size, &tail, replay, data);
+		if (err)
+			goto close;
+	}
+
+	err = pthread_mutex_init(&journal->lock, NULL);
+	if (err) {
+		err = -err;
+		goto close;
+	}
+
+	err = pthread_cond_init(&journal->cond, NULL);
+	if (err) {
+		err = -err;
+		goto destroy;
+	}
+
+	memset(journal->batch, 0, sizeof(journal->batch));
+	journal->curr = &journal->batch[0];
+	journal->queued = 0;
+	journal->synced = 0;
+	journal->tail = tail;
+	journal->syncing = false;
+	journal->err = 0;
+	journal->fd = fd;
+
+	return 0;
+
+destroy:
+	pthread_mutex_destroy(&journal->lock);
+
+close:
+	ufile_close(fd);
+
+	return err;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_journal_reserve(struct dpack_journal_batch * __restrict batch,
+                      size_t                                  size)
+{
+	dpack_assert_intern(batch);
+	dpack_assert_intern(batch->size <= batch->capa);
+	dpack_assert_intern(size);
+
+	if (size > (batch->capa - batch->size)) {
+		size_t    capa = stroll_max(2 * batch->capa,
+		                            batch->size + size);
+		uint8_t * area;
+
+		capa = stroll_max(capa, (size_t)DPACK_JOURNAL_BATCH_SIZE_MIN);
+		area = realloc(batch->data, capa);
+		if (!area)
+			return -ENOMEM;
+
+		batch->data = area;
+		batch->capa = capa;
+	}
+
+	return 0;
+}
+
+static __dpack_nonull(2) __warn_result
+int
+dpack_journal_commit(int                        fd,
+                     const uint8_t * __restrict data,
+                     size_t                     size,
+                     off_t                      off)
+{
+	dpack_assert_intern(fd >= 0);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+	dpack_assert_intern(off >= 0);
+
+	do {
+		ssize_t ret;
+
+		ret = pwrite(fd, data, size, off);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		else if (!ret)
+			return -EIO;
+
+		data += ret;
+		size -= (size_t)ret;
+		off += ret;
+	} while (size);
+
+	if (fdatasync(fd))
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Commit all records queued so far as a single group. Called with journal
+ * locked, the lock being released while writing to the file so that other
+ * appenders may queue records into the other batch meanwhile.
+ */
+static __dpack_nonull(1)
+void
+dpack_journal_lead(struct dpack_journal * __restrict journal)
+{
+	dpack_journal_assert_api(journal);
+	dpack_assert_intern(!journal->syncing);
+	dpack_assert_intern(!journal->err);
+	dpack_assert_intern(journal->curr->size);
+
+	struct dpack_journal_batch * batch = journal->curr;
+	uint64_t                     last = journal->queued;
+	off_t                        off = journal->tail;
+	int                          err;
+
+	journal->curr = (batch == &journal->batch[0]) ? &journal->batch[1] :
+	                                                &journal->batch[0];
+	dpack_assert_intern(!journal->curr->size);
+	journal->syncing = true;
+
+	pthread_mutex_unlock(&journal->lock);
+
+	err = dpack_journal_commit(journal->fd, batch->data, batch->size, off);
+
+	pthread_mutex_lock(&journal->lock);
+
+	if (!err) {
+		journal->synced = last;
+		journal->tail += (off_t)batch->size;
+	}
+	else
+		/* File content is unknown: refuse further appends. */
+		journal->err = err;
+
+	batch->size = 0;
+	journal->syncing = false;
+
+	pthread_cond_broadcast(&journal->cond);
+}
+
+int
+dpack_journal_append(struct dpack_journal * __restrict journal,
+                     dpack_journal_encode_fn *         encode,
+                     void * __restrict                 data)
+{
+	/* Journal state is checked once locked only. */
+	dpack_assert_api(journal);
+	dpack_assert_api(encode);
+
+	struct dpack_journal_scratch * scr;
+	size_t                         size;
+	struct dpack_journal_batch *   batch;
+	uint64_t                       seq;
+	int                            err;
+
+	/* Encode and frame record without holding the lock... */
+	err = dpack_journal_frame(encode, data, &scr, &size);
+	if (err)
+		return err;
+
+	pthread_mutex_lock(&journal->lock);
+
+	dpack_journal_assert_api(journal);
+
+	if (journal->err) {
+		err = journal->err;
+		goto unlock;
+	}
+
+	/* ...then just copy it into the current batch. */
+	batch = journal->curr;
+	err = dpack_journal_reserve(batch, size);
+	if (err)
+		goto unlock;
+
+	memcpy(&batch->data[batch->size], scr->data, size);
+	batch->size += size;
+	seq = ++journal->queued;
+
+	/*
+	 * Wait for the record to be made durable, becoming group commit leader
+	 * when no commit is in progress.
+	 */
+	while ((journal->synced < seq) && !journal->err) {
+		if (journal->syncing)
+			pthread_cond_wait(&journal->cond, &journal->lock);
+		else
+			dpack_journal_lead(journal);
+	}
+
+	err = (journal->synced >= seq) ? 0 : journal->err;
+
+unlock:
+	pthread_mutex_unlock(&journal->lock);
+
+	return err;
+}
+
+int
+dpack_journal_close(struct dpack_journal * __restrict journal)
+{
+	dpack_journal_assert_api(journal);
+	dpack_assert_api(!journal->syncing);
+
+	free(journal->batch[0].data);
+	free(journal->batch[1].data);
+
+	pthread_cond_destroy(&journal->cond);
+	pthread_mutex_destroy(&journal->lock);
+
+	return ufile_close(journal->fd);
+}
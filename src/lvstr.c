@@ -8,6 +8,8 @@
 #include "dpack/lvstr.h"
 #include "dpack/codec.h"
 #include "common.h"
+#include <stdlib.h>
+#include <string.h>
 
 size_t
 dpack_lvstr_size(size_t len)
@@ -160,3 +162,176 @@ dpack_decode_lvstr_range(struct dpack_decoder * __restrict decoder,
 
 	return len;
 }
+
+static __dpack_nonull(1, 3, 5) __warn_result
+ssize_t
+dpack_xtract_lvstr_sso(struct dpack_decoder * __restrict decoder,
+                       size_t                            length,
+                       char * __restrict                 buffer,
+                       size_t                            size,
+                       struct stroll_lvstr * __restrict  value)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(length);
+	dpack_assert_intern(length <= DPACK_LVSTRLEN_MAX);
+	dpack_assert_intern(buffer);
+	dpack_assert_intern(size);
+	dpack_assert_intern(value);
+
+	ssize_t ret;
+
+	if (length < size) {
+		/* Short string: fits into caller storage, no allocation. */
+		ret = dpack_xtract_strcpy(decoder, buffer, length);
+		if (ret > 0)
+			stroll_lvstr_nlend(value, buffer, length);
+	}
+	else {
+		char * cstr;
+
+		ret = dpack_xtract_strdup(decoder, &cstr, length);
+		if (ret > 0)
+			stroll_lvstr_ncede(value, cstr, length);
+	}
+
+	dpack_assert_intern(ret);
+	dpack_assert_intern((ret < 0) ||
+	                    ((size_t)ret == stroll_lvstr_len(value)));
+
+	return ret;
+}
+
+ssize_t
+dpack_decode_lvstr_sso(struct dpack_decoder * __restrict decoder,
+                       size_t                            size,
+                       char * __restrict                 buffer,
+                       struct stroll_lvstr * __restrict  value)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(size);
+	dpack_assert_api(buffer);
+	dpack_assert_api(value);
+
+	ssize_t len;
+
+	len = dpack_decode_str_tag(decoder, 1, DPACK_LVSTRLEN_MAX);
+	dpack_assert_intern(len);
+
+	return (len > 0) ? dpack_xtract_lvstr_sso(decoder,
+	                                          (size_t)len,
+	                                          buffer,
+	                                          size,
+	                                          value)
+	                 : len;
+}
+
+ssize_t
+dpack_decode_lvstr_sso_range(struct dpack_decoder * __restrict decoder,
+                             size_t                            min_len,
+                             size_t                            max_len,
+                             size_t                            size,
+                             char * __restrict                 buffer,
+                             struct stroll_lvstr * __restrict  value)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(min_len);
+	dpack_assert_api(min_len <= max_len);
+	dpack_assert_api(max_len <= DPACK_LVSTRLEN_MAX);
+	dpack_assert_api(size);
+	dpack_assert_api(buffer);
+	dpack_assert_api(value);
+
+	ssize_t len;
+
+	len = dpack_decode_str_tag(decoder, min_len, max_len);
+	dpack_assert_intern(len);
+
+	return (len > 0) ? dpack_xtract_lvstr_sso(decoder,
+	                                          (size_t)len,
+	                                          buffer,
+	                                          size,
+	                                          value)
+	                 : len;
+}
+
+ssize_t
+dpack_decode_lvstr_lend(struct dpack_decoder * __restrict  decoder,
+                        struct stroll_lvstr * __restrict   value,
+                        struct dpack_backing ** __restrict backing)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(value);
+	dpack_assert_api(backing);
+
+	ssize_t                len;
+	int                    err;
+	const uint8_t *        data;
+	struct dpack_backing * back;
+	char *                 cstr;
+
+	len = dpack_decode_str_tag(decoder, 1, DPACK_LVSTRLEN_MAX);
+	dpack_assert_intern(len);
+	if (len < 0)
+		return len;
+
+	err = dpack_decoder_borrow(decoder, (size_t)len, &data, &back);
+	if (err == -EAGAIN) {
+		/* Decoder cannot lend its backing storage: fallback to copy. */
+		len = dpack_xtract_strdup(decoder, &cstr, (size_t)len);
+		if (len > 0) {
+			stroll_lvstr_ncede(value, cstr, (size_t)len);
+			*backing = NULL;
+		}
+
+		return len;
+	}
+	else if (err)
+		return err;
+
+	dpack_assert_intern(data > back->data);
+	dpack_assert_intern(&data[len] <= &back->data[back->size]);
+
+	if (memchr(data, 0, (size_t)len)) {
+		/* msgpack strings must not contain NULL bytes. */
+		err = -EBADMSG;
+		goto put;
+	}
+
+	if (dpack_decoder_data_left(decoder) &&
+	    (&data[len] < &back->data[back->size]) &&
+	    !data[len]) {
+		/*
+		 * Encoded string happens to be followed by a NULL byte which
+		 * still belongs to data left to decode and lies within the
+		 * same backing storage: lend it as is without modifying
+		 * backing content, which may be shared with other borrowers.
+		 * Checking data left first prevents from reading past the
+		 * decoder logical end, e.g. beyond the end of a file mapping.
+		 */
+		stroll_lvstr_nlend(value, (const char *)data, (size_t)len);
+		*backing = back;
+
+		return len;
+	}
+
+	/* String is not NULL terminated in place: fallback to copy. */
+	cstr = malloc((size_t)len + 1);
+	if (!cstr) {
+		err = -errno;
+		goto put;
+	}
+
+	memcpy(cstr, data, (size_t)len);
+	cstr[len] = '\0';
+	dpack_backing_put(back);
+
+	stroll_lvstr_ncede(value, cstr, (size_t)len);
+	*backing = NULL;
+
+	return len;
+
+put:
+	dpack_backing_put(back);
+
+	return err;
+}
@@ -7,6 +7,7 @@
 
 #include "dpack/map.h"
 #include "common.h"
+#include <string.h>
 
 size_t
 dpack_map_size(unsigned int fld_nr, size_t data_size)
@@ -107,6 +108,52 @@ dpack_map_begin_encode(struct dpack_encoder * __restrict encoder,
 	return err;
 }
 
+int
+dpack_map_begin_encode_open(struct dpack_encoder * __restrict      encoder,
+                            unsigned int                           max_nr,
+                            struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(max_nr <= DPACK_MAP_FLDNR_MAX);
+	dpack_assert_api(mark);
+
+	return dpack_begin_open_encode(encoder,
+	                               _DPACK_FIXMAP_TAG,
+	                               DPACK_MAP16_TAG,
+	                               max_nr,
+	                               mark);
+}
+
+int
+dpack_map_end_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark,
+	unsigned int                                 nr,
+	bool                                         compact)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(mark);
+	dpack_assert_api(nr <= DPACK_MAP_FLDNR_MAX);
+
+	return dpack_end_open_encode(encoder,
+	                             mark,
+	                             _DPACK_FIXMAP_TAG,
+	                             DPACK_MAP16_TAG,
+	                             nr,
+	                             compact);
+}
+
+int
+dpack_map_cancel_encode_open(
+	struct dpack_encoder * __restrict            encoder,
+	const struct dpack_encoder_mark * __restrict mark)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(mark);
+
+	return dpack_cancel_open_encode(encoder, mark);
+}
+
 /******************************************************************************
  * Map boolean encoding
  ******************************************************************************/
@@ -338,6 +385,29 @@ dpack_map_encode_nil(struct dpack_encoder * __restrict encoder,
 	return dpack_encode_nil(encoder);
 }
 
+/******************************************************************************
+ * Map raw encoding
+ ******************************************************************************/
+
+int
+dpack_map_encode_raw(struct dpack_encoder * __restrict encoder,
+                     unsigned int                      id,
+                     const uint8_t * __restrict        data,
+                     size_t                            size)
+{
+	dpack_encoder_assert_api(encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	int err;
+
+	err = dpack_map_encode_fldid(encoder, id);
+	if (err)
+		return err;
+
+	return dpack_encode_raw(encoder, data, size);
+}
+
 /******************************************************************************
  * Nested collections encoding
  ******************************************************************************/
@@ -400,27 +470,37 @@ dpack_load_map_tag(struct dpack_decoder * __restrict decoder,
 	int     err;
 
 	err = dpack_read_tag(decoder, &tag);
-	if (!err) {
-		switch (tag) {
-		case DPACK_FIXMAP_TAG:
-			dpack_fixcnt(tag, _DPACK_FIXMAP_FLDNR_MAX, nr);
-			return 0;
+	if (err)
+		return err;
+
+	switch (tag) {
+	case DPACK_FIXMAP_TAG:
+		dpack_fixcnt(tag, _DPACK_FIXMAP_FLDNR_MAX, nr);
+		break;
 #if DPACK_MAP_FLDNR_MAX > _DPACK_FIXMAP_FLDNR_MAX
-		case DPACK_MAP16_TAG:
-			return dpack_read_cnt16(decoder, nr);
+	case DPACK_MAP16_TAG:
+		err = dpack_read_cnt16(decoder, nr);
+		break;
 #endif
 #if DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX
-		case DPACK_MAP32_TAG:
-			return dpack_read_cnt32(decoder, nr);
+	case DPACK_MAP32_TAG:
+		err = dpack_read_cnt32(decoder, nr);
+		break;
 #endif
-		default:
-			err = dpack_maybe_discard(decoder, tag);
-			if (!err)
-				err = -ENOMSG;
-		}
+	default:
+		err = dpack_maybe_discard(decoder, tag);
+		return (!err) ? -ENOMSG : err;
 	}
 
-	return err;
+	if (err)
+		return err;
+
+	/*
+	 * Enforce the runtime limit the decoder may have been restricted to.
+	 * Do not attempt to discard content since the whole point is to prevent
+	 * from processing oversized input.
+	 */
+	return (*nr <= decoder->fld_max) ? 0 : -EMSGSIZE;
 }
 
 static __dpack_nonull(1, 2) __warn_result
@@ -612,3 +692,569 @@ dpack_map_decode_range(struct dpack_decoder * __restrict decoder,
 
 	return dpack_map_xtract_range(decoder, min_nr, max_nr, decode, data);
 }
+
+#if defined(CONFIG_DPACK_ARRAY)
+
+/******************************************************************************
+ * Columnar decoding of arrays of maps
+ ******************************************************************************/
+
+static __dpack_const __dpack_nothrow __warn_result
+size_t
+dpack_column_value_size(enum dpack_column_type type)
+{
+	switch (type) {
+	case DPACK_COLUMN_BOOL:
+		return sizeof(bool);
+	case DPACK_COLUMN_INT8:
+	case DPACK_COLUMN_UINT8:
+		return sizeof(uint8_t);
+	case DPACK_COLUMN_INT16:
+	case DPACK_COLUMN_UINT16:
+		return sizeof(uint16_t);
+	case DPACK_COLUMN_INT32:
+	case DPACK_COLUMN_UINT32:
+		return sizeof(uint32_t);
+	case DPACK_COLUMN_INT64:
+	case DPACK_COLUMN_UINT64:
+		return sizeof(uint64_t);
+#if defined(CONFIG_DPACK_FLOAT)
+	case DPACK_COLUMN_FLOAT:
+		return sizeof(float);
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+#if defined(CONFIG_DPACK_DOUBLE)
+	case DPACK_COLUMN_DOUBLE:
+		return sizeof(double);
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+	default:
+		dpack_assert_api(0);
+	}
+
+	unreachable();
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_column_decode_value(struct dpack_decoder * __restrict      decoder,
+                          const struct dpack_column * __restrict column,
+                          unsigned int                           row)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(column);
+
+	switch (column->type) {
+	case DPACK_COLUMN_BOOL:
+		return dpack_decode_bool(decoder,
+		                         &((bool *)column->values)[row]);
+	case DPACK_COLUMN_INT8:
+		return dpack_decode_int8(decoder,
+		                         &((int8_t *)column->values)[row]);
+	case DPACK_COLUMN_UINT8:
+		return dpack_decode_uint8(decoder,
+		                          &((uint8_t *)column->values)[row]);
+	case DPACK_COLUMN_INT16:
+		return dpack_decode_int16(decoder,
+		                          &((int16_t *)column->values)[row]);
+	case DPACK_COLUMN_UINT16:
+		return dpack_decode_uint16(decoder,
+		                           &((uint16_t *)column->values)[row]);
+	case DPACK_COLUMN_INT32:
+		return dpack_decode_int32(decoder,
+		                          &((int32_t *)column->values)[row]);
+	case DPACK_COLUMN_UINT32:
+		return dpack_decode_uint32(decoder,
+		                           &((uint32_t *)column->values)[row]);
+	case DPACK_COLUMN_INT64:
+		return dpack_decode_int64(decoder,
+		                          &((int64_t *)column->values)[row]);
+	case DPACK_COLUMN_UINT64:
+		return dpack_decode_uint64(decoder,
+		                           &((uint64_t *)column->values)[row]);
+#if defined(CONFIG_DPACK_FLOAT)
+	case DPACK_COLUMN_FLOAT:
+		return dpack_decode_float(decoder,
+		                          &((float *)column->values)[row]);
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+#if defined(CONFIG_DPACK_DOUBLE)
+	case DPACK_COLUMN_DOUBLE:
+		return dpack_decode_double(decoder,
+		                           &((double *)column->values)[row]);
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+	default:
+		dpack_assert_intern(0);
+	}
+
+	unreachable();
+}
+
+/*
+ * Find column matching the given field identifier, trying the column following
+ * the previously matched one first since maps usually encode fields in a
+ * consistent order.
+ */
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+int
+dpack_column_lookup(const struct dpack_column * __restrict columns,
+                    unsigned int                           col_nr,
+                    unsigned int                           hint,
+                    unsigned int                           fid)
+{
+	dpack_assert_intern(columns);
+	dpack_assert_intern(col_nr);
+	dpack_assert_intern(hint < col_nr);
+
+	unsigned int c;
+
+	if (columns[hint].fid == fid)
+		return (int)hint;
+
+	for (c = 0; c < col_nr; c++) {
+		if (columns[c].fid == fid)
+			return (int)c;
+	}
+
+	return -ENOENT;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_map_decode_row(struct dpack_decoder * __restrict      decoder,
+                     const struct dpack_column * __restrict columns,
+                     unsigned int                           col_nr,
+                     unsigned int                           row)
+{
+	dpack_decoder_assert_intern(decoder);
+	dpack_assert_intern(columns);
+	dpack_assert_intern(col_nr);
+
+	unsigned int nr;
+	unsigned int hint = 0;
+	int          err;
+
+	err = dpack_load_map_tag(decoder, &nr);
+	if (err)
+		return err;
+	if (!nr)
+		return -EBADMSG;
+
+	nr *= 2;
+	do {
+		unsigned int fid;
+		int          col;
+
+		err = dpack_map_decode_fldid(decoder, &fid);
+		nr--;
+		if (err)
+			goto discard;
+
+		col = dpack_column_lookup(columns, col_nr, hint, fid);
+		if (col >= 0) {
+			err = dpack_column_decode_value(decoder,
+			                                &columns[col],
+			                                row);
+			nr--;
+			if (err)
+				goto discard;
+
+			columns[col].present[row / 64] |=
+				UINT64_C(1) << (row % 64);
+			hint = ((unsigned int)col + 1) % col_nr;
+		}
+		else {
+			/* Skip fields the caller is not interested into. */
+			err = dpack_decoder_discard(decoder);
+			nr--;
+			if (err)
+				goto discard;
+		}
+	} while (nr);
+
+	return 0;
+
+discard:
+	if (nr) {
+		int ret;
+
+		ret = dpack_maybe_discard_items(decoder,
+		                                nr,
+		                                2 * DPACK_MAP_FLDNR_MAX);
+		if (ret)
+			err = ret;
+	}
+
+	return err;
+}
+
+int
+dpack_map_decode_columns(struct dpack_decoder * __restrict decoder,
+                         struct dpack_column * __restrict  columns,
+                         unsigned int                      col_nr,
+                         unsigned int                      row_max,
+                         unsigned int * __restrict         row_nr)
+{
+	dpack_decoder_assert_api(decoder);
+	dpack_assert_api(columns);
+	dpack_assert_api(col_nr);
+	dpack_assert_api(row_max);
+	dpack_assert_api(row_max <= DPACK_ARRAY_ELMNR_MAX);
+	dpack_assert_api(row_nr);
+
+	unsigned int c;
+	unsigned int nr;
+	unsigned int r;
+	int          err;
+
+	for (c = 0; c < col_nr; c++) {
+		dpack_assert_api(columns[c].values);
+		dpack_assert_api(columns[c].present);
+
+		memset(columns[c].values,
+		       0,
+		       (size_t)row_max * dpack_column_value_size(columns[c].type));
+		memset(columns[c].present,
+		       0,
+		       DPACK_COLUMN_PRESENT_NR(row_max) *
+		       sizeof(columns[c].present[0]));
+	}
+
+	err = dpack_array_decode_count_max(decoder, row_max, &nr);
+	if (err)
+		return err;
+
+	for (r = 0; r < nr; r++) {
+		err = dpack_map_decode_row(decoder, columns, col_nr, r);
+		if (err)
+			goto discard;
+	}
+
+	*row_nr = nr;
+
+	return 0;
+
+discard:
+	/* Skip rows left so that decoder stands past the whole array. */
+	if (++r < nr) {
+		int ret;
+
+		ret = dpack_maybe_discard_items(decoder,
+		                                nr - r,
+		                                DPACK_ARRAY_ELMNR_MAX);
+		if (ret)
+			err = ret;
+	}
+
+	return err;
+}
+
+#endif /* defined(CONFIG_DPACK_ARRAY) */
+
+/******************************************************************************
+ * In-place map editing
+ ******************************************************************************/
+
+#if defined(CONFIG_DPACK_CODEC_BUFFER)
+
+/*
+ * Locate field identified by id and return offsets of its identifier, its value
+ * and its end within editor buffer. When not found, all offsets point to the
+ * end of the map.
+ */
+static __dpack_nonull(1, 3, 4, 5) __warn_result
+int
+dpack_map_editor_find(const struct dpack_map_editor * __restrict editor,
+                      unsigned int                               id,
+                      size_t * __restrict                        fld,
+                      size_t * __restrict                        val,
+                      size_t * __restrict                        end)
+{
+	dpack_map_editor_assert_api(editor);
+	dpack_assert_intern(fld);
+	dpack_assert_intern(val);
+	dpack_assert_intern(end);
+
+	struct dpack_decoder_buffer dec;
+	unsigned int                f;
+	int                         err = -ENOENT;
+
+	dpack_decoder_init_discard_buffer(&dec,
+	                                  &editor->buff[editor->head],
+	                                  editor->size - editor->head);
+
+	for (f = 0; f < editor->nr; f++) {
+		unsigned int fid;
+
+		*fld = editor->size - dpack_decoder_data_left(&dec.base);
+		err = dpack_map_decode_fldid(&dec.base, &fid);
+		if (err)
+			goto fini;
+
+		*val = editor->size - dpack_decoder_data_left(&dec.base);
+		err = dpack_decoder_discard(&dec.base);
+		if (err)
+			goto fini;
+
+		*end = editor->size - dpack_decoder_data_left(&dec.base);
+		if (fid == id)
+			goto fini;
+	}
+
+	*fld = *val = *end = editor->size - dpack_decoder_data_left(&dec.base);
+	err = -ENOENT;
+
+fini:
+	dpack_decoder_fini(&dec.base);
+
+	return err;
+}
+
+/*
+ * Replace the old bytes located at offset off with size bytes of data, moving
+ * the remaining tail of editor buffer at most once.
+ */
+static __dpack_nonull(1, 4) __dpack_nothrow
+void
+dpack_map_editor_splice(struct dpack_map_editor * __restrict editor,
+                        size_t                               off,
+                        size_t                               old,
+                        const uint8_t * __restrict           data,
+                        size_t                               size)
+{
+	dpack_map_editor_assert_api(editor);
+	dpack_assert_intern((off + old) <= editor->size);
+	dpack_assert_intern((editor->size - old + size) <= editor->capa);
+
+	if (size != old) {
+		memmove(&editor->buff[off + size],
+		        &editor->buff[off + old],
+		        editor->size - off - old);
+		editor->size = editor->size - old + size;
+	}
+
+	memcpy(&editor->buff[off], data, size);
+}
+
+/*
+ * Encode a map header holding nr fields into head. Keep width of the current
+ * header whenever possible so that the tail of the buffer is not moved.
+ */
+static __dpack_nonull(1, 3) __dpack_nothrow __warn_result
+size_t
+dpack_map_editor_head(const struct dpack_map_editor * __restrict editor,
+                      unsigned int                               nr,
+                      uint8_t * __restrict                       head)
+{
+	dpack_map_editor_assert_api(editor);
+	dpack_assert_intern(nr <= DPACK_MAP_FLDNR_MAX);
+	dpack_assert_intern(head);
+
+	size_t size = DPACK_FIXMAP_TAG_SIZE;
+
+#if DPACK_MAP_FLDNR_MAX > _DPACK_FIXMAP_FLDNR_MAX
+	if (nr > _DPACK_FIXMAP_FLDNR_MAX)
+		size = DPACK_MAP16_TAG_SIZE;
+#endif
+#if DPACK_MAP_FLDNR_MAX > _DPACK_MAP16_FLDNR_MAX
+	if (nr > _DPACK_MAP16_FLDNR_MAX)
+		size = DPACK_MAP32_TAG_SIZE;
+#endif
+	if (size < editor->head)
+		size = editor->head;
+
+	switch (size) {
+	case DPACK_FIXMAP_TAG_SIZE:
+		head[0] = (uint8_t)(_DPACK_FIXMAP_TAG | nr);
+		break;
+
+	case DPACK_MAP16_TAG_SIZE:
+		{
+			uint16_t val = htobe16((uint16_t)nr);
+
+			head[0] = DPACK_MAP16_TAG;
+			memcpy(&head[1], &val, sizeof(val));
+		}
+		break;
+
+	case DPACK_MAP32_TAG_SIZE:
+		{
+			uint32_t val = htobe32((uint32_t)nr);
+
+			head[0] = DPACK_MAP32_TAG;
+			memcpy(&head[1], &val, sizeof(val));
+		}
+		break;
+
+	default:
+		dpack_assert_intern(0);
+	}
+
+	return size;
+}
+
+/* Update header to reflect the new number of fields. */
+static __dpack_nonull(1) __dpack_nothrow
+void
+dpack_map_editor_recount(struct dpack_map_editor * __restrict editor,
+                         unsigned int                         nr)
+{
+	dpack_map_editor_assert_api(editor);
+
+	uint8_t head[DPACK_MAP32_TAG_SIZE];
+	size_t  size;
+
+	size = dpack_map_editor_head(editor, nr, head);
+	dpack_map_editor_splice(editor, 0, editor->head, head, size);
+	editor->head = size;
+	editor->nr = nr;
+}
+
+int
+dpack_map_editor_init(struct dpack_map_editor * __restrict editor,
+                      uint8_t * __restrict                 buffer,
+                      size_t                               size,
+                      size_t                               capa)
+{
+	dpack_assert_api(editor);
+	dpack_assert_api(buffer);
+	dpack_assert_api(size);
+	dpack_assert_api(size <= capa);
+
+	struct dpack_decoder_buffer dec;
+	int                         err;
+
+	dpack_decoder_init_discard_buffer(&dec, buffer, size);
+	err = dpack_load_map_tag(&dec.base, &editor->nr);
+	if (!err) {
+		editor->buff = buffer;
+		editor->size = size;
+		editor->capa = capa;
+		editor->head = size - dpack_decoder_data_left(&dec.base);
+	}
+	dpack_decoder_fini(&dec.base);
+
+	return err;
+}
+
+int
+dpack_map_edit_update(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id,
+                      const uint8_t * __restrict           value,
+                      size_t                               size)
+{
+	dpack_map_editor_assert_api(editor);
+	dpack_assert_api(value);
+	dpack_assert_api(size);
+	dpack_encode_raw_check(value, size);
+
+	size_t fld;
+	size_t val;
+	size_t end;
+	int    err;
+
+	err = dpack_map_editor_find(editor, id, &fld, &val, &end);
+	if (err)
+		return err;
+
+	if (size > (end - val)) {
+		if ((size - (end - val)) > (editor->capa - editor->size))
+			return -EMSGSIZE;
+	}
+
+	dpack_map_editor_splice(editor, val, end - val, value, size);
+
+	return 0;
+}
+
+int
+dpack_map_edit_insert(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id,
+                      const uint8_t * __restrict           value,
+                      size_t                               size)
+{
+	dpack_map_editor_assert_api(editor);
+	dpack_assert_api(value);
+	dpack_assert_api(size);
+	dpack_encode_raw_check(value, size);
+
+	uint8_t                     head[DPACK_MAP32_TAG_SIZE];
+	uint8_t                     fid[DPACK_MAP_FLDID_SIZE_MAX];
+	struct dpack_encoder_buffer enc;
+	size_t                      fsz;
+	size_t                      hsz;
+	size_t                      grow;
+	size_t                      fld;
+	size_t                      val;
+	size_t                      end;
+	int                         err;
+
+	err = dpack_map_editor_find(editor, id, &fld, &val, &end);
+	if (!err)
+		return -EEXIST;
+	if (err != -ENOENT)
+		return err;
+
+	if (editor->nr == DPACK_MAP_FLDNR_MAX)
+		return -EMSGSIZE;
+
+	dpack_encoder_init_buffer(&enc, fid, sizeof(fid));
+	err = dpack_map_encode_fldid(&enc.base, id);
+	dpack_assert_intern(!err);
+	fsz = dpack_encoder_space_used(&enc.base);
+	dpack_encoder_fini(&enc.base);
+
+	/* Check for room before modifying anything. */
+	hsz = dpack_map_editor_head(editor, editor->nr + 1, head);
+	if ((hsz - editor->head + fsz + size) > (editor->capa - editor->size))
+		return -EMSGSIZE;
+
+	/*
+	 * Header only grows when crossing a header size boundary. Shift data
+	 * following insertion point once to make room for header growth,
+	 * identifier and value altogether. Fields preceding insertion point are
+	 * moved by header growth only.
+	 */
+	grow = hsz - editor->head;
+	if (end != editor->size)
+		memmove(&editor->buff[end + grow + fsz + size],
+		        &editor->buff[end],
+		        editor->size - end);
+	if (grow)
+		memmove(&editor->buff[hsz],
+		        &editor->buff[editor->head],
+		        end - editor->head);
+	memcpy(editor->buff, head, hsz);
+	memcpy(&editor->buff[end + grow], fid, fsz);
+	memcpy(&editor->buff[end + grow + fsz], value, size);
+	editor->size += grow + fsz + size;
+	editor->head = hsz;
+	editor->nr++;
+
+	return 0;
+}
+
+int
+dpack_map_edit_delete(struct dpack_map_editor * __restrict editor,
+                      unsigned int                         id)
+{
+	dpack_map_editor_assert_api(editor);
+
+	size_t fld;
+	size_t val;
+	size_t end;
+	int    err;
+
+	err = dpack_map_editor_find(editor, id, &fld, &val, &end);
+	if (err)
+		return err;
+
+	memmove(&editor->buff[fld],
+	        &editor->buff[end],
+	        editor->size - end);
+	editor->size -= end - fld;
+
+	/* Header width is preserved: field count update is done in place. */
+	dpack_map_editor_recount(editor, editor->nr - 1);
+
+	return 0;
+}
+
+#endif /* defined(CONFIG_DPACK_CODEC_BUFFER) */
@@ -0,0 +1,256 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/memfd.h"
+#include "common.h"
+#include <stroll/page.h>
+#include <utils/file.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+
+#define dpack_encoder_assert_memfd_api(_enc) \
+	dpack_assert_api(_enc); \
+	dpack_assert_api((_enc)->capa); \
+	dpack_assert_api(stroll_aligned((_enc)->capa, stroll_page_size())); \
+	dpack_assert_api((_enc)->tail <= (_enc)->capa); \
+	dpack_assert_api((_enc)->map); \
+	dpack_assert_api((_enc)->map != MAP_FAILED); \
+	dpack_assert_api((_enc)->fd >= 0)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_memfd_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+
+	/* Memory file grows on demand. */
+	return (size_t)OFF_MAX -
+	       ((const struct dpack_encoder_memfd *)encoder)->tail;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_memfd_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+
+	return ((const struct dpack_encoder_memfd *)encoder)->tail;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_encoder_memfd_grow(struct dpack_encoder_memfd * __restrict encoder,
+                         size_t                                  size)
+{
+	dpack_encoder_assert_memfd_api(encoder);
+	dpack_assert_intern(size > encoder->capa);
+
+	size_t capa = stroll_max(2 * encoder->capa,
+	                         stroll_align_upper(size, stroll_page_size()));
+	void * map;
+
+	if (capa > (size_t)OFF_MAX)
+		return -EMSGSIZE;
+
+	if (ftruncate(encoder->fd, (off_t)capa))
+		return -errno;
+
+	map = mremap(encoder->map, encoder->capa, capa, MREMAP_MAYMOVE);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	encoder->map = map;
+	encoder->capa = capa;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __dpack_nothrow __warn_result
+int
+dpack_encoder_memfd_write(struct dpack_encoder * __restrict encoder,
+                          const uint8_t * __restrict        data,
+                          size_t                            size)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_memfd * enc = (struct dpack_encoder_memfd *)
+	                                   encoder;
+	size_t                       tail;
+
+	if (__builtin_add_overflow(enc->tail, size, &tail))
+		return -EMSGSIZE;
+
+	if (tail > enc->capa) {
+		int err;
+
+		err = dpack_encoder_memfd_grow(enc, tail);
+		if (err)
+			return err;
+	}
+
+	memcpy(&enc->map[enc->tail], data, size);
+	enc->tail = tail;
+
+	return 0;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_memfd_fini(struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+
+	struct dpack_encoder_memfd * enc = (struct dpack_encoder_memfd *)
+	                                   encoder;
+
+	munmap(enc->map, enc->capa);
+	enc->map = NULL;
+
+	return close(enc->fd) ? -errno : 0;
+}
+
+static __dpack_nonull(1, 3) __dpack_nothrow __warn_result
+int
+dpack_encoder_memfd_patch(struct dpack_encoder * __restrict encoder,
+                          size_t                            offset,
+                          const uint8_t * __restrict        data,
+                          size_t                            size)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_memfd * enc = (struct dpack_encoder_memfd *)
+	                                   encoder;
+	size_t                       end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->tail)) {
+		memcpy(&enc->map[offset], data, size);
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+static __dpack_nonull(1) __dpack_nothrow __warn_result
+int
+dpack_encoder_memfd_cut(struct dpack_encoder * __restrict encoder,
+                        size_t                            offset,
+                        size_t                            size)
+{
+	dpack_encoder_assert_memfd_api((const struct dpack_encoder_memfd *)
+	                               encoder);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_memfd * enc = (struct dpack_encoder_memfd *)
+	                                   encoder;
+	size_t                       end;
+
+	if (!__builtin_add_overflow(offset, size, &end) && (end <= enc->tail)) {
+		memmove(&enc->map[offset], &enc->map[end], enc->tail - end);
+		enc->tail -= size;
+		return 0;
+	}
+
+	return -ERANGE;
+}
+
+static const struct dpack_encoder_ops dpack_encoder_memfd_ops = {
+	.left  = dpack_encoder_memfd_left,
+	.used  = dpack_encoder_memfd_used,
+	.write = dpack_encoder_memfd_write,
+	.fini  = dpack_encoder_memfd_fini,
+	.patch = dpack_encoder_memfd_patch,
+	.cut   = dpack_encoder_memfd_cut
+};
+
+int
+dpack_encoder_init_memfd(struct dpack_encoder_memfd * __restrict encoder,
+                         const char * __restrict                 name,
+                         size_t                                  size)
+{
+	dpack_assert_api(encoder);
+	dpack_assert_api(name);
+	dpack_assert_api(*name);
+
+	size_t capa;
+	int    fd;
+	void * map;
+	int    err;
+
+	capa = stroll_align_upper(stroll_max(size, (size_t)1),
+	                          stroll_page_size());
+	if (capa > (size_t)OFF_MAX)
+		return -EMSGSIZE;
+
+	fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return -errno;
+
+	if (ftruncate(fd, (off_t)capa)) {
+		err = -errno;
+		goto close;
+	}
+
+	map = mmap(NULL, capa, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		goto close;
+	}
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_memfd_ops);
+	encoder->tail = 0;
+	encoder->capa = capa;
+	encoder->map = map;
+	encoder->fd = fd;
+
+	return 0;
+
+close:
+	close(fd);
+
+	return err;
+}
+
+int
+dpack_encoder_seal_memfd(struct dpack_encoder_memfd * __restrict encoder)
+{
+	dpack_encoder_assert_memfd_api(encoder);
+
+	int fd = encoder->fd;
+	int err;
+
+	/* Writable shared mappings would prevent from sealing against writes. */
+	munmap(encoder->map, encoder->capa);
+	encoder->map = NULL;
+
+	if (!encoder->tail) {
+		err = -ENODATA;
+		goto close;
+	}
+
+	if (ftruncate(fd, (off_t)encoder->tail) ||
+	    fcntl(fd, F_ADD_SEALS, DPACK_MEMFD_SEALS | F_SEAL_SEAL)) {
+		err = -errno;
+		goto close;
+	}
+
+	return fd;
+
+close:
+	close(fd);
+
+	return err;
+}
@@ -0,0 +1,298 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/mpbuffer.h"
+#include "common.h"
+#include <string.h>
+
+/*
+ * Record header. Producers reserve spans made of a header followed by message
+ * content. State is zero until the producer is done with its span, then holds
+ * the size of message content along with the DPACK_MPBUFFER_DONE flag.
+ *
+ * A zero size marks padding reserved up to the end of buffer by a producer
+ * which span would not fit contiguously: the flusher skips it and wraps
+ * around to the start of buffer.
+ */
+struct dpack_mpbuffer_head {
+	uint32_t size;
+	uint32_t state;
+};
+
+#define DPACK_MPBUFFER_DONE (1U << 31)
+
+/*
+ * Check fields producers may safely access, i.e. all but the flusher owned
+ * head offset.
+ */
+#define dpack_mpbuffer_assert_shared_api(_mpbuff) \
+	dpack_assert_api(_mpbuff); \
+	dpack_assert_api((_mpbuff)->buff); \
+	dpack_assert_api(!((uintptr_t)(_mpbuff)->buff % \
+	                   DPACK_MPBUFFER_HEAD_SIZE)); \
+	dpack_assert_api((_mpbuff)->capa > DPACK_MPBUFFER_HEAD_SIZE); \
+	dpack_assert_api(!((_mpbuff)->capa % DPACK_MPBUFFER_HEAD_SIZE))
+
+/* Check all fields. May only be used from flusher context. */
+#define dpack_mpbuffer_assert_api(_mpbuff) \
+	dpack_mpbuffer_assert_shared_api(_mpbuff); \
+	dpack_assert_api((_mpbuff)->head < (2 * (_mpbuff)->capa)); \
+	dpack_assert_api(!((_mpbuff)->head % DPACK_MPBUFFER_HEAD_SIZE))
+
+/*
+ * Head and tail are positions running modulo twice the buffer capacity so that
+ * a full buffer may be told apart from an empty one. Offset of a position
+ * within buffer is given by the position modulo buffer capacity.
+ */
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_mpbuffer_advance(const struct dpack_mpbuffer * __restrict mpbuffer,
+                       size_t                                   pos,
+                       size_t                                   size)
+{
+	dpack_mpbuffer_assert_shared_api(mpbuffer);
+	dpack_assert_intern(pos < (2 * mpbuffer->capa));
+	dpack_assert_intern(size <= mpbuffer->capa);
+
+	pos += size;
+
+	return (pos < (2 * mpbuffer->capa)) ? pos : pos - (2 * mpbuffer->capa);
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_mpbuffer_used(const struct dpack_mpbuffer * __restrict mpbuffer,
+                    size_t                                   head,
+                    size_t                                   tail)
+{
+	dpack_mpbuffer_assert_shared_api(mpbuffer);
+	dpack_assert_intern(head < (2 * mpbuffer->capa));
+	dpack_assert_intern(tail < (2 * mpbuffer->capa));
+
+	return (tail >= head) ? tail - head
+	                      : (2 * mpbuffer->capa) - head + tail;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+struct dpack_mpbuffer_head *
+dpack_mpbuffer_head(const struct dpack_mpbuffer * __restrict mpbuffer,
+                    size_t                                   offset)
+{
+	dpack_mpbuffer_assert_shared_api(mpbuffer);
+	dpack_assert_intern(!(offset % DPACK_MPBUFFER_HEAD_SIZE));
+	dpack_assert_intern(offset < mpbuffer->capa);
+
+	return (struct dpack_mpbuffer_head *)(void *)&mpbuffer->buff[offset];
+}
+
+static __dpack_const __dpack_nothrow __warn_result
+size_t
+dpack_mpbuffer_span(size_t size)
+{
+	return sizeof(struct dpack_mpbuffer_head) +
+	       stroll_align_upper(size, (size_t)DPACK_MPBUFFER_HEAD_SIZE);
+}
+
+void
+dpack_mpbuffer_init(struct dpack_mpbuffer * __restrict mpbuffer,
+                    uint8_t * __restrict               buffer,
+                    size_t                             size)
+{
+	dpack_assert_api(mpbuffer);
+	dpack_assert_api(buffer);
+	dpack_assert_api(!((uintptr_t)buffer % DPACK_MPBUFFER_HEAD_SIZE));
+	dpack_assert_api(size > DPACK_MPBUFFER_HEAD_SIZE);
+	dpack_assert_api(!(size % DPACK_MPBUFFER_HEAD_SIZE));
+	dpack_assert_api(size <= (SIZE_MAX / 4));
+
+	/* Unreserved space must always be zeroed, see dpack_mpbuffer_drain(). */
+	memset(buffer, 0, size);
+
+	mpbuffer->buff = buffer;
+	mpbuffer->capa = size;
+	mpbuffer->tail = 0;
+	mpbuffer->head = 0;
+}
+
+int
+dpack_encoder_init_mpbuffer(struct dpack_encoder_mpbuffer * __restrict encoder,
+                            struct dpack_mpbuffer * __restrict         mpbuffer,
+                            size_t                                     size)
+{
+	dpack_assert_api(encoder);
+	dpack_mpbuffer_assert_shared_api(mpbuffer);
+	dpack_assert_api(size);
+
+	size_t                       span;
+	size_t                       tail;
+	size_t                       off;
+	struct dpack_mpbuffer_head * head;
+
+	if ((size >= DPACK_MPBUFFER_DONE) ||
+	    (dpack_mpbuffer_span(size) > mpbuffer->capa))
+		return -EMSGSIZE;
+
+	span = dpack_mpbuffer_span(size);
+	tail = __atomic_load_n(&mpbuffer->tail, __ATOMIC_RELAXED);
+	while (true) {
+		size_t left;
+		size_t need;
+
+		/*
+		 * When span does not fit contiguously before the end of buffer,
+		 * reserve padding up to it first, then retry from the start of
+		 * buffer.
+		 * Acquire ordering of head load pairs with the release ordering
+		 * of the flusher reclaiming drained space so that zeroed
+		 * headers are visible.
+		 */
+		off = tail % mpbuffer->capa;
+		left = mpbuffer->capa - off;
+		need = (span <= left) ? span : left;
+		if ((dpack_mpbuffer_used(mpbuffer,
+		                         __atomic_load_n(&mpbuffer->head,
+		                                         __ATOMIC_ACQUIRE),
+		                         tail) + need) > mpbuffer->capa)
+			return -ENOSPC;
+
+		if (!__atomic_compare_exchange_n(
+			&mpbuffer->tail,
+			&tail,
+			dpack_mpbuffer_advance(mpbuffer, tail, need),
+			true,
+			__ATOMIC_RELAXED,
+			__ATOMIC_RELAXED))
+			continue;
+
+		if (need == span)
+			break;
+
+		/* Publish padding to flusher. */
+		head = dpack_mpbuffer_head(mpbuffer, off);
+		dpack_assert_intern(!head->state);
+		head->size = 0;
+		__atomic_store_n(&head->state,
+		                 DPACK_MPBUFFER_DONE,
+		                 __ATOMIC_RELEASE);
+
+		tail = dpack_mpbuffer_advance(mpbuffer, tail, need);
+	}
+
+	head = dpack_mpbuffer_head(mpbuffer, off);
+	dpack_assert_intern(!head->state);
+	head->size = (uint32_t)size;
+
+	dpack_encoder_init_buffer(&encoder->buff, (uint8_t *)&head[1], size);
+	encoder->mpbuffer = mpbuffer;
+	encoder->head = off;
+
+	return 0;
+}
+
+static __dpack_nonull(1) __dpack_nothrow
+void
+dpack_encoder_release_mpbuffer(struct dpack_encoder_mpbuffer * __restrict encoder,
+                               uint32_t                                   size)
+{
+	dpack_assert_intern(encoder);
+	dpack_mpbuffer_assert_shared_api(encoder->mpbuffer);
+
+	struct dpack_mpbuffer_head * head;
+	int                          err __unused;
+
+	head = dpack_mpbuffer_head(encoder->mpbuffer, encoder->head);
+	dpack_assert_intern(size <= head->size);
+
+	err = dpack_encoder_fini(&encoder->buff.base);
+	dpack_assert_intern(!err);
+
+	/* Publish span content to flusher. */
+	__atomic_store_n(&head->state, DPACK_MPBUFFER_DONE | size,
+	                 __ATOMIC_RELEASE);
+}
+
+void
+dpack_encoder_commit_mpbuffer(
+	struct dpack_encoder_mpbuffer * __restrict encoder)
+{
+	dpack_assert_api(encoder);
+
+	dpack_encoder_release_mpbuffer(
+		encoder,
+		(uint32_t)dpack_encoder_space_used(&encoder->buff.base));
+}
+
+void
+dpack_encoder_drop_mpbuffer(
+	struct dpack_encoder_mpbuffer * __restrict encoder)
+{
+	dpack_assert_api(encoder);
+
+	dpack_encoder_release_mpbuffer(encoder, 0);
+}
+
+int
+dpack_mpbuffer_drain(struct dpack_mpbuffer * __restrict mpbuffer,
+                     dpack_mpbuffer_drain_fn *          drain,
+                     void * __restrict                  data)
+{
+	dpack_mpbuffer_assert_api(mpbuffer);
+	dpack_assert_api(drain);
+
+	size_t pos = mpbuffer->head;
+	size_t tail = __atomic_load_n(&mpbuffer->tail, __ATOMIC_ACQUIRE);
+	int    err = 0;
+
+	while (pos != tail) {
+		size_t                       off = pos % mpbuffer->capa;
+		struct dpack_mpbuffer_head * head;
+		uint32_t                     state;
+		size_t                       span;
+
+		head = dpack_mpbuffer_head(mpbuffer, off);
+		state = __atomic_load_n(&head->state, __ATOMIC_ACQUIRE);
+		if (!state)
+			/* Span still being encoded. */
+			break;
+
+		if (!head->size) {
+			/*
+			 * Padding: wrap around to the start of buffer. Its
+			 * content has never been written to.
+			 */
+			span = mpbuffer->capa - off;
+			memset(head, 0, sizeof(*head));
+		}
+		else {
+			if (state & ~DPACK_MPBUFFER_DONE) {
+				err = drain((const uint8_t *)&head[1],
+				            state & ~DPACK_MPBUFFER_DONE,
+				            data);
+				if (err)
+					break;
+			}
+
+			/*
+			 * Zero span as it gets drained so that reclaimed space
+			 * is ready for reuse without further processing.
+			 */
+			span = dpack_mpbuffer_span(head->size);
+			dpack_assert_intern(span <= (mpbuffer->capa - off));
+			memset(head, 0, span);
+		}
+
+		pos = dpack_mpbuffer_advance(mpbuffer, pos, span);
+	}
+
+	/*
+	 * Hand drained space back to producers. Release ordering makes zeroed
+	 * spans visible to them.
+	 */
+	__atomic_store_n(&mpbuffer->head, pos, __ATOMIC_RELEASE);
+
+	return err;
+}
@@ -0,0 +1,324 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2023 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/array.h"
+#include "common.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+
+/*
+ * Number of slices to split the element range into per thread. Using more
+ * slices than threads balances load when elements encoding cost is not
+ * uniform.
+ */
+#define DPACK_ARRAY_PARALLEL_SLICE_PER_THREAD (4U)
+
+/* Initial size of buffer a slice is encoded into. */
+#define DPACK_ARRAY_PARALLEL_SLICE_SIZE (4096U)
+
+struct dpack_array_pjob {
+	dpack_encode_item_fn * encode;
+	void *                 data;
+	unsigned int           elm_nr;
+	unsigned int           slice_len;
+	unsigned int           slice_nr;
+	struct iovec *         iov;
+	unsigned int           next;
+	int                    err;
+};
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_array_encode_slice(const struct dpack_array_pjob * __restrict job,
+                         struct iovec * __restrict                  iov,
+                         unsigned int                               index)
+{
+	dpack_assert_intern(job);
+	dpack_assert_intern(iov);
+	dpack_assert_intern(index < job->slice_nr);
+
+	/* Compute element range as size_t to prevent from wrapping around. */
+	size_t    elm = (size_t)index * job->slice_len;
+	size_t    end = stroll_min(elm + job->slice_len, (size_t)job->elm_nr);
+	size_t    capa = DPACK_ARRAY_PARALLEL_SLICE_SIZE;
+	size_t    used = 0;
+	uint8_t * buff;
+	int       err = 0;
+
+	buff = malloc(capa);
+	if (!buff)
+		return -ENOMEM;
+
+	/*
+	 * Encode elements right into a buffer grown on demand. Each element is
+	 * encoded once except the one overflowing current buffer, which is
+	 * encoded again once the buffer has been grown.
+	 */
+	while (elm < end) {
+		struct dpack_encoder_buffer enc;
+		size_t                      left = 0;
+		uint8_t *                   tmp;
+
+		dpack_encoder_init_buffer(&enc, &buff[used], capa - used);
+		do {
+			size_t mark = dpack_encoder_space_used(&enc.base);
+
+			err = job->encode(&enc.base,
+			                  (unsigned int)elm,
+			                  job->data);
+			if (err) {
+				/* Drop partially encoded element. */
+				left = capa - used - mark;
+				used += mark;
+				break;
+			}
+		} while (++elm < end);
+		if (!err)
+			used += dpack_encoder_space_used(&enc.base);
+		dpack_encoder_fini(&enc.base);
+
+		if (!err)
+			break;
+		if ((err != -EMSGSIZE) || (left >= DPACK_ARRAY_ELMSZ_MAX))
+			/* Not a matter of buffer space. */
+			goto free;
+
+		/*
+		 * Ensure the element to retry is given at least the maximum
+		 * room a single element may require.
+		 */
+		capa = stroll_max(2 * capa, used + DPACK_ARRAY_ELMSZ_MAX);
+		tmp = realloc(buff, capa);
+		if (!tmp) {
+			err = -ENOMEM;
+			goto free;
+		}
+		buff = tmp;
+		err = 0;
+	}
+
+	if (!used) {
+		err = -EMSGSIZE;
+		goto free;
+	}
+
+	if (used < capa) {
+		/* Give back unused space. */
+		uint8_t * tmp;
+
+		tmp = realloc(buff, used);
+		if (tmp)
+			buff = tmp;
+	}
+
+	iov->iov_base = buff;
+	iov->iov_len = used;
+
+	return 0;
+
+free:
+	free(buff);
+
+	return err;
+}
+
+static __dpack_nonull(1)
+void *
+dpack_array_encode_worker(void * arg)
+{
+	dpack_assert_intern(arg);
+
+	struct dpack_array_pjob * job = arg;
+
+	while (!__atomic_load_n(&job->err, __ATOMIC_RELAXED)) {
+		unsigned int idx;
+		int          err;
+		int          none = 0;
+
+		idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (idx >= job->slice_nr)
+			break;
+
+		err = dpack_array_encode_slice(job, &job->iov[idx], idx);
+		if (err)
+			/* Keep the first error reported only. */
+			__atomic_compare_exchange_n(&job->err,
+			                            &none,
+			                            err,
+			                            false,
+			                            __ATOMIC_RELAXED,
+			                            __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+static __dpack_nonull(1)
+void
+dpack_array_release_slices(struct iovec * __restrict iov, unsigned int nr)
+{
+	dpack_assert_intern(iov);
+
+	while (nr--)
+		free(iov[nr].iov_base);
+
+	free(iov);
+}
+
+int
+dpack_array_encode_parallel(struct dpack_array_slices * __restrict slices,
+                            unsigned int                           elm_nr,
+                            dpack_encode_item_fn *                 encode,
+                            void * __restrict                      data,
+                            unsigned int                           thread_nr)
+{
+	dpack_assert_api(slices);
+	dpack_assert_api(elm_nr);
+	dpack_assert_api(elm_nr <= DPACK_ARRAY_ELMNR_MAX);
+	dpack_assert_api(encode);
+	dpack_assert_api(thread_nr);
+
+	struct dpack_encoder_buffer enc;
+	struct dpack_array_pjob     job;
+	struct iovec *              iov;
+	unsigned int                s;
+	int                         err __unused;
+
+	dpack_encoder_init_buffer(&enc, slices->head, sizeof(slices->head));
+	err = dpack_array_begin_encode(&enc.base, elm_nr);
+	dpack_array_end_encode(&enc.base);
+	dpack_assert_intern(!err);
+
+	/*
+	 * Compute slicing as size_t so that neither the number of slices nor
+	 * the rounded up element counts may wrap around.
+	 */
+	job.slice_nr = (unsigned int)
+	               stroll_min((size_t)elm_nr,
+	                          (size_t)thread_nr *
+	                          DPACK_ARRAY_PARALLEL_SLICE_PER_THREAD);
+	job.slice_len = (unsigned int)
+	                (((size_t)elm_nr + job.slice_nr - 1) / job.slice_nr);
+	job.slice_nr = (unsigned int)
+	               (((size_t)elm_nr + job.slice_len - 1) / job.slice_len);
+	thread_nr = stroll_min(thread_nr, job.slice_nr);
+
+	iov = calloc((size_t)job.slice_nr + 1, sizeof(*iov));
+	if (!iov) {
+		dpack_encoder_fini(&enc.base);
+		return -ENOMEM;
+	}
+
+	iov[0].iov_base = slices->head;
+	iov[0].iov_len = dpack_encoder_space_used(&enc.base);
+	dpack_encoder_fini(&enc.base);
+
+	job.encode = encode;
+	job.data = data;
+	job.elm_nr = elm_nr;
+	job.iov = &iov[1];
+	job.next = 0;
+	job.err = 0;
+
+	dpack_run_workers(dpack_array_encode_worker, &job, thread_nr);
+
+	if (job.err) {
+		iov[0].iov_base = NULL;
+		dpack_array_release_slices(iov, job.slice_nr + 1);
+		return job.err;
+	}
+
+	slices->nr = job.slice_nr + 1;
+	slices->iov = iov;
+	slices->size = 0;
+	for (s = 0; s < slices->nr; s++)
+		slices->size += iov[s].iov_len;
+
+	return 0;
+}
+
+int
+dpack_array_slices_writev(const struct dpack_array_slices * __restrict slices,
+                          int                                          fd)
+{
+	dpack_assert_api(slices);
+	dpack_assert_api(slices->nr > 1);
+	dpack_assert_api(slices->iov);
+	dpack_assert_api(fd >= 0);
+
+	struct iovec * iov = slices->iov;
+	unsigned int   nr = slices->nr;
+	size_t         off = 0;
+
+	while (nr) {
+		struct iovec orig = *iov;
+		ssize_t      ret;
+
+		/*
+		 * Temporarily adjust current entry to resume from where the
+		 * previous writev() call stopped in case of partial write.
+		 */
+		iov->iov_base = (uint8_t *)orig.iov_base + off;
+		iov->iov_len = orig.iov_len - off;
+		ret = writev(fd,
+		             iov,
+		             (int)stroll_min(nr, (unsigned int)IOV_MAX));
+		*iov = orig;
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		/* Skip fully written entries. */
+		off += (size_t)ret;
+		while (nr && (off >= iov->iov_len)) {
+			off -= iov->iov_len;
+			iov++;
+			nr--;
+		}
+	}
+
+	return 0;
+}
+
+int
+dpack_array_slices_copy(const struct dpack_array_slices * __restrict slices,
+                        struct dpack_encoder * __restrict            encoder)
+{
+	dpack_assert_api(slices);
+	dpack_assert_api(slices->nr > 1);
+	dpack_assert_api(slices->iov);
+	dpack_encoder_assert_api(encoder);
+
+	unsigned int s;
+
+	for (s = 0; s < slices->nr; s++) {
+		int err;
+
+		err = dpack_encoder_write(encoder,
+		                          slices->iov[s].iov_base,
+		                          slices->iov[s].iov_len);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+void
+dpack_array_slices_fini(struct dpack_array_slices * __restrict slices)
+{
+	dpack_assert_api(slices);
+	dpack_assert_api(slices->nr > 1);
+	dpack_assert_api(slices->iov);
+
+	/* First entry points to embedded header storage. */
+	slices->iov[0].iov_base = NULL;
+	dpack_array_release_slices(slices->iov, slices->nr);
+}
@@ -0,0 +1,360 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/ring.h"
+#include "common.h"
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Size of a cache line. Producer and consumer indices live in distinct cache
+ * lines to prevent false sharing between both ends of the ring.
+ */
+#define DPACK_RING_CACHELINE_SIZE (64U)
+
+/* Size of slot header holding size of message. */
+#define DPACK_RING_SLOT_HEAD_SIZE sizeof(uint32_t)
+
+struct dpack_ring_shm {
+	/* Ring geometry, set once at creation time. */
+	uint32_t slot_nr;
+	uint32_t msg_max;
+	/* Index of next slot to produce, written by producer only. */
+	uint32_t head __align(DPACK_RING_CACHELINE_SIZE);
+	/* Index of next slot to consume, written by consumer only. */
+	uint32_t tail __align(DPACK_RING_CACHELINE_SIZE);
+	/* Whether consumer is sleeping onto wakeup eventfd. */
+	uint32_t waiting __align(DPACK_RING_CACHELINE_SIZE);
+	/* Message slots. */
+	uint8_t  slots[] __align(DPACK_RING_CACHELINE_SIZE);
+};
+
+#define dpack_ring_assert_api(_ring) \
+	dpack_assert_api(_ring); \
+	dpack_assert_api((_ring)->shm); \
+	dpack_assert_api((_ring)->size > sizeof(*(_ring)->shm)); \
+	dpack_assert_api((_ring)->stride > (_ring)->msg_max); \
+	dpack_assert_api((_ring)->msg_max); \
+	dpack_assert_api((_ring)->mask); \
+	dpack_assert_api((_ring)->mfd >= 0); \
+	dpack_assert_api((_ring)->efd >= 0)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow
+uint8_t *
+dpack_ring_slot(const struct dpack_ring * __restrict ring, uint32_t index)
+{
+	dpack_ring_assert_api(ring);
+
+	return &ring->shm->slots[(size_t)(index & ring->mask) * ring->stride];
+}
+
+static __dpack_const __dpack_nothrow __warn_result
+size_t
+dpack_ring_stride(size_t msg_max)
+{
+	return stroll_align_upper(DPACK_RING_SLOT_HEAD_SIZE + msg_max,
+	                          (size_t)DPACK_RING_CACHELINE_SIZE);
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_ring_map(struct dpack_ring * __restrict ring,
+               size_t                         size,
+               int                            mfd,
+               int                            efd)
+{
+	dpack_assert_intern(ring);
+	dpack_assert_intern(size);
+	dpack_assert_intern(mfd >= 0);
+	dpack_assert_intern(efd >= 0);
+
+	void * shm;
+
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+	if (shm == MAP_FAILED)
+		return -errno;
+
+	ring->shm = shm;
+	ring->size = size;
+	/*
+	 * Peer may have exchanged messages already: start with caches holding
+	 * a conservative value so that they are refreshed on first use.
+	 */
+	ring->prod_cache = __atomic_load_n(&ring->shm->tail, __ATOMIC_ACQUIRE);
+	ring->cons_cache = ring->prod_cache;
+	ring->mfd = mfd;
+	ring->efd = efd;
+
+	return 0;
+}
+
+int
+dpack_ring_wait(struct dpack_ring * __restrict ring)
+{
+	dpack_ring_assert_api(ring);
+
+	struct dpack_ring_shm * shm = ring->shm;
+	uint32_t                tail = __atomic_load_n(&shm->tail,
+	                                               __ATOMIC_RELAXED);
+
+	while (true) {
+		uint64_t cnt;
+
+		if (__atomic_load_n(&shm->head, __ATOMIC_ACQUIRE) != tail)
+			return 0;
+
+		/*
+		 * Announce we are about to sleep, then check for messages once
+		 * again: paired with the full barrier of the producer, this
+		 * ensures that either we see its message or it sees us waiting.
+		 */
+		__atomic_store_n(&shm->waiting, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&shm->head, __ATOMIC_SEQ_CST) != tail) {
+			__atomic_store_n(&shm->waiting, 0, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		if (read(ring->efd, &cnt, sizeof(cnt)) < 0) {
+			__atomic_store_n(&shm->waiting, 0, __ATOMIC_RELAXED);
+			return -errno;
+		}
+
+		__atomic_store_n(&shm->waiting, 0, __ATOMIC_RELAXED);
+	}
+
+	unreachable();
+}
+
+int
+dpack_ring_create(struct dpack_ring * __restrict ring,
+                  unsigned int                   slot_nr,
+                  size_t                         msg_max)
+{
+	dpack_assert_api(ring);
+	dpack_assert_api(slot_nr >= 2);
+	dpack_assert_api(slot_nr <= DPACK_RING_SLOT_NR_MAX);
+	dpack_assert_api(!(slot_nr & (slot_nr - 1)));
+	dpack_assert_api(msg_max);
+	dpack_assert_api(msg_max <= UINT32_MAX);
+
+	size_t stride = dpack_ring_stride(msg_max);
+	size_t size = sizeof(*ring->shm) + ((size_t)slot_nr * stride);
+	int    mfd;
+	int    efd;
+	int    err;
+
+	mfd = memfd_create("dpack_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (mfd < 0)
+		return -errno;
+
+	if (ftruncate(mfd, (off_t)size)) {
+		err = -errno;
+		goto close_mem;
+	}
+
+	/* Prevent peer from being hit by SIGBUS because of truncation. */
+	if (fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+		err = -errno;
+		goto close_mem;
+	}
+
+	efd = eventfd(0, EFD_CLOEXEC);
+	if (efd < 0) {
+		err = -errno;
+		goto close_mem;
+	}
+
+	err = dpack_ring_map(ring, size, mfd, efd);
+	if (err)
+		goto close_evt;
+
+	ring->shm->slot_nr = slot_nr;
+	ring->shm->msg_max = (uint32_t)msg_max;
+	ring->stride = stride;
+	ring->msg_max = msg_max;
+	ring->mask = slot_nr - 1;
+
+	return 0;
+
+close_evt:
+	close(efd);
+close_mem:
+	close(mfd);
+
+	return err;
+}
+
+int
+dpack_ring_attach(struct dpack_ring * __restrict ring, int mfd, int efd)
+{
+	dpack_assert_api(ring);
+	dpack_assert_api(mfd >= 0);
+	dpack_assert_api(efd >= 0);
+
+	struct stat st;
+	int         seals;
+	uint32_t    slot_nr;
+	uint32_t    msg_max;
+	int         err;
+
+	/* Peer might truncate memory file under our feet otherwise. */
+	seals = fcntl(mfd, F_GET_SEALS);
+	if (seals < 0)
+		return -errno;
+	if (!(seals & F_SEAL_SHRINK))
+		return -EPERM;
+
+	if (fstat(mfd, &st))
+		return -errno;
+	if ((size_t)st.st_size <= sizeof(*ring->shm))
+		return -EBADMSG;
+
+	err = dpack_ring_map(ring, (size_t)st.st_size, mfd, efd);
+	if (err)
+		return err;
+
+	/* Ring geometry is set by peer: validate it. */
+	slot_nr = ring->shm->slot_nr;
+	msg_max = ring->shm->msg_max;
+	if ((slot_nr < 2) ||
+	    (slot_nr > DPACK_RING_SLOT_NR_MAX) ||
+	    (slot_nr & (slot_nr - 1)) ||
+	    !msg_max ||
+	    (ring->size != (sizeof(*ring->shm) +
+	                    ((size_t)slot_nr * dpack_ring_stride(msg_max))))) {
+		munmap(ring->shm, ring->size);
+		return -EBADMSG;
+	}
+
+	ring->stride = dpack_ring_stride(msg_max);
+	ring->msg_max = msg_max;
+	ring->mask = slot_nr - 1;
+
+	return 0;
+}
+
+void
+dpack_ring_fini(struct dpack_ring * __restrict ring)
+{
+	dpack_ring_assert_api(ring);
+
+	munmap(ring->shm, ring->size);
+	close(ring->efd);
+	close(ring->mfd);
+}
+
+int
+dpack_encoder_init_ring(struct dpack_encoder_ring * __restrict encoder,
+                        struct dpack_ring * __restrict         ring)
+{
+	dpack_assert_api(encoder);
+	dpack_ring_assert_api(ring);
+
+	uint32_t  head = __atomic_load_n(&ring->shm->head, __ATOMIC_RELAXED);
+	uint8_t * slot;
+
+	if ((head - ring->prod_cache) > ring->mask) {
+		/*
+		 * Ring seems full according to cached consumer index: refresh
+		 * it. Caching prevents from fetching the consumer's cache line
+		 * for each message produced.
+		 */
+		ring->prod_cache = __atomic_load_n(&ring->shm->tail,
+		                                   __ATOMIC_ACQUIRE);
+		if ((head - ring->prod_cache) > ring->mask)
+			return -EAGAIN;
+	}
+
+	slot = dpack_ring_slot(ring, head);
+	dpack_encoder_init_buffer(&encoder->buff,
+	                          &slot[DPACK_RING_SLOT_HEAD_SIZE],
+	                          ring->msg_max);
+	encoder->ring = ring;
+	encoder->head = head;
+
+	return 0;
+}
+
+void
+dpack_encoder_commit_ring(struct dpack_encoder_ring * __restrict encoder)
+{
+	dpack_assert_api(encoder);
+	dpack_ring_assert_api(encoder->ring);
+	dpack_assert_api(dpack_encoder_space_used(&encoder->buff.base));
+
+	struct dpack_ring * ring = encoder->ring;
+	uint32_t            size;
+
+	size = (uint32_t)dpack_encoder_space_used(&encoder->buff.base);
+	memcpy(dpack_ring_slot(ring, encoder->head), &size, sizeof(size));
+	dpack_encoder_fini(&encoder->buff.base);
+
+	/* Publish slot content along with producer index. */
+	__atomic_store_n(&ring->shm->head, encoder->head + 1, __ATOMIC_RELEASE);
+
+	/* See dpack_ring_wait(). */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->shm->waiting, __ATOMIC_RELAXED)) {
+		const uint64_t cnt = 1;
+
+		/* Nothing sensible to do on error... */
+		if (write(ring->efd, &cnt, sizeof(cnt)) < 0)
+			return;
+	}
+}
+
+int
+dpack_decoder_init_ring(struct dpack_decoder_ring * __restrict decoder,
+                        struct dpack_ring * __restrict         ring)
+{
+	dpack_assert_api(decoder);
+	dpack_ring_assert_api(ring);
+
+	uint32_t        tail = __atomic_load_n(&ring->shm->tail,
+	                                       __ATOMIC_RELAXED);
+	const uint8_t * slot;
+	uint32_t        size;
+
+	if (tail == ring->cons_cache) {
+		/* Ring seems empty according to cached producer index. */
+		ring->cons_cache = __atomic_load_n(&ring->shm->head,
+		                                   __ATOMIC_ACQUIRE);
+		if (tail == ring->cons_cache)
+			return -EAGAIN;
+	}
+
+	slot = dpack_ring_slot(ring, tail);
+	memcpy(&size, slot, sizeof(size));
+	if (!size || (size > ring->msg_max))
+		return -EBADMSG;
+
+	dpack_decoder_init_buffer(&decoder->buff,
+	                          &slot[DPACK_RING_SLOT_HEAD_SIZE],
+	                          size);
+	decoder->ring = ring;
+	decoder->tail = tail;
+
+	return 0;
+}
+
+void
+dpack_decoder_release_ring(struct dpack_decoder_ring * __restrict decoder)
+{
+	dpack_assert_api(decoder);
+	dpack_ring_assert_api(decoder->ring);
+
+	dpack_decoder_fini(&decoder->buff.base);
+
+	/* Hand slot back to producer once done reading from it. */
+	__atomic_store_n(&decoder->ring->shm->tail,
+	                 decoder->tail + 1,
+	                 __ATOMIC_RELEASE);
+}
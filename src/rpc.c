@@ -0,0 +1,1383 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/rpc.h"
+#include "dpack/array.h"
+#include "dpack/scalar.h"
+#include "common.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* MessagePack-RPC message types. */
+#define DPACK_RPC_REQUEST_TYPE (0U)
+#define DPACK_RPC_REPLY_TYPE   (1U)
+#define DPACK_RPC_NOTIFY_TYPE  (2U)
+
+/* Number of MessagePack-RPC message array elements. */
+#define DPACK_RPC_REQUEST_NR   (4U)
+#define DPACK_RPC_REPLY_NR     (4U)
+#define DPACK_RPC_NOTIFY_NR    (3U)
+
+/* Size of connection transmit buffer. */
+#define DPACK_RPC_TX_SIZE      (2U * DPACK_RPC_MSG_SIZE_MAX)
+
+/* Average number of methods per method table hash bucket. */
+#define DPACK_RPC_BUCKET_LOAD  (4U)
+
+/* Number of hashing seeds tried before giving up building method table. */
+#define DPACK_RPC_SEED_NR      (16U)
+
+/* Maximum number of epoll events processed per dpack_rpc_server_run() call. */
+#define DPACK_RPC_EVENT_NR     (16U)
+
+#define dpack_rpc_assert_conn_intern(_conn) \
+	dpack_assert_intern(_conn); \
+	dpack_assert_intern((_conn)->head <= (_conn)->tail); \
+	dpack_assert_intern((_conn)->tail <= DPACK_RPC_MSG_SIZE_MAX); \
+	dpack_assert_intern((_conn)->rx); \
+	dpack_assert_intern((_conn)->fd >= 0)
+
+#define dpack_rpc_assert_server_api(_server) \
+	dpack_assert_api(_server); \
+	dpack_assert_api((_server)->slots); \
+	dpack_assert_api((_server)->disps); \
+	dpack_assert_api((_server)->slot_nr); \
+	dpack_assert_api((_server)->bucket_nr); \
+	dpack_assert_api((_server)->efd >= 0)
+
+/******************************************************************************
+ * Connection handling
+ ******************************************************************************/
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_rpc_conn_init(struct dpack_rpc_conn * __restrict conn, int fd)
+{
+	dpack_assert_intern(conn);
+	dpack_assert_intern(fd >= 0);
+
+	uint8_t * tx;
+
+	conn->rx = malloc(DPACK_RPC_MSG_SIZE_MAX);
+	if (!conn->rx)
+		return -ENOMEM;
+
+	tx = malloc(DPACK_RPC_TX_SIZE);
+	if (!tx) {
+		free(conn->rx);
+		return -ENOMEM;
+	}
+
+	conn->head = 0;
+	conn->tail = 0;
+	dpack_encoder_init_buffer(&conn->tx, tx, DPACK_RPC_TX_SIZE);
+	conn->fd = fd;
+
+	return 0;
+}
+
+static __dpack_nonull(1)
+void
+dpack_rpc_conn_fini(struct dpack_rpc_conn * __restrict conn)
+{
+	dpack_rpc_assert_conn_intern(conn);
+
+	dpack_encoder_fini(&conn->tx.base);
+	free(conn->tx.buff);
+	free(conn->rx);
+	close(conn->fd);
+}
+
+/*
+ * Transmit queued messages at once, as much of them as socket accepts without
+ * blocking. Unsent bytes are moved to start of transmit buffer so that they
+ * go out first next time.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_rpc_conn_flush(struct dpack_rpc_conn * __restrict conn)
+{
+	dpack_rpc_assert_conn_intern(conn);
+
+	size_t size = dpack_encoder_space_used(&conn->tx.base);
+	size_t off = 0;
+	int    err = 0;
+
+	while (off < size) {
+		ssize_t ret;
+
+		ret = send(conn->fd,
+		           &conn->tx.buff[off],
+		           size - off,
+		           MSG_NOSIGNAL);
+		if (ret > 0) {
+			off += (size_t)ret;
+			continue;
+		}
+
+		dpack_assert_intern(ret < 0);
+		if (errno != EINTR) {
+			err = -errno;
+			break;
+		}
+	}
+
+	if (off) {
+		memmove(conn->tx.buff, &conn->tx.buff[off], size - off);
+		conn->tx.tail = size - off;
+	}
+
+	return err;
+}
+
+static __dpack_nonull(1) __warn_result
+ssize_t
+dpack_rpc_conn_recv(struct dpack_rpc_conn * __restrict conn)
+{
+	dpack_rpc_assert_conn_intern(conn);
+
+	ssize_t ret;
+
+	if (conn->head) {
+		/* Move partially received message to start of buffer. */
+		memmove(conn->rx, &conn->rx[conn->head], conn->tail - conn->head);
+		conn->tail -= conn->head;
+		conn->head = 0;
+	}
+
+	if (conn->tail == DPACK_RPC_MSG_SIZE_MAX)
+		return -EMSGSIZE;
+
+	do {
+		ret = recv(conn->fd,
+		           &conn->rx[conn->tail],
+		           DPACK_RPC_MSG_SIZE_MAX - conn->tail,
+		           0);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (ret > 0) {
+		conn->tail += (size_t)ret;
+		return ret;
+	}
+
+	return !ret ? -ECONNRESET : -errno;
+}
+
+/*
+ * Find extent of next complete message received. Messages are not length
+ * prefixed: skip over a whole MessagePack object to find out where it ends.
+ * Skipping runs in constant stack space whatever the nesting depth of the
+ * received data.
+ */
+static __dpack_nonull(1, 2, 3) __warn_result
+int
+dpack_rpc_conn_next(struct dpack_rpc_conn * __restrict conn,
+                    const uint8_t ** __restrict       msg,
+                    size_t * __restrict               size)
+{
+	dpack_rpc_assert_conn_intern(conn);
+	dpack_assert_intern(msg);
+	dpack_assert_intern(size);
+
+	struct dpack_decoder_buffer dec;
+	size_t                      left = conn->tail - conn->head;
+	int                         err;
+
+	if (!left)
+		return -EAGAIN;
+
+	dpack_decoder_init_buffer(&dec, &conn->rx[conn->head], left);
+	err = dpack_decoder_discard(&dec.base);
+	if (!err) {
+		*msg = &conn->rx[conn->head];
+		*size = left - dpack_decoder_data_left(&dec.base);
+		conn->head += *size;
+	}
+	dpack_decoder_fini(&dec.base);
+
+	switch (err) {
+	case 0:
+		return 0;
+	case -ENODATA:
+		/*
+		 * Incomplete message filling up the whole receive buffer will
+		 * never complete.
+		 */
+		return (left < DPACK_RPC_MSG_SIZE_MAX) ? -EAGAIN : -EMSGSIZE;
+	default:
+		return -EPROTO;
+	}
+}
+
+/******************************************************************************
+ * Method minimal perfect hash table
+ *
+ * Built using the Compress, Hash and Displace (CHD) scheme: methods are spread
+ * among hash buckets holding a few of them each, then every bucket is given a
+ * pair of displacements (d0, d1) so that all of its methods land into
+ * distinct free slots, i.e. at (f1 + (d0 * f2) + d1) % slot_nr. Placing
+ * largest buckets first while the table is still mostly empty keeps expected
+ * build time linear.
+ ******************************************************************************/
+
+struct dpack_rpc_key {
+	uint32_t bucket;
+	uint32_t f1;
+	uint32_t f2;
+};
+
+static __dpack_nonull(1, 6) __dpack_nothrow
+void
+dpack_rpc_hash(const char * __restrict           name,
+               size_t                            len,
+               uint32_t                          seed,
+               uint32_t                          bucket_nr,
+               uint32_t                          slot_nr,
+               struct dpack_rpc_key * __restrict key)
+{
+	dpack_assert_intern(name);
+	dpack_assert_intern(bucket_nr);
+	dpack_assert_intern(slot_nr);
+	dpack_assert_intern(key);
+
+	uint64_t hash = 14695981039346656037ULL ^ seed;
+	size_t   c;
+
+	/* Seeded FNV-1a... */
+	for (c = 0; c < len; c++) {
+		hash ^= (uint8_t)name[c];
+		hash *= 1099511628211ULL;
+	}
+
+	/* ...with final avalanche so that all bits depend on all bytes. */
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	key->bucket = (uint32_t)(hash >> 32) % bucket_nr;
+	key->f1 = (uint32_t)hash % slot_nr;
+
+	/* Mix once more to derive d0 multiplier. */
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	key->f2 = (uint32_t)(hash >> 32) % slot_nr;
+}
+
+static __dpack_nonull(1, 2) __dpack_pure __dpack_nothrow __warn_result
+uint32_t
+dpack_rpc_slot(const struct dpack_rpc_key * __restrict  key,
+               const struct dpack_rpc_disp * __restrict disp,
+               uint32_t                                 slot_nr)
+{
+	dpack_assert_intern(key);
+	dpack_assert_intern(disp);
+	dpack_assert_intern(slot_nr);
+
+	uint64_t slot = ((uint64_t)disp->d0 * key->f2) % slot_nr;
+
+	return (uint32_t)((slot + key->f1 + disp->d1) % slot_nr);
+}
+
+/*
+ * Search for displacements mapping all nr methods of a bucket to distinct free
+ * slots, which are returned into pos.
+ */
+static __dpack_nonull(1, 3, 4, 6, 7) __warn_result
+bool
+dpack_rpc_place_bucket(const struct dpack_rpc_method ** __restrict slots,
+                       uint32_t                                    slot_nr,
+                       const struct dpack_rpc_key * __restrict     keys,
+                       const uint32_t * __restrict                 members,
+                       uint32_t                                    nr,
+                       uint32_t * __restrict                       pos,
+                       struct dpack_rpc_disp * __restrict          disp)
+{
+	dpack_assert_intern(slots);
+	dpack_assert_intern(slot_nr);
+	dpack_assert_intern(keys);
+	dpack_assert_intern(members);
+	dpack_assert_intern(nr);
+	dpack_assert_intern(pos);
+	dpack_assert_intern(disp);
+
+	for (disp->d0 = 0; disp->d0 < slot_nr; disp->d0++) {
+		uint32_t m;
+
+		/*
+		 * d1 shifts all slots of the bucket alike: first make sure d0
+		 * separates them...
+		 */
+		disp->d1 = 0;
+		for (m = 0; m < nr; m++) {
+			uint32_t o;
+
+			pos[m] = dpack_rpc_slot(&keys[members[m]],
+			                        disp,
+			                        slot_nr);
+			for (o = 0; (o < m) && (pos[o] != pos[m]); o++)
+				;
+			if (o < m)
+				break;
+		}
+		if (m < nr)
+			continue;
+
+		/* ...then look for a shift landing all of them on free ones. */
+		for (; disp->d1 < slot_nr; disp->d1++) {
+			for (m = 0; m < nr; m++)
+				if (slots[(pos[m] + disp->d1) % slot_nr])
+					break;
+			if (m == nr) {
+				for (m = 0; m < nr; m++)
+					pos[m] = (pos[m] + disp->d1) % slot_nr;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Sort methods by hash bucket into members, recording the offset of each
+ * bucket first member into firsts, and check for duplicate names.
+ */
+static __dpack_nonull(1, 2, 4, 6, 7) __warn_result
+int
+dpack_rpc_group_buckets(const struct dpack_rpc_method * __restrict methods,
+                        const struct dpack_rpc_key * __restrict    keys,
+                        uint32_t                                   nr,
+                        uint32_t * __restrict                      members,
+                        uint32_t                                   bucket_nr,
+                        uint32_t * __restrict                      firsts,
+                        uint32_t * __restrict                      cursors)
+{
+	dpack_assert_intern(methods);
+	dpack_assert_intern(keys);
+	dpack_assert_intern(nr);
+	dpack_assert_intern(members);
+	dpack_assert_intern(bucket_nr);
+	dpack_assert_intern(firsts);
+	dpack_assert_intern(cursors);
+
+	uint32_t m;
+	uint32_t b;
+
+	memset(firsts, 0, ((size_t)bucket_nr + 1) * sizeof(firsts[0]));
+	for (m = 0; m < nr; m++)
+		firsts[keys[m].bucket + 1]++;
+	for (b = 0; b < bucket_nr; b++) {
+		firsts[b + 1] += firsts[b];
+		cursors[b] = firsts[b];
+	}
+	for (m = 0; m < nr; m++)
+		members[cursors[keys[m].bucket]++] = m;
+
+	/* Identical names always end up into the same bucket. */
+	for (b = 0; b < bucket_nr; b++) {
+		for (m = firsts[b]; m < firsts[b + 1]; m++) {
+			const struct dpack_rpc_key * key = &keys[members[m]];
+			uint32_t                     o;
+
+			for (o = m + 1; o < firsts[b + 1]; o++) {
+				const struct dpack_rpc_key * other =
+					&keys[members[o]];
+
+				if ((key->f1 == other->f1) &&
+				    (key->f2 == other->f2) &&
+				    !strcmp(methods[members[m]].name,
+				            methods[members[o]].name))
+					return -EEXIST;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Order buckets by decreasing number of members using a counting sort. */
+static __dpack_nonull(1, 3, 4, 5)
+void
+dpack_rpc_sort_buckets(const uint32_t * __restrict firsts,
+                       uint32_t                    bucket_nr,
+                       uint32_t * __restrict       order,
+                       uint32_t * __restrict       counts,
+                       uint32_t                    nr)
+{
+	dpack_assert_intern(firsts);
+	dpack_assert_intern(bucket_nr);
+	dpack_assert_intern(order);
+	dpack_assert_intern(counts);
+	dpack_assert_intern(nr);
+
+	uint32_t b;
+	uint32_t sz;
+	uint32_t off = 0;
+
+	memset(counts, 0, ((size_t)nr + 1) * sizeof(counts[0]));
+	for (b = 0; b < bucket_nr; b++)
+		counts[firsts[b + 1] - firsts[b]]++;
+
+	sz = nr + 1;
+	do {
+		uint32_t cnt = counts[--sz];
+
+		counts[sz] = off;
+		off += cnt;
+	} while (sz);
+
+	for (b = 0; b < bucket_nr; b++)
+		order[counts[firsts[b + 1] - firsts[b]]++] = b;
+}
+
+/*
+ * Build a minimal perfect hash table of methods so that dispatching a method
+ * name costs a single hash computation and string comparison.
+ */
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_rpc_build_table(struct dpack_rpc_server * __restrict       server,
+                      const struct dpack_rpc_method * __restrict methods,
+                      unsigned int                               nr)
+{
+	dpack_assert_intern(server);
+	dpack_assert_intern(methods);
+	dpack_assert_intern(nr);
+
+	uint32_t                         bucket_nr;
+	const struct dpack_rpc_method ** slots;
+	struct dpack_rpc_disp *          disps;
+	struct dpack_rpc_key *           keys;
+	uint32_t *                       members;
+	uint32_t *                       firsts;
+	uint32_t *                       order;
+	uint32_t *                       counts;
+	uint32_t *                       pos;
+	uint32_t                         seed;
+	unsigned int                     m;
+	int                              err = -ENOMEM;
+
+	for (m = 0; m < nr; m++) {
+		dpack_assert_api(methods[m].name);
+		dpack_assert_api(*methods[m].name);
+		dpack_assert_api(strlen(methods[m].name) <=
+		                 DPACK_RPC_METHOD_LEN_MAX);
+		dpack_assert_api(methods[m].handler);
+	}
+
+	bucket_nr = (nr + DPACK_RPC_BUCKET_LOAD - 1) / DPACK_RPC_BUCKET_LOAD;
+
+	slots = malloc(nr * sizeof(slots[0]));
+	if (!slots)
+		return -ENOMEM;
+
+	disps = malloc(bucket_nr * sizeof(disps[0]));
+	if (!disps)
+		goto free_slots;
+
+	/* Scratch: keys followed by members, firsts, order, counts and pos. */
+	keys = malloc((nr * sizeof(keys[0])) +
+	              ((((size_t)3 * nr) + (2 * (size_t)bucket_nr) + 2) *
+	               sizeof(uint32_t)));
+	if (!keys)
+		goto free_disps;
+	members = (uint32_t *)&keys[nr];
+	firsts = &members[nr];
+	order = &firsts[bucket_nr + 1];
+	counts = &order[bucket_nr];
+	pos = &counts[nr + 1];
+
+	for (seed = 0; seed < DPACK_RPC_SEED_NR; seed++) {
+		uint32_t b;
+
+		for (m = 0; m < nr; m++)
+			dpack_rpc_hash(methods[m].name,
+			               strlen(methods[m].name),
+			               seed,
+			               bucket_nr,
+			               nr,
+			               &keys[m]);
+
+		err = dpack_rpc_group_buckets(methods,
+		                              keys,
+		                              nr,
+		                              members,
+		                              bucket_nr,
+		                              firsts,
+		                              order);
+		if (err)
+			break;
+
+		dpack_rpc_sort_buckets(firsts, bucket_nr, order, counts, nr);
+
+		memset(slots, 0, nr * sizeof(slots[0]));
+		for (b = 0; b < bucket_nr; b++) {
+			uint32_t bckt = order[b];
+			uint32_t cnt = firsts[bckt + 1] - firsts[bckt];
+			uint32_t p;
+
+			if (!cnt) {
+				/* Empty buckets are sorted last. */
+				disps[bckt].d0 = 0;
+				disps[bckt].d1 = 0;
+				continue;
+			}
+
+			if (!dpack_rpc_place_bucket(slots,
+			                            nr,
+			                            keys,
+			                            &members[firsts[bckt]],
+			                            cnt,
+			                            pos,
+			                            &disps[bckt]))
+				break;
+
+			for (p = 0; p < cnt; p++)
+				slots[pos[p]] = &methods[members[firsts[bckt] +
+				                                 p]];
+		}
+
+		if (b == bucket_nr) {
+			free(keys);
+			server->slots = slots;
+			server->disps = disps;
+			server->slot_nr = nr;
+			server->bucket_nr = bucket_nr;
+			server->seed = seed;
+			return 0;
+		}
+
+		/* Very unlikely: retry with another seed. */
+		err = -ENOMEM;
+	}
+
+	free(keys);
+free_disps:
+	free(disps);
+free_slots:
+	free(slots);
+
+	return err;
+}
+
+static __dpack_nonull(1, 2) __dpack_pure __warn_result
+const struct dpack_rpc_method *
+dpack_rpc_lookup(const struct dpack_rpc_server * __restrict server,
+                 const char * __restrict                    name,
+                 size_t                                     len)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_intern(name);
+
+	struct dpack_rpc_key            key;
+	const struct dpack_rpc_method * meth;
+
+	dpack_rpc_hash(name,
+	               len,
+	               server->seed,
+	               server->bucket_nr,
+	               server->slot_nr,
+	               &key);
+	meth = server->slots[dpack_rpc_slot(&key,
+	                                    &server->disps[key.bucket],
+	                                    server->slot_nr)];
+	dpack_assert_intern(meth);
+	if (!strcmp(meth->name, name))
+		return meth;
+
+	return NULL;
+}
+
+/******************************************************************************
+ * Server
+ ******************************************************************************/
+
+static __dpack_nonull(1, 2, 3) __warn_result
+int
+dpack_rpc_decode_method(struct dpack_decoder * __restrict          decoder,
+                        const struct dpack_rpc_server * __restrict server,
+                        const struct dpack_rpc_method ** __restrict meth)
+{
+	dpack_assert_intern(decoder);
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_intern(meth);
+
+	char    name[DPACK_RPC_METHOD_LEN_MAX + 1];
+	ssize_t len;
+
+	len = dpack_decode_strcpy(decoder, sizeof(name), name);
+	if (len == -EMSGSIZE) {
+		/*
+		 * Too long to be one of ours. Its header has been consumed
+		 * already and nothing is decoded past it: the whole message is
+		 * dropped once replied to.
+		 */
+		*meth = NULL;
+		return 0;
+	}
+	if (len < 0)
+		return (int)len;
+
+	*meth = dpack_rpc_lookup(server, name, (size_t)len);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2, 3) __warn_result
+int
+dpack_rpc_serve_request(struct dpack_rpc_server * __restrict server,
+                        struct dpack_rpc_conn * __restrict   conn,
+                        struct dpack_decoder * __restrict    decoder)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_rpc_assert_conn_intern(conn);
+	dpack_assert_intern(decoder);
+
+	uint32_t                        msgid;
+	const struct dpack_rpc_method * meth;
+	struct dpack_encoder *          enc = &conn->tx.base;
+	size_t                          start;
+	int                             ret;
+	int                             err;
+
+	err = dpack_decode_uint32(decoder, &msgid);
+	if (err)
+		return err;
+
+	err = dpack_rpc_decode_method(decoder, server, &meth);
+	if (err)
+		return err;
+
+	/* Caller makes sure a maximum sized reply fits. */
+	dpack_assert_intern(dpack_encoder_space_left(enc) >=
+	                    DPACK_RPC_MSG_SIZE_MAX);
+
+	start = dpack_encoder_space_used(enc);
+	err = dpack_array_begin_encode(enc, DPACK_RPC_REPLY_NR);
+	if (!err)
+		err = dpack_encode_uint8(enc, DPACK_RPC_REPLY_TYPE);
+	if (!err)
+		err = dpack_encode_uint32(enc, msgid);
+	if (err)
+		return err;
+
+	if (meth) {
+		ret = dpack_encode_nil(enc);
+		if (!ret)
+			ret = meth->handler(decoder, enc, server->data);
+		dpack_assert_intern(ret <= 0);
+	}
+	else
+		ret = -ENOSYS;
+
+	if (!ret) {
+		dpack_array_end_encode(enc);
+		if ((dpack_encoder_space_used(enc) - start) <=
+		    DPACK_RPC_MSG_SIZE_MAX)
+			return 0;
+		/* Client would not be able to receive it. */
+		ret = -EMSGSIZE;
+	}
+
+	/* Discard partial result and report error instead. */
+	conn->tx.tail = start;
+	err = dpack_array_begin_encode(enc, DPACK_RPC_REPLY_NR);
+	if (!err)
+		err = dpack_encode_uint8(enc, DPACK_RPC_REPLY_TYPE);
+	if (!err)
+		err = dpack_encode_uint32(enc, msgid);
+	if (!err)
+		err = dpack_encode_int32(enc, ret);
+	if (!err)
+		err = dpack_encode_nil(enc);
+	if (err)
+		return err;
+
+	dpack_array_end_encode(enc);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_rpc_serve_notify(struct dpack_rpc_server * __restrict server,
+                       struct dpack_decoder * __restrict    decoder)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_intern(decoder);
+
+	const struct dpack_rpc_method * meth;
+	int                             err;
+
+	err = dpack_rpc_decode_method(decoder, server, &meth);
+	if (err)
+		return err;
+
+	if (meth) {
+		struct dpack_encoder_count enc;
+
+		/* Nobody to report errors to... */
+		dpack_encoder_init_count(&enc);
+		meth->handler(decoder, &enc.base, server->data);
+		dpack_encoder_fini(&enc.base);
+	}
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2, 3) __warn_result
+int
+dpack_rpc_serve_msg(struct dpack_rpc_server * __restrict server,
+                    struct dpack_rpc_conn * __restrict   conn,
+                    const uint8_t * __restrict           msg,
+                    size_t                               size)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_rpc_assert_conn_intern(conn);
+	dpack_assert_intern(msg);
+	dpack_assert_intern(size);
+
+	struct dpack_decoder_buffer dec;
+	unsigned int                nr;
+	uint8_t                     type;
+	int                         err;
+
+	dpack_decoder_init_buffer(&dec, msg, size);
+
+	err = dpack_array_decode_count(&dec.base, &nr);
+	if (!err)
+		err = dpack_decode_uint8(&dec.base, &type);
+	if (err)
+		goto fini;
+
+	if ((type == DPACK_RPC_REQUEST_TYPE) && (nr == DPACK_RPC_REQUEST_NR))
+		err = dpack_rpc_serve_request(server, conn, &dec.base);
+	else if ((type == DPACK_RPC_NOTIFY_TYPE) &&
+	         (nr == DPACK_RPC_NOTIFY_NR))
+		err = dpack_rpc_serve_notify(server, &dec.base);
+	else
+		err = -EPROTO;
+
+fini:
+	dpack_decoder_fini(&dec.base);
+
+	return err;
+}
+
+static __dpack_nonull(1, 2)
+void
+dpack_rpc_close_conn(struct dpack_rpc_server * __restrict server,
+                     struct dpack_rpc_conn * __restrict   conn)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_rpc_assert_conn_intern(conn);
+
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		server->conns = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+
+	dpack_rpc_conn_fini(conn);
+	free(conn);
+}
+
+/* Update the set of epoll events watched for a connection. */
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_rpc_server_watch(const struct dpack_rpc_server * __restrict server,
+                       struct dpack_rpc_conn * __restrict         conn,
+                       uint32_t                                   events)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_rpc_assert_conn_intern(conn);
+
+	struct epoll_event evt;
+
+	if (conn->events == events)
+		return 0;
+
+	evt.events = events;
+	evt.data.ptr = conn;
+	if (epoll_ctl(server->efd, EPOLL_CTL_MOD, conn->fd, &evt))
+		return -errno;
+
+	conn->events = events;
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2)
+void
+dpack_rpc_serve_conn(struct dpack_rpc_server * __restrict server,
+                     struct dpack_rpc_conn * __restrict   conn)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_rpc_assert_conn_intern(conn);
+
+	const uint8_t * msg;
+	size_t          size;
+	bool            full;
+	int             err;
+
+	if (conn->events & EPOLLIN) {
+		ssize_t ret;
+
+		ret = dpack_rpc_conn_recv(conn);
+		if (ret < 0) {
+			if (ret == -EAGAIN)
+				return;
+			goto close;
+		}
+	}
+
+	do {
+		/*
+		 * Process pipelined requests received so far as long as
+		 * transmit buffer has room for a maximum sized reply...
+		 */
+		full = true;
+		while (dpack_encoder_space_left(&conn->tx.base) >=
+		       DPACK_RPC_MSG_SIZE_MAX) {
+			err = dpack_rpc_conn_next(conn, &msg, &size);
+			if (err == -EAGAIN) {
+				full = false;
+				break;
+			}
+			if (!err)
+				err = dpack_rpc_serve_msg(server,
+				                          conn,
+				                          msg,
+				                          size);
+			if (err)
+				goto close;
+		}
+
+		/* ...and send back their replies at once. */
+		err = dpack_rpc_conn_flush(conn);
+		if (err == -EAGAIN) {
+			/*
+			 * Socket is full: stop receiving requests until it
+			 * drains instead of blocking the whole server.
+			 */
+			if (!dpack_rpc_server_watch(server, conn, EPOLLOUT))
+				return;
+			goto close;
+		}
+		if (err)
+			goto close;
+	} while (full);
+
+	/* All replies sent: resume receiving requests. */
+	if (!dpack_rpc_server_watch(server, conn, EPOLLIN))
+		return;
+
+close:
+	dpack_rpc_close_conn(server, conn);
+}
+
+int
+dpack_rpc_server_attach(struct dpack_rpc_server * __restrict server, int fd)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_api(fd >= 0);
+
+	struct dpack_rpc_conn * conn;
+	struct epoll_event      evt;
+	int                     flags;
+	int                     err;
+
+	flags = fcntl(fd, F_GETFL);
+	if ((flags < 0) || fcntl(fd, F_SETFL, flags | O_NONBLOCK)) {
+		err = -errno;
+		goto close;
+	}
+
+	conn = malloc(sizeof(*conn));
+	if (!conn) {
+		err = -ENOMEM;
+		goto close;
+	}
+
+	err = dpack_rpc_conn_init(conn, fd);
+	if (err)
+		goto free;
+
+	conn->events = EPOLLIN;
+	evt.events = EPOLLIN;
+	evt.data.ptr = conn;
+	if (epoll_ctl(server->efd, EPOLL_CTL_ADD, fd, &evt)) {
+		err = -errno;
+		dpack_rpc_conn_fini(conn);
+		free(conn);
+		return err;
+	}
+
+	conn->prev = NULL;
+	conn->next = server->conns;
+	if (server->conns)
+		server->conns->prev = conn;
+	server->conns = conn;
+
+	return 0;
+
+free:
+	free(conn);
+close:
+	close(fd);
+
+	return err;
+}
+
+static __dpack_nonull(1)
+void
+dpack_rpc_server_accept(struct dpack_rpc_server * __restrict server)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_intern(server->lfd >= 0);
+
+	while (true) {
+		int fd;
+		int err;
+
+		fd = accept4(server->lfd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		/* On failure, fd is closed and peer will notice. */
+		err = dpack_rpc_server_attach(server, fd);
+		if (err)
+			continue;
+	}
+}
+
+int
+dpack_rpc_server_run(struct dpack_rpc_server * __restrict server, int tmout)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_api(tmout >= -1);
+
+	struct epoll_event evts[DPACK_RPC_EVENT_NR];
+	int                nr;
+	int                e;
+
+	nr = epoll_wait(server->efd, evts, (int)stroll_array_nr(evts), tmout);
+	if (nr < 0)
+		return (errno != EINTR) ? -errno : 0;
+
+	for (e = 0; e < nr; e++) {
+		if (evts[e].data.ptr)
+			dpack_rpc_serve_conn(server, evts[e].data.ptr);
+		else
+			dpack_rpc_server_accept(server);
+	}
+
+	return 0;
+}
+
+int
+dpack_rpc_server_listen(struct dpack_rpc_server * __restrict server,
+                        const char * __restrict              path)
+{
+	dpack_rpc_assert_server_api(server);
+	dpack_assert_api(server->lfd < 0);
+	dpack_assert_api(path);
+	dpack_assert_api(*path);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct epoll_event evt;
+	int                fd;
+	int                err;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, SOMAXCONN))
+		goto err;
+
+	evt.events = EPOLLIN;
+	evt.data.ptr = NULL;
+	if (epoll_ctl(server->efd, EPOLL_CTL_ADD, fd, &evt))
+		goto err;
+
+	server->lfd = fd;
+
+	return 0;
+
+err:
+	err = -errno;
+	close(fd);
+
+	return err;
+}
+
+int
+dpack_rpc_server_init(struct dpack_rpc_server * __restrict       server,
+                      const struct dpack_rpc_method * __restrict methods,
+                      unsigned int                               nr,
+                      void * __restrict                          data)
+{
+	dpack_assert_api(server);
+	dpack_assert_api(methods);
+	dpack_assert_api(nr);
+
+	int err;
+
+	err = dpack_rpc_build_table(server, methods, nr);
+	if (err)
+		return err;
+
+	server->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (server->efd < 0) {
+		err = -errno;
+		free(server->disps);
+		free(server->slots);
+		return err;
+	}
+
+	server->conns = NULL;
+	server->data = data;
+	server->lfd = -1;
+
+	return 0;
+}
+
+void
+dpack_rpc_server_fini(struct dpack_rpc_server * __restrict server)
+{
+	dpack_rpc_assert_server_api(server);
+
+	while (server->conns)
+		dpack_rpc_close_conn(server, server->conns);
+
+	if (server->lfd >= 0)
+		close(server->lfd);
+	close(server->efd);
+	free(server->disps);
+	free(server->slots);
+}
+
+/******************************************************************************
+ * Client
+ ******************************************************************************/
+
+#define dpack_rpc_assert_client_api(_client) \
+	dpack_assert_api(_client); \
+	dpack_assert_api((_client)->conn.rx); \
+	dpack_assert_api((_client)->conn.fd >= 0); \
+	dpack_assert_api((_client)->msgid <= INT_MAX)
+
+/*
+ * Transmit all queued messages. Clients have no event loop to return to: wait
+ * for socket to drain when non-blocking.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_rpc_client_drain(struct dpack_rpc_client * __restrict client)
+{
+	dpack_rpc_assert_client_api(client);
+
+	int err;
+
+	while ((err = dpack_rpc_conn_flush(&client->conn)) == -EAGAIN) {
+		struct pollfd pfd = { .fd = client->conn.fd,
+		                      .events = POLLOUT };
+
+		if ((poll(&pfd, 1, -1) < 0) && (errno != EINTR))
+			return -errno;
+	}
+
+	return err;
+}
+
+static __dpack_nonull(1, 4, 5) __warn_result
+int
+dpack_rpc_client_queue(struct dpack_rpc_client * __restrict client,
+                       uint8_t                              type,
+                       uint32_t                             msgid,
+                       const char * __restrict              method,
+                       dpack_rpc_encode_fn *                encode,
+                       void * __restrict                    data)
+{
+	dpack_rpc_assert_client_api(client);
+	dpack_assert_api(method);
+	dpack_assert_api(*method);
+	dpack_assert_api(encode);
+
+	struct dpack_rpc_conn * conn = &client->conn;
+	struct dpack_encoder *  enc = &conn->tx.base;
+	size_t                  start;
+	int                     err;
+
+	if (dpack_encoder_space_left(enc) < DPACK_RPC_MSG_SIZE_MAX) {
+		/* Make room for a maximum sized message. */
+		err = dpack_rpc_client_drain(client);
+		if (err)
+			return err;
+	}
+
+	start = dpack_encoder_space_used(enc);
+	err = dpack_array_begin_encode(enc,
+	                               (type == DPACK_RPC_REQUEST_TYPE)
+	                               ? DPACK_RPC_REQUEST_NR
+	                               : DPACK_RPC_NOTIFY_NR);
+	if (!err)
+		err = dpack_encode_uint8(enc, type);
+	if (!err && (type == DPACK_RPC_REQUEST_TYPE))
+		err = dpack_encode_uint32(enc, msgid);
+	if (!err)
+		err = dpack_encode_str(enc, method);
+	if (!err)
+		err = encode(enc, data);
+	if (!err) {
+		dpack_array_end_encode(enc);
+		if ((dpack_encoder_space_used(enc) - start) <=
+		    DPACK_RPC_MSG_SIZE_MAX)
+			return 0;
+		/* Server would not be able to receive it. */
+		err = -EMSGSIZE;
+	}
+
+	conn->tx.tail = start;
+
+	return err;
+}
+
+int
+dpack_rpc_call(struct dpack_rpc_client * __restrict client,
+               const char * __restrict              method,
+               dpack_rpc_encode_fn *                encode,
+               void * __restrict                    data)
+{
+	dpack_rpc_assert_client_api(client);
+
+	uint32_t msgid = client->msgid;
+	int      err;
+
+	err = dpack_rpc_client_queue(client,
+	                             DPACK_RPC_REQUEST_TYPE,
+	                             msgid,
+	                             method,
+	                             encode,
+	                             data);
+	if (err)
+		return err;
+
+	client->msgid = (msgid + 1) & INT_MAX;
+
+	return (int)msgid;
+}
+
+int
+dpack_rpc_notify(struct dpack_rpc_client * __restrict client,
+                 const char * __restrict              method,
+                 dpack_rpc_encode_fn *                encode,
+                 void * __restrict                    data)
+{
+	dpack_rpc_assert_client_api(client);
+
+	return dpack_rpc_client_queue(client,
+	                              DPACK_RPC_NOTIFY_TYPE,
+	                              0,
+	                              method,
+	                              encode,
+	                              data);
+}
+
+int
+dpack_rpc_client_flush(struct dpack_rpc_client * __restrict client)
+{
+	dpack_rpc_assert_client_api(client);
+
+	return dpack_rpc_client_drain(client);
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_rpc_decode_error(struct dpack_decoder_buffer * __restrict decoder,
+                       int * __restrict                         error)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(error);
+
+	struct dpack_decoder_buffer tmp;
+	int32_t                     val;
+
+	/*
+	 * Error object type is not known in advance: try decoding from a copy
+	 * of the decoder so that a mismatch leaves the original untouched.
+	 */
+	tmp = *decoder;
+	if (!dpack_decode_nil(&tmp.base)) {
+		*error = 0;
+		*decoder = tmp;
+		return 0;
+	}
+
+	tmp = *decoder;
+	if (!dpack_decode_int32(&tmp.base, &val) && (val < 0)) {
+		*error = val;
+		*decoder = tmp;
+		return 0;
+	}
+
+	/* Foreign server error object. */
+	*error = -EREMOTEIO;
+
+	return dpack_decoder_discard(&decoder->base);
+}
+
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_rpc_client_process(const uint8_t * __restrict msg,
+                         size_t                     size,
+                         dpack_rpc_reply_fn *       reply,
+                         void * __restrict          data)
+{
+	dpack_assert_intern(msg);
+	dpack_assert_intern(size);
+	dpack_assert_intern(reply);
+
+	struct dpack_decoder_buffer dec;
+	uint8_t                     type;
+	uint32_t                    msgid;
+	int                         error;
+	int                         err;
+
+	dpack_decoder_init_buffer(&dec, msg, size);
+
+	err = dpack_array_decode_count_equ(&dec.base, DPACK_RPC_REPLY_NR);
+	if (!err)
+		err = dpack_decode_uint8(&dec.base, &type);
+	if (!err && (type != DPACK_RPC_REPLY_TYPE))
+		err = -EPROTO;
+	if (!err)
+		err = dpack_decode_uint32(&dec.base, &msgid);
+	if (!err)
+		err = dpack_rpc_decode_error(&dec, &error);
+	if (err) {
+		err = -EPROTO;
+		goto fini;
+	}
+
+	err = reply(msgid, error, &dec.base, data);
+
+fini:
+	dpack_decoder_fini(&dec.base);
+
+	return err;
+}
+
+int
+dpack_rpc_client_recv(struct dpack_rpc_client * __restrict client,
+                      dpack_rpc_reply_fn *                 reply,
+                      void * __restrict                    data)
+{
+	dpack_rpc_assert_client_api(client);
+	dpack_assert_api(reply);
+
+	struct dpack_rpc_conn * conn = &client->conn;
+	int                     cnt = 0;
+	int                     err;
+
+	err = dpack_rpc_client_drain(client);
+	if (err)
+		return err;
+
+	do {
+		ssize_t         ret;
+		const uint8_t * msg;
+		size_t          size;
+
+		ret = dpack_rpc_conn_recv(conn);
+		if (ret < 0)
+			return (int)ret;
+
+		while (!(err = dpack_rpc_conn_next(conn, &msg, &size))) {
+			err = dpack_rpc_client_process(msg, size, reply, data);
+			if (err)
+				return err;
+			cnt++;
+		}
+		if (err != -EAGAIN)
+			return err;
+	} while (!cnt);
+
+	return cnt;
+}
+
+int
+dpack_rpc_client_init(struct dpack_rpc_client * __restrict client, int fd)
+{
+	dpack_assert_api(client);
+	dpack_assert_api(fd >= 0);
+
+	client->conn.next = NULL;
+	client->conn.prev = NULL;
+	client->msgid = 0;
+
+	return dpack_rpc_conn_init(&client->conn, fd);
+}
+
+int
+dpack_rpc_client_connect(struct dpack_rpc_client * __restrict client,
+                         const char * __restrict              path)
+{
+	dpack_assert_api(client);
+	dpack_assert_api(path);
+	dpack_assert_api(*path);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int                fd;
+	int                err;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr))) {
+		err = -errno;
+		goto close;
+	}
+
+	err = dpack_rpc_client_init(client, fd);
+	if (!err)
+		return 0;
+
+close:
+	close(fd);
+
+	return err;
+}
+
+void
+dpack_rpc_client_fini(struct dpack_rpc_client * __restrict client)
+{
+	dpack_rpc_assert_client_api(client);
+
+	dpack_rpc_conn_fini(&client->conn);
+}
@@ -0,0 +1,484 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/socket.h"
+#include "common.h"
+#include <stroll/page.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct dpack_socket_chunk {
+	/* Identifier following the last zero-copy send referencing chunk. */
+	uint32_t end;
+	/* Whether chunk is still referenced by the kernel. */
+	bool     busy;
+};
+
+#define dpack_encoder_assert_socket_api(_enc) \
+	dpack_assert_api(_enc); \
+	dpack_assert_api((_enc)->csize); \
+	dpack_assert_api(stroll_aligned((_enc)->csize, stroll_page_size())); \
+	dpack_assert_api((_enc)->tail < (_enc)->csize); \
+	dpack_assert_api((_enc)->mem); \
+	dpack_assert_api((_enc)->chunks); \
+	dpack_assert_api((_enc)->nr); \
+	dpack_assert_api((_enc)->nr <= DPACK_ENCODER_SOCKET_CHUNK_NR_MAX); \
+	dpack_assert_api((_enc)->head < (_enc)->nr); \
+	dpack_assert_api((_enc)->poll); \
+	dpack_assert_api((_enc)->err <= 0); \
+	dpack_assert_api((_enc)->fd >= 0)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+uint8_t *
+dpack_encoder_socket_chunk(const struct dpack_encoder_socket * __restrict enc,
+                           unsigned int                                   index)
+{
+	dpack_assert_intern(enc);
+	dpack_assert_intern(enc->mem);
+	dpack_assert_intern(index < enc->nr);
+
+	return &enc->mem[(size_t)index * enc->csize];
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_socket_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_socket_api((const struct dpack_encoder_socket *)
+	                                encoder);
+
+	const struct dpack_encoder_socket * enc =
+		(const struct dpack_encoder_socket *)encoder;
+
+	/* Chunks are sent as they fill up: stream is unbounded. */
+	return SIZE_MAX - enc->sent - enc->tail;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_socket_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_socket_api((const struct dpack_encoder_socket *)
+	                                encoder);
+
+	const struct dpack_encoder_socket * enc =
+		(const struct dpack_encoder_socket *)encoder;
+
+	return enc->sent + enc->tail;
+}
+
+/*
+ * Process zero-copy completion notifications queued onto the socket error
+ * queue and return the number of messages dequeued.
+ *
+ * Each successful send(MSG_ZEROCOPY) call is assigned the next value of a per
+ * socket 32-bit counter. Notifications carry the range of identifiers of
+ * completed calls. Since TCP completes transmissions in order, tracking the
+ * end of the last completed range is enough to tell which chunks the kernel
+ * no longer references.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_socket_reap(struct dpack_encoder_socket * __restrict encoder)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(encoder->fd >= 0);
+
+	int nr = 0;
+
+	while (true) {
+		union {
+			char           buff[CMSG_SPACE(
+			                    sizeof(struct sock_extended_err) +
+			                    sizeof(struct sockaddr_in6))];
+			struct cmsghdr align;
+		}                  ctrl;
+		struct msghdr      msg = {
+			.msg_control    = ctrl.buff,
+			.msg_controllen = sizeof(ctrl.buff)
+		};
+		struct cmsghdr *   cmsg;
+
+		if (recvmsg(encoder->fd, &msg, MSG_ERRQUEUE) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return nr;
+			return -errno;
+		}
+
+		nr++;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg);
+		     cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			const struct sock_extended_err * serr;
+			uint32_t                         end;
+
+			if (!(((cmsg->cmsg_level == SOL_IP) &&
+			       (cmsg->cmsg_type == IP_RECVERR)) ||
+			      ((cmsg->cmsg_level == SOL_IPV6) &&
+			       (cmsg->cmsg_type == IPV6_RECVERR))))
+				continue;
+
+			serr = (const struct sock_extended_err *)
+			       CMSG_DATA(cmsg);
+			if ((serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) ||
+			    serr->ee_errno)
+				continue;
+
+			/* ee_data holds the last identifier of the range. */
+			end = serr->ee_data + 1;
+			if ((int32_t)(end - encoder->done) > 0)
+				encoder->done = end;
+		}
+	}
+}
+
+/* Fetch and clear pending socket error. */
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_socket_error(const struct dpack_encoder_socket * __restrict enc)
+{
+	dpack_assert_intern(enc);
+	dpack_assert_intern(enc->fd >= 0);
+
+	int       err;
+	socklen_t len = sizeof(err);
+
+	if (getsockopt(enc->fd, SOL_SOCKET, SO_ERROR, &err, &len))
+		return -errno;
+
+	return -err;
+}
+
+/*
+ * Wait for the kernel to release a chunk sent using MSG_ZEROCOPY.
+ *
+ * poll(2) reports POLLERR as long as the socket error queue is not empty, but
+ * also when a socket error is pending, and POLLHUP / POLLNVAL whatever the
+ * requested events: bail out instead of spinning when woken up for anything
+ * else than completion notifications.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_socket_wait(struct dpack_encoder_socket * __restrict encoder,
+                          unsigned int                             index)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(encoder->chunks);
+	dpack_assert_intern(index < encoder->nr);
+
+	struct dpack_socket_chunk * chunk = &encoder->chunks[index];
+	short                       revents = 0;
+
+	while (chunk->busy) {
+		struct pollfd pfd = { .fd = encoder->fd, .events = 0 };
+		int           ret;
+
+		ret = dpack_encoder_socket_reap(encoder);
+		if (ret < 0)
+			return ret;
+
+		if ((int32_t)(encoder->done - chunk->end) >= 0) {
+			chunk->busy = false;
+			break;
+		}
+
+		if (revents & POLLNVAL)
+			return -EBADF;
+
+		if ((revents & POLLERR) && !ret) {
+			/* Empty error queue: a socket error is pending. */
+			ret = dpack_encoder_socket_error(encoder);
+			if (ret)
+				return ret;
+		}
+
+		if (revents & POLLHUP) {
+			/* Connection is gone: nothing left to wait for. */
+			ret = dpack_encoder_socket_error(encoder);
+			return ret ? ret : -EPIPE;
+		}
+
+		if (encoder->poll(&pfd, 1, -1) < 0) {
+			if (errno != EINTR)
+				return -errno;
+			pfd.revents = 0;
+		}
+		revents = pfd.revents;
+	}
+
+	return 0;
+}
+
+/*
+ * Send content of current chunk and switch to the next one, waiting for the
+ * kernel to release it if needed.
+ *
+ * Current chunk is given up on failure as well since part of it may have been
+ * sent already.
+ */
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_socket_send(struct dpack_encoder_socket * __restrict encoder,
+                          size_t                                   size)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(size);
+	dpack_assert_intern(size <= encoder->csize);
+	dpack_assert_intern(encoder->head < encoder->nr);
+	dpack_assert_intern(!encoder->chunks[encoder->head].busy);
+
+	const uint8_t * data = dpack_encoder_socket_chunk(encoder,
+	                                                  encoder->head);
+	bool            zcopy = encoder->zcopy && (size >= encoder->zcopy);
+	bool            pinned = false;
+	size_t          off = 0;
+	int             err = 0;
+
+	while (off < size) {
+		ssize_t ret;
+
+		ret = send(encoder->fd,
+		           &data[off],
+		           size - off,
+		           MSG_NOSIGNAL | (zcopy ? MSG_ZEROCOPY : 0));
+		if (ret < 0) {
+			struct pollfd pfd = { .fd = encoder->fd,
+			                      .events = POLLOUT };
+
+			switch (errno) {
+			case EINTR:
+				break;
+
+			case EAGAIN:
+				if ((encoder->poll(&pfd, 1, -1) < 0) &&
+				    (errno != EINTR))
+					err = -errno;
+				break;
+
+			case ENOBUFS:
+				/*
+				 * Too much memory pinned by pending zero-copy
+				 * sends: copy remaining data instead.
+				 */
+				if (zcopy) {
+					zcopy = false;
+					break;
+				}
+				err = -ENOBUFS;
+				break;
+
+			default:
+				err = -errno;
+			}
+
+			if (err)
+				break;
+
+			continue;
+		}
+
+		if (zcopy) {
+			encoder->next++;
+			pinned = true;
+		}
+		off += (size_t)ret;
+	}
+
+	/*
+	 * Kernel may reference chunk even when a failure happened after a
+	 * successful partial zero-copy send: keep it from being freed.
+	 */
+	if (pinned) {
+		encoder->chunks[encoder->head].end = encoder->next;
+		encoder->chunks[encoder->head].busy = true;
+	}
+
+	encoder->sent += off;
+	encoder->tail = 0;
+	encoder->head = (encoder->head + 1) % encoder->nr;
+	if (err)
+		return err;
+
+	return dpack_encoder_socket_wait(encoder, encoder->head);
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_socket_push(struct dpack_encoder_socket * __restrict enc,
+                          const uint8_t * __restrict               data,
+                          size_t                                   size)
+{
+	dpack_assert_intern(enc);
+	dpack_assert_intern(data);
+	dpack_assert_intern(size);
+	dpack_assert_intern(!enc->chunks[enc->head].busy);
+
+	if (size > dpack_encoder_socket_left(&enc->base))
+		return -EMSGSIZE;
+
+	do {
+		size_t bytes = stroll_min(size, enc->csize - enc->tail);
+
+		memcpy(&dpack_encoder_socket_chunk(enc, enc->head)[enc->tail],
+		       data,
+		       bytes);
+		enc->tail += bytes;
+		data += bytes;
+		size -= bytes;
+
+		if (enc->tail == enc->csize) {
+			int err;
+
+			err = dpack_encoder_socket_send(enc, enc->csize);
+			if (err)
+				return err;
+		}
+	} while (size);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_socket_write(struct dpack_encoder * __restrict encoder,
+                           const uint8_t * __restrict        data,
+                           size_t                            size)
+{
+	dpack_encoder_assert_socket_api((const struct dpack_encoder_socket *)
+	                                encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_socket * enc = (struct dpack_encoder_socket *)
+	                                    encoder;
+
+	/*
+	 * Objects are written piecewise and chunks may have been partially
+	 * sent when a failure happens: retrying would corrupt the stream. Make
+	 * errors sticky.
+	 */
+	if (!enc->err)
+		enc->err = dpack_encoder_socket_push(enc, data, size);
+
+	return enc->err;
+}
+
+int
+dpack_encoder_flush_socket(struct dpack_encoder_socket * __restrict encoder)
+{
+	dpack_encoder_assert_socket_api(encoder);
+
+	if (!encoder->err && encoder->tail)
+		encoder->err = dpack_encoder_socket_send(encoder,
+		                                         encoder->tail);
+
+	return encoder->err;
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_socket_fini(struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_socket_api((const struct dpack_encoder_socket *)
+	                                encoder);
+
+	struct dpack_encoder_socket * enc = (struct dpack_encoder_socket *)
+	                                    encoder;
+	unsigned int                  c;
+	int                           ret;
+
+	ret = dpack_encoder_flush_socket(enc);
+
+	/* Chunks must not be freed while still referenced by the kernel. */
+	for (c = 0; c < enc->nr; c++) {
+		int err;
+
+		err = dpack_encoder_socket_wait(enc, c);
+		if (err) {
+			if (!ret)
+				ret = err;
+			/* Leak memory rather than corrupting transmission. */
+			if (enc->chunks[c].busy)
+				enc->mem = NULL;
+		}
+	}
+
+	free(enc->chunks);
+	free(enc->mem);
+
+	return ret;
+}
+
+static const struct dpack_encoder_ops dpack_encoder_socket_ops = {
+	.left  = dpack_encoder_socket_left,
+	.used  = dpack_encoder_socket_used,
+	.write = dpack_encoder_socket_write,
+	.fini  = dpack_encoder_socket_fini
+};
+
+int
+dpack_encoder_init_socket(struct dpack_encoder_socket * __restrict encoder,
+                          int                                      fd,
+                          size_t                                   size,
+                          unsigned int                             nr,
+                          size_t                                   zcopy)
+{
+	dpack_assert_api(encoder);
+	dpack_assert_api(fd >= 0);
+	dpack_assert_api(size);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_ENCODER_SOCKET_CHUNK_NR_MAX);
+
+	size_t page = (size_t)stroll_page_size();
+	int    one = 1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one))) {
+		/* Not a TCP socket or zero-copy unsupported: always copy. */
+		if ((errno != EOPNOTSUPP) && (errno != ENOPROTOOPT))
+			return -errno;
+		zcopy = 0;
+	}
+	else
+		zcopy = stroll_max(zcopy, (size_t)1);
+
+	size = stroll_align_upper(size, page);
+	if (size > (SIZE_MAX / nr))
+		return -ENOMEM;
+
+	encoder->chunks = calloc(nr, sizeof(encoder->chunks[0]));
+	if (!encoder->chunks)
+		return -ENOMEM;
+
+	/* Align chunks on pages so that the kernel pins as few as needed. */
+	encoder->mem = aligned_alloc(page, nr * size);
+	if (!encoder->mem) {
+		free(encoder->chunks);
+		return -ENOMEM;
+	}
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_socket_ops);
+	encoder->sent = 0;
+	encoder->tail = 0;
+	encoder->csize = size;
+	encoder->zcopy = zcopy;
+	encoder->nr = nr;
+	encoder->head = 0;
+	encoder->next = 0;
+	encoder->done = 0;
+	encoder->poll = poll;
+	encoder->err = 0;
+	encoder->fd = fd;
+
+	return 0;
+}
@@ -181,7 +181,6 @@ dpack_load_str_tag(struct dpack_decoder * __restrict decoder)
 	return err;
 }
 
-static __dpack_nonull(1) __warn_result
 ssize_t
 dpack_decode_str_tag(struct dpack_decoder * __restrict decoder,
                      size_t                            min_len,
@@ -211,7 +210,6 @@ dpack_decode_str_tag(struct dpack_decoder * __restrict decoder,
 	return len;
 }
 
-static __dpack_nonull(1, 2) __warn_result
 ssize_t
 dpack_xtract_strdup(struct dpack_decoder * __restrict decoder,
                     char ** __restrict                value,
@@ -387,7 +385,6 @@ dpack_decode_strdup_range(struct dpack_decoder * decoder,
 	                 : len;
 }
 
-static __dpack_nonull(1, 2) __warn_result
 ssize_t
 dpack_xtract_strcpy(struct dpack_decoder * __restrict decoder,
                     char * __restrict                 value,
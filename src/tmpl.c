@@ -0,0 +1,200 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/tmpl.h"
+#include "common.h"
+#include <stdlib.h>
+#if defined(CONFIG_DPACK_FLOAT) || defined(CONFIG_DPACK_DOUBLE)
+#include <math.h>
+#endif /* defined(CONFIG_DPACK_FLOAT) || defined(CONFIG_DPACK_DOUBLE) */
+
+/*
+ * Encode a slot made of a tag followed by size bytes of value and record
+ * location of the latter, or location of the tag itself when value is carried
+ * by the tag.
+ */
+static __dpack_nonull(1, 3) __warn_result
+int
+dpack_tmpl_record(struct dpack_tmpl * __restrict tmpl,
+                  uint8_t                        tag,
+                  const uint8_t * __restrict     value,
+                  size_t                         size)
+{
+	dpack_tmpl_assert_api(tmpl);
+	dpack_assert_intern(value);
+
+	struct dpack_encoder *   enc = &tmpl->buff.base;
+	struct dpack_tmpl_slot * slot;
+	int                      err;
+
+	if (tmpl->nr == tmpl->max)
+		return -ENOSPC;
+
+	if ((sizeof(tag) + size) > dpack_encoder_space_left(enc))
+		return -EMSGSIZE;
+
+	slot = &tmpl->slots[tmpl->nr];
+	slot->off = dpack_encoder_space_used(enc);
+	slot->tag = tag;
+	err = dpack_write_tag(enc, tag);
+	dpack_assert_intern(!err);
+
+	if (size) {
+		slot->off += sizeof(tag);
+		slot->size = size;
+		err = dpack_encoder_write(enc, value, size);
+		dpack_assert_intern(!err);
+	}
+	else
+		slot->size = sizeof(tag);
+
+	return (int)tmpl->nr++;
+}
+
+int
+dpack_tmpl_encode_bool(struct dpack_tmpl * __restrict tmpl, bool value)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	return dpack_tmpl_record(tmpl,
+	                         value ? DPACK_TRUE_TAG : DPACK_FALSE_TAG,
+	                         (const uint8_t *)&value,
+	                         0);
+}
+
+int
+dpack_tmpl_encode_uint32(struct dpack_tmpl * __restrict tmpl, uint32_t value)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	value = htobe32(value);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_UINT32_TAG,
+	                         (const uint8_t *)&value,
+	                         sizeof(value));
+}
+
+int
+dpack_tmpl_encode_int32(struct dpack_tmpl * __restrict tmpl, int32_t value)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	uint32_t val = htobe32((uint32_t)value);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_INT32_TAG,
+	                         (const uint8_t *)&val,
+	                         sizeof(val));
+}
+
+int
+dpack_tmpl_encode_uint64(struct dpack_tmpl * __restrict tmpl, uint64_t value)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	value = htobe64(value);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_UINT64_TAG,
+	                         (const uint8_t *)&value,
+	                         sizeof(value));
+}
+
+int
+dpack_tmpl_encode_int64(struct dpack_tmpl * __restrict tmpl, int64_t value)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	uint64_t val = htobe64((uint64_t)value);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_INT64_TAG,
+	                         (const uint8_t *)&val,
+	                         sizeof(val));
+}
+
+#if defined(CONFIG_DPACK_FLOAT)
+
+int
+dpack_tmpl_encode_float(struct dpack_tmpl * __restrict tmpl, float value)
+{
+	dpack_tmpl_assert_api(tmpl);
+	dpack_assert_api(!isnanf(value));
+
+	union { float f; uint32_t u; } val = { .f = value };
+
+	val.u = htobe32(val.u);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_FLOAT32_TAG,
+	                         (const uint8_t *)&val.u,
+	                         sizeof(val.u));
+}
+
+#endif /* defined(CONFIG_DPACK_FLOAT) */
+
+#if defined(CONFIG_DPACK_DOUBLE)
+
+int
+dpack_tmpl_encode_double(struct dpack_tmpl * __restrict tmpl, double value)
+{
+	dpack_tmpl_assert_api(tmpl);
+	dpack_assert_api(!isnan(value));
+
+	union { double d; uint64_t u; } val = { .d = value };
+
+	val.u = htobe64(val.u);
+
+	return dpack_tmpl_record(tmpl,
+	                         DPACK_FLOAT64_TAG,
+	                         (const uint8_t *)&val.u,
+	                         sizeof(val.u));
+}
+
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+
+int
+dpack_tmpl_init(struct dpack_tmpl * __restrict tmpl,
+                size_t                         size,
+                unsigned int                   nr)
+{
+	dpack_assert_api(tmpl);
+	dpack_assert_api(size);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= INT_MAX);
+
+	uint8_t * buff;
+
+	buff = malloc(size);
+	if (!buff)
+		return -ENOMEM;
+
+	tmpl->slots = malloc(nr * sizeof(tmpl->slots[0]));
+	if (!tmpl->slots) {
+		free(buff);
+		return -ENOMEM;
+	}
+
+	dpack_encoder_init_buffer(&tmpl->buff, buff, size);
+	tmpl->nr = 0;
+	tmpl->max = nr;
+
+	return 0;
+}
+
+void
+dpack_tmpl_fini(struct dpack_tmpl * __restrict tmpl)
+{
+	dpack_tmpl_assert_api(tmpl);
+
+	uint8_t * buff = tmpl->buff.buff;
+
+	dpack_encoder_fini(&tmpl->buff.base);
+	free(buff);
+	free(tmpl->slots);
+}
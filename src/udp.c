@@ -0,0 +1,244 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/udp.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define dpack_udp_assert_batch_api(_batch) \
+	dpack_assert_api(_batch); \
+	dpack_assert_api((_batch)->hdrs); \
+	dpack_assert_api((_batch)->iovs); \
+	dpack_assert_api((_batch)->addrs); \
+	dpack_assert_api((_batch)->arena); \
+	dpack_assert_api((_batch)->msg_max); \
+	dpack_assert_api((_batch)->msg_max <= DPACK_UDP_MSG_SIZE_MAX); \
+	dpack_assert_api((_batch)->nr); \
+	dpack_assert_api((_batch)->nr <= DPACK_UDP_BATCH_NR_MAX); \
+	dpack_assert_api((_batch)->head <= (_batch)->cnt); \
+	dpack_assert_api((_batch)->cnt <= (_batch)->nr); \
+	dpack_assert_api((_batch)->fd >= 0)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+uint8_t *
+dpack_udp_slot(const struct dpack_udp_batch * __restrict batch,
+               unsigned int                              index)
+{
+	dpack_udp_assert_batch_api(batch);
+	dpack_assert_intern(index < batch->nr);
+
+	return &batch->arena[(size_t)index * batch->msg_max];
+}
+
+int
+dpack_udp_batch_init(struct dpack_udp_batch * __restrict batch,
+                     int                                 fd,
+                     unsigned int                        nr,
+                     size_t                              msg_max)
+{
+	dpack_assert_api(batch);
+	dpack_assert_api(fd >= 0);
+	dpack_assert_api(nr);
+	dpack_assert_api(nr <= DPACK_UDP_BATCH_NR_MAX);
+	dpack_assert_api(msg_max);
+	dpack_assert_api(msg_max <= DPACK_UDP_MSG_SIZE_MAX);
+
+	unsigned int m;
+
+	batch->hdrs = calloc(nr, sizeof(batch->hdrs[0]));
+	batch->iovs = malloc(nr * sizeof(batch->iovs[0]));
+	batch->addrs = malloc(nr * sizeof(batch->addrs[0]));
+	batch->arena = malloc(nr * msg_max);
+	if (!batch->hdrs || !batch->iovs || !batch->addrs || !batch->arena) {
+		free(batch->arena);
+		free(batch->addrs);
+		free(batch->iovs);
+		free(batch->hdrs);
+		return -ENOMEM;
+	}
+
+	/* Message vectors point to their own slot once for all. */
+	for (m = 0; m < nr; m++) {
+		batch->iovs[m].iov_base = &batch->arena[(size_t)m * msg_max];
+		batch->hdrs[m].msg_hdr.msg_iov = &batch->iovs[m];
+		batch->hdrs[m].msg_hdr.msg_iovlen = 1;
+	}
+
+	batch->msg_max = msg_max;
+	batch->nr = nr;
+	batch->head = 0;
+	batch->cnt = 0;
+	batch->fd = fd;
+
+	return 0;
+}
+
+void
+dpack_udp_batch_fini(struct dpack_udp_batch * __restrict batch)
+{
+	dpack_udp_assert_batch_api(batch);
+
+	free(batch->arena);
+	free(batch->addrs);
+	free(batch->iovs);
+	free(batch->hdrs);
+}
+
+int
+dpack_encoder_init_udp(struct dpack_encoder_udp * __restrict encoder,
+                       struct dpack_udp_batch * __restrict   batch)
+{
+	dpack_assert_api(encoder);
+	dpack_udp_assert_batch_api(batch);
+
+	if (batch->cnt == batch->nr)
+		return -ENOBUFS;
+
+	dpack_encoder_init_buffer(&encoder->buff,
+	                          dpack_udp_slot(batch, batch->cnt),
+	                          batch->msg_max);
+	encoder->batch = batch;
+
+	return 0;
+}
+
+void
+dpack_encoder_commit_udp(struct dpack_encoder_udp * __restrict encoder,
+                         const struct sockaddr * __restrict    addr,
+                         socklen_t                             size)
+{
+	dpack_assert_api(encoder);
+	dpack_udp_assert_batch_api(encoder->batch);
+	dpack_assert_api(encoder->batch->cnt < encoder->batch->nr);
+	dpack_assert_api(!addr || size);
+	dpack_assert_api(size <= sizeof(encoder->batch->addrs[0]));
+
+	struct dpack_udp_batch * batch = encoder->batch;
+	unsigned int             cnt = batch->cnt;
+	struct msghdr *          hdr = &batch->hdrs[cnt].msg_hdr;
+	size_t                   used;
+
+	used = dpack_encoder_space_used(&encoder->buff.base);
+	batch->iovs[cnt].iov_len = used;
+	if (addr) {
+		memcpy(&batch->addrs[cnt], addr, size);
+		hdr->msg_name = &batch->addrs[cnt];
+		hdr->msg_namelen = size;
+	}
+	else {
+		hdr->msg_name = NULL;
+		hdr->msg_namelen = 0;
+	}
+
+	dpack_encoder_fini(&encoder->buff.base);
+	batch->cnt = cnt + 1;
+}
+
+int
+dpack_udp_batch_send(struct dpack_udp_batch * __restrict batch)
+{
+	dpack_udp_assert_batch_api(batch);
+
+	unsigned int sent = 0;
+	int          ret = 0;
+
+	while (batch->head < batch->cnt) {
+		ret = sendmmsg(batch->fd,
+		               &batch->hdrs[batch->head],
+		               batch->cnt - batch->head,
+		               0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+
+		/* Messages sent so far are never sent again. */
+		batch->head += (unsigned int)ret;
+		sent += (unsigned int)ret;
+	}
+
+	if (batch->head == batch->cnt) {
+		/* All sent: give message slots back. */
+		batch->head = 0;
+		batch->cnt = 0;
+	}
+
+	return (!sent && (ret < 0)) ? ret : (int)sent;
+}
+
+int
+dpack_udp_batch_recv(struct dpack_udp_batch * __restrict batch, int flags)
+{
+	dpack_udp_assert_batch_api(batch);
+
+	unsigned int m;
+	int          ret;
+
+	/* Reset vectors possibly modified by previous send / receive calls. */
+	for (m = 0; m < batch->nr; m++) {
+		struct msghdr * hdr = &batch->hdrs[m].msg_hdr;
+
+		batch->iovs[m].iov_len = batch->msg_max;
+		hdr->msg_name = &batch->addrs[m];
+		hdr->msg_namelen = sizeof(batch->addrs[m]);
+		hdr->msg_flags = 0;
+	}
+
+	batch->head = 0;
+	batch->cnt = 0;
+
+	do {
+		ret = recvmmsg(batch->fd, batch->hdrs, batch->nr, flags, NULL);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (ret < 0)
+		return -errno;
+
+	batch->cnt = (unsigned int)ret;
+
+	return ret;
+}
+
+int
+dpack_decoder_init_udp(struct dpack_decoder_buffer * __restrict decoder,
+                       const struct dpack_udp_batch * __restrict batch,
+                       unsigned int                              index)
+{
+	dpack_assert_api(decoder);
+	dpack_udp_assert_batch_api(batch);
+	dpack_assert_api(index < batch->cnt);
+
+	const struct mmsghdr * hdr = &batch->hdrs[index];
+
+	if (hdr->msg_hdr.msg_flags & MSG_TRUNC)
+		return -EMSGSIZE;
+	if (!hdr->msg_len)
+		return -ENODATA;
+
+	dpack_decoder_init_buffer(decoder,
+	                          dpack_udp_slot(batch, index),
+	                          hdr->msg_len);
+
+	return 0;
+}
+
+const struct sockaddr *
+dpack_udp_batch_peer(const struct dpack_udp_batch * __restrict batch,
+                     unsigned int                              index,
+                     socklen_t * __restrict                    size)
+{
+	dpack_udp_assert_batch_api(batch);
+	dpack_assert_api(index < batch->cnt);
+	dpack_assert_api(size);
+
+	*size = batch->hdrs[index].msg_hdr.msg_namelen;
+
+	return (const struct sockaddr *)&batch->addrs[index];
+}
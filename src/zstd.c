@@ -0,0 +1,513 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/zstd.h"
+#include "common.h"
+#include <zstd.h>
+#include <zstd_errors.h>
+#include <stdlib.h>
+#include <string.h>
+
+static __dpack_nothrow __warn_result
+int
+dpack_zstd_errno(size_t ret, int dflt)
+{
+	dpack_assert_intern(ZSTD_isError(ret));
+	dpack_assert_intern(dflt < 0);
+
+	switch (ZSTD_getErrorCode(ret)) {
+	case ZSTD_error_memory_allocation:
+		return -ENOMEM;
+
+	case ZSTD_error_parameter_unsupported:
+	case ZSTD_error_parameter_outOfBound:
+		return -EINVAL;
+
+	case ZSTD_error_frameParameter_windowTooLarge:
+		return -EMSGSIZE;
+
+	default:
+		return dflt;
+	}
+}
+
+/******************************************************************************
+ * Compressing encoder / packer
+ ******************************************************************************/
+
+#define dpack_encoder_assert_zstd_api(_enc) \
+	dpack_assert_api(_enc); \
+	dpack_encoder_assert_api((_enc)->next); \
+	dpack_assert_api((_enc)->cctx); \
+	dpack_assert_api((_enc)->block); \
+	dpack_assert_api((_enc)->capa)
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_zstd_left(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_zstd_api((const struct dpack_encoder_zstd *)
+	                              encoder);
+
+	const struct dpack_encoder_zstd * enc =
+		(const struct dpack_encoder_zstd *)encoder;
+
+	/* Compressed size is unknown in advance: stream is unbounded. */
+	return SIZE_MAX - enc->done;
+}
+
+static __dpack_nonull(1) __dpack_pure __dpack_nothrow __warn_result
+size_t
+dpack_encoder_zstd_used(const struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_zstd_api((const struct dpack_encoder_zstd *)
+	                              encoder);
+
+	const struct dpack_encoder_zstd * enc =
+		(const struct dpack_encoder_zstd *)encoder;
+
+	return enc->done;
+}
+
+/*
+ * Feed input to compressor and write compressed data to underlying encoder.
+ *
+ * Unless continuing, loop until the compressor reports it has nothing left to
+ * flush.
+ */
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_zstd_compress(struct dpack_encoder_zstd * __restrict encoder,
+                            ZSTD_inBuffer * __restrict             input,
+                            ZSTD_EndDirective                      op)
+{
+	dpack_assert_intern(encoder);
+	dpack_assert_intern(input);
+
+	size_t ret;
+
+	do {
+		ZSTD_outBuffer out = {
+			.dst  = encoder->block,
+			.size = encoder->capa,
+			.pos  = 0
+		};
+
+		ret = ZSTD_compressStream2(encoder->cctx, &out, input, op);
+		if (ZSTD_isError(ret))
+			return dpack_zstd_errno(ret, -EIO);
+
+		if (out.pos) {
+			int err;
+
+			err = dpack_encoder_write(encoder->next,
+			                          encoder->block,
+			                          out.pos);
+			if (err)
+				return err;
+		}
+	} while ((op == ZSTD_e_continue) ? (input->pos < input->size) : ret);
+
+	return 0;
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_encoder_zstd_write(struct dpack_encoder * __restrict encoder,
+                         const uint8_t * __restrict        data,
+                         size_t                            size)
+{
+	dpack_encoder_assert_zstd_api((const struct dpack_encoder_zstd *)
+	                              encoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	struct dpack_encoder_zstd * enc = (struct dpack_encoder_zstd *)encoder;
+	ZSTD_inBuffer               in = {
+		.src  = data,
+		.size = size,
+		.pos  = 0
+	};
+	int                         err;
+
+	if (size > dpack_encoder_zstd_left(encoder))
+		return -EMSGSIZE;
+
+	err = dpack_encoder_zstd_compress(enc, &in, ZSTD_e_continue);
+	if (err)
+		return err;
+
+	enc->done += size;
+
+	return 0;
+}
+
+int
+dpack_encoder_flush_zstd(struct dpack_encoder_zstd * __restrict encoder)
+{
+	dpack_encoder_assert_zstd_api(encoder);
+
+	ZSTD_inBuffer in = { .src = NULL, .size = 0, .pos = 0 };
+
+	return dpack_encoder_zstd_compress(encoder, &in, ZSTD_e_flush);
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_encoder_zstd_fini(struct dpack_encoder * __restrict encoder)
+{
+	dpack_encoder_assert_zstd_api((const struct dpack_encoder_zstd *)
+	                              encoder);
+
+	struct dpack_encoder_zstd * enc = (struct dpack_encoder_zstd *)encoder;
+	ZSTD_inBuffer               in = { .src = NULL, .size = 0, .pos = 0 };
+	int                         err;
+
+	/*
+	 * Terminate compressed frame. Underlying encoder is owned by the
+	 * caller: do not finalize it.
+	 */
+	err = dpack_encoder_zstd_compress(enc, &in, ZSTD_e_end);
+
+	ZSTD_freeCCtx(enc->cctx);
+	free(enc->block);
+
+	return err;
+}
+
+static const struct dpack_encoder_ops dpack_encoder_zstd_ops = {
+	.left  = dpack_encoder_zstd_left,
+	.used  = dpack_encoder_zstd_used,
+	.write = dpack_encoder_zstd_write,
+	.fini  = dpack_encoder_zstd_fini
+};
+
+int
+dpack_encoder_init_zstd(struct dpack_encoder_zstd * __restrict encoder,
+                        struct dpack_encoder * __restrict      next,
+                        int                                    level,
+                        unsigned int                           wlog)
+{
+	dpack_assert_api(encoder);
+	dpack_encoder_assert_api(next);
+
+	size_t ret;
+	int    err;
+
+	if (wlog > INT_MAX)
+		return -EINVAL;
+
+	encoder->cctx = ZSTD_createCCtx();
+	if (!encoder->cctx)
+		return -ENOMEM;
+
+	/* Zero level and window selects compressor defaults. */
+	ret = ZSTD_CCtx_setParameter(encoder->cctx,
+	                             ZSTD_c_compressionLevel,
+	                             level);
+	if (!ZSTD_isError(ret))
+		ret = ZSTD_CCtx_setParameter(encoder->cctx,
+		                             ZSTD_c_windowLog,
+		                             (int)wlog);
+	if (!ZSTD_isError(ret))
+		/* Let decoders detect corrupted archives. */
+		ret = ZSTD_CCtx_setParameter(encoder->cctx,
+		                             ZSTD_c_checksumFlag,
+		                             1);
+	if (ZSTD_isError(ret)) {
+		err = dpack_zstd_errno(ret, -EINVAL);
+		goto free;
+	}
+
+	encoder->capa = ZSTD_CStreamOutSize();
+	encoder->block = malloc(encoder->capa);
+	if (!encoder->block) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	dpack_encoder_init(&encoder->base, &dpack_encoder_zstd_ops);
+	encoder->next = next;
+	encoder->done = 0;
+
+	return 0;
+
+free:
+	ZSTD_freeCCtx(encoder->cctx);
+
+	return err;
+}
+
+/******************************************************************************
+ * Decompressing decoder / unpacker
+ ******************************************************************************/
+
+#define dpack_decoder_assert_zstd_api(_dec) \
+	dpack_assert_api(_dec); \
+	dpack_decoder_assert_api((_dec)->next); \
+	dpack_assert_api((_dec)->dctx); \
+	dpack_assert_api((_dec)->in); \
+	dpack_assert_api((_dec)->in_capa); \
+	dpack_assert_api((_dec)->in_tail <= (_dec)->in_capa); \
+	dpack_assert_api((_dec)->in_head <= (_dec)->in_tail); \
+	dpack_assert_api((_dec)->out); \
+	dpack_assert_api((_dec)->out_capa); \
+	dpack_assert_api((_dec)->out_tail <= (_dec)->out_capa); \
+	dpack_assert_api((_dec)->out_head <= (_dec)->out_tail)
+
+/*
+ * Decompressed data staging block is refilled as soon as it is fully consumed
+ * so that it is found empty at end of stream only.
+ */
+static __dpack_nonull(1) __dpack_pure __warn_result
+size_t
+dpack_decoder_zstd_left(const struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_zstd_api((const struct dpack_decoder_zstd *)
+	                              decoder);
+
+	const struct dpack_decoder_zstd * dec =
+		(const struct dpack_decoder_zstd *)decoder;
+	size_t                            staged = dec->out_tail -
+	                                           dec->out_head;
+
+	if (!staged ||
+	    ((dec->in_head == dec->in_tail) &&
+	     dec->idle &&
+	     !dpack_decoder_data_left(dec->next)))
+		return staged;
+
+	/* Decompressed size is unknown until all of it has been staged. */
+	return SIZE_MAX - dec->done;
+}
+
+/* Decompress more data once staging block has been fully consumed. */
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_zstd_fill(struct dpack_decoder_zstd * __restrict decoder)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(decoder->out_head == decoder->out_tail);
+
+	decoder->out_head = 0;
+	decoder->out_tail = 0;
+
+	while (true) {
+		ZSTD_outBuffer out = {
+			.dst  = decoder->out,
+			.size = decoder->out_capa,
+			.pos  = 0
+		};
+		ZSTD_inBuffer  in;
+		size_t         ret;
+
+		if (decoder->in_head == decoder->in_tail) {
+			size_t size = dpack_decoder_data_left(decoder->next);
+
+			size = stroll_min(decoder->in_capa, size);
+			if (size) {
+				int err;
+
+				err = dpack_decoder_read(decoder->next,
+				                         decoder->in,
+				                         size);
+				if (err)
+					return err;
+
+				decoder->in_head = 0;
+				decoder->in_tail = size;
+			}
+			else if (decoder->idle)
+				/* End of stream. */
+				return 0;
+		}
+
+		in.src = decoder->in;
+		in.size = decoder->in_tail;
+		in.pos = decoder->in_head;
+		ret = ZSTD_decompressStream(decoder->dctx, &out, &in);
+		if (ZSTD_isError(ret))
+			return dpack_zstd_errno(ret, -EBADMSG);
+
+		decoder->in_head = in.pos;
+		decoder->idle = !ret;
+		if (out.pos) {
+			decoder->out_tail = out.pos;
+			return 0;
+		}
+
+		if ((decoder->in_head == decoder->in_tail) &&
+		    !decoder->idle &&
+		    !dpack_decoder_data_left(decoder->next))
+			/* Compressed data ends in the middle of a frame. */
+			return -ENODATA;
+	}
+}
+
+/* Consume staged data, copying it to data when not NULL. */
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_zstd_consume(struct dpack_decoder_zstd * __restrict decoder,
+                           uint8_t * __restrict                   data,
+                           size_t                                 size)
+{
+	dpack_assert_intern(decoder);
+	dpack_assert_intern(size);
+
+	if (size > dpack_decoder_zstd_left(&decoder->base))
+		return -ENODATA;
+
+	while (true) {
+		size_t bytes = decoder->out_tail - decoder->out_head;
+
+		bytes = stroll_min(size, bytes);
+
+		if (data) {
+			memcpy(data, &decoder->out[decoder->out_head], bytes);
+			data += bytes;
+		}
+		decoder->out_head += bytes;
+		decoder->done += bytes;
+		size -= bytes;
+
+		if (decoder->out_head == decoder->out_tail) {
+			int err;
+
+			err = dpack_decoder_zstd_fill(decoder);
+			if (err)
+				return err;
+		}
+
+		if (!size)
+			return 0;
+
+		if (decoder->out_head == decoder->out_tail)
+			return -ENODATA;
+	}
+}
+
+static __dpack_nonull(1, 2) __warn_result
+int
+dpack_decoder_zstd_read(struct dpack_decoder * __restrict decoder,
+                        uint8_t * __restrict              data,
+                        size_t                            size)
+{
+	dpack_decoder_assert_zstd_api((const struct dpack_decoder_zstd *)
+	                              decoder);
+	dpack_assert_api(data);
+	dpack_assert_api(size);
+
+	return dpack_decoder_zstd_consume((struct dpack_decoder_zstd *)decoder,
+	                                  data,
+	                                  size);
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_zstd_skip(struct dpack_decoder * __restrict decoder,
+                        size_t                            size)
+{
+	dpack_decoder_assert_zstd_api((const struct dpack_decoder_zstd *)
+	                              decoder);
+	dpack_assert_api(size);
+
+	/* Decompress and discard. */
+	return dpack_decoder_zstd_consume((struct dpack_decoder_zstd *)decoder,
+	                                  NULL,
+	                                  size);
+}
+
+static __dpack_nonull(1) __warn_result
+int
+dpack_decoder_zstd_fini(struct dpack_decoder * __restrict decoder)
+{
+	dpack_decoder_assert_zstd_api((const struct dpack_decoder_zstd *)
+	                              decoder);
+
+	struct dpack_decoder_zstd * dec = (struct dpack_decoder_zstd *)decoder;
+
+	/* Underlying decoder is owned by the caller: do not finalize it. */
+	ZSTD_freeDCtx(dec->dctx);
+	free(dec->out);
+	free(dec->in);
+
+	return 0;
+}
+
+static const struct dpack_decoder_ops dpack_decoder_zstd_ops = {
+	.left = dpack_decoder_zstd_left,
+	.read = dpack_decoder_zstd_read,
+	.skip = dpack_decoder_zstd_skip,
+	.fini = dpack_decoder_zstd_fini
+};
+
+int
+dpack_decoder_init_zstd(struct dpack_decoder_zstd * __restrict decoder,
+                        struct dpack_decoder * __restrict      next,
+                        unsigned int                           wlog)
+{
+	dpack_assert_api(decoder);
+	dpack_decoder_assert_api(next);
+
+	size_t ret;
+	int    err;
+
+	if (wlog > INT_MAX)
+		return -EINVAL;
+
+	decoder->dctx = ZSTD_createDCtx();
+	if (!decoder->dctx)
+		return -ENOMEM;
+
+	/* Zero window selects decompressor default limit. */
+	ret = ZSTD_DCtx_setParameter(decoder->dctx,
+	                             ZSTD_d_windowLogMax,
+	                             (int)wlog);
+	if (ZSTD_isError(ret)) {
+		err = dpack_zstd_errno(ret, -EINVAL);
+		goto free_ctx;
+	}
+
+	decoder->in_capa = ZSTD_DStreamInSize();
+	decoder->in = malloc(decoder->in_capa);
+	if (!decoder->in) {
+		err = -ENOMEM;
+		goto free_ctx;
+	}
+
+	decoder->out_capa = ZSTD_DStreamOutSize();
+	decoder->out = malloc(decoder->out_capa);
+	if (!decoder->out) {
+		err = -ENOMEM;
+		goto free_in;
+	}
+
+	dpack_decoder_init(&decoder->base, &dpack_decoder_zstd_ops, next->disc);
+	decoder->next = next;
+	decoder->in_head = 0;
+	decoder->in_tail = 0;
+	decoder->out_head = 0;
+	decoder->out_tail = 0;
+	decoder->done = 0;
+	decoder->idle = true;
+
+	/* Stage first decompressed block so that empty streams are detected. */
+	err = dpack_decoder_zstd_fill(decoder);
+	if (err)
+		goto free_out;
+
+	return 0;
+
+free_out:
+	free(decoder->out);
+free_in:
+	free(decoder->in);
+free_ctx:
+	ZSTD_freeDCtx(decoder->dctx);
+
+	return err;
+}
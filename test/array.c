@@ -365,6 +365,363 @@ CUTE_TEST(dpackut_array_encode_bool)
 	               DPACKUT_ARRAY_BOOL_PACK_SIZE);
 }
 
+CUTE_TEST(dpackut_array_encode_open)
+{
+	struct dpack_encoder_buffer enc;
+	struct dpack_decoder_buffer dec;
+	uint8_t                     buff[DPACK_ARRAY_OPEN_HEAD_SIZE + 2] = { 0, };
+	struct dpack_encoder_mark   mark;
+	unsigned int                nr;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(dpack_array_begin_encode_open(&enc.base,
+	                                              DPACK_ARRAY_ELMNR_MAX,
+	                                              &mark),
+	                equal,
+	                0);
+	cute_check_uint(mark.off, equal, 0);
+	cute_check_sint(dpack_encode_bool(&enc.base, false), equal, 0);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+	cute_check_sint(dpack_array_end_encode_open(&enc.base,
+	                                            &mark,
+	                                            DPACKUT_ARRAY_BOOL_ELM_NR,
+	                                            false),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                sizeof(buff));
+
+	dpack_encoder_fini(&enc.base);
+
+	/* Reserved header width is kept: check it decodes properly. */
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff));
+	cute_check_sint(dpack_array_decode_count(&dec.base, &nr), equal, 0);
+	cute_check_uint(nr, equal, DPACKUT_ARRAY_BOOL_ELM_NR);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 2);
+	dpack_decoder_fini(&dec.base);
+}
+
+CUTE_TEST(dpackut_array_encode_open_compact)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[DPACK_ARRAY_OPEN_HEAD_SIZE + 2] = { 0, };
+	struct dpack_encoder_mark   mark;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(dpack_array_begin_encode_open(&enc.base,
+	                                              DPACK_ARRAY_ELMNR_MAX,
+	                                              &mark),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encode_bool(&enc.base, false), equal, 0);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+	cute_check_sint(dpack_array_end_encode_open(&enc.base,
+	                                            &mark,
+	                                            DPACKUT_ARRAY_BOOL_ELM_NR,
+	                                            true),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_ARRAY_BOOL_PACK_SIZE);
+
+	dpack_encoder_fini(&enc.base);
+
+	cute_check_mem(buff,
+	               equal,
+	               DPACKUT_ARRAY_BOOL_PACK_DATA,
+	               DPACKUT_ARRAY_BOOL_PACK_SIZE);
+}
+
+CUTE_TEST(dpackut_array_encode_open_width)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[4] = { 0, };
+	struct dpack_encoder_mark   mark;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	/* Up to 15 elements: a single byte fixarray header is reserved. */
+	cute_check_sint(dpack_array_begin_encode_open(&enc.base, 15, &mark),
+	                equal,
+	                0);
+	cute_check_uint(mark.size, equal, DPACK_FIXARRAY_TAG_SIZE);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+	cute_check_sint(dpack_array_end_encode_open(&enc.base, &mark, 16, true),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_sint(dpack_array_end_encode_open(&enc.base, &mark, 1, true),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 2);
+	cute_check_mem(buff, equal, "\x91\xc3", 2);
+
+	dpack_encoder_fini(&enc.base);
+}
+
+CUTE_TEST(dpackut_array_encode_open_cancel)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[DPACK_ARRAY_OPEN_HEAD_SIZE + 2] = { 0, };
+	struct dpack_encoder_mark   mark;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(dpack_encode_bool(&enc.base, false), equal, 0);
+	cute_check_sint(dpack_array_begin_encode_open(&enc.base,
+	                                              DPACK_ARRAY_ELMNR_MAX,
+	                                              &mark),
+	                equal,
+	                0);
+	cute_check_uint(mark.off, equal, 1);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+
+	/* Filtered iteration yielded nothing worth keeping. */
+	cute_check_sint(dpack_array_cancel_encode_open(&enc.base, &mark),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 1);
+	cute_check_uint(buff[0], equal, 0xc2);
+
+	dpack_encoder_fini(&enc.base);
+}
+
+CUTE_TEST(dpackut_array_encode_count)
+{
+	struct dpack_encoder_count enc;
+	struct dpack_encoder_mark  mark;
+
+	dpack_encoder_init_count(&enc);
+
+	cute_check_sint(dpack_array_begin_encode(&enc.base,
+	                                         DPACKUT_ARRAY_BOOL_ELM_NR),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encode_bool(&enc.base, false), equal, 0);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+	dpack_array_end_encode(&enc.base);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_ARRAY_BOOL_PACK_SIZE);
+
+	cute_check_sint(dpack_array_begin_encode_open(&enc.base,
+	                                              DPACK_ARRAY_ELMNR_MAX,
+	                                              &mark),
+	                equal,
+	                0);
+	cute_check_uint(mark.off, equal, DPACKUT_ARRAY_BOOL_PACK_SIZE);
+	cute_check_sint(dpack_encode_bool(&enc.base, false), equal, 0);
+	cute_check_sint(dpack_encode_bool(&enc.base, true), equal, 0);
+	cute_check_sint(dpack_array_end_encode_open(&enc.base,
+	                                            &mark,
+	                                            DPACKUT_ARRAY_BOOL_ELM_NR,
+	                                            true),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                2 * DPACKUT_ARRAY_BOOL_PACK_SIZE);
+
+	/* Overflowing count is left untouched. */
+	enc.size = SIZE_MAX;
+	cute_check_sint(enc.base.ops->write(&enc.base,
+	                                    (const uint8_t *)"\xc3",
+	                                    1),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_uint(enc.size, equal, SIZE_MAX);
+
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+}
+
+#if defined(CONFIG_DPACK_ARRAY_PARALLEL)
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#define DPACKUT_ARRAY_PARALLEL_ELM_NR \
+	((DPACK_ARRAY_ELMNR_MAX < 1000U) ? DPACK_ARRAY_ELMNR_MAX : 1000U)
+
+static int
+dpackut_array_pack_parallel(struct dpack_encoder * encoder,
+                            unsigned int           id,
+                            void * __restrict      data __unused)
+{
+	return dpack_encode_uint32(encoder, id * 65537U);
+}
+
+CUTE_TEST(dpackut_array_encode_parallel)
+{
+	struct dpack_array_slices   slices;
+	struct dpack_encoder_buffer enc;
+	size_t                      size;
+	uint8_t *                   ref;
+	uint8_t *                   buff;
+	unsigned int                e;
+	int                         fd;
+
+	size = DPACK_ARRAY_UINT32_SIZE_MAX(DPACKUT_ARRAY_PARALLEL_ELM_NR);
+	ref = malloc(size);
+	cute_check_ptr(ref, unequal, NULL);
+	buff = malloc(size);
+	cute_check_ptr(buff, unequal, NULL);
+
+	dpack_encoder_init_buffer(&enc, ref, size);
+	cute_check_sint(dpack_array_begin_encode(&enc.base,
+	                                         DPACKUT_ARRAY_PARALLEL_ELM_NR),
+	                equal,
+	                0);
+	for (e = 0; e < DPACKUT_ARRAY_PARALLEL_ELM_NR; e++)
+		cute_check_sint(dpackut_array_pack_parallel(&enc.base, e, NULL),
+		                equal,
+		                0);
+	dpack_array_end_encode(&enc.base);
+	size = dpack_encoder_space_used(&enc.base);
+	dpack_encoder_fini(&enc.base);
+
+	cute_check_sint(
+		dpack_array_encode_parallel(&slices,
+		                            DPACKUT_ARRAY_PARALLEL_ELM_NR,
+		                            dpackut_array_pack_parallel,
+		                            NULL,
+		                            4),
+		equal,
+		0);
+	cute_check_uint(slices.size, equal, size);
+
+	dpack_encoder_init_buffer(&enc, buff, size);
+	cute_check_sint(dpack_array_slices_copy(&slices, &enc.base), equal, 0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, size);
+	dpack_encoder_fini(&enc.base);
+	cute_check_mem(buff, equal, ref, size);
+
+	fd = memfd_create("dpackut_array_encode_parallel", 0);
+	cute_check_sint(fd, greater_equal, 0);
+	cute_check_sint(dpack_array_slices_writev(&slices, fd), equal, 0);
+	memset(buff, 0, size);
+	cute_check_sint(pread(fd, buff, size, 0), equal, (ssize_t)size);
+	cute_check_mem(buff, equal, ref, size);
+	close(fd);
+
+	dpack_array_slices_fini(&slices);
+
+	/*
+	 * Number of slices derived from such a thread count would wrap around
+	 * when computed as unsigned int.
+	 */
+	cute_check_sint(
+		dpack_array_encode_parallel(&slices,
+		                            3,
+		                            dpackut_array_pack_parallel,
+		                            NULL,
+		                            0x40000000U),
+		equal,
+		0);
+	cute_check_uint(slices.nr, equal, 3 + 1);
+	dpack_array_slices_fini(&slices);
+
+	free(buff);
+	free(ref);
+}
+
+/*
+ * Nested arrays of 32-bit integers, large enough to overflow initial slice
+ * buffers while fitting into DPACK_ARRAY_ELMSZ_MAX.
+ */
+#define DPACKUT_ARRAY_PARALLEL_NEST_NR \
+	stroll_min(8U, (DPACK_ARRAY_ELMSZ_MAX - DPACK_FIXARRAY_TAG_SIZE) / \
+	               DPACK_UINT32_SIZE_MAX)
+
+static int
+dpackut_array_pack_parallel_nest(struct dpack_encoder * encoder,
+                                 unsigned int           id,
+                                 void * __restrict      data __unused)
+{
+	unsigned int n;
+	int          err;
+
+	err = dpack_array_begin_encode(encoder,
+	                               DPACKUT_ARRAY_PARALLEL_NEST_NR);
+	for (n = 0; !err && (n < DPACKUT_ARRAY_PARALLEL_NEST_NR); n++)
+		err = dpack_encode_uint32(encoder, (id * 65537U) + n);
+	dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+CUTE_TEST(dpackut_array_encode_parallel_grow)
+{
+	struct dpack_array_slices   slices;
+	struct dpack_encoder_buffer enc;
+	size_t                      size;
+	uint8_t *                   ref;
+	uint8_t *                   buff;
+	unsigned int                e;
+
+	size = DPACK_ARRAY32_TAG_SIZE +
+	       (DPACKUT_ARRAY_PARALLEL_ELM_NR *
+	        (DPACK_FIXARRAY_TAG_SIZE +
+	         (DPACKUT_ARRAY_PARALLEL_NEST_NR * DPACK_UINT32_SIZE_MAX)));
+	ref = malloc(size);
+	cute_check_ptr(ref, unequal, NULL);
+	buff = malloc(size);
+	cute_check_ptr(buff, unequal, NULL);
+
+	dpack_encoder_init_buffer(&enc, ref, size);
+	cute_check_sint(dpack_array_begin_encode(&enc.base,
+	                                         DPACKUT_ARRAY_PARALLEL_ELM_NR),
+	                equal,
+	                0);
+	for (e = 0; e < DPACKUT_ARRAY_PARALLEL_ELM_NR; e++)
+		cute_check_sint(dpackut_array_pack_parallel_nest(&enc.base,
+		                                                 e,
+		                                                 NULL),
+		                equal,
+		                0);
+	dpack_array_end_encode(&enc.base);
+	size = dpack_encoder_space_used(&enc.base);
+	dpack_encoder_fini(&enc.base);
+
+	/* Single thread: few large slices which buffers must be grown. */
+	cute_check_sint(
+		dpack_array_encode_parallel(&slices,
+		                            DPACKUT_ARRAY_PARALLEL_ELM_NR,
+		                            dpackut_array_pack_parallel_nest,
+		                            NULL,
+		                            1),
+		equal,
+		0);
+	cute_check_uint(slices.size, equal, size);
+
+	dpack_encoder_init_buffer(&enc, buff, size);
+	cute_check_sint(dpack_array_slices_copy(&slices, &enc.base), equal, 0);
+	dpack_encoder_fini(&enc.base);
+	cute_check_mem(buff, equal, ref, size);
+
+	dpack_array_slices_fini(&slices);
+
+	free(buff);
+	free(ref);
+}
+
+#else  /* !defined(CONFIG_DPACK_ARRAY_PARALLEL) */
+
+CUTE_TEST(dpackut_array_encode_parallel)
+{
+	cute_skip("parallel array encoding support not compiled-in");
+}
+
+CUTE_TEST(dpackut_array_encode_parallel_grow)
+{
+	cute_skip("parallel array encoding support not compiled-in");
+}
+
+#endif /* defined(CONFIG_DPACK_ARRAY_PARALLEL) */
+
 /* dpack-utest-gen.py "[-128,0,127]" */
 #define DPACKUT_ARRAY_INT8_ELM_NR \
 	(3U)
@@ -1200,6 +1557,26 @@ CUTE_TEST(dpackut_array_decode_short)
 	dpack_decoder_fini(&dec.base);
 }
 
+CUTE_TEST(dpackut_array_decode_limit)
+{
+	struct dpack_decoder_buffer dec;
+	const uint8_t               buff[] = "\x92\xc3\xc2";
+	unsigned int                nr;
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	dpack_decoder_limit_array(&dec.base, 1);
+	cute_check_sint(dpack_array_decode_count(&dec.base, &nr),
+	                equal,
+	                -EMSGSIZE);
+	dpack_decoder_fini(&dec.base);
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	dpack_decoder_limit_array(&dec.base, 2);
+	cute_check_sint(dpack_array_decode_count(&dec.base, &nr), equal, 0);
+	cute_check_uint(nr, equal, 2);
+	dpack_decoder_fini(&dec.base);
+}
+
 static int
 dpackut_array_xtract_bool(struct dpack_decoder * decoder,
                           unsigned int           id,
@@ -1769,6 +2146,114 @@ CUTE_TEST(dpackut_array_decode_str)
 	dpack_decoder_fini(&dec.base);
 }
 
+CUTE_TEST(dpackut_array_decode_strtab)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	const uint8_t               buff[] = DPACKUT_ARRAY_STR_PACK_DATA;
+	char **                     tab = NULL;
+	const char *                xpct[] = { "a", "list", "of strings" };
+	unsigned int                v;
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+
+	cute_check_sint(dpack_array_decode_strtab(&dec.base, &tab),
+	                equal,
+	                (int)stroll_array_nr(xpct));
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	cute_check_ptr(tab, unequal, NULL);
+
+	for (v = 0; v < stroll_array_nr(xpct); v++) {
+		cute_check_str(tab[v], equal, xpct[v]);
+		if (v)
+			/* Strings must be stored contiguously. */
+			cute_check_ptr(tab[v],
+			               equal,
+			               tab[v - 1] + strlen(tab[v - 1]) + 1);
+	}
+	cute_check_ptr(tab[v], equal, NULL);
+
+	free(tab);
+	dpack_decoder_fini(&dec.base);
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_range)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	const uint8_t               buff[] = DPACKUT_ARRAY_STR_PACK_DATA;
+	char **                     tab = NULL;
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_array_decode_strtab_range(&dec.base, 1, 2, &tab),
+	                equal,
+	                -EMSGSIZE);
+	dpack_decoder_fini(&dec.base);
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_array_decode_strtab_range(&dec.base, 2, 3, &tab),
+	                equal,
+	                3);
+	cute_check_str(tab[2], equal, "of strings");
+	free(tab);
+	dpack_decoder_fini(&dec.base);
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_badmsg)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	const uint8_t               buff[] = "\x92\xa1\x61\xa2\x62\x00";
+	char **                     tab = NULL;
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_array_decode_strtab(&dec.base, &tab),
+	                equal,
+	                -EBADMSG);
+	cute_check_ptr(tab, equal, NULL);
+	dpack_decoder_fini(&dec.base);
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_oversized)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	char **                     tab = NULL;
+
+#if DPACK_ARRAY_ELMNR_MAX >= 1024U
+	/* array16 announcing 1024 strings followed by 2 strings only. */
+	const uint8_t               buff[] = "\xdc\x04\x00\xa1\x61\xa1\x62";
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_array_decode_strtab(&dec.base, &tab),
+	                equal,
+	                -ENODATA);
+	cute_check_ptr(tab, equal, NULL);
+	dpack_decoder_fini(&dec.base);
+#endif /* DPACK_ARRAY_ELMNR_MAX >= 1024U */
+
+#if DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX
+	/* array32 announcing 0x7fffffff strings followed by 2 strings only. */
+	const uint8_t               huge[] = "\xdd\x7f\xff\xff\xff"
+	                                     "\xa1\x61\xa1\x62";
+	/* array32 announcing 0xffffffff strings followed by 2 strings only. */
+	const uint8_t               over[] = "\xdd\xff\xff\xff\xff"
+	                                     "\xa1\x61\xa1\x62";
+
+	dpack_decoder_init_buffer(&dec, huge, sizeof(huge) - 1);
+	cute_check_sint(dpack_array_decode_strtab(&dec.base, &tab),
+	                equal,
+	                (DPACK_ARRAY_ELMNR_MAX >= 0x7fffffffU) ? -ENODATA
+	                                                       : -ENOTSUP);
+	cute_check_ptr(tab, equal, NULL);
+	dpack_decoder_fini(&dec.base);
+
+	/* Count beyond the largest configurable limit. */
+	dpack_decoder_init_buffer(&dec, over, sizeof(over) - 1);
+	cute_check_sint(dpack_array_decode_strtab(&dec.base, &tab),
+	                equal,
+	                -ENOTSUP);
+	cute_check_ptr(tab, equal, NULL);
+	dpack_decoder_fini(&dec.base);
+#endif /* DPACK_ARRAY_ELMNR_MAX > _DPACK_ARRAY16_ELMNR_MAX */
+}
+
 #else  /* !defined(CONFIG_DPACK_STRING) */
 
 CUTE_TEST(dpackut_array_decode_str)
@@ -1776,6 +2261,26 @@ CUTE_TEST(dpackut_array_decode_str)
 	cute_skip("MessagePack string support not compiled-in");
 }
 
+CUTE_TEST(dpackut_array_decode_strtab)
+{
+	cute_skip("MessagePack string support not compiled-in");
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_range)
+{
+	cute_skip("MessagePack string support not compiled-in");
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_badmsg)
+{
+	cute_skip("MessagePack string support not compiled-in");
+}
+
+CUTE_TEST(dpackut_array_decode_strtab_oversized)
+{
+	cute_skip("MessagePack string support not compiled-in");
+}
+
 #endif  /* !defined(CONFIG_DPACK_STRING) */
 
 #if defined(CONFIG_DPACK_BIN)
@@ -1981,6 +2486,13 @@ CUTE_GROUP(dpackut_array_group) = {
 	CUTE_REF(dpackut_array_encode_goon_msgsize),
 
 	CUTE_REF(dpackut_array_encode_bool),
+	CUTE_REF(dpackut_array_encode_open),
+	CUTE_REF(dpackut_array_encode_open_compact),
+	CUTE_REF(dpackut_array_encode_open_width),
+	CUTE_REF(dpackut_array_encode_open_cancel),
+	CUTE_REF(dpackut_array_encode_count),
+	CUTE_REF(dpackut_array_encode_parallel),
+	CUTE_REF(dpackut_array_encode_parallel_grow),
 	CUTE_REF(dpackut_array_encode_int8),
 	CUTE_REF(dpackut_array_encode_uint8),
 	CUTE_REF(dpackut_array_encode_int16),
@@ -2005,6 +2517,7 @@ CUTE_GROUP(dpackut_array_group) = {
 	CUTE_REF(dpackut_array_decode_nodata),
 	CUTE_REF(dpackut_array_decode_starve),
 	CUTE_REF(dpackut_array_decode_short),
+	CUTE_REF(dpackut_array_decode_limit),
 
 	CUTE_REF(dpackut_array_decode_bool),
 	CUTE_REF(dpackut_array_decode_int8),
@@ -2018,6 +2531,10 @@ CUTE_GROUP(dpackut_array_group) = {
 	CUTE_REF(dpackut_array_decode_float),
 	CUTE_REF(dpackut_array_decode_double),
 	CUTE_REF(dpackut_array_decode_str),
+	CUTE_REF(dpackut_array_decode_strtab),
+	CUTE_REF(dpackut_array_decode_strtab_range),
+	CUTE_REF(dpackut_array_decode_strtab_badmsg),
+	CUTE_REF(dpackut_array_decode_strtab_oversized),
 	CUTE_REF(dpackut_array_decode_bin),
 	CUTE_REF(dpackut_array_decode_multi)
 };
@@ -3335,6 +3335,49 @@ CUTE_TEST(dpackut_bin_decode_cpy_range_nok_binsz_short)
 	                             DPACK_BINSZ_MAX);
 }
 
+CUTE_TEST(dpackut_bin_decode_lend_backed)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = NULL;
+	const uint8_t *             bin = NULL;
+	const uint8_t               buff[] = { 0xc4, 0x02, 0x30, 0x31 };
+
+	back = dpack_backing_create(sizeof(buff));
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data, buff, sizeof(buff));
+
+	dpack_decoder_init_backed_buffer(&dec, back, sizeof(buff));
+	dpack_backing_put(back);
+
+	cute_check_sint(dpack_decode_bin_lend(&dec.base, &bin, &ref), equal, 2);
+	cute_check_ptr(ref, equal, back);
+	cute_check_ptr(bin, equal, &back->data[2]);
+	dpack_decoder_fini(&dec.base);
+
+	/* Bin must remain valid after decoder is released. */
+	cute_check_mem(bin, equal, &buff[2], 2);
+	dpack_backing_put(ref);
+}
+
+CUTE_TEST(dpackut_bin_decode_lend_copy)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	const uint8_t *             bin = NULL;
+	const uint8_t               buff[] = { 0xc4, 0x02, 0x30, 0x31 };
+
+	/* Caller owned buffers cannot be lent: bin is copied. */
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff));
+	cute_check_sint(dpack_decode_bin_lend(&dec.base, &bin, &ref), equal, 2);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_ptr(bin, unequal, &buff[2]);
+	cute_check_mem(bin, equal, &buff[2], 2);
+	dpack_decoder_fini(&dec.base);
+
+	free((void *)bin);
+}
+
 CUTE_GROUP(dpackut_bin_group) = {
 	CUTE_REF(dpackut_bin8_sizes),
 	CUTE_REF(dpackut_bin16_sizes),
@@ -3568,7 +3611,10 @@ CUTE_GROUP(dpackut_bin_group) = {
 	CUTE_REF(dpackut_bin_decode_cpy_range_ok_binszminus_sup),
 	CUTE_REF(dpackut_bin_decode_cpy_range_nok_binszminus_short_sup),
 	CUTE_REF(dpackut_bin_decode_cpy_range_ok_binsz),
-	CUTE_REF(dpackut_bin_decode_cpy_range_nok_binsz_short)
+	CUTE_REF(dpackut_bin_decode_cpy_range_nok_binsz_short),
+
+	CUTE_REF(dpackut_bin_decode_lend_backed),
+	CUTE_REF(dpackut_bin_decode_lend_copy)
 };
 
 CUTE_SUITE_EXTERN(dpackut_bin_suite,
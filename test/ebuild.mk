@@ -34,6 +34,12 @@ test-cflags         := $(filter-out -DNDEBUG,$(test-cflags))
 test-ldflags        := $(filter-out -DNDEBUG,$(test-ldflags))
 endif # ($(filter y,$(CONFIG_DPACK_ASSERT_API) $(CONFIG_DPACK_ASSERT_INTERN)),)
 
+# Journal and multi-producer buffer tests spawn POSIX threads.
+ifneq ($(filter y,$(CONFIG_DPACK_JOURNAL) $(CONFIG_DPACK_CODEC_MPBUFFER)),)
+test-cflags         += -pthread
+test-ldflags        += -pthread
+endif # ($(filter y,$(CONFIG_DPACK_JOURNAL) $(CONFIG_DPACK_CODEC_MPBUFFER)),)
+
 builtins            := builtin.a
 builtin.a-objs      := utest.o $(config-obj)
 builtin.a-cflags    := $(test-cflags)
@@ -55,7 +61,20 @@ dpack-utest-objs    += $(call kconf_enabled,DPACK_SCALAR,uint64.o)
 dpack-utest-objs    += $(call kconf_enabled,DPACK_SCALAR,int64.o)
 dpack-utest-objs    += $(call kconf_enabled,DPACK_STRING,string.o)
 dpack-utest-objs    += $(call kconf_enabled,DPACK_LVSTR,lvstr.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_INTERN,intern.o)
 dpack-utest-objs    += $(call kconf_enabled,DPACK_MAP,map.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_JOURNAL,journal.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_RING,ring.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_MEMFD,memfd.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_FILE_PARALLEL,file.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_MPBUFFER,mpbuffer.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_SOCKET,socket.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_FD,fd.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_FILTER,filter.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_CODEC_ZSTD,zstd.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_RPC,rpc.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_UDP,udp.o)
+dpack-utest-objs    += $(call kconf_enabled,DPACK_TMPL,tmpl.o)
 dpack-utest-cflags  := $(test-cflags)
 dpack-utest-ldflags := $(test-ldflags)
 dpack-utest-pkgconf := libstroll libcute
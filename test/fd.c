@@ -0,0 +1,328 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/fd.h"
+#include "dpack/scalar.h"
+#include "dpack/string.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Encoded size of values used below. */
+#define DPACKUT_FD_VAL_SIZE (5U)
+#define DPACKUT_FD_VAL_BASE (0x10000U)
+
+static void
+dpackut_fd_pipe(int fds[2])
+{
+	cute_check_sint(pipe2(fds, O_CLOEXEC | O_NONBLOCK), equal, 0);
+}
+
+static size_t
+dpackut_fd_check(int fd, unsigned int first, unsigned int nr)
+{
+	uint8_t                     buff[4096];
+	ssize_t                     ret;
+	struct dpack_decoder_buffer dec;
+	unsigned int                v;
+
+	ret = read(fd, buff, sizeof(buff));
+	if (!nr) {
+		cute_check_sint(ret, equal, -1);
+		cute_check_sint(errno, equal, EAGAIN);
+		return 0;
+	}
+
+	cute_check_sint(ret, equal, nr * DPACKUT_FD_VAL_SIZE);
+
+	dpack_decoder_init_buffer(&dec, buff, (size_t)ret);
+	for (v = first; v < (first + nr); v++) {
+		uint32_t val;
+
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, DPACKUT_FD_VAL_BASE + v);
+	}
+	dpack_decoder_fini(&dec.base);
+
+	return (size_t)ret;
+}
+
+CUTE_TEST(dpackut_fd_thres)
+{
+	int                     fds[2];
+	struct dpack_encoder_fd enc;
+	unsigned int            v;
+
+	dpackut_fd_pipe(fds);
+
+	/* 4 chunks of 16 bytes, written once 32 bytes are pending. */
+	cute_check_sint(dpack_encoder_init_fd(&enc, fds[1], 16, 4, 32, 60000),
+	                equal,
+	                0);
+
+	for (v = 0; v < 6; v++)
+		cute_check_sint(dpack_encode_uint32(&enc.base,
+		                                    DPACKUT_FD_VAL_BASE + v),
+		                equal,
+		                0);
+	dpackut_fd_check(fds[0], 0, 0);
+
+	/* Crossing threshold writes all 3 pending chunks at once. */
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + v),
+	                equal,
+	                0);
+	dpackut_fd_check(fds[0], 0, 7);
+	cute_check_sint(dpack_encoder_fd_timeout(&enc), equal, -1);
+
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + 7),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                8 * DPACKUT_FD_VAL_SIZE);
+
+	/* Finalization writes remaining data. */
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+	dpackut_fd_check(fds[0], 7, 1);
+
+	close(fds[1]);
+	close(fds[0]);
+}
+
+CUTE_TEST(dpackut_fd_delay)
+{
+	const struct timespec       nap = { .tv_sec = 0, .tv_nsec = 20000000 };
+	int                         fds[2];
+	struct dpack_encoder_fd     enc;
+	int                         tmout;
+	uint8_t                     buff[3 * DPACKUT_FD_VAL_SIZE];
+	ssize_t                     ret;
+	size_t                      sz;
+	struct dpack_decoder_buffer dec;
+	unsigned int                v;
+
+	dpackut_fd_pipe(fds);
+
+	/* Pending data may not wait for more than 10 milliseconds. */
+	cute_check_sint(dpack_encoder_init_fd(&enc, fds[1], 64, 2, 128, 10),
+	                equal,
+	                0);
+
+	cute_check_sint(dpack_encoder_fd_timeout(&enc), equal, -1);
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE),
+	                equal,
+	                0);
+	dpackut_fd_check(fds[0], 0, 0);
+
+	tmout = dpack_encoder_fd_timeout(&enc);
+	cute_check_sint(tmout, greater, 0);
+	cute_check_sint(tmout, lower_equal, 10);
+
+	cute_check_sint(nanosleep(&nap, NULL), equal, 0);
+	cute_check_sint(dpack_encoder_fd_timeout(&enc), equal, 0);
+
+	/*
+	 * Encoding past deadline does not sample the clock: pending data is
+	 * written upon explicit flush, as performed upon poll(2) timeout.
+	 */
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + 1),
+	                equal,
+	                0);
+	dpackut_fd_check(fds[0], 0, 0);
+	cute_check_sint(dpack_encoder_flush_fd(&enc), equal, 0);
+	ret = read(fds[0], buff, sizeof(buff));
+	cute_check_sint(ret, equal, 2 * DPACKUT_FD_VAL_SIZE);
+	sz = (size_t)ret;
+	cute_check_sint(dpack_encoder_fd_timeout(&enc), equal, -1);
+
+	/* Next write cycle is given a fresh deadline. */
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + 2),
+	                equal,
+	                0);
+	tmout = dpack_encoder_fd_timeout(&enc);
+	cute_check_sint(tmout, greater, 0);
+	cute_check_sint(tmout, lower_equal, 10);
+	cute_check_sint(dpack_encoder_flush_fd(&enc), equal, 0);
+	ret = read(fds[0], &buff[sz], sizeof(buff) - sz);
+	cute_check_sint(ret, equal, sizeof(buff) - sz);
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff));
+	for (v = 0; v < 3; v++) {
+		uint32_t val;
+
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, DPACKUT_FD_VAL_BASE + v);
+	}
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	close(fds[1]);
+	close(fds[0]);
+}
+
+CUTE_TEST(dpackut_fd_backpressure)
+{
+	int                     fds[2];
+	struct dpack_encoder_fd enc;
+	unsigned int            v = 0;
+	int                     err;
+	uint8_t                 buff[4096];
+	size_t                  sz = 0;
+	size_t                  pad = 0;
+	ssize_t                 ret;
+
+	dpackut_fd_pipe(fds);
+
+	/* Write as soon as possible into 2 chunks of 16 bytes. */
+	cute_check_sint(dpack_encoder_init_fd(&enc, fds[1], 16, 2, 1, 0),
+	                equal,
+	                0);
+
+	/* Fill the pipe, then the chunks, encoding whole values only. */
+	while (true) {
+		if (dpack_encoder_fd_avail(&enc) < DPACKUT_FD_VAL_SIZE) {
+			err = dpack_encoder_flush_fd(&enc);
+			if (err) {
+				cute_check_sint(err, equal, -EAGAIN);
+				if (dpack_encoder_fd_avail(&enc) <
+				    DPACKUT_FD_VAL_SIZE)
+					break;
+			}
+		}
+
+		cute_check_sint(dpack_encode_uint32(&enc.base,
+		                                    DPACKUT_FD_VAL_BASE + v),
+		                equal,
+		                0);
+		v++;
+	}
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                v * DPACKUT_FD_VAL_SIZE);
+
+	/* Fill chunks up with single byte values... */
+	while (dpack_encoder_fd_avail(&enc)) {
+		cute_check_sint(dpack_encode_uint32(&enc.base, 0), equal, 0);
+		pad++;
+	}
+
+	/* ...so that next value is left unconsumed: failure is not sticky. */
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + v),
+	                equal,
+	                -EAGAIN);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                (v * DPACKUT_FD_VAL_SIZE) + pad);
+
+	/* Drain the pipe a bit and retry. */
+	ret = read(fds[0], buff, sizeof(buff));
+	cute_check_sint(ret, greater, 0);
+	sz += (size_t)ret;
+	cute_check_sint(dpack_encoder_flush_fd(&enc), equal, 0);
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE + v),
+	                equal,
+	                0);
+	v++;
+
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	do {
+		ret = read(fds[0], buff, sizeof(buff));
+		if (ret > 0)
+			sz += (size_t)ret;
+	} while (ret > 0);
+	cute_check_uint(sz, equal, (v * DPACKUT_FD_VAL_SIZE) + pad);
+
+	close(fds[1]);
+	close(fds[0]);
+}
+
+#if defined(CONFIG_DPACK_STRING)
+
+CUTE_TEST(dpackut_fd_broken)
+{
+	int                         fds[2];
+	struct dpack_encoder_fd     enc;
+	uint8_t                     buff[4096] = { 0, };
+	ssize_t                     ret;
+	struct dpack_decoder_buffer dec;
+	uint32_t                    val;
+
+	dpackut_fd_pipe(fds);
+	cute_check_sint(fcntl(fds[1], F_SETPIPE_SZ, (int)sizeof(buff)),
+	                greater_equal,
+	                0);
+	while (write(fds[1], buff, sizeof(buff)) > 0)
+		;
+
+	/* 2 chunks of 4 bytes never written unless full. */
+	cute_check_sint(dpack_encoder_init_fd(&enc, fds[1], 4, 2, 64, 60000),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE),
+	                equal,
+	                0);
+
+	/*
+	 * String header fits into the 3 bytes left, payload is larger than all
+	 * chunks together: it gets partially consumed before failing.
+	 */
+	cute_check_sint(dpack_encode_str(&enc.base, "0123456789abcdef"),
+	                equal,
+	                -EAGAIN);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 8);
+
+	/* Stream is dead, even once the pipe drains. */
+	while (read(fds[0], buff, sizeof(buff)) > 0)
+		;
+	cute_check_sint(dpack_encode_uint32(&enc.base, DPACKUT_FD_VAL_BASE),
+	                equal,
+	                -EAGAIN);
+	cute_check_sint(dpack_encode_str(&enc.base, "0123456789abcdef"),
+	                equal,
+	                -EAGAIN);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 8);
+
+	/* Data encoded so far is written, trailing partial string included. */
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, -EAGAIN);
+	ret = read(fds[0], buff, sizeof(buff));
+	cute_check_sint(ret, equal, 8);
+
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_FD_VAL_SIZE);
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+	cute_check_uint(val, equal, DPACKUT_FD_VAL_BASE);
+	dpack_decoder_fini(&dec.base);
+	cute_check_uint(buff[DPACKUT_FD_VAL_SIZE], equal, 0xa0 | 16);
+	cute_check_uint(buff[DPACKUT_FD_VAL_SIZE + 1], equal, '0');
+	cute_check_uint(buff[DPACKUT_FD_VAL_SIZE + 2], equal, '1');
+
+	close(fds[1]);
+	close(fds[0]);
+}
+
+#endif /* defined(CONFIG_DPACK_STRING) */
+
+CUTE_GROUP(dpackut_fd_group) = {
+	CUTE_REF(dpackut_fd_thres),
+	CUTE_REF(dpackut_fd_delay),
+	CUTE_REF(dpackut_fd_backpressure),
+#if defined(CONFIG_DPACK_STRING)
+	CUTE_REF(dpackut_fd_broken)
+#endif /* defined(CONFIG_DPACK_STRING) */
+};
+
+CUTE_SUITE_EXTERN(dpackut_fd_suite,
+                  dpackut_fd_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -0,0 +1,319 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/codec.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Messages written to test files are 2 items arrays made of a sequence number
+ * followed by a bin payload which content is given by the test.
+ */
+#define DPACKUT_FILE_MSG_HEAD_SIZE (1U + 5U + 3U)
+
+struct dpackut_file_msgs {
+	unsigned int   nr;
+	size_t *       offs;
+	unsigned int * hits;
+	char           path[32];
+	int            fd;
+};
+
+static void
+dpackut_file_put_msg(struct dpackut_file_msgs * msgs,
+                     uint8_t *                  buff,
+                     const uint8_t *            payload,
+                     size_t                     size)
+{
+	cute_check_uint(size, lower_equal, UINT16_MAX);
+
+	buff[0] = 0x92;
+	buff[1] = 0xce;
+	buff[2] = (uint8_t)(msgs->nr >> 24);
+	buff[3] = (uint8_t)(msgs->nr >> 16);
+	buff[4] = (uint8_t)(msgs->nr >> 8);
+	buff[5] = (uint8_t)msgs->nr;
+	buff[6] = 0xc5;
+	buff[7] = (uint8_t)(size >> 8);
+	buff[8] = (uint8_t)size;
+	memcpy(&buff[DPACKUT_FILE_MSG_HEAD_SIZE], payload, size);
+}
+
+/*
+ * Write nr messages which payload sizes are given by size() into a memory
+ * file and record their offsets.
+ */
+static void
+dpackut_file_build(struct dpackut_file_msgs * msgs,
+                   unsigned int               nr,
+                   const uint8_t *            payload,
+                   size_t                  (* size)(unsigned int))
+{
+	size_t  off = 0;
+	uint8_t buff[DPACKUT_FILE_MSG_HEAD_SIZE + UINT16_MAX];
+
+	msgs->nr = 0;
+	msgs->offs = malloc(nr * sizeof(msgs->offs[0]));
+	cute_check_ptr(msgs->offs, unequal, NULL);
+	msgs->hits = calloc(nr, sizeof(msgs->hits[0]));
+	cute_check_ptr(msgs->hits, unequal, NULL);
+
+	msgs->fd = memfd_create("dpackut_file", 0);
+	cute_check_sint(msgs->fd, greater_equal, 0);
+	sprintf(msgs->path, "/proc/self/fd/%d", msgs->fd);
+
+	while (msgs->nr < nr) {
+		size_t sz = size(msgs->nr);
+
+		dpackut_file_put_msg(msgs, buff, payload, sz);
+		sz += DPACKUT_FILE_MSG_HEAD_SIZE;
+		cute_check_sint(write(msgs->fd, buff, sz), equal, (ssize_t)sz);
+
+		msgs->offs[msgs->nr++] = off;
+		off += sz;
+	}
+}
+
+static void
+dpackut_file_reset(struct dpackut_file_msgs * msgs)
+{
+	memset(msgs->hits, 0, msgs->nr * sizeof(msgs->hits[0]));
+}
+
+static void
+dpackut_file_fini(struct dpackut_file_msgs * msgs)
+{
+	close(msgs->fd);
+	free(msgs->hits);
+	free(msgs->offs);
+}
+
+static int
+dpackut_file_offset_cmp(const void * key, const void * elm)
+{
+	size_t off = *(const size_t *)key;
+	size_t cur = *(const size_t *)elm;
+
+	return (off > cur) - (off < cur);
+}
+
+static int
+dpackut_file_decode(struct dpack_decoder * __restrict decoder,
+                    off_t                             offset,
+                    void * __restrict                 data)
+{
+	struct dpackut_file_msgs * msgs = data;
+	size_t                     off = (size_t)offset;
+	const size_t *             found;
+
+	/* Reject messages not starting at a true message boundary. */
+	found = bsearch(&off,
+	                msgs->offs,
+	                msgs->nr,
+	                sizeof(msgs->offs[0]),
+	                dpackut_file_offset_cmp);
+	if (!found)
+		return -ENOENT;
+
+	__atomic_fetch_add(&msgs->hits[found - msgs->offs],
+	                   1,
+	                   __ATOMIC_RELAXED);
+
+	return dpack_decoder_discard(decoder);
+}
+
+static void
+dpackut_file_check_parallel(struct dpackut_file_msgs * msgs,
+                            unsigned int               thread_nr)
+{
+	unsigned int m;
+
+	dpackut_file_reset(msgs);
+	cute_check_sint(dpack_decode_file_parallel(msgs->path,
+	                                           dpackut_file_decode,
+	                                           msgs,
+	                                           thread_nr),
+	                equal,
+	                0);
+
+	/* Every message must have been decoded exactly once. */
+	for (m = 0; m < msgs->nr; m++)
+		cute_check_uint(msgs->hits[m], equal, 1);
+}
+
+static const uint8_t dpackut_file_zero[UINT16_MAX];
+
+static size_t
+dpackut_file_mixed_size(unsigned int index)
+{
+	return (index * 37U) % 300U;
+}
+
+/*
+ * Many messages of various sizes: ranges are sampled in the middle of
+ * messages and must be resynchronized onto true boundaries.
+ */
+CUTE_TEST(dpackut_file_parallel_sample)
+{
+	struct dpackut_file_msgs msgs;
+	unsigned int             t;
+
+	dpackut_file_build(&msgs,
+	                   2000,
+	                   dpackut_file_zero,
+	                   dpackut_file_mixed_size);
+	for (t = 1; t <= 8; t++)
+		dpackut_file_check_parallel(&msgs, t);
+	dpackut_file_fini(&msgs);
+}
+
+static size_t
+dpackut_file_large_size(unsigned int index __unused)
+{
+	return 9000U;
+}
+
+/*
+ * Messages larger than ranges: a single message straddles multiple range
+ * boundaries.
+ */
+CUTE_TEST(dpackut_file_parallel_straddle)
+{
+	struct dpackut_file_msgs msgs;
+	unsigned int             t;
+
+	dpackut_file_build(&msgs,
+	                   7,
+	                   dpackut_file_zero,
+	                   dpackut_file_large_size);
+	for (t = 1; t <= 8; t++)
+		dpackut_file_check_parallel(&msgs, t);
+	dpackut_file_fini(&msgs);
+}
+
+static size_t
+dpackut_file_single_size(unsigned int index __unused)
+{
+	return UINT16_MAX;
+}
+
+CUTE_TEST(dpackut_file_parallel_single)
+{
+	struct dpackut_file_msgs msgs;
+
+	dpackut_file_build(&msgs,
+	                   1,
+	                   dpackut_file_zero,
+	                   dpackut_file_single_size);
+	dpackut_file_check_parallel(&msgs, 1);
+	dpackut_file_check_parallel(&msgs, 4);
+	dpackut_file_fini(&msgs);
+}
+
+static size_t
+dpackut_file_mimic_size(unsigned int index)
+{
+	return (index & 1) ? UINT16_MAX : 17U;
+}
+
+/*
+ * Payloads made of bytes that look like MessagePack headers: speculative
+ * scans started in the middle of them walk deeply nested arrays, huge
+ * containers and bogus sizes.
+ */
+CUTE_TEST(dpackut_file_parallel_mimic)
+{
+	static const uint8_t     fake[] = {
+		0xdd, 0xff, 0xff, 0xff, 0xff,   /* array32 of 2^32 - 1 items */
+		0xdf, 0x7f, 0xff, 0xff, 0xff,   /* map32 of 2^31 - 1 fields */
+		0xc5, 0xff, 0xff,               /* bin16 of 65535 bytes */
+		0x92, 0xce                      /* message head start */
+	};
+	struct dpackut_file_msgs msgs;
+	uint8_t *                payload;
+	unsigned int             t;
+
+	payload = malloc(UINT16_MAX);
+	cute_check_ptr(payload, unequal, NULL);
+
+	/* Deeply nested fixarray(1) headers... */
+	memset(payload, 0x91, UINT16_MAX - sizeof(fake));
+	/* ...followed by other fake headers. */
+	memcpy(&payload[UINT16_MAX - sizeof(fake)], fake, sizeof(fake));
+
+	dpackut_file_build(&msgs, 16, payload, dpackut_file_mimic_size);
+	for (t = 1; t <= 8; t++)
+		dpackut_file_check_parallel(&msgs, t);
+	dpackut_file_fini(&msgs);
+
+	free(payload);
+}
+
+CUTE_TEST(dpackut_file_parallel_truncated)
+{
+	struct dpackut_file_msgs msgs;
+	struct stat              st;
+
+	dpackut_file_build(&msgs,
+	                   100,
+	                   dpackut_file_zero,
+	                   dpackut_file_mixed_size);
+	cute_check_sint(fstat(msgs.fd, &st), equal, 0);
+	cute_check_sint(ftruncate(msgs.fd, st.st_size - 1), equal, 0);
+
+	cute_check_sint(dpack_decode_file_parallel(msgs.path,
+	                                           dpackut_file_decode,
+	                                           &msgs,
+	                                           4),
+	                equal,
+	                -ENODATA);
+
+	dpackut_file_fini(&msgs);
+}
+
+CUTE_TEST(dpackut_file_parallel_empty)
+{
+	int  fd;
+	char path[32];
+
+	fd = memfd_create("dpackut_file_parallel_empty", 0);
+	cute_check_sint(fd, greater_equal, 0);
+	sprintf(path, "/proc/self/fd/%d", fd);
+
+	cute_check_sint(dpack_decode_file_parallel(path,
+	                                           dpackut_file_decode,
+	                                           NULL,
+	                                           4),
+	                equal,
+	                -ENODATA);
+
+	close(fd);
+}
+
+CUTE_GROUP(dpackut_file_group) = {
+	CUTE_REF(dpackut_file_parallel_sample),
+	CUTE_REF(dpackut_file_parallel_straddle),
+	CUTE_REF(dpackut_file_parallel_single),
+	CUTE_REF(dpackut_file_parallel_mimic),
+	CUTE_REF(dpackut_file_parallel_truncated),
+	CUTE_REF(dpackut_file_parallel_empty)
+};
+
+CUTE_SUITE_EXTERN(dpackut_file_suite,
+                  dpackut_file_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/filter.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <errno.h>
+#include <string.h>
+
+#define DPACKUT_FILTER_VAL_NR   (64U)
+/* Encoded size of values used below. */
+#define DPACKUT_FILTER_VAL_SIZE (5U)
+#define DPACKUT_FILTER_VAL_BASE (0x10000U)
+#define DPACKUT_FILTER_SIZE \
+	(DPACKUT_FILTER_VAL_NR * DPACKUT_FILTER_VAL_SIZE)
+
+struct dpackut_filter_stats {
+	uint32_t crc;
+	size_t   bytes;
+	size_t   calls;
+};
+
+static uint32_t
+dpackut_filter_crc(uint32_t crc, const uint8_t * data, size_t size)
+{
+	crc = ~crc;
+	while (size--) {
+		unsigned int b;
+
+		crc ^= *data++;
+		for (b = 0; b < 8; b++)
+			crc = (crc >> 1) ^ (0xedb88320U & (0U - (crc & 1U)));
+	}
+
+	return ~crc;
+}
+
+static int
+dpackut_filter_stats(uint8_t * __restrict block,
+                     size_t               size,
+                     void * __restrict    data)
+{
+	struct dpackut_filter_stats * stats = data;
+
+	stats->crc = dpackut_filter_crc(stats->crc, block, size);
+	stats->bytes += size;
+	stats->calls++;
+
+	return 0;
+}
+
+static int
+dpackut_filter_tee(uint8_t * __restrict block,
+                   size_t               size,
+                   void * __restrict    data)
+{
+	struct dpack_encoder * tee = data;
+
+	return tee->ops->write(tee, block, size);
+}
+
+static int
+dpackut_filter_xor(uint8_t * __restrict block,
+                   size_t               size,
+                   void * __restrict    data __unused)
+{
+	while (size--)
+		*block++ ^= 0x5aU;
+
+	return 0;
+}
+
+static void
+dpackut_filter_encode(struct dpack_encoder * encoder)
+{
+	unsigned int v;
+
+	for (v = 0; v < DPACKUT_FILTER_VAL_NR; v++) {
+		uint32_t val = DPACKUT_FILTER_VAL_BASE + v;
+
+		cute_check_sint(dpack_encode_uint32(encoder, val), equal, 0);
+	}
+}
+
+static void
+dpackut_filter_decode(struct dpack_decoder * decoder)
+{
+	unsigned int v;
+
+	for (v = 0; v < DPACKUT_FILTER_VAL_NR; v++) {
+		uint32_t val;
+
+		cute_check_sint(dpack_decode_uint32(decoder, &val), equal, 0);
+		cute_check_uint(val, equal, DPACKUT_FILTER_VAL_BASE + v);
+	}
+	cute_check_uint(dpack_decoder_data_left(decoder), equal, 0);
+}
+
+CUTE_TEST(dpackut_filter_encode_stats)
+{
+	uint8_t                     buff[DPACKUT_FILTER_SIZE];
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_filter enc;
+	struct dpackut_filter_stats stats = { 0, };
+
+	dpack_encoder_init_buffer(&next, buff, sizeof(buff));
+	cute_check_sint(dpack_encoder_init_filter(&enc,
+	                                          &next.base,
+	                                          64,
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+
+	dpackut_filter_encode(&enc.base);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_FILTER_SIZE);
+	cute_check_uint(dpack_encoder_space_left(&enc.base), equal, 0);
+
+	/* Only full blocks have been handed over so far. */
+	cute_check_uint(stats.bytes, equal, DPACKUT_FILTER_SIZE - 64);
+	cute_check_uint(dpack_encoder_space_used(&next.base),
+	                equal,
+	                DPACKUT_FILTER_SIZE - 64);
+
+	cute_check_sint(dpack_encoder_flush_filter(&enc), equal, 0);
+	cute_check_uint(stats.bytes, equal, DPACKUT_FILTER_SIZE);
+	cute_check_uint(stats.calls, equal, DPACKUT_FILTER_SIZE / 64);
+	cute_check_uint(stats.crc,
+	                equal,
+	                dpackut_filter_crc(0, buff, sizeof(buff)));
+
+	cute_check_sint(dpack_encode_uint32(&enc.base, 0), equal, -EMSGSIZE);
+
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+}
+
+CUTE_TEST(dpackut_filter_encode_tee)
+{
+	uint8_t                     buff[DPACKUT_FILTER_SIZE];
+	uint8_t                     copy[DPACKUT_FILTER_SIZE];
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_buffer tee;
+	struct dpack_encoder_filter enc;
+	struct dpack_encoder_filter stack;
+	struct dpackut_filter_stats stats = { 0, };
+
+	dpack_encoder_init_buffer(&next, buff, sizeof(buff));
+	dpack_encoder_init_buffer(&tee, copy, sizeof(copy));
+
+	/* Stack a counting filter on top of a tee filter. */
+	cute_check_sint(dpack_encoder_init_filter(&enc,
+	                                          &next.base,
+	                                          48,
+	                                          dpackut_filter_tee,
+	                                          &tee.base),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encoder_init_filter(&stack,
+	                                          &enc.base,
+	                                          100,
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+
+	dpackut_filter_encode(&stack.base);
+
+	cute_check_sint(dpack_encoder_fini(&stack.base), equal, 0);
+	cute_check_uint(stats.bytes, equal, DPACKUT_FILTER_SIZE);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	cute_check_uint(dpack_encoder_space_used(&tee.base),
+	                equal,
+	                DPACKUT_FILTER_SIZE);
+	cute_check_mem(copy, equal, buff, sizeof(buff));
+
+	cute_check_sint(dpack_encoder_fini(&tee.base), equal, 0);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+}
+
+CUTE_TEST(dpackut_filter_encode_patch)
+{
+	uint8_t                     buff[16];
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_filter enc;
+	struct dpackut_filter_stats stats = { 0, };
+	const uint8_t               data[4] = { 0xc0, 0xc0, 0xc0, 0xc0 };
+	const uint8_t               byte = 0xc3;
+
+	dpack_encoder_init_buffer(&next, buff, sizeof(buff));
+	cute_check_sint(dpack_encoder_init_filter(&enc,
+	                                          &next.base,
+	                                          4,
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+
+	cute_check_sint(enc.base.ops->write(&enc.base, data, 4), equal, 0);
+	cute_check_sint(enc.base.ops->write(&enc.base, data, 2), equal, 0);
+
+	/* First block has been handed over already. */
+	cute_check_sint(enc.base.ops->patch(&enc.base, 3, &byte, 1),
+	                equal,
+	                -ERANGE);
+	cute_check_sint(enc.base.ops->patch(&enc.base, 5, &byte, 1),
+	                equal,
+	                0);
+	cute_check_sint(enc.base.ops->patch(&enc.base, 6, &byte, 1),
+	                equal,
+	                -ERANGE);
+	cute_check_sint(enc.base.ops->cut(&enc.base, 4, 1), equal, 0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 5);
+
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+	cute_check_uint(dpack_encoder_space_used(&next.base), equal, 5);
+	cute_check_uint(buff[4], equal, byte);
+	cute_check_uint(stats.crc, equal, dpackut_filter_crc(0, buff, 5));
+
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+}
+
+CUTE_TEST(dpackut_filter_decode_stats)
+{
+	uint8_t                     buff[DPACKUT_FILTER_SIZE];
+	struct dpack_encoder_buffer enc;
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_filter dec;
+	struct dpackut_filter_stats stats = { 0, };
+	uint32_t                    val;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+	dpackut_filter_encode(&enc.base);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	dpack_decoder_init_buffer(&next, buff, sizeof(buff));
+	cute_check_sint(dpack_decoder_init_filter(&dec,
+	                                          &next.base,
+	                                          24,
+	                                          sizeof(buff),
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+	cute_check_uint(val, equal, DPACKUT_FILTER_VAL_BASE);
+
+	/* Skipped data is filtered as well. */
+	cute_check_sint(dpack_decoder_skip(&dec.base,
+	                                   sizeof(buff) -
+	                                   (2 * DPACKUT_FILTER_VAL_SIZE)),
+	                equal,
+	                0);
+	cute_check_uint(dpack_decoder_data_left(&dec.base),
+	                equal,
+	                DPACKUT_FILTER_VAL_SIZE);
+
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+	cute_check_uint(val,
+	                equal,
+	                DPACKUT_FILTER_VAL_BASE + DPACKUT_FILTER_VAL_NR - 1);
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, -ENODATA);
+
+	cute_check_uint(stats.bytes, equal, sizeof(buff));
+	cute_check_uint(stats.crc,
+	                equal,
+	                dpackut_filter_crc(0, buff, sizeof(buff)));
+	/* Data is handed to the filter by blocks, not per decoded item. */
+	cute_check_uint(stats.calls, equal, (sizeof(buff) + 23) / 24);
+
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&next.base);
+}
+
+CUTE_TEST(dpackut_filter_decode_concat)
+{
+	uint8_t                     buff[2 * DPACKUT_FILTER_SIZE];
+	struct dpack_encoder_buffer enc;
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_filter dec;
+	struct dpackut_filter_stats stats = { 0, };
+	unsigned int                v;
+
+	/* Encode 2 messages back to back. */
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+	dpackut_filter_encode(&enc.base);
+	dpackut_filter_encode(&enc.base);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	dpack_decoder_init_buffer(&next, buff, sizeof(buff));
+
+	/* Decode first message only... */
+	cute_check_sint(dpack_decoder_init_filter(&dec,
+	                                          &next.base,
+	                                          24,
+	                                          DPACKUT_FILTER_SIZE,
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+	for (v = 0; v < DPACKUT_FILTER_VAL_NR; v++) {
+		uint32_t val;
+
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, DPACKUT_FILTER_VAL_BASE + v);
+	}
+	dpack_decoder_fini(&dec.base);
+
+	/* ...by blocks, without consuming the second one. */
+	cute_check_uint(stats.calls, equal, (DPACKUT_FILTER_SIZE + 23) / 24);
+	cute_check_uint(stats.bytes, equal, DPACKUT_FILTER_SIZE);
+	cute_check_uint(stats.crc,
+	                equal,
+	                dpackut_filter_crc(0, buff, DPACKUT_FILTER_SIZE));
+	cute_check_uint(dpack_decoder_data_left(&next.base),
+	                equal,
+	                DPACKUT_FILTER_SIZE);
+
+	/* Then decode second message through another filtering decoder. */
+	memset(&stats, 0, sizeof(stats));
+	cute_check_sint(dpack_decoder_init_filter(&dec,
+	                                          &next.base,
+	                                          24,
+	                                          DPACKUT_FILTER_SIZE,
+	                                          dpackut_filter_stats,
+	                                          &stats),
+	                equal,
+	                0);
+	dpackut_filter_decode(&dec.base);
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_uint(stats.bytes, equal, DPACKUT_FILTER_SIZE);
+	cute_check_uint(stats.crc,
+	                equal,
+	                dpackut_filter_crc(0,
+	                                   &buff[DPACKUT_FILTER_SIZE],
+	                                   DPACKUT_FILTER_SIZE));
+
+	dpack_decoder_fini(&next.base);
+}
+
+CUTE_TEST(dpackut_filter_transform)
+{
+	uint8_t                     buff[DPACKUT_FILTER_SIZE];
+	uint8_t                     ref[DPACKUT_FILTER_SIZE];
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_filter enc;
+	struct dpack_decoder_buffer src;
+	struct dpack_decoder_filter dec;
+	unsigned int                b;
+
+	dpack_encoder_init_buffer(&next, ref, sizeof(ref));
+	dpackut_filter_encode(&next.base);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+
+	/* Scramble encoded data in place... */
+	dpack_encoder_init_buffer(&next, buff, sizeof(buff));
+	cute_check_sint(dpack_encoder_init_filter(&enc,
+	                                          &next.base,
+	                                          32,
+	                                          dpackut_filter_xor,
+	                                          NULL),
+	                equal,
+	                0);
+	dpackut_filter_encode(&enc.base);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+
+	for (b = 0; b < sizeof(buff); b++)
+		cute_check_uint(buff[b], equal, ref[b] ^ 0x5aU);
+
+	/* ...and unscramble it while decoding. */
+	dpack_decoder_init_buffer(&src, buff, sizeof(buff));
+	cute_check_sint(dpack_decoder_init_filter(&dec,
+	                                          &src.base,
+	                                          32,
+	                                          sizeof(buff),
+	                                          dpackut_filter_xor,
+	                                          NULL),
+	                equal,
+	                0);
+	dpackut_filter_decode(&dec.base);
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&src.base);
+}
+
+CUTE_GROUP(dpackut_filter_group) = {
+	CUTE_REF(dpackut_filter_encode_stats),
+	CUTE_REF(dpackut_filter_encode_tee),
+	CUTE_REF(dpackut_filter_encode_patch),
+	CUTE_REF(dpackut_filter_decode_stats),
+	CUTE_REF(dpackut_filter_decode_concat),
+	CUTE_REF(dpackut_filter_transform)
+};
+
+CUTE_SUITE_EXTERN(dpackut_filter_suite,
+                  dpackut_filter_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
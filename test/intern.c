@@ -0,0 +1,280 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/intern.h"
+#include "dpack/codec.h"
+#include "utest.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include <errno.h>
+
+static struct dpack_intern dpackut_intern;
+
+static void
+dpackut_intern_setup(void)
+{
+	cute_check_sint(dpack_intern_init(&dpackut_intern, 5), equal, 0);
+}
+
+static void
+dpackut_intern_teardown(void)
+{
+	dpack_intern_fini(&dpackut_intern);
+}
+
+#if defined(CONFIG_DPACK_ASSERT_API)
+
+CUTE_TEST_STATIC(dpackut_intern_assert,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	struct dpack_intern         intern = { 0, };
+	const char *                str;
+	char                        buff[8];
+	int                         err __unused;
+	ssize_t                     ret __unused;
+
+	cute_expect_assertion(err = dpack_intern_init(NULL, 1));
+	cute_expect_assertion(err = dpack_intern_init(&intern, 0));
+	cute_expect_assertion(err = dpack_intern_init(&intern,
+	                                              DPACK_INTERN_NR_MAX + 1));
+
+	dpack_decoder_init_buffer(&dec, (uint8_t *)buff, sizeof(buff));
+	cute_expect_assertion(ret = dpack_decode_str_intern(NULL,
+	                                                    &dpackut_intern,
+	                                                    &str));
+	cute_expect_assertion(ret = dpack_decode_str_intern(&dec.base,
+	                                                    NULL,
+	                                                    &str));
+	cute_expect_assertion(ret = dpack_decode_str_intern(&dec.base,
+	                                                    &intern,
+	                                                    &str));
+	cute_expect_assertion(ret = dpack_decode_str_intern(&dec.base,
+	                                                    &dpackut_intern,
+	                                                    NULL));
+	dpack_decoder_fini(&dec.base);
+}
+
+#else  /* !(defined(CONFIG_DPACK_ASSERT_API)) */
+
+CUTE_TEST_STATIC(dpackut_intern_assert,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	cute_skip("assertion unsupported");
+}
+
+#endif  /* defined(CONFIG_DPACK_ASSERT_API) */
+
+CUTE_TEST_STATIC(dpackut_intern_decode,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	struct dpack_decoder_buffer dec;
+	const char                  buff[] = "\xa3" "foo"
+	                                     "\xa3" "bar"
+	                                     "\xa3" "foo"
+	                                     "\xa2" "ba";
+	const char *                foo0;
+	const char *                bar;
+	const char *                foo1;
+	const char *                ba;
+
+	dpack_decoder_init_buffer(&dec, (const uint8_t *)buff, sizeof(buff) - 1);
+
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &foo0),
+	                equal,
+	                3);
+	cute_check_str(foo0, equal, "foo");
+
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &bar),
+	                equal,
+	                3);
+	cute_check_str(bar, equal, "bar");
+	cute_check_ptr(bar, unequal, foo0);
+
+	/* Same content MUST give the same interned string. */
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &foo1),
+	                equal,
+	                3);
+	cute_check_ptr(foo1, equal, foo0);
+
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &ba),
+	                equal,
+	                2);
+	cute_check_str(ba, equal, "ba");
+	cute_check_ptr(ba, unequal, bar);
+
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+}
+
+#if DPACK_STRLEN_MAX >= 300
+
+CUTE_TEST_STATIC(dpackut_intern_decode_long,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	struct dpack_decoder_buffer dec;
+	uint8_t                     buff[2 * (3 + 300)];
+	const char *                str0;
+	const char *                str1;
+	unsigned int                b;
+
+	/* Strings longer than internal scratch buffer. */
+	for (b = 0; b < 2; b++) {
+		uint8_t * p = &buff[b * (3 + 300)];
+
+		p[0] = 0xda;
+		p[1] = 0x01;
+		p[2] = 0x2c;
+		memset(&p[3], 'a', 300);
+	}
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff));
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &str0),
+	                equal,
+	                300);
+	cute_check_uint(strlen(str0), equal, 300);
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &str1),
+	                equal,
+	                300);
+	cute_check_ptr(str1, equal, str0);
+	dpack_decoder_fini(&dec.base);
+}
+
+#else  /* !(DPACK_STRLEN_MAX >= 300) */
+
+CUTE_TEST_STATIC(dpackut_intern_decode_long,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	cute_skip("string length >= 300 support not compiled-in");
+}
+
+#endif /* DPACK_STRLEN_MAX >= 300 */
+
+CUTE_TEST_STATIC(dpackut_intern_decode_fail,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	struct dpack_decoder_buffer dec;
+	const char                  nul[] = "\xa3" "f\0o";
+	const char                  empty[] = "\xa0";
+	const char                  notstr[] = "\x01";
+	const char *                str;
+
+	dpack_decoder_init_buffer(&dec, (const uint8_t *)nul, sizeof(nul) - 1);
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &str),
+	                equal,
+	                -EBADMSG);
+	dpack_decoder_fini(&dec.base);
+
+	dpack_decoder_init_buffer(&dec,
+	                          (const uint8_t *)empty,
+	                          sizeof(empty) - 1);
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &str),
+	                equal,
+	                -EBADMSG);
+	dpack_decoder_fini(&dec.base);
+
+	dpack_decoder_init_buffer(&dec,
+	                          (const uint8_t *)notstr,
+	                          sizeof(notstr) - 1);
+	cute_check_sint(dpack_decode_str_intern(&dec.base,
+	                                        &dpackut_intern,
+	                                        &str),
+	                equal,
+	                -ENOMSG);
+	dpack_decoder_fini(&dec.base);
+}
+
+#if defined(CONFIG_DPACK_LVSTR)
+
+CUTE_TEST_STATIC(dpackut_intern_decode_lvstr,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	struct dpack_decoder_buffer dec;
+	const char                  buff[] = "\xa4" "test" "\xa4" "test";
+	struct stroll_lvstr         lvstr0 = STROLL_LVSTR_INIT;
+	struct stroll_lvstr         lvstr1 = STROLL_LVSTR_INIT;
+
+	dpack_decoder_init_buffer(&dec, (const uint8_t *)buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_decode_lvstr_intern(&dec.base,
+	                                          &dpackut_intern,
+	                                          &lvstr0),
+	                equal,
+	                4);
+	cute_check_uint(stroll_lvstr_len(&lvstr0), equal, 4);
+	cute_check_str(stroll_lvstr_cstr(&lvstr0), equal, "test");
+
+	cute_check_sint(dpack_decode_lvstr_intern(&dec.base,
+	                                          &dpackut_intern,
+	                                          &lvstr1),
+	                equal,
+	                4);
+	cute_check_ptr(stroll_lvstr_cstr(&lvstr1),
+	               equal,
+	               stroll_lvstr_cstr(&lvstr0));
+	dpack_decoder_fini(&dec.base);
+
+	/* lvstr are lent interned strings: nothing to free here. */
+	stroll_lvstr_fini(&lvstr0);
+	stroll_lvstr_fini(&lvstr1);
+}
+
+#else  /* !defined(CONFIG_DPACK_LVSTR) */
+
+CUTE_TEST_STATIC(dpackut_intern_decode_lvstr,
+                 dpackut_intern_setup,
+                 dpackut_intern_teardown,
+                 CUTE_DFLT_TMOUT)
+{
+	cute_skip("lvstr support not compiled-in");
+}
+
+#endif /* defined(CONFIG_DPACK_LVSTR) */
+
+CUTE_GROUP(dpackut_intern_group) = {
+	CUTE_REF(dpackut_intern_assert),
+	CUTE_REF(dpackut_intern_decode),
+	CUTE_REF(dpackut_intern_decode_long),
+	CUTE_REF(dpackut_intern_decode_fail),
+	CUTE_REF(dpackut_intern_decode_lvstr)
+};
+
+CUTE_SUITE_EXTERN(dpackut_intern_suite,
+                  dpackut_intern_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -0,0 +1,406 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/journal.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define DPACKUT_JOURNAL_REC_NR (16U)
+
+struct dpackut_journal_replay {
+	unsigned int nr;
+	uint32_t     values[DPACKUT_JOURNAL_REC_NR];
+};
+
+static int
+dpackut_journal_pack(struct dpack_encoder * __restrict encoder,
+                     void * __restrict                 data)
+{
+	return dpack_encode_uint32(encoder, *(const uint32_t *)data);
+}
+
+static int
+dpackut_journal_unpack(struct dpack_decoder * __restrict decoder,
+                       void * __restrict                 data)
+{
+	struct dpackut_journal_replay * rep = data;
+	int                             err;
+
+	cute_check_uint(rep->nr, lower, DPACKUT_JOURNAL_REC_NR);
+	err = dpack_decode_uint32(decoder, &rep->values[rep->nr]);
+	if (err)
+		return err;
+	cute_check_uint(dpack_decoder_data_left(decoder), equal, 0);
+
+	rep->nr++;
+
+	return 0;
+}
+
+static void
+dpackut_journal_fill(int fd, unsigned int nr)
+{
+	struct dpack_journal journal;
+	char                 path[32];
+	uint32_t             v;
+
+	sprintf(path, "/proc/self/fd/%d", fd);
+	cute_check_sint(dpack_journal_open(&journal, path, 0600, NULL, NULL),
+	                equal,
+	                0);
+	for (v = 0; v < nr; v++)
+		cute_check_sint(dpack_journal_append(&journal,
+		                                     dpackut_journal_pack,
+		                                     &v),
+		                equal,
+		                0);
+	cute_check_sint(dpack_journal_close(&journal), equal, 0);
+}
+
+static void
+dpackut_journal_check(int fd, unsigned int nr)
+{
+	struct dpack_journal          journal;
+	struct dpackut_journal_replay rep = { .nr = 0 };
+	char                          path[32];
+	unsigned int                  v;
+
+	sprintf(path, "/proc/self/fd/%d", fd);
+	cute_check_sint(dpack_journal_open(&journal,
+	                                   path,
+	                                   0600,
+	                                   dpackut_journal_unpack,
+	                                   &rep),
+	                equal,
+	                0);
+	cute_check_sint(dpack_journal_close(&journal), equal, 0);
+
+	cute_check_uint(rep.nr, equal, nr);
+	for (v = 0; v < nr; v++)
+		cute_check_uint(rep.values[v], equal, v);
+}
+
+CUTE_TEST(dpackut_journal_replay)
+{
+	int fd;
+
+	fd = memfd_create("dpackut_journal_replay", 0);
+	cute_check_sint(fd, greater_equal, 0);
+
+	dpackut_journal_check(fd, 0);
+	dpackut_journal_fill(fd, DPACKUT_JOURNAL_REC_NR / 2);
+	dpackut_journal_fill(fd, DPACKUT_JOURNAL_REC_NR / 2);
+	cute_check_sint(lseek(fd, 0, SEEK_END),
+	                equal,
+	                DPACKUT_JOURNAL_REC_NR *
+	                (DPACK_JOURNAL_HEAD_SIZE + 1));
+
+	close(fd);
+}
+
+CUTE_TEST(dpackut_journal_torn)
+{
+	/* Header of a truncated record. */
+	const uint8_t torn[] = "\x10\x00\x00\x00\x00\x00\x00\x00\xcc";
+	/* Each record is made of an 8 bytes header and a 1 byte fixint. */
+	off_t         size = 4 * (DPACK_JOURNAL_HEAD_SIZE + 1);
+	uint8_t       byte;
+	int           fd;
+
+	fd = memfd_create("dpackut_journal_torn", 0);
+	cute_check_sint(fd, greater_equal, 0);
+
+	dpackut_journal_fill(fd, 4);
+
+	/* Append a partially written record and check it is discarded. */
+	cute_check_sint(pwrite(fd, torn, sizeof(torn) - 1, size),
+	                equal,
+	                (ssize_t)sizeof(torn) - 1);
+	dpackut_journal_check(fd, 4);
+	cute_check_sint(lseek(fd, 0, SEEK_END), equal, size);
+
+	/* Corrupt content of last record and check it is discarded. */
+	cute_check_sint(pread(fd, &byte, 1, size - 1), equal, 1);
+	byte ^= 1;
+	cute_check_sint(pwrite(fd, &byte, 1, size - 1), equal, 1);
+	dpackut_journal_check(fd, 3);
+	cute_check_sint(lseek(fd, 0, SEEK_END),
+	                equal,
+	                size - (DPACK_JOURNAL_HEAD_SIZE + 1));
+
+	/* Zero fill end of file and check it is discarded. */
+	size -= DPACK_JOURNAL_HEAD_SIZE + 1;
+	cute_check_sint(ftruncate(fd, size + 64), equal, 0);
+	dpackut_journal_check(fd, 3);
+	cute_check_sint(lseek(fd, 0, SEEK_END), equal, size);
+
+	close(fd);
+}
+
+CUTE_TEST(dpackut_journal_corrupt)
+{
+	/* Each record is made of an 8 bytes header and a 1 byte fixint. */
+	const off_t                   rec = DPACK_JOURNAL_HEAD_SIZE + 1;
+	struct dpack_journal          journal;
+	struct dpackut_journal_replay rep = { .nr = 0 };
+	char                          path[32];
+	uint8_t                       byte;
+	int                           fd;
+
+	fd = memfd_create("dpackut_journal_corrupt", 0);
+	cute_check_sint(fd, greater_equal, 0);
+	sprintf(path, "/proc/self/fd/%d", fd);
+
+	dpackut_journal_fill(fd, 4);
+
+	/*
+	 * Corrupt content of second record: records following it must not be
+	 * mistaken for the remainder of an interrupted append.
+	 */
+	cute_check_sint(pread(fd, &byte, 1, (2 * rec) - 1), equal, 1);
+	byte ^= 1;
+	cute_check_sint(pwrite(fd, &byte, 1, (2 * rec) - 1), equal, 1);
+
+	cute_check_sint(dpack_journal_open(&journal,
+	                                   path,
+	                                   0600,
+	                                   dpackut_journal_unpack,
+	                                   &rep),
+	                equal,
+	                -EBADMSG);
+	cute_check_uint(rep.nr, equal, 1);
+	cute_check_uint(rep.values[0], equal, 0);
+	cute_check_sint(lseek(fd, 0, SEEK_END), equal, 4 * rec);
+
+	/* Same with a corrupted size field. */
+	byte ^= 1;
+	cute_check_sint(pwrite(fd, &byte, 1, (2 * rec) - 1), equal, 1);
+	byte = 0;
+	cute_check_sint(pwrite(fd, &byte, 1, rec), equal, 1);
+
+	rep.nr = 0;
+	cute_check_sint(dpack_journal_open(&journal,
+	                                   path,
+	                                   0600,
+	                                   dpackut_journal_unpack,
+	                                   &rep),
+	                equal,
+	                -EBADMSG);
+	cute_check_uint(rep.nr, equal, 1);
+	cute_check_sint(lseek(fd, 0, SEEK_END), equal, 4 * rec);
+
+	close(fd);
+}
+
+static int
+dpackut_journal_pack_empty(struct dpack_encoder * __restrict encoder __unused,
+                           void * __restrict                 data __unused)
+{
+	return 0;
+}
+
+CUTE_TEST(dpackut_journal_append_empty)
+{
+	struct dpack_journal journal;
+	char                 path[32];
+	int                  fd;
+
+	fd = memfd_create("dpackut_journal_append_empty", 0);
+	cute_check_sint(fd, greater_equal, 0);
+
+	sprintf(path, "/proc/self/fd/%d", fd);
+	cute_check_sint(dpack_journal_open(&journal, path, 0600, NULL, NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_journal_append(&journal,
+	                                     dpackut_journal_pack_empty,
+	                                     NULL),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_sint(dpack_journal_close(&journal), equal, 0);
+	cute_check_sint(lseek(fd, 0, SEEK_END), equal, 0);
+
+	close(fd);
+}
+
+#define DPACKUT_JOURNAL_THREAD_NR (4U)
+#define DPACKUT_JOURNAL_MT_REC_NR (64U)
+
+static struct dpack_journal dpackut_journal_mt;
+static bool                 dpackut_journal_sync_hold;
+static unsigned int         dpackut_journal_sync_nr;
+
+/*
+ * Mock Glibc's fdatasync(2) to count group commits.
+ *
+ * When dpackut_journal_sync_hold is set, the first commit is held until every
+ * appending thread has queued a record so that records appended meanwhile are
+ * known to be coalesced into the next commit.
+ */
+int
+fdatasync(int fd)
+{
+	if (__atomic_exchange_n(&dpackut_journal_sync_hold,
+	                        false,
+	                        __ATOMIC_RELAXED)) {
+		while (true) {
+			uint64_t queued;
+
+			pthread_mutex_lock(&dpackut_journal_mt.lock);
+			queued = dpackut_journal_mt.queued;
+			pthread_mutex_unlock(&dpackut_journal_mt.lock);
+			if (queued >= DPACKUT_JOURNAL_THREAD_NR)
+				break;
+
+			usleep(1000);
+		}
+	}
+
+	__atomic_fetch_add(&dpackut_journal_sync_nr, 1, __ATOMIC_RELAXED);
+
+	return (int)syscall(SYS_fdatasync, fd);
+}
+
+struct dpackut_journal_mt_replay {
+	unsigned int nr;
+	unsigned int next[DPACKUT_JOURNAL_THREAD_NR];
+};
+
+static void *
+dpackut_journal_mt_append(void * arg)
+{
+	uint32_t tid = (uint32_t)(uintptr_t)arg;
+	uint32_t r;
+
+	for (r = 0; r < DPACKUT_JOURNAL_MT_REC_NR; r++) {
+		uint32_t val = (tid << 16) | r;
+		int      err;
+
+		err = dpack_journal_append(&dpackut_journal_mt,
+		                           dpackut_journal_pack,
+		                           &val);
+		if (err)
+			return (void *)(intptr_t)err;
+	}
+
+	return NULL;
+}
+
+static int
+dpackut_journal_mt_unpack(struct dpack_decoder * __restrict decoder,
+                          void * __restrict                 data)
+{
+	struct dpackut_journal_mt_replay * rep = data;
+	uint32_t                           val;
+	uint32_t                           tid;
+	int                                err;
+
+	err = dpack_decode_uint32(decoder, &val);
+	if (err)
+		return err;
+
+	tid = val >> 16;
+	/* Records of a thread must be replayed in append order. */
+	if ((tid >= DPACKUT_JOURNAL_THREAD_NR) ||
+	    ((val & 0xffffU) != rep->next[tid]))
+		return -EBADMSG;
+
+	rep->next[tid]++;
+	rep->nr++;
+
+	return 0;
+}
+
+CUTE_TEST(dpackut_journal_append_mt)
+{
+	struct dpackut_journal_mt_replay rep = { .nr = 0, };
+	pthread_t                        tids[DPACKUT_JOURNAL_THREAD_NR];
+	char                             path[32];
+	unsigned int                     t;
+	int                              fd;
+
+	fd = memfd_create("dpackut_journal_append_mt", 0);
+	cute_check_sint(fd, greater_equal, 0);
+
+	sprintf(path, "/proc/self/fd/%d", fd);
+	cute_check_sint(dpack_journal_open(&dpackut_journal_mt,
+	                                   path,
+	                                   0600,
+	                                   NULL,
+	                                   NULL),
+	                equal,
+	                0);
+
+	dpackut_journal_sync_nr = 0;
+	dpackut_journal_sync_hold = true;
+	for (t = 0; t < DPACKUT_JOURNAL_THREAD_NR; t++)
+		cute_check_sint(pthread_create(&tids[t],
+		                               NULL,
+		                               dpackut_journal_mt_append,
+		                               (void *)(uintptr_t)t),
+		                equal,
+		                0);
+	for (t = 0; t < DPACKUT_JOURNAL_THREAD_NR; t++) {
+		void * ret;
+
+		cute_check_sint(pthread_join(tids[t], &ret), equal, 0);
+		cute_check_ptr(ret, equal, NULL);
+	}
+
+	cute_check_uint(dpackut_journal_mt.queued,
+	                equal,
+	                DPACKUT_JOURNAL_THREAD_NR * DPACKUT_JOURNAL_MT_REC_NR);
+	cute_check_uint(dpackut_journal_mt.synced,
+	                equal,
+	                dpackut_journal_mt.queued);
+	/* Records queued while the first commit was held were coalesced. */
+	cute_check_uint(dpackut_journal_sync_nr,
+	                lower,
+	                DPACKUT_JOURNAL_THREAD_NR * DPACKUT_JOURNAL_MT_REC_NR);
+	cute_check_sint(dpack_journal_close(&dpackut_journal_mt), equal, 0);
+
+	/* All acknowledged records must be durable and replayed in order. */
+	cute_check_sint(dpack_journal_open(&dpackut_journal_mt,
+	                                   path,
+	                                   0600,
+	                                   dpackut_journal_mt_unpack,
+	                                   &rep),
+	                equal,
+	                0);
+	cute_check_sint(dpack_journal_close(&dpackut_journal_mt), equal, 0);
+
+	cute_check_uint(rep.nr,
+	                equal,
+	                DPACKUT_JOURNAL_THREAD_NR * DPACKUT_JOURNAL_MT_REC_NR);
+	for (t = 0; t < DPACKUT_JOURNAL_THREAD_NR; t++)
+		cute_check_uint(rep.next[t], equal, DPACKUT_JOURNAL_MT_REC_NR);
+
+	close(fd);
+}
+
+CUTE_GROUP(dpackut_journal_group) = {
+	CUTE_REF(dpackut_journal_replay),
+	CUTE_REF(dpackut_journal_torn),
+	CUTE_REF(dpackut_journal_corrupt),
+	CUTE_REF(dpackut_journal_append_empty),
+	CUTE_REF(dpackut_journal_append_mt)
+};
+
+CUTE_SUITE_EXTERN(dpackut_journal_suite,
+                  dpackut_journal_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
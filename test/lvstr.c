@@ -1671,6 +1671,350 @@ CUTE_TEST(dpackut_lvstr_decode_range_maxminus1_max)
 	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_range);
 }
 
+#if defined(CONFIG_DPACK_ASSERT_API)
+
+CUTE_TEST(dpackut_lvstr_decode_sso_assert)
+{
+	struct dpack_decoder_buffer dec = { 0, };
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+	char                        buff[8];
+	char                        sso[8];
+	ssize_t                     ret __unused;
+
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso(NULL,
+	                                                   sizeof(sso),
+	                                                   sso,
+	                                                   &lvstr));
+#if defined(CONFIG_DPACK_DEBUG)
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso(&dec.base,
+	                                                   sizeof(sso),
+	                                                   sso,
+	                                                   &lvstr));
+#endif /* defined(CONFIG_DPACK_DEBUG) */
+
+	dpack_decoder_init_buffer(&dec, (uint8_t *)buff, sizeof(buff));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso(&dec.base,
+	                                                   0,
+	                                                   sso,
+	                                                   &lvstr));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso(&dec.base,
+	                                                   sizeof(sso),
+	                                                   NULL,
+	                                                   &lvstr));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso(&dec.base,
+	                                                   sizeof(sso),
+	                                                   sso,
+	                                                   NULL));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso_range(
+		&dec.base, 0, 2, sizeof(sso), sso, &lvstr));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso_range(
+		&dec.base, 3, 2, sizeof(sso), sso, &lvstr));
+	cute_expect_assertion(ret = dpack_decode_lvstr_sso_range(
+		&dec.base, 1, DPACK_LVSTRLEN_MAX + 1, sizeof(sso), sso, &lvstr));
+	dpack_decoder_fini(&dec.base);
+}
+
+#else  /* !(defined(CONFIG_DPACK_ASSERT_API)) */
+
+CUTE_TEST(dpackut_lvstr_decode_sso_assert)
+{
+	cute_skip("assertion unsupported");
+}
+
+#endif  /* defined(CONFIG_DPACK_ASSERT_API) */
+
+/*
+ * Reuse the equ field to carry the size of the caller provided short string
+ * storage.
+ */
+#define DPACKUT_LVSTR_DEC_SSO(_len, _error, _size, _low, _high) \
+	((struct dpackut_lvstr_data) { \
+		.len       = _len, \
+		.error     = _error, \
+		.equ       = _size, \
+		.low       = _low, \
+		.high      = _high \
+	 })
+
+static void
+dpackut_lvstr_unpack_sso(struct dpack_decoder *            decoder,
+                         const struct dpackut_lvstr_data * data)
+{
+	struct stroll_lvstr val = STROLL_LVSTR_INIT;
+	char *              sso;
+	ssize_t             ret;
+
+	sso = malloc(data->equ);
+	cute_check_ptr(sso, unequal, NULL);
+
+	if (data->low)
+		ret = dpack_decode_lvstr_sso_range(decoder,
+		                                   data->low,
+		                                   data->high,
+		                                   data->equ,
+		                                   sso,
+		                                   &val);
+	else
+		ret = dpack_decode_lvstr_sso(decoder, data->equ, sso, &val);
+	cute_check_sint(ret, equal, data->error);
+
+	if (data->error >= 0) {
+		cute_check_uint(stroll_lvstr_len(&val), equal, data->len);
+		cute_check_str(stroll_lvstr_cstr(&val),
+		               equal,
+		               stroll_lvstr_cstr(&data->value));
+		if (data->len < data->equ)
+			/* Short string MUST be stored into caller storage. */
+			cute_check_ptr(stroll_lvstr_cstr(&val), equal, sso);
+		else
+			cute_check_ptr(stroll_lvstr_cstr(&val), unequal, sso);
+		stroll_lvstr_fini(&val);
+	}
+
+	free(sso);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_sso_1)
+{
+	struct dpackut_lvstr_data data;
+
+	data = DPACKUT_LVSTR_DEC_SSO(0, -EBADMSG, 8, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(1, 1, 2, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(1, 1, 1, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+}
+
+#if DPACK_LVSTRLEN_MAX >= 32
+
+CUTE_TEST(dpackut_lvstr_decode_sso_32)
+{
+	struct dpackut_lvstr_data data;
+
+	data = DPACKUT_LVSTR_DEC_SSO(31, 31, 32, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(32, 32, 32, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(32, 32, 33, 0, 0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+}
+
+#else  /* !(DPACK_LVSTRLEN_MAX >= 32) */
+
+CUTE_TEST(dpackut_lvstr_decode_sso_32)
+{
+	cute_skip("lvstr length >= 32 support not compiled-in");
+}
+
+#endif /* DPACK_LVSTRLEN_MAX >= 32 */
+
+CUTE_TEST(dpackut_lvstr_decode_sso_max)
+{
+	struct dpackut_lvstr_data data;
+
+	data = DPACKUT_LVSTR_DEC_SSO(DPACK_LVSTRLEN_MAX,
+	                             DPACK_LVSTRLEN_MAX,
+	                             8,
+	                             0,
+	                             0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(DPACK_LVSTRLEN_MAX + 1,
+	                             -ENOTSUP,
+	                             8,
+	                             0,
+	                             0);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_sso_range)
+{
+	struct dpackut_lvstr_data data;
+
+	data = DPACKUT_LVSTR_DEC_SSO(1, -EMSGSIZE, 8, 2, 4);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(2, 2, 8, 2, 4);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(4, 4, 4, 2, 4);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+
+	data = DPACKUT_LVSTR_DEC_SSO(5, -EMSGSIZE, 8, 2, 4);
+	dpackut_lvstr_decode(&data, dpackut_lvstr_unpack_sso);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_sso_fail)
+{
+	struct dpack_decoder_buffer dec;
+	char                        buff[] = "\xa2\x30\x31";
+	char                        sso[2];
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	/* String does not fit into sso: allocation is required. */
+	dpack_decoder_init_buffer(&dec, (uint8_t *)buff, sizeof(buff));
+	if (dpackut_expect_malloc()) {
+		cute_check_sint(dpack_decode_lvstr_sso(&dec.base,
+		                                       sizeof(sso),
+		                                       sso,
+		                                       &lvstr),
+		                equal,
+		                2);
+		cute_check_ptr(stroll_lvstr_cstr(&lvstr), unequal, NULL);
+		stroll_lvstr_fini(&lvstr);
+	}
+	else
+		cute_check_sint(dpack_decode_lvstr_sso(&dec.base,
+		                                       sizeof(sso),
+		                                       sso,
+		                                       &lvstr),
+		                equal,
+		                -ENOMEM);
+	dpack_decoder_fini(&dec.base);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_lend_backed)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = NULL;
+	/* "012" string followed by a 0 positive fixint. */
+	const char                  buff[] = "\xa3\x30\x31\x32\x00";
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	back = dpack_backing_create(sizeof(buff) - 1);
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data, buff, sizeof(buff) - 1);
+
+	dpack_decoder_init_backed_buffer(&dec, back, sizeof(buff) - 1);
+	dpack_backing_put(back);
+
+	cute_check_sint(dpack_decode_lvstr_lend(&dec.base, &lvstr, &ref),
+	                equal,
+	                3);
+	cute_check_ptr(ref, equal, back);
+	cute_check_str(stroll_lvstr_cstr(&lvstr), equal, "012");
+	cute_check_ptr(stroll_lvstr_cstr(&lvstr),
+	               equal,
+	               (char *)&back->data[1]);
+
+	/* Backing content is left untouched. */
+	cute_check_mem(back->data, equal, buff, sizeof(buff) - 1);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 1);
+	dpack_decoder_fini(&dec.base);
+
+	/* String must remain valid after decoder is released. */
+	cute_check_str(stroll_lvstr_cstr(&lvstr), equal, "012");
+	stroll_lvstr_fini(&lvstr);
+	dpack_backing_put(ref);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_lend_unterm)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	const char                  buff[] = "\xa3\x30\x31\x32";
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	back = dpack_backing_create(sizeof(buff) - 1);
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data, buff, sizeof(buff) - 1);
+
+	/* No NULL byte follows string: copied, backing left untouched. */
+	dpack_decoder_init_backed_buffer(&dec, back, sizeof(buff) - 1);
+	cute_check_sint(dpack_decode_lvstr_lend(&dec.base, &lvstr, &ref),
+	                equal,
+	                3);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_str(stroll_lvstr_cstr(&lvstr), equal, "012");
+	cute_check_mem(back->data, equal, buff, sizeof(buff) - 1);
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_uint(back->refcnt, equal, 1);
+	dpack_backing_put(back);
+	stroll_lvstr_fini(&lvstr);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_lend_end)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	/* "012" string followed by a NULL byte beyond decoder end. */
+	const char                  buff[] = "\xa3\x30\x31\x32\x00";
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	back = dpack_backing_create(sizeof(buff) - 1);
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data, buff, sizeof(buff) - 1);
+
+	/* NULL byte is not part of data to decode: string is copied. */
+	dpack_decoder_init_backed_buffer(&dec, back, sizeof(buff) - 2);
+	cute_check_sint(dpack_decode_lvstr_lend(&dec.base, &lvstr, &ref),
+	                equal,
+	                3);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_str(stroll_lvstr_cstr(&lvstr), equal, "012");
+	cute_check_ptr(stroll_lvstr_cstr(&lvstr),
+	               unequal,
+	               (char *)&back->data[1]);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_uint(back->refcnt, equal, 1);
+	dpack_backing_put(back);
+	stroll_lvstr_fini(&lvstr);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_lend_copy)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	char                        buff[] = "\xa3\x30\x31\x32";
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	/* Caller owned buffers cannot be lent: string is copied. */
+	dpack_decoder_init_buffer(&dec, (uint8_t *)buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_decode_lvstr_lend(&dec.base, &lvstr, &ref),
+	                equal,
+	                3);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_str(stroll_lvstr_cstr(&lvstr), equal, "012");
+	cute_check_ptr(stroll_lvstr_cstr(&lvstr), unequal, &buff[1]);
+	dpack_decoder_fini(&dec.base);
+	stroll_lvstr_fini(&lvstr);
+}
+
+CUTE_TEST(dpackut_lvstr_decode_lend_badmsg)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = NULL;
+	const char                  buff[] = "\xa3\x30\x00\x32";
+	struct stroll_lvstr         lvstr = STROLL_LVSTR_INIT;
+
+	back = dpack_backing_create(sizeof(buff) - 1);
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data, buff, sizeof(buff) - 1);
+
+	dpack_decoder_init_backed_buffer(&dec, back, sizeof(buff) - 1);
+	cute_check_sint(dpack_decode_lvstr_lend(&dec.base, &lvstr, &ref),
+	                equal,
+	                -EBADMSG);
+	cute_check_ptr(ref, equal, NULL);
+	dpack_decoder_fini(&dec.base);
+
+	/* Only the initial reference should be left. */
+	cute_check_uint(back->refcnt, equal, 1);
+	dpack_backing_put(back);
+}
+
 CUTE_GROUP(dpackut_lvstr_group) = {
 	CUTE_REF(dpackut_fixlvstr_sizes),
 	CUTE_REF(dpackut_fixlvstr_sizes_30),
@@ -1743,7 +2087,20 @@ CUTE_GROUP(dpackut_lvstr_group) = {
 	CUTE_REF(dpackut_lvstr_decode_range_255_256),
 	CUTE_REF(dpackut_lvstr_decode_range_65535),
 	CUTE_REF(dpackut_lvstr_decode_range_65536),
-	CUTE_REF(dpackut_lvstr_decode_range_maxminus1_max)
+	CUTE_REF(dpackut_lvstr_decode_range_maxminus1_max),
+
+	CUTE_REF(dpackut_lvstr_decode_sso_assert),
+	CUTE_REF(dpackut_lvstr_decode_sso_1),
+	CUTE_REF(dpackut_lvstr_decode_sso_32),
+	CUTE_REF(dpackut_lvstr_decode_sso_max),
+	CUTE_REF(dpackut_lvstr_decode_sso_range),
+	CUTE_REF(dpackut_lvstr_decode_sso_fail),
+
+	CUTE_REF(dpackut_lvstr_decode_lend_backed),
+	CUTE_REF(dpackut_lvstr_decode_lend_unterm),
+	CUTE_REF(dpackut_lvstr_decode_lend_end),
+	CUTE_REF(dpackut_lvstr_decode_lend_copy),
+	CUTE_REF(dpackut_lvstr_decode_lend_badmsg)
 };
 
 CUTE_SUITE_EXTERN(dpackut_lvstr_suite,
@@ -12,6 +12,8 @@
 #include "utest.h"
 #include <math.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define DPACKUT_MAP_ENABLED(_fld_nr) \
 	(DPACK_MAP_FLDNR_MAX >= (_fld_nr))
@@ -262,6 +264,77 @@ CUTE_TEST(dpackut_map_encode_bool)
 	               DPACKUT_MAP_BOOL_PACK_SIZE);
 }
 
+CUTE_TEST(dpackut_map_encode_open_compact)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[DPACK_MAP_OPEN_HEAD_SIZE + 4] = { 0, };
+	struct dpack_encoder_mark   mark;
+	unsigned int                f;
+	unsigned int                nr = 0;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(dpack_map_begin_encode_open(&enc.base,
+	                                            DPACK_MAP_FLDNR_MAX,
+	                                            &mark),
+	                equal,
+	                0);
+	/* Field count is known once iteration completes only. */
+	for (f = 0; f < DPACKUT_MAP_BOOL_FLD_NR; f++, nr++)
+		cute_check_sint(dpack_map_encode_bool(&enc.base, f, !!f),
+		                equal,
+		                0);
+	cute_check_sint(dpack_map_end_encode_open(&enc.base, &mark, nr, true),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_MAP_BOOL_PACK_SIZE);
+
+	dpack_encoder_fini(&enc.base);
+
+	cute_check_mem(buff,
+	               equal,
+	               DPACKUT_MAP_BOOL_PACK_DATA,
+	               DPACKUT_MAP_BOOL_PACK_SIZE);
+}
+
+CUTE_TEST(dpackut_map_encode_open_cancel)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[DPACK_MAP_OPEN_HEAD_SIZE + 4] = { 0, };
+	struct dpack_encoder_mark   mark;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(dpack_map_begin_encode_open(&enc.base,
+	                                            DPACK_MAP_FLDNR_MAX,
+	                                            &mark),
+	                equal,
+	                0);
+	cute_check_sint(dpack_map_encode_bool(&enc.base, 0, true), equal, 0);
+
+	/* Drop header and fields encoded so far. */
+	cute_check_sint(dpack_map_cancel_encode_open(&enc.base, &mark),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 0);
+
+	/* Nothing to encode: an empty map is left. */
+	cute_check_sint(dpack_map_begin_encode_open(&enc.base,
+	                                            DPACK_MAP_FLDNR_MAX,
+	                                            &mark),
+	                equal,
+	                0);
+	cute_check_sint(dpack_map_end_encode_open(&enc.base, &mark, 0, true),
+	                equal,
+	                0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 1);
+	cute_check_uint(buff[0], equal, 0x80);
+
+	dpack_encoder_fini(&enc.base);
+}
+
 /* dpack-utest-gen.py "{ 0: -128, 1: 0, 2: 127 }" */
 #define DPACKUT_MAP_INT8_FLD_NR \
 	(3U)
@@ -1027,6 +1100,623 @@ CUTE_TEST(dpackut_map_encode_nest)
           defined(CONFIG_DPACK_DOUBLE) && \
           defined(CONFIG_DPACK_STRING) */
 
+#if defined(CONFIG_DPACK_SCALAR) && \
+    defined(CONFIG_DPACK_DOUBLE) && \
+    defined(CONFIG_DPACK_STRING)
+
+/* Pre-encoded { 0: -32768, 1: 1.005 } nested map. */
+#define DPACKUT_MAP_RAW_NEST_DATA \
+	"\x82" \
+		"\x00\xd1\x80\x00" \
+		"\x01\xcb\x3f\xf0\x14\x7a\xe1\x47\xae\x14"
+#define DPACKUT_MAP_RAW_NEST_SIZE \
+	(sizeof(DPACKUT_MAP_RAW_NEST_DATA) - 1)
+#define DPACKUT_MAP_RAW_PACK_SIZE_MAX \
+	DPACK_MAP_SIZE(DPACKUT_MAP_NEST_LVL0_FLD_NR, \
+	               DPACK_MAP_BOOL_SIZE_MAX + \
+	               DPACK_MAP_RAW_SIZE(DPACKUT_MAP_RAW_NEST_SIZE) + \
+	               DPACK_MAP_STR_SIZE(4))
+
+CUTE_TEST(dpackut_map_encode_raw)
+{
+	struct dpack_encoder_buffer enc;
+	uint8_t                     buff[DPACKUT_MAP_RAW_PACK_SIZE_MAX] = { 0, };
+	const uint8_t               nest[] = DPACKUT_MAP_RAW_NEST_DATA;
+
+	dpack_encoder_init_buffer(&enc, buff, sizeof(buff));
+
+	cute_check_sint(
+		dpack_map_begin_encode(&enc.base, DPACKUT_MAP_NEST_LVL0_FLD_NR),
+		equal,
+		0);
+	cute_check_sint(dpack_map_encode_bool(&enc.base, 3, true), equal, 0);
+	cute_check_sint(dpack_map_encode_raw(&enc.base,
+	                                     5,
+	                                     nest,
+	                                     DPACKUT_MAP_RAW_NEST_SIZE),
+	                equal,
+	                0);
+	cute_check_sint(dpack_map_encode_str(&enc.base, 0, "test"), equal, 0);
+	dpack_map_end_encode(&enc.base);
+
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_mem(buff,
+	               equal,
+	               DPACKUT_MAP_NEST_PACK_DATA,
+	               DPACKUT_MAP_NEST_PACK_SIZE);
+
+	/* Not enough room left for the whole pre-encoded item. */
+	dpack_encoder_fini(&enc.base);
+	dpack_encoder_init_buffer(&enc, buff, DPACKUT_MAP_RAW_NEST_SIZE - 1);
+	cute_check_sint(dpack_encode_raw(&enc.base,
+	                                 nest,
+	                                 DPACKUT_MAP_RAW_NEST_SIZE),
+	                equal,
+	                -EMSGSIZE);
+
+	dpack_encoder_fini(&enc.base);
+}
+
+/* Nested map test data followed by a true boolean. */
+#define DPACKUT_MAP_RAW_PACK_DATA \
+	DPACKUT_MAP_NEST_PACK_DATA "\xc3"
+#define DPACKUT_MAP_RAW_PACK_SIZE \
+	(sizeof(DPACKUT_MAP_RAW_PACK_DATA) - 1)
+
+CUTE_TEST(dpackut_map_decode_raw_lend)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      back;
+	struct dpack_backing *      ref = NULL;
+	const uint8_t *             raw = NULL;
+
+	back = dpack_backing_create(DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_ptr(back, unequal, NULL);
+	memcpy(back->data,
+	       DPACKUT_MAP_RAW_PACK_DATA,
+	       DPACKUT_MAP_RAW_PACK_SIZE);
+
+	dpack_decoder_init_backed_buffer(&dec, back, DPACKUT_MAP_RAW_PACK_SIZE);
+	dpack_backing_put(back);
+
+	/* Whole nested map is lent as a single span. */
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_ptr(ref, equal, back);
+	cute_check_ptr(raw, equal, back->data);
+	dpack_backing_put(ref);
+
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref), equal, 1);
+	cute_check_ptr(ref, equal, back);
+	cute_check_ptr(raw, equal, &back->data[DPACKUT_MAP_NEST_PACK_SIZE]);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	/* Span must remain valid after decoder is released. */
+	cute_check_uint(*raw, equal, 0xc3);
+	dpack_backing_put(ref);
+}
+
+CUTE_TEST(dpackut_map_decode_raw_inplace)
+{
+	struct dpack_decoder_buffer dec;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	const uint8_t *             raw = NULL;
+	const uint8_t               buff[] = DPACKUT_MAP_RAW_PACK_DATA;
+
+	/* Caller owned buffers are lent with no backing reference. */
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_ptr(raw, equal, buff);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 1);
+
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref), equal, 1);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_ptr(raw, equal, &buff[DPACKUT_MAP_NEST_PACK_SIZE]);
+	dpack_decoder_fini(&dec.base);
+
+	/* Decoder is left untouched on error. */
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_MAP_NEST_PACK_SIZE - 1);
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref),
+	                equal,
+	                -ENODATA);
+	cute_check_uint(dpack_decoder_data_left(&dec.base),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE - 1);
+	dpack_decoder_fini(&dec.base);
+}
+
+/* Streaming decoder unable to lend its input, wrapping a buffer one. */
+struct dpackut_map_stream {
+	struct dpack_decoder        base;
+	struct dpack_decoder_buffer src;
+};
+
+static size_t
+dpackut_map_stream_left(const struct dpack_decoder * __restrict decoder)
+{
+	const struct dpackut_map_stream * strm =
+		(const struct dpackut_map_stream *)decoder;
+
+	return dpack_decoder_data_left(&strm->src.base);
+}
+
+static int
+dpackut_map_stream_read(struct dpack_decoder * __restrict decoder,
+                        uint8_t * __restrict              data,
+                        size_t                            size)
+{
+	struct dpackut_map_stream * strm = (struct dpackut_map_stream *)decoder;
+
+	return strm->src.base.ops->read(&strm->src.base, data, size);
+}
+
+static int
+dpackut_map_stream_skip(struct dpack_decoder * __restrict decoder,
+                        size_t                            size)
+{
+	struct dpackut_map_stream * strm = (struct dpackut_map_stream *)decoder;
+
+	return dpack_decoder_skip(&strm->src.base, size);
+}
+
+static int
+dpackut_map_stream_fini(struct dpack_decoder * __restrict decoder)
+{
+	struct dpackut_map_stream * strm = (struct dpackut_map_stream *)decoder;
+
+	return strm->src.base.ops->fini(&strm->src.base);
+}
+
+static const struct dpack_decoder_ops dpackut_map_stream_ops = {
+	.left = dpackut_map_stream_left,
+	.read = dpackut_map_stream_read,
+	.skip = dpackut_map_stream_skip,
+	.fini = dpackut_map_stream_fini
+};
+
+CUTE_TEST(dpackut_map_decode_raw_copy)
+{
+	struct dpackut_map_stream   dec;
+	struct dpack_backing *      ref = (struct dpack_backing *)0xdead;
+	const uint8_t *             raw = NULL;
+	const uint8_t               buff[] = DPACKUT_MAP_RAW_PACK_DATA;
+
+	/* Decoders unable to lend their input get items copied. */
+	dpack_decoder_init(&dec.base,
+	                   &dpackut_map_stream_ops,
+	                   DPACK_DECODER_NODISC);
+	dpack_decoder_init_buffer(&dec.src, buff, DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_sint(dpack_decode_raw(&dec.base, &raw, &ref),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_ptr(ref, equal, NULL);
+	cute_check_ptr(raw, unequal, buff);
+	cute_check_mem(raw, equal, buff, DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 1);
+	dpack_decoder_fini(&dec.base);
+
+	free((void *)raw);
+}
+
+CUTE_TEST(dpackut_map_decode_raw_cpy)
+{
+	struct dpack_decoder_buffer dec;
+	const uint8_t               buff[] = DPACKUT_MAP_RAW_PACK_DATA;
+	uint8_t                     raw[DPACKUT_MAP_NEST_PACK_SIZE];
+
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw)),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_mem(raw, equal, buff, DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw)),
+	                equal,
+	                1);
+	cute_check_uint(raw[0], equal, 0xc3);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw)),
+	                equal,
+	                -ENODATA);
+	dpack_decoder_fini(&dec.base);
+
+	/* Buffer too small to hold the whole item: decoder is untouched. */
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw) - 1),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_uint(dpack_decoder_data_left(&dec.base),
+	                equal,
+	                DPACKUT_MAP_RAW_PACK_SIZE);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw)),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE);
+	cute_check_mem(raw, equal, buff, DPACKUT_MAP_NEST_PACK_SIZE);
+	dpack_decoder_fini(&dec.base);
+
+	/* Truncated item. */
+	dpack_decoder_init_buffer(&dec, buff, DPACKUT_MAP_NEST_PACK_SIZE - 1);
+	cute_check_sint(dpack_decode_rawcpy(&dec.base, raw, sizeof(raw)),
+	                equal,
+	                -ENODATA);
+	cute_check_uint(dpack_decoder_data_left(&dec.base),
+	                equal,
+	                DPACKUT_MAP_NEST_PACK_SIZE - 1);
+	dpack_decoder_fini(&dec.base);
+}
+
+#else  /* !(defined(CONFIG_DPACK_SCALAR) && \
+            defined(CONFIG_DPACK_DOUBLE) && \
+            defined(CONFIG_DPACK_STRING)) */
+
+CUTE_TEST(dpackut_map_encode_raw)
+{
+	cute_skip("MessagePack raw map test not compiled-in");
+}
+
+CUTE_TEST(dpackut_map_decode_raw_lend)
+{
+	cute_skip("MessagePack raw map test not compiled-in");
+}
+
+CUTE_TEST(dpackut_map_decode_raw_inplace)
+{
+	cute_skip("MessagePack raw map test not compiled-in");
+}
+
+CUTE_TEST(dpackut_map_decode_raw_copy)
+{
+	cute_skip("MessagePack raw map test not compiled-in");
+}
+
+CUTE_TEST(dpackut_map_decode_raw_cpy)
+{
+	cute_skip("MessagePack raw map test not compiled-in");
+}
+
+#endif /* defined(CONFIG_DPACK_SCALAR) && \
+          defined(CONFIG_DPACK_DOUBLE) && \
+          defined(CONFIG_DPACK_STRING) */
+
+#if defined(CONFIG_DPACK_ARRAY)
+
+CUTE_TEST(dpackut_map_decode_columns)
+{
+	/* [{0: 1, 1: true, 5: 255}, {1: false}] */
+	const uint8_t               buff[] = "\x92"
+	                                     "\x83\x00\x01\x01\xc3\x05\xcc\xff"
+	                                     "\x81\x01\xc2";
+	struct dpack_decoder_buffer dec = { 0, };
+	uint16_t                    ids[4];
+	bool                        flags[4];
+	uint64_t                    ids_bmap[DPACK_COLUMN_PRESENT_NR(4)];
+	uint64_t                    flags_bmap[DPACK_COLUMN_PRESENT_NR(4)];
+	struct dpack_column         cols[] = {
+		{
+			.fid     = 0,
+			.type    = DPACK_COLUMN_UINT16,
+			.values  = ids,
+			.present = ids_bmap
+		},
+		{
+			.fid     = 1,
+			.type    = DPACK_COLUMN_BOOL,
+			.values  = flags,
+			.present = flags_bmap
+		}
+	};
+	unsigned int                nr;
+
+	dpack_decoder_init_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_map_decode_columns(&dec.base,
+	                                         cols,
+	                                         stroll_array_nr(cols),
+	                                         stroll_array_nr(ids),
+	                                         &nr),
+	                equal,
+	                0);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_uint(nr, equal, 2);
+	cute_check_uint(ids[0], equal, 1);
+	cute_check_uint(ids[1], equal, 0);
+	cute_check_uint(ids_bmap[0], equal, UINT64_C(0x1));
+	cute_check_bool(flags[0], is, true);
+	cute_check_bool(flags[1], is, false);
+	cute_check_uint(flags_bmap[0], equal, UINT64_C(0x3));
+}
+
+CUTE_TEST(dpackut_map_decode_columns_error)
+{
+	/* [{1: "x", 0: 1}, {1: false}, 3] */
+	const uint8_t               buff[] = "\x93"
+	                                     "\x82\x01\xa1x\x00\x01"
+	                                     "\x81\x01\xc2"
+	                                     "\x03";
+	struct dpack_decoder_buffer dec = { 0, };
+	uint16_t                    ids[4];
+	bool                        flags[4];
+	uint64_t                    ids_bmap[DPACK_COLUMN_PRESENT_NR(4)];
+	uint64_t                    flags_bmap[DPACK_COLUMN_PRESENT_NR(4)];
+	struct dpack_column         cols[] = {
+		{
+			.fid     = 0,
+			.type    = DPACK_COLUMN_UINT16,
+			.values  = ids,
+			.present = ids_bmap
+		},
+		{
+			.fid     = 1,
+			.type    = DPACK_COLUMN_BOOL,
+			.values  = flags,
+			.present = flags_bmap
+		}
+	};
+	unsigned int                nr = 0;
+
+	/* Whole array must be skipped on row decoding error. */
+	dpack_decoder_init_discard_buffer(&dec, buff, sizeof(buff) - 1);
+	cute_check_sint(dpack_map_decode_columns(&dec.base,
+	                                         cols,
+	                                         stroll_array_nr(cols),
+	                                         stroll_array_nr(ids),
+	                                         &nr),
+	                equal,
+	                -ENOMSG);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	cute_check_uint(nr, equal, 0);
+}
+
+#else  /* !defined(CONFIG_DPACK_ARRAY) */
+
+CUTE_TEST(dpackut_map_decode_columns)
+{
+	cute_skip("array support not compiled-in");
+}
+
+CUTE_TEST(dpackut_map_decode_columns_error)
+{
+	cute_skip("array support not compiled-in");
+}
+
+#endif /* defined(CONFIG_DPACK_ARRAY) */
+
+CUTE_TEST(dpackut_map_edit_init)
+{
+	uint8_t                 buff[] = "\xc0";
+	struct dpack_map_editor edit;
+
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 1, 1),
+	                equal,
+	                -ENOMSG);
+
+	buff[0] = 0xde;
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 1, 1),
+	                equal,
+	                -ENODATA);
+
+	buff[0] = 0x80;
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 1, 1), equal, 0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 1);
+}
+
+CUTE_TEST(dpackut_map_edit_update)
+{
+	/* {0: 1, 1: true, 5: 255} followed by nil. */
+	uint8_t                 buff[16] = "\x83\x00\x01\x01\xc3\x05\xcc\xff"
+	                                   "\xc0";
+	struct dpack_map_editor edit;
+
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 9, sizeof(buff)),
+	                equal,
+	                0);
+
+	/* Same size: overwritten in place. */
+	cute_check_sint(dpack_map_edit_update(&edit,
+	                                      1,
+	                                      (const uint8_t *)"\xc2",
+	                                      1),
+	                equal,
+	                0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 9);
+	cute_check_mem(buff,
+	               equal,
+	               "\x83\x00\x01\x01\xc2\x05\xcc\xff\xc0",
+	               9);
+
+	/* Larger value: tail shifted forward. */
+	cute_check_sint(dpack_map_edit_update(&edit,
+	                                      0,
+	                                      (const uint8_t *)"\xcd\x01\x00",
+	                                      3),
+	                equal,
+	                0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 11);
+	cute_check_mem(buff,
+	               equal,
+	               "\x83\x00\xcd\x01\x00\x01\xc2\x05\xcc\xff\xc0",
+	               11);
+
+	/* Smaller value: tail shifted backward. */
+	cute_check_sint(dpack_map_edit_update(&edit,
+	                                      5,
+	                                      (const uint8_t *)"\x07",
+	                                      1),
+	                equal,
+	                0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 10);
+	cute_check_mem(buff,
+	               equal,
+	               "\x83\x00\xcd\x01\x00\x01\xc2\x05\x07\xc0",
+	               10);
+
+	cute_check_sint(dpack_map_edit_update(&edit,
+	                                      2,
+	                                      (const uint8_t *)"\x07",
+	                                      1),
+	                equal,
+	                -ENOENT);
+
+	/* Not enough room left: buffer left untouched. */
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 10, 10), equal, 0);
+	cute_check_sint(dpack_map_edit_update(&edit,
+	                                      1,
+	                                      (const uint8_t *)"\xcc\xff",
+	                                      2),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 10);
+	cute_check_mem(buff,
+	               equal,
+	               "\x83\x00\xcd\x01\x00\x01\xc2\x05\x07\xc0",
+	               10);
+}
+
+CUTE_TEST(dpackut_map_edit_insert)
+{
+	/* {0: 1} followed by nil. */
+	uint8_t                 buff[40] = "\x81\x00\x01\xc0";
+	uint8_t                 ref[40];
+	struct dpack_map_editor edit;
+	unsigned int            f;
+
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 4, sizeof(buff)),
+	                equal,
+	                0);
+	cute_check_sint(dpack_map_edit_insert(&edit,
+	                                      3,
+	                                      (const uint8_t *)"\xc3",
+	                                      1),
+	                equal,
+	                0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 6);
+	cute_check_mem(buff, equal, "\x82\x00\x01\x03\xc3\xc0", 6);
+
+	cute_check_sint(dpack_map_edit_insert(&edit,
+	                                      0,
+	                                      (const uint8_t *)"\xc3",
+	                                      1),
+	                equal,
+	                -EEXIST);
+
+	/* Not enough room left. */
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 6, 7), equal, 0);
+	cute_check_sint(dpack_map_edit_insert(&edit,
+	                                      4,
+	                                      (const uint8_t *)"\xc3",
+	                                      1),
+	                equal,
+	                -EMSGSIZE);
+	cute_check_mem(buff, equal, "\x82\x00\x01\x03\xc3\xc0", 6);
+
+	/*
+	 * Fixmap holding 15 nil fields followed by a true grows into a map16
+	 * when inserting.
+	 */
+	buff[0] = 0x8f;
+	for (f = 0; f < 15; f++) {
+		buff[1 + (2 * f)] = (uint8_t)f;
+		buff[2 + (2 * f)] = 0xc0;
+	}
+	buff[31] = 0xc3;
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 32, sizeof(buff)),
+	                equal,
+	                0);
+	cute_check_sint(dpack_map_edit_insert(&edit,
+	                                      15,
+	                                      (const uint8_t *)"\xc0",
+	                                      1),
+	                equal,
+	                0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 36);
+
+	ref[0] = 0xde;
+	ref[1] = 0x00;
+	ref[2] = 0x10;
+	for (f = 0; f < 16; f++) {
+		ref[3 + (2 * f)] = (uint8_t)f;
+		ref[4 + (2 * f)] = 0xc0;
+	}
+	ref[35] = 0xc3;
+	cute_check_mem(buff, equal, ref, 36);
+}
+
+#if defined(CONFIG_DPACK_ASSERT_API)
+
+CUTE_TEST(dpackut_map_edit_assert)
+{
+	/* {0: 1} followed by nil. */
+	uint8_t                 buff[16] = "\x81\x00\x01\xc0";
+	struct dpack_map_editor edit;
+	int                     ret __unused;
+
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 4, sizeof(buff)),
+	                equal,
+	                0);
+
+	/* Values must hold exactly one well-formed item. */
+	cute_expect_assertion(
+		ret = dpack_map_edit_update(&edit,
+		                            0,
+		                            (const uint8_t *)"\xc0\xc0",
+		                            2));
+	cute_expect_assertion(
+		ret = dpack_map_edit_update(&edit,
+		                            0,
+		                            (const uint8_t *)"\xcd\x01",
+		                            2));
+	cute_expect_assertion(
+		ret = dpack_map_edit_insert(&edit,
+		                            1,
+		                            (const uint8_t *)"\x92\xc0",
+		                            2));
+}
+
+#else  /* !defined(CONFIG_DPACK_ASSERT_API) */
+
+CUTE_TEST(dpackut_map_edit_assert)
+{
+	cute_skip("assertion unsupported");
+}
+
+#endif /* defined(CONFIG_DPACK_ASSERT_API) */
+
+CUTE_TEST(dpackut_map_edit_delete)
+{
+	/* {0: 1, 1: true, 5: 255} followed by nil. */
+	uint8_t                 buff[] = "\x83\x00\x01\x01\xc3\x05\xcc\xff"
+	                                 "\xc0";
+	/* map16 encoded {0: 1, 1: true}. */
+	uint8_t                 wide[] = "\xde\x00\x02\x00\x01\x01\xc3";
+	struct dpack_map_editor edit;
+
+	cute_check_sint(dpack_map_editor_init(&edit, buff, 9, 9), equal, 0);
+	cute_check_sint(dpack_map_edit_delete(&edit, 1), equal, 0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 7);
+	cute_check_mem(buff, equal, "\x82\x00\x01\x05\xcc\xff\xc0", 7);
+
+	cute_check_sint(dpack_map_edit_delete(&edit, 1), equal, -ENOENT);
+
+	cute_check_sint(dpack_map_edit_delete(&edit, 5), equal, 0);
+	cute_check_sint(dpack_map_edit_delete(&edit, 0), equal, 0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 2);
+	cute_check_mem(buff, equal, "\x80\xc0", 2);
+
+	/* Header width is preserved. */
+	cute_check_sint(dpack_map_editor_init(&edit, wide, 7, 7), equal, 0);
+	cute_check_sint(dpack_map_edit_delete(&edit, 0), equal, 0);
+	cute_check_uint(dpack_map_editor_size(&edit), equal, 5);
+	cute_check_mem(wide, equal, "\xde\x00\x01\x01\xc3", 5);
+}
+
 CUTE_GROUP(dpackut_map_group) = {
 	CUTE_REF(dpackut_fixmap_sizes),
 	CUTE_REF(dpackut_map16_sizes),
@@ -1041,6 +1731,8 @@ CUTE_GROUP(dpackut_map_group) = {
 	CUTE_REF(dpackut_map_encode_end_uninit_enc),
 
 	CUTE_REF(dpackut_map_encode_bool),
+	CUTE_REF(dpackut_map_encode_open_compact),
+	CUTE_REF(dpackut_map_encode_open_cancel),
 	CUTE_REF(dpackut_map_encode_int8),
 	CUTE_REF(dpackut_map_encode_uint8),
 	CUTE_REF(dpackut_map_encode_int16),
@@ -1056,6 +1748,20 @@ CUTE_GROUP(dpackut_map_group) = {
 	CUTE_REF(dpackut_map_encode_bin),
 	CUTE_REF(dpackut_map_encode_multi),
 	CUTE_REF(dpackut_map_encode_nest),
+	CUTE_REF(dpackut_map_encode_raw),
+
+	CUTE_REF(dpackut_map_decode_columns),
+	CUTE_REF(dpackut_map_decode_columns_error),
+	CUTE_REF(dpackut_map_decode_raw_lend),
+	CUTE_REF(dpackut_map_decode_raw_inplace),
+	CUTE_REF(dpackut_map_decode_raw_copy),
+	CUTE_REF(dpackut_map_decode_raw_cpy),
+
+	CUTE_REF(dpackut_map_edit_init),
+	CUTE_REF(dpackut_map_edit_update),
+	CUTE_REF(dpackut_map_edit_insert),
+	CUTE_REF(dpackut_map_edit_delete),
+	CUTE_REF(dpackut_map_edit_assert)
 };
 
 CUTE_SUITE_EXTERN(dpackut_map_suite,
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/memfd.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Enough elements to force memory file to grow beyond a single page. */
+#define DPACKUT_MEMFD_ELM_NR (4096U)
+
+CUTE_TEST(dpackut_memfd_handoff)
+{
+	struct dpack_encoder_memfd enc;
+	struct dpack_decoder_file  dec;
+	uint32_t                   v;
+	uint32_t                   val;
+	int                        fd;
+
+	cute_check_sint(dpack_encoder_init_memfd(&enc, "dpackut_memfd", 1),
+	                equal,
+	                0);
+	for (v = 0; v < DPACKUT_MEMFD_ELM_NR; v++)
+		cute_check_sint(dpack_encode_uint32(&enc.base, v * 1000U),
+		                equal,
+		                0);
+	fd = dpack_encoder_seal_memfd(&enc);
+	cute_check_sint(fd, greater_equal, 0);
+
+	/* Sealed content cannot be modified anymore. */
+	cute_check_sint(pwrite(fd, &v, sizeof(v), 0), equal, -1);
+	cute_check_sint(errno, equal, EPERM);
+
+	cute_check_sint(dpack_decoder_init_memfd(&dec, fd, false), equal, 0);
+	for (v = 0; v < DPACKUT_MEMFD_ELM_NR; v++) {
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, v * 1000U);
+	}
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	cute_check_sint(dpack_decoder_fini(&dec.base), equal, 0);
+}
+
+CUTE_TEST(dpackut_memfd_unsealed)
+{
+	struct dpack_decoder_file dec;
+	int                       fd;
+
+	fd = memfd_create("dpackut_memfd_unsealed", 0);
+	cute_check_sint(fd, greater_equal, 0);
+	cute_check_sint(write(fd, "\x01", 1), equal, 1);
+
+	cute_check_sint(dpack_decoder_init_memfd(&dec, fd, false),
+	                equal,
+	                -EPERM);
+
+	close(fd);
+}
+
+CUTE_TEST(dpackut_memfd_empty)
+{
+	struct dpack_encoder_memfd enc;
+
+	cute_check_sint(dpack_encoder_init_memfd(&enc, "dpackut_memfd", 0),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encoder_seal_memfd(&enc), equal, -ENODATA);
+}
+
+CUTE_GROUP(dpackut_memfd_group) = {
+	CUTE_REF(dpackut_memfd_handoff),
+	CUTE_REF(dpackut_memfd_unsealed),
+	CUTE_REF(dpackut_memfd_empty)
+};
+
+CUTE_SUITE_EXTERN(dpackut_memfd_suite,
+                  dpackut_memfd_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
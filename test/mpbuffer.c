@@ -0,0 +1,407 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/mpbuffer.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+
+/* Room for 4 records holding a single encoded uint32_t each. */
+#define DPACKUT_MPBUFFER_SIZE (4U * 2U * DPACK_MPBUFFER_HEAD_SIZE)
+
+struct dpackut_mpbuffer_sink {
+	unsigned int nr;
+	uint32_t     vals[8];
+	int          err;
+};
+
+static int
+dpackut_mpbuffer_drain(const uint8_t * __restrict msg,
+                       size_t                     size,
+                       void * __restrict          data)
+{
+	struct dpackut_mpbuffer_sink * sink = data;
+	struct dpack_decoder_buffer    dec;
+
+	if (sink->err)
+		return sink->err;
+
+	dpack_decoder_init_buffer(&dec, msg, size);
+	cute_check_sint(dpack_decode_uint32(&dec.base,
+	                                    &sink->vals[sink->nr++]),
+	                equal,
+	                0);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	return 0;
+}
+
+static void
+dpackut_mpbuffer_encode(struct dpack_encoder_mpbuffer * encoder,
+                        struct dpack_mpbuffer *         mpbuffer,
+                        uint32_t                        value)
+{
+	cute_check_sint(dpack_encoder_init_mpbuffer(encoder,
+	                                            mpbuffer,
+	                                            DPACK_UINT32_SIZE_MAX),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encode_uint32(&encoder->buff.base, value),
+	                equal,
+	                0);
+}
+
+CUTE_TEST(dpackut_mpbuffer_order)
+{
+	uint64_t                      mem[DPACKUT_MPBUFFER_SIZE /
+	                                  sizeof(uint64_t)];
+	struct dpack_mpbuffer         mpbuff;
+	struct dpack_encoder_mpbuffer enc[4];
+	struct dpackut_mpbuffer_sink  sink = { 0, };
+
+	dpack_mpbuffer_init(&mpbuff, (uint8_t *)mem, sizeof(mem));
+
+	dpackut_mpbuffer_encode(&enc[0], &mpbuff, 0);
+	dpackut_mpbuffer_encode(&enc[1], &mpbuff, 1);
+	dpackut_mpbuffer_encode(&enc[2], &mpbuff, 2);
+
+	/* Nothing may be drained until first reserved span is released. */
+	dpack_encoder_commit_mpbuffer(&enc[1]);
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 0);
+
+	dpack_encoder_drop_mpbuffer(&enc[0]);
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 1);
+	cute_check_uint(sink.vals[0], equal, 1);
+
+	/* Drain errors interrupt draining and keep message around. */
+	dpack_encoder_commit_mpbuffer(&enc[2]);
+	sink.err = -EIO;
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                -EIO);
+	sink.err = 0;
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 2);
+	cute_check_uint(sink.vals[1], equal, 2);
+}
+
+CUTE_TEST(dpackut_mpbuffer_reclaim)
+{
+	uint64_t                      mem[DPACKUT_MPBUFFER_SIZE /
+	                                  sizeof(uint64_t)];
+	struct dpack_mpbuffer         mpbuff;
+	struct dpack_encoder_mpbuffer enc;
+	struct dpackut_mpbuffer_sink  sink = { 0, };
+	uint32_t                      v;
+
+	dpack_mpbuffer_init(&mpbuff, (uint8_t *)mem, sizeof(mem));
+
+	cute_check_sint(dpack_encoder_init_mpbuffer(&enc,
+	                                            &mpbuff,
+	                                            sizeof(mem)),
+	                equal,
+	                -EMSGSIZE);
+
+	/* Fill buffer up... */
+	for (v = 0; v < 4; v++) {
+		dpackut_mpbuffer_encode(&enc, &mpbuff, v);
+		dpack_encoder_commit_mpbuffer(&enc);
+	}
+	cute_check_sint(dpack_encoder_init_mpbuffer(&enc, &mpbuff, 1),
+	                equal,
+	                -ENOSPC);
+
+	/* ...drain it so that space is reclaimed. */
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 4);
+	for (v = 0; v < 4; v++)
+		cute_check_uint(sink.vals[v], equal, v);
+
+	for (v = 4; v < 8; v++) {
+		dpackut_mpbuffer_encode(&enc, &mpbuff, v);
+		dpack_encoder_commit_mpbuffer(&enc);
+	}
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 8);
+	for (v = 4; v < 8; v++)
+		cute_check_uint(sink.vals[v], equal, v);
+}
+
+CUTE_TEST(dpackut_mpbuffer_wrap)
+{
+	uint64_t                      mem[DPACKUT_MPBUFFER_SIZE /
+	                                  sizeof(uint64_t)];
+	struct dpack_mpbuffer         mpbuff;
+	struct dpack_encoder_mpbuffer enc[4];
+	struct dpackut_mpbuffer_sink  sink = { 0, };
+
+	dpack_mpbuffer_init(&mpbuff, (uint8_t *)mem, sizeof(mem));
+
+	dpackut_mpbuffer_encode(&enc[0], &mpbuff, 0);
+	dpackut_mpbuffer_encode(&enc[1], &mpbuff, 1);
+	dpackut_mpbuffer_encode(&enc[2], &mpbuff, 2);
+	dpack_encoder_commit_mpbuffer(&enc[0]);
+	dpack_encoder_commit_mpbuffer(&enc[1]);
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 2);
+
+	/*
+	 * Space drained ahead of the span still being encoded is reclaimed: a
+	 * span too large to fit before the end of buffer wraps around to its
+	 * start.
+	 */
+	cute_check_sint(dpack_encoder_init_mpbuffer(&enc[3],
+	                                            &mpbuff,
+	                                            2 * DPACK_UINT32_SIZE_MAX),
+	                equal,
+	                0);
+	cute_check_ptr(enc[3].buff.buff,
+	               equal,
+	               (uint8_t *)mem + DPACK_MPBUFFER_HEAD_SIZE);
+	cute_check_sint(dpack_encode_uint32(&enc[3].buff.base, 3), equal, 0);
+	cute_check_sint(dpack_encoder_init_mpbuffer(&enc[0], &mpbuff, 1),
+	                equal,
+	                -ENOSPC);
+
+	dpack_encoder_commit_mpbuffer(&enc[3]);
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 2);
+
+	dpack_encoder_commit_mpbuffer(&enc[2]);
+	cute_check_sint(dpack_mpbuffer_drain(&mpbuff,
+	                                     dpackut_mpbuffer_drain,
+	                                     &sink),
+	                equal,
+	                0);
+	cute_check_uint(sink.nr, equal, 4);
+	cute_check_uint(sink.vals[2], equal, 2);
+	cute_check_uint(sink.vals[3], equal, 3);
+	cute_check_uint(mpbuff.head, equal, mpbuff.tail);
+}
+
+#define DPACKUT_MPBUFFER_THREAD_NR (4U)
+#define DPACKUT_MPBUFFER_MSG_NR    (4096U)
+/* Room for 16 records holding a single encoded uint32_t each. */
+#define DPACKUT_MPBUFFER_MT_SIZE   (16U * 2U * DPACK_MPBUFFER_HEAD_SIZE)
+
+/* Every 5th message of each producer is dropped instead of committed. */
+#define dpackut_mpbuffer_mt_dropped(_id) (((_id) % 5U) == 4U)
+
+static struct dpack_mpbuffer dpackut_mpbuffer_mt;
+
+/*
+ * Extra space producers reserve for every other message, making spans of
+ * various sizes wrap around the end of buffer.
+ */
+static size_t                dpackut_mpbuffer_mt_extra;
+
+struct dpackut_mpbuffer_mt_sink {
+	unsigned int nr;
+	uint32_t     next[DPACKUT_MPBUFFER_THREAD_NR];
+};
+
+static void *
+dpackut_mpbuffer_mt_produce(void * arg)
+{
+	uint32_t tid = (uint32_t)(uintptr_t)arg;
+	uint32_t m;
+
+	for (m = 0; m < DPACKUT_MPBUFFER_MSG_NR; m++) {
+		struct dpack_encoder_mpbuffer enc;
+		int                           err;
+
+		do {
+			err = dpack_encoder_init_mpbuffer(
+				&enc,
+				&dpackut_mpbuffer_mt,
+				DPACK_UINT32_SIZE_MAX +
+				((m & 1) * dpackut_mpbuffer_mt_extra));
+			if (err == -ENOSPC)
+				/* Wait for flusher to reclaim space. */
+				sched_yield();
+		} while (err == -ENOSPC);
+		if (err)
+			return (void *)(intptr_t)err;
+
+		err = dpack_encode_uint32(&enc.buff.base, (tid << 16) | m);
+		if (err) {
+			dpack_encoder_drop_mpbuffer(&enc);
+			return (void *)(intptr_t)err;
+		}
+
+		if (dpackut_mpbuffer_mt_dropped(m))
+			dpack_encoder_drop_mpbuffer(&enc);
+		else
+			dpack_encoder_commit_mpbuffer(&enc);
+	}
+
+	return NULL;
+}
+
+static int
+dpackut_mpbuffer_mt_drain(const uint8_t * __restrict msg,
+                          size_t                     size,
+                          void * __restrict          data)
+{
+	struct dpackut_mpbuffer_mt_sink * sink = data;
+	struct dpack_decoder_buffer       dec;
+	uint32_t                          val;
+	uint32_t                          tid;
+	int                               err;
+
+	dpack_decoder_init_buffer(&dec, msg, size);
+	err = dpack_decode_uint32(&dec.base, &val);
+	if (!err && dpack_decoder_data_left(&dec.base))
+		err = -EBADMSG;
+	dpack_decoder_fini(&dec.base);
+	if (err)
+		return err;
+
+	tid = val >> 16;
+	if (tid >= DPACKUT_MPBUFFER_THREAD_NR)
+		return -EBADMSG;
+
+	/*
+	 * Messages of a producer must be drained in encoding order, dropped
+	 * ones excluded.
+	 */
+	if (dpackut_mpbuffer_mt_dropped(sink->next[tid]))
+		sink->next[tid]++;
+	if ((val & 0xffffU) != sink->next[tid])
+		return -EBADMSG;
+
+	sink->next[tid]++;
+	sink->nr++;
+
+	return 0;
+}
+
+static void
+dpackut_mpbuffer_mt_run(size_t extra, size_t size)
+{
+	uint64_t                        mem[DPACKUT_MPBUFFER_MT_SIZE /
+	                                    sizeof(uint64_t)];
+	pthread_t                       tids[DPACKUT_MPBUFFER_THREAD_NR];
+	struct dpackut_mpbuffer_mt_sink sink = { .nr = 0, };
+	unsigned int                    expect = 0;
+	unsigned int                    t;
+	uint32_t                        m;
+
+	for (m = 0; m < DPACKUT_MPBUFFER_MSG_NR; m++)
+		if (!dpackut_mpbuffer_mt_dropped(m))
+			expect++;
+	expect *= DPACKUT_MPBUFFER_THREAD_NR;
+
+	cute_check_uint(size, lower_equal, sizeof(mem));
+	dpackut_mpbuffer_mt_extra = extra;
+	dpack_mpbuffer_init(&dpackut_mpbuffer_mt, (uint8_t *)mem, size);
+
+	for (t = 0; t < DPACKUT_MPBUFFER_THREAD_NR; t++)
+		cute_check_sint(pthread_create(&tids[t],
+		                               NULL,
+		                               dpackut_mpbuffer_mt_produce,
+		                               (void *)(uintptr_t)t),
+		                equal,
+		                0);
+
+	/* Calling thread is the single flusher. */
+	while (sink.nr < expect) {
+		int err;
+
+		err = dpack_mpbuffer_drain(&dpackut_mpbuffer_mt,
+		                           dpackut_mpbuffer_mt_drain,
+		                           &sink);
+		if (err) {
+			cute_check_sint(err, equal, 0);
+			break;
+		}
+
+		sched_yield();
+	}
+
+	for (t = 0; t < DPACKUT_MPBUFFER_THREAD_NR; t++) {
+		void * ret;
+
+		cute_check_sint(pthread_join(tids[t], &ret), equal, 0);
+		cute_check_ptr(ret, equal, NULL);
+	}
+
+	cute_check_uint(sink.nr, equal, expect);
+	/* Everything was drained and all space reclaimed. */
+	cute_check_uint(dpackut_mpbuffer_mt.head,
+	                equal,
+	                dpackut_mpbuffer_mt.tail);
+}
+
+CUTE_TEST(dpackut_mpbuffer_concurrent)
+{
+	dpackut_mpbuffer_mt_run(0, DPACKUT_MPBUFFER_MT_SIZE);
+}
+
+/*
+ * Producers keep reserving spans of various sizes while flusher drains them:
+ * space must be reclaimed from behind drained spans without waiting for the
+ * whole buffer to be drained.
+ */
+CUTE_TEST(dpackut_mpbuffer_sustained)
+{
+	dpackut_mpbuffer_mt_run(3 * DPACK_MPBUFFER_HEAD_SIZE,
+	                        DPACKUT_MPBUFFER_MT_SIZE -
+	                        DPACK_MPBUFFER_HEAD_SIZE);
+}
+
+CUTE_GROUP(dpackut_mpbuffer_group) = {
+	CUTE_REF(dpackut_mpbuffer_order),
+	CUTE_REF(dpackut_mpbuffer_reclaim),
+	CUTE_REF(dpackut_mpbuffer_wrap),
+	CUTE_REF(dpackut_mpbuffer_concurrent),
+	CUTE_REF(dpackut_mpbuffer_sustained)
+};
+
+CUTE_SUITE_EXTERN(dpackut_mpbuffer_suite,
+                  dpackut_mpbuffer_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
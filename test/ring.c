@@ -0,0 +1,126 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/ring.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <unistd.h>
+#include <errno.h>
+
+#define DPACKUT_RING_SLOT_NR (4U)
+
+static void
+dpackut_ring_setup(struct dpack_ring * prod, struct dpack_ring * cons)
+{
+	int mfd;
+	int efd;
+
+	cute_check_sint(dpack_ring_create(prod, DPACKUT_RING_SLOT_NR, 16),
+	                equal,
+	                0);
+
+	mfd = dup(dpack_ring_mem_fd(prod));
+	cute_check_sint(mfd, greater_equal, 0);
+	efd = dup(dpack_ring_event_fd(prod));
+	cute_check_sint(efd, greater_equal, 0);
+
+	cute_check_sint(dpack_ring_attach(cons, mfd, efd), equal, 0);
+}
+
+static void
+dpackut_ring_produce(struct dpack_ring * ring, uint32_t value)
+{
+	struct dpack_encoder_ring enc;
+
+	cute_check_sint(dpack_encoder_init_ring(&enc, ring), equal, 0);
+	cute_check_sint(dpack_encode_uint32(&enc.buff.base, value), equal, 0);
+	dpack_encoder_commit_ring(&enc);
+}
+
+static void
+dpackut_ring_consume(struct dpack_ring * ring, uint32_t value)
+{
+	struct dpack_decoder_ring dec;
+	uint32_t                  val;
+
+	cute_check_sint(dpack_decoder_init_ring(&dec, ring), equal, 0);
+	cute_check_sint(dpack_decode_uint32(&dec.buff.base, &val), equal, 0);
+	cute_check_uint(val, equal, value);
+	cute_check_uint(dpack_decoder_data_left(&dec.buff.base), equal, 0);
+	dpack_decoder_release_ring(&dec);
+}
+
+CUTE_TEST(dpackut_ring_exchange)
+{
+	struct dpack_ring         prod;
+	struct dpack_ring         cons;
+	struct dpack_encoder_ring enc;
+	struct dpack_decoder_ring dec;
+	uint32_t                  v;
+
+	dpackut_ring_setup(&prod, &cons);
+
+	cute_check_sint(dpack_decoder_init_ring(&dec, &cons), equal, -EAGAIN);
+
+	/* Fill ring up... */
+	for (v = 0; v < DPACKUT_RING_SLOT_NR; v++)
+		dpackut_ring_produce(&prod, v);
+	cute_check_sint(dpack_encoder_init_ring(&enc, &prod), equal, -EAGAIN);
+	cute_check_sint(dpack_ring_wait(&cons), equal, 0);
+
+	/* ...release a single slot and wrap around. */
+	dpackut_ring_consume(&cons, 0);
+	dpackut_ring_produce(&prod, DPACKUT_RING_SLOT_NR);
+
+	for (v = 1; v <= DPACKUT_RING_SLOT_NR; v++)
+		dpackut_ring_consume(&cons, v);
+	cute_check_sint(dpack_decoder_init_ring(&dec, &cons), equal, -EAGAIN);
+
+	dpack_ring_fini(&cons);
+	dpack_ring_fini(&prod);
+}
+
+CUTE_TEST(dpackut_ring_drop)
+{
+	struct dpack_ring         prod;
+	struct dpack_ring         cons;
+	struct dpack_encoder_ring enc;
+	struct dpack_decoder_ring dec;
+
+	dpackut_ring_setup(&prod, &cons);
+
+	/* Message larger than slot size cannot be encoded, then dropped. */
+	cute_check_sint(dpack_encoder_init_ring(&enc, &prod), equal, 0);
+	cute_check_sint(dpack_encode_uint64(&enc.buff.base, UINT64_MAX),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encode_uint64(&enc.buff.base, UINT64_MAX),
+	                equal,
+	                -EMSGSIZE);
+	dpack_encoder_fini(&enc.buff.base);
+	cute_check_sint(dpack_decoder_init_ring(&dec, &cons), equal, -EAGAIN);
+
+	dpackut_ring_produce(&prod, 1);
+	dpackut_ring_consume(&cons, 1);
+
+	dpack_ring_fini(&cons);
+	dpack_ring_fini(&prod);
+}
+
+CUTE_GROUP(dpackut_ring_group) = {
+	CUTE_REF(dpackut_ring_exchange),
+	CUTE_REF(dpackut_ring_drop)
+};
+
+CUTE_SUITE_EXTERN(dpackut_ring_suite,
+                  dpackut_ring_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -0,0 +1,645 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/rpc.h"
+#include "dpack/array.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static unsigned int dpackut_rpc_notified;
+
+static int
+dpackut_rpc_add(struct dpack_decoder * __restrict params,
+                struct dpack_encoder * __restrict result,
+                void * __restrict                 data __unused)
+{
+	uint32_t a;
+	uint32_t b;
+	int      err;
+
+	err = dpack_array_decode_count_equ(params, 2);
+	if (!err)
+		err = dpack_decode_uint32(params, &a);
+	if (!err)
+		err = dpack_decode_uint32(params, &b);
+	if (err)
+		return -EINVAL;
+
+	return dpack_encode_uint32(result, a + b);
+}
+
+static int
+dpackut_rpc_fail(struct dpack_decoder * __restrict params __unused,
+                 struct dpack_encoder * __restrict result,
+                 void * __restrict                 data __unused)
+{
+	/* Partial result must be discarded. */
+	cute_check_sint(dpack_encode_uint32(result, 1), equal, 0);
+
+	return -EPERM;
+}
+
+static int
+dpackut_rpc_notice(struct dpack_decoder * __restrict params __unused,
+                   struct dpack_encoder * __restrict result __unused,
+                   void * __restrict                 data __unused)
+{
+	dpackut_rpc_notified++;
+
+	return 0;
+}
+
+#define DPACKUT_RPC_BLOB_TESTS \
+	(((3 * DPACK_RPC_MSG_SIZE_MAX / 2) / DPACK_STRLEN_MAX) < \
+	 DPACK_ARRAY_ELMNR_MAX)
+
+#if DPACKUT_RPC_BLOB_TESTS
+
+/* Encode an array of strings carrying about size bytes of payload. */
+static int
+dpackut_rpc_encode_blob(struct dpack_encoder * __restrict encoder, size_t size)
+{
+	static char  str[DPACK_STRLEN_MAX + 1];
+	unsigned int nr = (unsigned int)((size + DPACK_STRLEN_MAX - 1) /
+	                                 DPACK_STRLEN_MAX);
+	size_t       len = size / nr;
+	unsigned int s;
+	int          err;
+
+	memset(str, 'x', len);
+	str[len] = '\0';
+
+	err = dpack_array_begin_encode(encoder, nr);
+	for (s = 0; !err && (s < nr); s++)
+		err = dpack_encode_str_fix(encoder, str, len);
+	if (!err)
+		dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+static int
+dpackut_rpc_half(struct dpack_decoder * __restrict params __unused,
+                 struct dpack_encoder * __restrict result,
+                 void * __restrict                 data __unused)
+{
+	return dpackut_rpc_encode_blob(result, DPACK_RPC_MSG_SIZE_MAX / 2);
+}
+
+static int
+dpackut_rpc_huge(struct dpack_decoder * __restrict params __unused,
+                 struct dpack_encoder * __restrict result,
+                 void * __restrict                 data __unused)
+{
+	/* Larger than a message but fits into transmit buffer. */
+	return dpackut_rpc_encode_blob(result,
+	                               3 * DPACK_RPC_MSG_SIZE_MAX / 2);
+}
+
+#endif /* DPACKUT_RPC_BLOB_TESTS */
+
+static const struct dpack_rpc_method dpackut_rpc_methods[] = {
+	{ .name = "add",    .handler = dpackut_rpc_add },
+	{ .name = "fail",   .handler = dpackut_rpc_fail },
+#if DPACKUT_RPC_BLOB_TESTS
+	{ .name = "half",   .handler = dpackut_rpc_half },
+	{ .name = "huge",   .handler = dpackut_rpc_huge },
+#endif /* DPACKUT_RPC_BLOB_TESTS */
+	{ .name = "notice", .handler = dpackut_rpc_notice }
+};
+
+static int
+dpackut_rpc_encode_add(struct dpack_encoder * __restrict encoder,
+                       void * __restrict                 data)
+{
+	const uint32_t * ops = data;
+	int              err;
+
+	err = dpack_array_begin_encode(encoder, 2);
+	if (!err)
+		err = dpack_encode_uint32(encoder, ops[0]);
+	if (!err)
+		err = dpack_encode_uint32(encoder, ops[1]);
+	if (!err)
+		dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+static int
+dpackut_rpc_encode_nil(struct dpack_encoder * __restrict encoder,
+                       void * __restrict                 data __unused)
+{
+	int err;
+
+	/* Empty arrays cannot be encoded: pass a single nil parameter. */
+	err = dpack_array_begin_encode(encoder, 1);
+	if (!err)
+		err = dpack_encode_nil(encoder);
+	if (!err)
+		dpack_array_end_encode(encoder);
+
+	return err;
+}
+
+struct dpackut_rpc_reply {
+	uint32_t msgid;
+	int      error;
+	uint32_t sum;
+};
+
+static int
+dpackut_rpc_reply(uint32_t                          msgid,
+                  int                               error,
+                  struct dpack_decoder * __restrict result,
+                  void * __restrict                 data)
+{
+	struct dpackut_rpc_reply * rep = data;
+	int                        err;
+
+	rep->msgid = msgid;
+	rep->error = error;
+	if (!error) {
+		err = dpack_decode_uint32(result, &rep->sum);
+		cute_check_sint(err, equal, 0);
+	}
+	else {
+		err = dpack_decode_nil(result);
+		cute_check_sint(err, equal, 0);
+	}
+
+	return 0;
+}
+
+static int
+dpackut_rpc_collect(uint32_t                          msgid,
+                    int                               error,
+                    struct dpack_decoder * __restrict result,
+                    void * __restrict                 data)
+{
+	struct dpackut_rpc_reply * reps = data;
+
+	return dpackut_rpc_reply(msgid, error, result, &reps[msgid]);
+}
+
+static int
+dpackut_rpc_errors(uint32_t                          msgid,
+                   int                               error,
+                   struct dpack_decoder * __restrict result __unused,
+                   void * __restrict                 data)
+{
+	int * errs = data;
+
+	/* Result is left undecoded and skipped. */
+	errs[msgid] = error;
+
+	return 0;
+}
+
+CUTE_TEST(dpackut_rpc_pipeline)
+{
+	struct dpack_rpc_server  srv;
+	struct dpack_rpc_client  clnt;
+	struct dpackut_rpc_reply reps[3] = { 0, };
+	const uint32_t           ops[2] = { 40, 2 };
+	int                      fds[2];
+	int                      id;
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      dpackut_rpc_methods,
+	                                      stroll_array_nr(dpackut_rpc_methods),
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+	cute_check_sint(dpack_rpc_client_init(&clnt, fds[1]), equal, 0);
+
+	/* Pipeline requests and a notification, then send them at once. */
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "add",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_notify(&clnt,
+	                                 "notice",
+	                                 dpackut_rpc_encode_nil,
+	                                 NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "fail",
+	                               dpackut_rpc_encode_nil,
+	                               NULL),
+	                equal,
+	                1);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "unknown",
+	                               dpackut_rpc_encode_nil,
+	                               NULL),
+	                equal,
+	                2);
+	cute_check_sint(dpack_rpc_client_flush(&clnt), equal, 0);
+
+	cute_check_sint(dpack_rpc_server_run(&srv, -1), equal, 0);
+	cute_check_uint(dpackut_rpc_notified, equal, 1);
+
+	for (id = 0; id < 3;) {
+		int cnt;
+
+		cnt = dpack_rpc_client_recv(&clnt, dpackut_rpc_collect, reps);
+		cute_check_sint(cnt, greater, 0);
+		id += cnt;
+	}
+
+	cute_check_uint(reps[0].msgid, equal, 0);
+	cute_check_sint(reps[0].error, equal, 0);
+	cute_check_uint(reps[0].sum, equal, 42);
+	cute_check_uint(reps[1].msgid, equal, 1);
+	cute_check_sint(reps[1].error, equal, -EPERM);
+	cute_check_uint(reps[2].msgid, equal, 2);
+	cute_check_sint(reps[2].error, equal, -ENOSYS);
+
+	dpack_rpc_client_fini(&clnt);
+	dpack_rpc_server_fini(&srv);
+}
+
+CUTE_TEST(dpackut_rpc_dup_method)
+{
+	const struct dpack_rpc_method meths[] = {
+		{ .name = "add", .handler = dpackut_rpc_add },
+		{ .name = "add", .handler = dpackut_rpc_fail }
+	};
+	struct dpack_rpc_server       srv;
+
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      meths,
+	                                      stroll_array_nr(meths),
+	                                      NULL),
+	                equal,
+	                -EEXIST);
+}
+
+#define DPACKUT_RPC_METHOD_NR (257U)
+
+CUTE_TEST(dpackut_rpc_many_methods)
+{
+	static char              names[DPACKUT_RPC_METHOD_NR][8];
+	struct dpack_rpc_method  meths[DPACKUT_RPC_METHOD_NR];
+	struct dpack_rpc_server  srv;
+	struct dpack_rpc_client  clnt;
+	struct dpackut_rpc_reply reps[3] = { 0, };
+	const uint32_t           ops[2] = { 40, 2 };
+	int                      fds[2];
+	unsigned int             m;
+	int                      id;
+
+	for (m = 0; m < DPACKUT_RPC_METHOD_NR; m++) {
+		sprintf(names[m], "m%u", m);
+		meths[m].name = names[m];
+		meths[m].handler = dpackut_rpc_add;
+	}
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      meths,
+	                                      DPACKUT_RPC_METHOD_NR,
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+	cute_check_sint(dpack_rpc_client_init(&clnt, fds[1]), equal, 0);
+
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "m0",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "m256",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                1);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "m257",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                2);
+	cute_check_sint(dpack_rpc_client_flush(&clnt), equal, 0);
+
+	cute_check_sint(dpack_rpc_server_run(&srv, -1), equal, 0);
+
+	for (id = 0; id < 3;) {
+		int cnt;
+
+		cnt = dpack_rpc_client_recv(&clnt, dpackut_rpc_collect, reps);
+		cute_check_sint(cnt, greater, 0);
+		id += cnt;
+	}
+
+	cute_check_sint(reps[0].error, equal, 0);
+	cute_check_uint(reps[0].sum, equal, 42);
+	cute_check_sint(reps[1].error, equal, 0);
+	cute_check_uint(reps[1].sum, equal, 42);
+	cute_check_sint(reps[2].error, equal, -ENOSYS);
+
+	dpack_rpc_client_fini(&clnt);
+	dpack_rpc_server_fini(&srv);
+
+	/* Duplicates are detected whatever their position. */
+	meths[DPACKUT_RPC_METHOD_NR - 1].name = names[0];
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      meths,
+	                                      DPACKUT_RPC_METHOD_NR,
+	                                      NULL),
+	                equal,
+	                -EEXIST);
+}
+
+#if DPACK_STRLEN_MAX > DPACK_RPC_METHOD_LEN_MAX
+
+CUTE_TEST(dpackut_rpc_long_method)
+{
+	struct dpack_rpc_server  srv;
+	struct dpack_rpc_client  clnt;
+	struct dpackut_rpc_reply reps[2] = { 0, };
+	const uint32_t           ops[2] = { 40, 2 };
+	char                     name[DPACK_RPC_METHOD_LEN_MAX + 2];
+	int                      fds[2];
+	int                      id;
+
+	/*
+	 * Name too long to be registered, starting with a byte that is not a
+	 * valid MessagePack tag.
+	 */
+	memset(name, 'x', sizeof(name) - 1);
+	name[0] = (char)0xc1;
+	name[sizeof(name) - 1] = '\0';
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      dpackut_rpc_methods,
+	                                      stroll_array_nr(dpackut_rpc_methods),
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+	cute_check_sint(dpack_rpc_client_init(&clnt, fds[1]), equal, 0);
+
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               name,
+	                               dpackut_rpc_encode_nil,
+	                               NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "add",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                1);
+	cute_check_sint(dpack_rpc_client_flush(&clnt), equal, 0);
+
+	cute_check_sint(dpack_rpc_server_run(&srv, -1), equal, 0);
+
+	for (id = 0; id < 2;) {
+		int cnt;
+
+		cnt = dpack_rpc_client_recv(&clnt, dpackut_rpc_collect, reps);
+		cute_check_sint(cnt, greater, 0);
+		id += cnt;
+	}
+
+	/* Unknown method is replied to and connection remains usable. */
+	cute_check_sint(reps[0].error, equal, -ENOSYS);
+	cute_check_sint(reps[1].error, equal, 0);
+	cute_check_uint(reps[1].sum, equal, 42);
+
+	dpack_rpc_client_fini(&clnt);
+	dpack_rpc_server_fini(&srv);
+}
+
+#endif /* DPACK_STRLEN_MAX > DPACK_RPC_METHOD_LEN_MAX */
+
+/*
+ * Send raw data to server and check it closes the connection without replying.
+ */
+static void
+dpackut_rpc_check_reject(const uint8_t * data, size_t size)
+{
+	struct dpack_rpc_server srv;
+	int                     fds[2];
+	size_t                  sent = 0;
+	uint8_t                 byte;
+	ssize_t                 ret;
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      dpackut_rpc_methods,
+	                                      stroll_array_nr(dpackut_rpc_methods),
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+
+	while (sent < size) {
+		ret = send(fds[1],
+		           &data[sent],
+		           size - sent,
+		           MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret < 0) {
+			cute_check_sint(errno, equal, EAGAIN);
+			ret = 0;
+		}
+		sent += (size_t)ret;
+
+		cute_check_sint(dpack_rpc_server_run(&srv, 0), equal, 0);
+	}
+
+	while ((ret = recv(fds[1], &byte, 1, MSG_DONTWAIT)) < 0) {
+		cute_check_sint(errno, equal, EAGAIN);
+		cute_check_sint(dpack_rpc_server_run(&srv, 0), equal, 0);
+	}
+	cute_check_sint(ret, equal, 0);
+
+	close(fds[1]);
+	dpack_rpc_server_fini(&srv);
+}
+
+CUTE_TEST(dpackut_rpc_deep_nesting)
+{
+	uint8_t * data;
+
+	data = malloc(DPACK_RPC_MSG_SIZE_MAX);
+	cute_check_ptr(data, unequal, NULL);
+
+	/*
+	 * Maximum sized message made of nested single item arrays: it is framed
+	 * then rejected as not being a MessagePack-RPC message.
+	 */
+	memset(data, 0x91, DPACK_RPC_MSG_SIZE_MAX - 1);
+	data[DPACK_RPC_MSG_SIZE_MAX - 1] = 0xc0;
+	dpackut_rpc_check_reject(data, DPACK_RPC_MSG_SIZE_MAX);
+
+	/* Unterminated nesting fills up receive buffer. */
+	data[DPACK_RPC_MSG_SIZE_MAX - 1] = 0x91;
+	dpackut_rpc_check_reject(data, DPACK_RPC_MSG_SIZE_MAX);
+
+	free(data);
+}
+
+#if DPACKUT_RPC_BLOB_TESTS
+
+CUTE_TEST(dpackut_rpc_huge_reply)
+{
+	struct dpack_rpc_server srv;
+	struct dpack_rpc_client clnt;
+	const uint32_t          ops[2] = { 40, 2 };
+	int                     errs[2] = { 1, 1 };
+	int                     fds[2];
+	int                     id;
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      dpackut_rpc_methods,
+	                                      stroll_array_nr(dpackut_rpc_methods),
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+	cute_check_sint(dpack_rpc_client_init(&clnt, fds[1]), equal, 0);
+
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "huge",
+	                               dpackut_rpc_encode_nil,
+	                               NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_call(&clnt,
+	                               "add",
+	                               dpackut_rpc_encode_add,
+	                               (void *)ops),
+	                equal,
+	                1);
+	cute_check_sint(dpack_rpc_client_flush(&clnt), equal, 0);
+
+	cute_check_sint(dpack_rpc_server_run(&srv, -1), equal, 0);
+
+	for (id = 0; id < 2;) {
+		int cnt;
+
+		cnt = dpack_rpc_client_recv(&clnt, dpackut_rpc_errors, errs);
+		cute_check_sint(cnt, greater, 0);
+		id += cnt;
+	}
+
+	/* Oversized reply is replaced by an error, next one goes through. */
+	cute_check_sint(errs[0], equal, -EMSGSIZE);
+	cute_check_sint(errs[1], equal, 0);
+
+	dpack_rpc_client_fini(&clnt);
+	dpack_rpc_server_fini(&srv);
+}
+
+#define DPACKUT_RPC_HALF_NR (16U)
+
+CUTE_TEST(dpackut_rpc_backpressure)
+{
+	struct dpack_rpc_server srv;
+	struct dpack_rpc_client clnt;
+	int                     errs[DPACKUT_RPC_HALF_NR];
+	int                     fds[2];
+	int                     sz = 4096;
+	unsigned int            id;
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	cute_check_sint(setsockopt(fds[0],
+	                           SOL_SOCKET,
+	                           SO_SNDBUF,
+	                           &sz,
+	                           sizeof(sz)),
+	                equal,
+	                0);
+	cute_check_sint(fcntl(fds[1], F_SETFL, O_NONBLOCK), equal, 0);
+	cute_check_sint(dpack_rpc_server_init(&srv,
+	                                      dpackut_rpc_methods,
+	                                      stroll_array_nr(dpackut_rpc_methods),
+	                                      NULL),
+	                equal,
+	                0);
+	cute_check_sint(dpack_rpc_server_attach(&srv, fds[0]), equal, 0);
+	cute_check_sint(dpack_rpc_client_init(&clnt, fds[1]), equal, 0);
+
+	for (id = 0; id < DPACKUT_RPC_HALF_NR; id++) {
+		errs[id] = 1;
+		cute_check_sint(dpack_rpc_call(&clnt,
+		                               "half",
+		                               dpackut_rpc_encode_nil,
+		                               NULL),
+		                equal,
+		                (int)id);
+	}
+	cute_check_sint(dpack_rpc_client_flush(&clnt), equal, 0);
+
+	/*
+	 * Replies overflow server socket: it must give control back instead of
+	 * waiting for client to read them.
+	 */
+	for (id = 0; id < DPACKUT_RPC_HALF_NR;) {
+		int cnt;
+
+		cute_check_sint(dpack_rpc_server_run(&srv, 0), equal, 0);
+
+		cnt = dpack_rpc_client_recv(&clnt, dpackut_rpc_errors, errs);
+		if (cnt == -EAGAIN)
+			continue;
+		cute_check_sint(cnt, greater, 0);
+		id += (unsigned int)cnt;
+	}
+
+	for (id = 0; id < DPACKUT_RPC_HALF_NR; id++)
+		cute_check_sint(errs[id], equal, 0);
+
+	dpack_rpc_client_fini(&clnt);
+	dpack_rpc_server_fini(&srv);
+}
+
+#endif /* DPACKUT_RPC_BLOB_TESTS */
+
+CUTE_GROUP(dpackut_rpc_group) = {
+	CUTE_REF(dpackut_rpc_pipeline),
+	CUTE_REF(dpackut_rpc_dup_method),
+	CUTE_REF(dpackut_rpc_many_methods),
+#if DPACK_STRLEN_MAX > DPACK_RPC_METHOD_LEN_MAX
+	CUTE_REF(dpackut_rpc_long_method),
+#endif /* DPACK_STRLEN_MAX > DPACK_RPC_METHOD_LEN_MAX */
+	CUTE_REF(dpackut_rpc_deep_nesting),
+#if DPACKUT_RPC_BLOB_TESTS
+	CUTE_REF(dpackut_rpc_huge_reply),
+	CUTE_REF(dpackut_rpc_backpressure)
+#endif /* DPACKUT_RPC_BLOB_TESTS */
+};
+
+CUTE_SUITE_EXTERN(dpackut_rpc_suite,
+                  dpackut_rpc_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -0,0 +1,269 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/socket.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Enough values to cycle through all chunks multiple times while fitting into
+ * the loopback receive window: zero-copy sends would otherwise never complete
+ * since nobody reads the receiving end until encoding is over.
+ */
+#define DPACKUT_SOCKET_VAL_NR (4096U)
+
+static short        dpackut_socket_revents;
+static unsigned int dpackut_socket_poll_nr;
+
+/*
+ * Encoder poll hook injecting events a socket would report once broken.
+ */
+static int
+dpackut_socket_poll(struct pollfd * fds, nfds_t nr, int tmout)
+{
+	nfds_t f;
+
+	if (!dpackut_socket_revents)
+		return poll(fds, nr, tmout);
+
+	dpackut_socket_poll_nr++;
+	for (f = 0; f < nr; f++)
+		fds[f].revents = dpackut_socket_revents;
+
+	return (int)nr;
+}
+
+static int
+dpackut_socket_connect(int * __restrict sfd)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port   = 0,
+		.sin_addr   = { .s_addr = htonl(INADDR_LOOPBACK) }
+	};
+	socklen_t          len = sizeof(addr);
+	int                lfd;
+	int                cfd;
+
+	lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	cute_check_sint(lfd, greater_equal, 0);
+	cute_check_sint(bind(lfd, (const struct sockaddr *)&addr, len),
+	                equal,
+	                0);
+	cute_check_sint(getsockname(lfd, (struct sockaddr *)&addr, &len),
+	                equal,
+	                0);
+	cute_check_sint(listen(lfd, 1), equal, 0);
+
+	cfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	cute_check_sint(cfd, greater_equal, 0);
+	cute_check_sint(connect(cfd, (const struct sockaddr *)&addr, len),
+	                equal,
+	                0);
+	*sfd = accept(lfd, NULL, NULL);
+	cute_check_sint(*sfd, greater_equal, 0);
+
+	close(lfd);
+
+	return cfd;
+}
+
+static void
+dpackut_socket_check(int fd, size_t size)
+{
+	uint8_t *                   buff;
+	size_t                      got = 0;
+	struct dpack_decoder_buffer dec;
+	unsigned int                v;
+
+	buff = malloc(size);
+	cute_check_ptr(buff, unequal, NULL);
+
+	while (got < size) {
+		ssize_t ret;
+
+		ret = recv(fd, &buff[got], size - got, 0);
+		cute_check_sint(ret, greater, 0);
+		got += (size_t)ret;
+	}
+
+	dpack_decoder_init_buffer(&dec, buff, size);
+	for (v = 0; v < DPACKUT_SOCKET_VAL_NR; v++) {
+		uint64_t val;
+
+		cute_check_sint(dpack_decode_uint64(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, ((uint64_t)v + 1) << 32);
+	}
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	free(buff);
+}
+
+static void
+dpackut_socket_encode(struct dpack_encoder_socket * __restrict enc,
+                      int                                      fd)
+{
+	unsigned int v;
+	size_t       size;
+
+	for (v = 0; v < DPACKUT_SOCKET_VAL_NR; v++)
+		cute_check_sint(dpack_encode_uint64(&enc->base,
+		                                    ((uint64_t)v + 1) << 32),
+		                equal,
+		                0);
+
+	size = dpack_encoder_space_used(&enc->base);
+	cute_check_uint(size, equal, DPACKUT_SOCKET_VAL_NR * 9U);
+
+	/* Waits for all zero-copy sends to complete. */
+	cute_check_sint(dpack_encoder_fini(&enc->base), equal, 0);
+
+	dpackut_socket_check(fd, size);
+}
+
+CUTE_TEST(dpackut_socket_tcp)
+{
+	int                         sfd;
+	int                         cfd = dpackut_socket_connect(&sfd);
+	struct dpack_encoder_socket enc;
+
+	/*
+	 * Full chunks go through MSG_ZEROCOPY, the last partial one through a
+	 * regular send. Few chunks force recycling upon completion.
+	 */
+	cute_check_sint(dpack_encoder_init_socket(&enc, cfd, 4096, 2, 2048),
+	                equal,
+	                0);
+	dpackut_socket_encode(&enc, sfd);
+
+	close(sfd);
+	close(cfd);
+}
+
+CUTE_TEST(dpackut_socket_copy)
+{
+	int                         fds[2];
+	struct dpack_encoder_socket enc;
+	int                         err;
+
+	/* Unix sockets do not support zero-copy: chunks are copied. */
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	err = dpack_encoder_init_socket(&enc,
+	                                fds[0],
+	                                4096,
+	                                1,
+	                                DPACK_ENCODER_SOCKET_ZCOPY_DFLT);
+	cute_check_sint(err, equal, 0);
+
+	cute_check_sint(dpack_encode_uint64(&enc.base, 0), equal, 0);
+	cute_check_sint(dpack_encoder_flush_socket(&enc), equal, 0);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 1);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	close(fds[1]);
+	close(fds[0]);
+}
+
+CUTE_TEST(dpackut_socket_sticky)
+{
+	int                         fds[2];
+	struct dpack_encoder_socket enc;
+	unsigned int                v = 0;
+	int                         err;
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), equal, 0);
+	err = dpack_encoder_init_socket(&enc,
+	                                fds[0],
+	                                4096,
+	                                2,
+	                                DPACK_ENCODER_SOCKET_ZCOPY_DFLT);
+	cute_check_sint(err, equal, 0);
+
+	/* Sending the first full chunk fails once the peer is gone. */
+	close(fds[1]);
+	do {
+		err = dpack_encode_uint64(&enc.base, ((uint64_t)v++ + 1) << 32);
+	} while (!err && (v < DPACKUT_SOCKET_VAL_NR));
+	cute_check_sint(err, equal, -EPIPE);
+	cute_check_uint(dpack_encoder_space_used(&enc.base), equal, 0);
+
+	/* Chunk is not sent again: encoder keeps failing instead. */
+	cute_check_sint(dpack_encode_uint64(&enc.base, 0), equal, -EPIPE);
+	cute_check_sint(dpack_encoder_flush_socket(&enc), equal, -EPIPE);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, -EPIPE);
+
+	close(fds[0]);
+}
+
+CUTE_TEST(dpackut_socket_hangup)
+{
+	int                         sfd;
+	int                         cfd = dpackut_socket_connect(&sfd);
+	struct dpack_encoder_socket enc;
+	uint8_t                     buff[4096];
+	unsigned int                v = 0;
+	int                         err;
+
+	/*
+	 * A single chunk sent using MSG_ZEROCOPY must be released before
+	 * encoding goes on: make poll(2) report a hang up meanwhile.
+	 */
+	cute_check_sint(dpack_encoder_init_socket(&enc, cfd, 4096, 1, 2048),
+	                equal,
+	                0);
+	enc.poll = dpackut_socket_poll;
+	dpackut_socket_poll_nr = 0;
+	dpackut_socket_revents = POLLHUP;
+	do {
+		err = dpack_encode_uint64(&enc.base, ((uint64_t)v++ + 1) << 32);
+	} while (!err && (v < DPACKUT_SOCKET_VAL_NR));
+	dpackut_socket_revents = 0;
+
+	if (dpackut_socket_poll_nr) {
+		/* Encoder gave up instead of polling again and again. */
+		cute_check_sint(err, equal, -EPIPE);
+		cute_check_uint(dpackut_socket_poll_nr, equal, 1);
+	}
+	else
+		/* Chunks were released without waiting. */
+		cute_check_sint(err, equal, 0);
+
+	/*
+	 * Drain receiving end so that the chunk is eventually released. Failure
+	 * is sticky.
+	 */
+	while (recv(sfd, buff, sizeof(buff), MSG_DONTWAIT) > 0)
+		;
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, err);
+
+	close(sfd);
+	close(cfd);
+}
+
+CUTE_GROUP(dpackut_socket_group) = {
+	CUTE_REF(dpackut_socket_tcp),
+	CUTE_REF(dpackut_socket_copy),
+	CUTE_REF(dpackut_socket_sticky),
+	CUTE_REF(dpackut_socket_hangup)
+};
+
+CUTE_SUITE_EXTERN(dpackut_socket_suite,
+                  dpackut_socket_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
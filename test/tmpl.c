@@ -0,0 +1,224 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/tmpl.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <errno.h>
+
+/* Constant 5 between fixed-width slots holding true, 1, -1, 2 and -2. */
+#define DPACKUT_TMPL_PACK_DATA \
+	"\xc3" \
+	"\xce\x00\x00\x00\x01" \
+	"\x05" \
+	"\xd2\xff\xff\xff\xff" \
+	"\xcf\x00\x00\x00\x00\x00\x00\x00\x02" \
+	"\xd3\xff\xff\xff\xff\xff\xff\xff\xfe"
+#define DPACKUT_TMPL_PACK_SIZE \
+	(sizeof(DPACKUT_TMPL_PACK_DATA) - 1)
+
+static void
+dpackut_tmpl_build(struct dpack_tmpl * __restrict tmpl, int * __restrict slots)
+{
+	cute_check_sint(dpack_tmpl_init(tmpl, DPACKUT_TMPL_PACK_SIZE, 5),
+	                equal,
+	                0);
+
+	slots[0] = dpack_tmpl_encode_bool(tmpl, true);
+	cute_check_sint(slots[0], equal, 0);
+	slots[1] = dpack_tmpl_encode_uint32(tmpl, 1);
+	cute_check_sint(slots[1], equal, 1);
+	cute_check_sint(dpack_encode_uint8(dpack_tmpl_encoder(tmpl), 5),
+	                equal,
+	                0);
+	slots[2] = dpack_tmpl_encode_int32(tmpl, -1);
+	cute_check_sint(slots[2], equal, 2);
+	slots[3] = dpack_tmpl_encode_uint64(tmpl, 2);
+	cute_check_sint(slots[3], equal, 3);
+	slots[4] = dpack_tmpl_encode_int64(tmpl, -2);
+	cute_check_sint(slots[4], equal, 4);
+}
+
+CUTE_TEST(dpackut_tmpl_encode)
+{
+	struct dpack_tmpl tmpl;
+	int               slots[5];
+	uint8_t           msg[DPACKUT_TMPL_PACK_SIZE];
+
+	dpackut_tmpl_build(&tmpl, slots);
+
+	/* Slots are fixed-width encoded whatever their value. */
+	cute_check_uint(dpack_tmpl_size(&tmpl), equal, DPACKUT_TMPL_PACK_SIZE);
+	cute_check_uint(dpack_tmpl_copy(&tmpl, msg),
+	                equal,
+	                DPACKUT_TMPL_PACK_SIZE);
+	cute_check_mem(msg,
+	               equal,
+	               DPACKUT_TMPL_PACK_DATA,
+	               DPACKUT_TMPL_PACK_SIZE);
+
+	dpack_tmpl_fini(&tmpl);
+}
+
+CUTE_TEST(dpackut_tmpl_store)
+{
+	struct dpack_tmpl           tmpl;
+	int                         slots[5];
+	uint8_t                     msg[DPACKUT_TMPL_PACK_SIZE];
+	struct dpack_decoder_buffer dec;
+	bool                        bval;
+	uint32_t                    u32;
+	uint8_t                     u8;
+	int32_t                     s32;
+	uint64_t                    u64;
+	int64_t                     s64;
+
+	dpackut_tmpl_build(&tmpl, slots);
+
+	dpack_tmpl_copy(&tmpl, msg);
+	dpack_tmpl_store_bool(&tmpl, msg, (unsigned int)slots[0], false);
+	dpack_tmpl_store_uint32(&tmpl, msg, (unsigned int)slots[1], UINT32_MAX);
+	dpack_tmpl_store_int32(&tmpl, msg, (unsigned int)slots[2], INT32_MIN);
+	dpack_tmpl_store_uint64(&tmpl, msg, (unsigned int)slots[3], UINT64_MAX);
+	dpack_tmpl_store_int64(&tmpl, msg, (unsigned int)slots[4], INT64_MIN);
+
+	dpack_decoder_init_buffer(&dec, msg, sizeof(msg));
+	cute_check_sint(dpack_decode_bool(&dec.base, &bval), equal, 0);
+	cute_check_bool(bval, is, false);
+	cute_check_sint(dpack_decode_uint32(&dec.base, &u32), equal, 0);
+	cute_check_uint(u32, equal, UINT32_MAX);
+	cute_check_sint(dpack_decode_uint8(&dec.base, &u8), equal, 0);
+	cute_check_uint(u8, equal, 5);
+	cute_check_sint(dpack_decode_int32(&dec.base, &s32), equal, 0);
+	cute_check_sint(s32, equal, INT32_MIN);
+	cute_check_sint(dpack_decode_uint64(&dec.base, &u64), equal, 0);
+	cute_check_uint(u64, equal, UINT64_MAX);
+	cute_check_sint(dpack_decode_int64(&dec.base, &s64), equal, 0);
+	cute_check_sint(s64, equal, INT64_MIN);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+
+	/* Template itself is left untouched. */
+	cute_check_mem(tmpl.buff.buff,
+	               equal,
+	               DPACKUT_TMPL_PACK_DATA,
+	               DPACKUT_TMPL_PACK_SIZE);
+
+	dpack_tmpl_fini(&tmpl);
+}
+
+#if defined(CONFIG_DPACK_ASSERT_API)
+
+CUTE_TEST(dpackut_tmpl_store_assert)
+{
+	struct dpack_tmpl tmpl;
+	int               slots[5];
+	uint8_t           msg[DPACKUT_TMPL_PACK_SIZE];
+
+	dpackut_tmpl_build(&tmpl, slots);
+	dpack_tmpl_copy(&tmpl, msg);
+
+	/* Slots of same size but of another type are rejected. */
+	cute_expect_assertion(dpack_tmpl_store_int32(&tmpl,
+	                                             msg,
+	                                             (unsigned int)slots[1],
+	                                             0));
+	cute_expect_assertion(dpack_tmpl_store_uint32(&tmpl,
+	                                              msg,
+	                                              (unsigned int)slots[2],
+	                                              0));
+	cute_expect_assertion(dpack_tmpl_store_int64(&tmpl,
+	                                             msg,
+	                                             (unsigned int)slots[3],
+	                                             0));
+	cute_expect_assertion(dpack_tmpl_store_uint64(&tmpl,
+	                                              msg,
+	                                              (unsigned int)slots[4],
+	                                              0));
+	cute_expect_assertion(dpack_tmpl_store_bool(&tmpl,
+	                                            msg,
+	                                            (unsigned int)slots[1],
+	                                            false));
+
+	dpack_tmpl_fini(&tmpl);
+}
+
+#else  /* !defined(CONFIG_DPACK_ASSERT_API) */
+
+CUTE_TEST(dpackut_tmpl_store_assert)
+{
+	cute_skip("assertion unsupported");
+}
+
+#endif /* defined(CONFIG_DPACK_ASSERT_API) */
+
+#if defined(CONFIG_DPACK_DOUBLE)
+
+CUTE_TEST(dpackut_tmpl_double)
+{
+	struct dpack_tmpl           tmpl;
+	int                         slot;
+	uint8_t                     msg[DPACK_DOUBLE_SIZE];
+	struct dpack_decoder_buffer dec;
+	double                      val;
+
+	cute_check_sint(dpack_tmpl_init(&tmpl, sizeof(msg), 1), equal, 0);
+	slot = dpack_tmpl_encode_double(&tmpl, 0.0);
+	cute_check_sint(slot, equal, 0);
+
+	cute_check_uint(dpack_tmpl_copy(&tmpl, msg), equal, sizeof(msg));
+	dpack_tmpl_store_double(&tmpl, msg, (unsigned int)slot, 1.005);
+
+	dpack_decoder_init_buffer(&dec, msg, sizeof(msg));
+	cute_check_sint(dpack_decode_double(&dec.base, &val), equal, 0);
+	cute_check_flt(val, equal, 1.005);
+	dpack_decoder_fini(&dec.base);
+
+	dpack_tmpl_fini(&tmpl);
+}
+
+#else  /* !defined(CONFIG_DPACK_DOUBLE) */
+
+CUTE_TEST(dpackut_tmpl_double)
+{
+	cute_skip("MessagePack double template test not compiled-in");
+}
+
+#endif /* defined(CONFIG_DPACK_DOUBLE) */
+
+CUTE_TEST(dpackut_tmpl_full)
+{
+	struct dpack_tmpl tmpl;
+
+	/* Not enough room left for a 32-bits integer. */
+	cute_check_sint(dpack_tmpl_init(&tmpl, 4, 2), equal, 0);
+	cute_check_sint(dpack_tmpl_encode_uint32(&tmpl, 0), equal, -EMSGSIZE);
+	cute_check_sint(dpack_tmpl_encode_bool(&tmpl, true), equal, 0);
+	cute_check_sint(dpack_tmpl_encode_bool(&tmpl, false), equal, 1);
+
+	/* No slot left. */
+	cute_check_sint(dpack_tmpl_encode_bool(&tmpl, true), equal, -ENOSPC);
+	cute_check_uint(dpack_tmpl_size(&tmpl), equal, 2);
+	dpack_tmpl_fini(&tmpl);
+}
+
+CUTE_GROUP(dpackut_tmpl_group) = {
+	CUTE_REF(dpackut_tmpl_encode),
+	CUTE_REF(dpackut_tmpl_store),
+	CUTE_REF(dpackut_tmpl_store_assert),
+	CUTE_REF(dpackut_tmpl_double),
+	CUTE_REF(dpackut_tmpl_full)
+};
+
+CUTE_SUITE_EXTERN(dpackut_tmpl_suite,
+                  dpackut_tmpl_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
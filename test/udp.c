@@ -0,0 +1,244 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/udp.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int
+dpackut_udp_open(struct sockaddr_in * __restrict addr)
+{
+	socklen_t len = sizeof(*addr);
+	int       fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	cute_check_sint(fd, greater_equal, 0);
+
+	addr->sin_family = AF_INET;
+	addr->sin_port = 0;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	cute_check_sint(bind(fd, (const struct sockaddr *)addr, sizeof(*addr)),
+	                equal,
+	                0);
+	cute_check_sint(getsockname(fd, (struct sockaddr *)addr, &len),
+	                equal,
+	                0);
+
+	return fd;
+}
+
+CUTE_TEST(dpackut_udp_batch)
+{
+	struct sockaddr_in          src;
+	struct sockaddr_in          dst;
+	int                         sfd = dpackut_udp_open(&src);
+	int                         rfd = dpackut_udp_open(&dst);
+	struct dpack_udp_batch      tx;
+	struct dpack_udp_batch      rx;
+	struct dpack_encoder_udp    enc;
+	struct dpack_decoder_buffer dec;
+	const struct sockaddr_in *  peer;
+	socklen_t                   len;
+	uint32_t                    val;
+	unsigned int                m;
+
+	cute_check_sint(dpack_udp_batch_init(&tx, sfd, 4, 64), equal, 0);
+	cute_check_sint(dpack_udp_batch_init(&rx, rfd, 8, 64), equal, 0);
+
+	for (m = 0; m < 4; m++) {
+		cute_check_sint(dpack_encoder_init_udp(&enc, &tx), equal, 0);
+		cute_check_sint(dpack_encode_uint32(&enc.buff.base, m * 1000),
+		                equal,
+		                0);
+		dpack_encoder_commit_udp(&enc,
+		                         (const struct sockaddr *)&dst,
+		                         sizeof(dst));
+	}
+	cute_check_uint(dpack_udp_batch_count(&tx), equal, 4);
+
+	/* Batch is full: it must be flushed before encoding further. */
+	cute_check_sint(dpack_encoder_init_udp(&enc, &tx), equal, -ENOBUFS);
+
+	cute_check_sint(dpack_udp_batch_send(&tx), equal, 4);
+	cute_check_uint(dpack_udp_batch_count(&tx), equal, 0);
+
+	/* Loopback datagrams are queued by the time sendmmsg(2) returns. */
+	cute_check_sint(dpack_udp_batch_recv(&rx, MSG_DONTWAIT), equal, 4);
+	cute_check_uint(dpack_udp_batch_count(&rx), equal, 4);
+
+	for (m = 0; m < 4; m++) {
+		cute_check_sint(dpack_decoder_init_udp(&dec, &rx, m), equal, 0);
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, m * 1000);
+		cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+		dpack_decoder_fini(&dec.base);
+
+		peer = (const struct sockaddr_in *)
+		       dpack_udp_batch_peer(&rx, m, &len);
+		cute_check_uint(len, equal, sizeof(src));
+		cute_check_uint(peer->sin_port, equal, src.sin_port);
+	}
+
+	cute_check_sint(dpack_udp_batch_recv(&rx, MSG_DONTWAIT),
+	                equal,
+	                -EAGAIN);
+
+	dpack_udp_batch_fini(&rx);
+	dpack_udp_batch_fini(&tx);
+	close(rfd);
+	close(sfd);
+}
+
+CUTE_TEST(dpackut_udp_trunc)
+{
+	struct dpack_udp_batch      tx;
+	struct dpack_udp_batch      rx;
+	struct dpack_encoder_udp    enc;
+	struct dpack_decoder_buffer dec;
+	int                         fds[2];
+
+	cute_check_sint(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), equal, 0);
+	cute_check_sint(dpack_udp_batch_init(&tx, fds[0], 1, 16), equal, 0);
+	cute_check_sint(dpack_udp_batch_init(&rx, fds[1], 1, 4), equal, 0);
+
+	cute_check_sint(dpack_encoder_init_udp(&enc, &tx), equal, 0);
+	cute_check_sint(dpack_encode_uint64(&enc.buff.base, UINT64_MAX),
+	                equal,
+	                0);
+	dpack_encoder_commit_udp(&enc, NULL, 0);
+	cute_check_sint(dpack_udp_batch_send(&tx), equal, 1);
+
+	cute_check_sint(dpack_udp_batch_recv(&rx, MSG_DONTWAIT), equal, 1);
+	cute_check_sint(dpack_decoder_init_udp(&dec, &rx, 0),
+	                equal,
+	                -EMSGSIZE);
+
+	dpack_udp_batch_fini(&rx);
+	dpack_udp_batch_fini(&tx);
+	close(fds[1]);
+	close(fds[0]);
+}
+
+#define DPACKUT_UDP_PARTIAL_NR (64U)
+
+CUTE_TEST(dpackut_udp_partial)
+{
+	struct dpack_udp_batch      tx;
+	struct dpack_udp_batch      rx;
+	struct dpack_encoder_udp    enc;
+	struct dpack_decoder_buffer dec;
+	int                         fds[2];
+	int                         sz = 1;
+	uint32_t                    val;
+	unsigned int                m;
+	unsigned int                cnt;
+	int                         ret;
+
+	/* Shrink send buffer so that transmission stops midway. */
+	cute_check_sint(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), equal, 0);
+	cute_check_sint(setsockopt(fds[0],
+	                           SOL_SOCKET,
+	                           SO_SNDBUF,
+	                           &sz,
+	                           sizeof(sz)),
+	                equal,
+	                0);
+	cute_check_sint(fcntl(fds[0], F_SETFL, O_NONBLOCK), equal, 0);
+	cute_check_sint(dpack_udp_batch_init(&tx,
+	                                     fds[0],
+	                                     DPACKUT_UDP_PARTIAL_NR,
+	                                     16),
+	                equal,
+	                0);
+	cute_check_sint(dpack_udp_batch_init(&rx,
+	                                     fds[1],
+	                                     DPACKUT_UDP_PARTIAL_NR,
+	                                     16),
+	                equal,
+	                0);
+
+	for (m = 0; m < DPACKUT_UDP_PARTIAL_NR; m++) {
+		cute_check_sint(dpack_encoder_init_udp(&enc, &tx), equal, 0);
+		cute_check_sint(dpack_encode_uint32(&enc.buff.base, m),
+		                equal,
+		                0);
+		dpack_encoder_commit_udp(&enc, NULL, 0);
+	}
+
+	/* Partial count is returned and unsent messages are kept queued... */
+	ret = dpack_udp_batch_send(&tx);
+	cute_check_sint(ret, greater, 0);
+	cute_check_sint(ret, lower, (int)DPACKUT_UDP_PARTIAL_NR);
+	cute_check_uint(dpack_udp_batch_count(&tx),
+	                equal,
+	                DPACKUT_UDP_PARTIAL_NR - (unsigned int)ret);
+	cute_check_sint(dpack_udp_batch_send(&tx), equal, -EAGAIN);
+	cute_check_uint(dpack_udp_batch_count(&tx),
+	                equal,
+	                DPACKUT_UDP_PARTIAL_NR - (unsigned int)ret);
+
+	/* ...and go out in order, none twice, as receiver drains them. */
+	for (m = 0; m < DPACKUT_UDP_PARTIAL_NR;) {
+		unsigned int r;
+
+		ret = dpack_udp_batch_recv(&rx, MSG_DONTWAIT);
+		cute_check_sint(ret, greater, 0);
+		for (r = 0; r < (unsigned int)ret; r++, m++) {
+			cute_check_sint(dpack_decoder_init_udp(&dec, &rx, r),
+			                equal,
+			                0);
+			cute_check_sint(dpack_decode_uint32(&dec.base, &val),
+			                equal,
+			                0);
+			cute_check_uint(val, equal, m);
+			dpack_decoder_fini(&dec.base);
+		}
+
+		cnt = dpack_udp_batch_count(&tx);
+		if (cnt) {
+			ret = dpack_udp_batch_send(&tx);
+			cute_check_sint(ret, greater, 0);
+			cute_check_uint(dpack_udp_batch_count(&tx),
+			                equal,
+			                cnt - (unsigned int)ret);
+		}
+	}
+
+	cute_check_uint(dpack_udp_batch_count(&tx), equal, 0);
+
+	/* Leftovers may be dropped as well. */
+	cute_check_sint(dpack_encoder_init_udp(&enc, &tx), equal, 0);
+	cute_check_sint(dpack_encode_uint32(&enc.buff.base, 0), equal, 0);
+	dpack_encoder_commit_udp(&enc, NULL, 0);
+	dpack_udp_batch_drop(&tx);
+	cute_check_uint(dpack_udp_batch_count(&tx), equal, 0);
+
+	dpack_udp_batch_fini(&rx);
+	dpack_udp_batch_fini(&tx);
+	close(fds[1]);
+	close(fds[0]);
+}
+
+CUTE_GROUP(dpackut_udp_group) = {
+	CUTE_REF(dpackut_udp_batch),
+	CUTE_REF(dpackut_udp_trunc),
+	CUTE_REF(dpackut_udp_partial)
+};
+
+CUTE_SUITE_EXTERN(dpackut_udp_suite,
+                  dpackut_udp_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);
@@ -294,9 +294,48 @@ extern CUTE_SUITE_DECL(dpackut_str_suite);
 #if defined(CONFIG_DPACK_LVSTR)
 extern CUTE_SUITE_DECL(dpackut_lvstr_suite);
 #endif
+#if defined(CONFIG_DPACK_INTERN)
+extern CUTE_SUITE_DECL(dpackut_intern_suite);
+#endif
 #if defined(CONFIG_DPACK_MAP)
 extern CUTE_SUITE_DECL(dpackut_map_suite);
 #endif
+#if defined(CONFIG_DPACK_JOURNAL)
+extern CUTE_SUITE_DECL(dpackut_journal_suite);
+#endif
+#if defined(CONFIG_DPACK_RING)
+extern CUTE_SUITE_DECL(dpackut_ring_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_MEMFD)
+extern CUTE_SUITE_DECL(dpackut_memfd_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+extern CUTE_SUITE_DECL(dpackut_file_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_MPBUFFER)
+extern CUTE_SUITE_DECL(dpackut_mpbuffer_suite);
+#endif
+#if defined(CONFIG_DPACK_RPC)
+extern CUTE_SUITE_DECL(dpackut_rpc_suite);
+#endif
+#if defined(CONFIG_DPACK_UDP)
+extern CUTE_SUITE_DECL(dpackut_udp_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_SOCKET)
+extern CUTE_SUITE_DECL(dpackut_socket_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_FD)
+extern CUTE_SUITE_DECL(dpackut_fd_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_FILTER)
+extern CUTE_SUITE_DECL(dpackut_filter_suite);
+#endif
+#if defined(CONFIG_DPACK_CODEC_ZSTD)
+extern CUTE_SUITE_DECL(dpackut_zstd_suite);
+#endif
+#if defined(CONFIG_DPACK_TMPL)
+extern CUTE_SUITE_DECL(dpackut_tmpl_suite);
+#endif
 
 CUTE_GROUP(dpackut_group) = {
 #if defined(CONFIG_DPACK_ARRAY)
@@ -328,9 +367,48 @@ CUTE_GROUP(dpackut_group) = {
 #if defined(CONFIG_DPACK_LVSTR)
 	CUTE_REF(dpackut_lvstr_suite),
 #endif
+#if defined(CONFIG_DPACK_INTERN)
+	CUTE_REF(dpackut_intern_suite),
+#endif
 #if defined(CONFIG_DPACK_MAP)
 	CUTE_REF(dpackut_map_suite),
 #endif
+#if defined(CONFIG_DPACK_JOURNAL)
+	CUTE_REF(dpackut_journal_suite),
+#endif
+#if defined(CONFIG_DPACK_RING)
+	CUTE_REF(dpackut_ring_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_MEMFD)
+	CUTE_REF(dpackut_memfd_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_FILE_PARALLEL)
+	CUTE_REF(dpackut_file_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_MPBUFFER)
+	CUTE_REF(dpackut_mpbuffer_suite),
+#endif
+#if defined(CONFIG_DPACK_RPC)
+	CUTE_REF(dpackut_rpc_suite),
+#endif
+#if defined(CONFIG_DPACK_UDP)
+	CUTE_REF(dpackut_udp_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_SOCKET)
+	CUTE_REF(dpackut_socket_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_FD)
+	CUTE_REF(dpackut_fd_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_FILTER)
+	CUTE_REF(dpackut_filter_suite),
+#endif
+#if defined(CONFIG_DPACK_CODEC_ZSTD)
+	CUTE_REF(dpackut_zstd_suite),
+#endif
+#if defined(CONFIG_DPACK_TMPL)
+	CUTE_REF(dpackut_tmpl_suite),
+#endif
 };
 
 CUTE_SUITE(dpackut_suite, dpackut_group);
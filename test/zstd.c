@@ -0,0 +1,209 @@
+/******************************************************************************
+ * SPDX-License-Identifier: LGPL-3.0-only
+ *
+ * This file is part of DPack.
+ * Copyright (C) 2024 Grégor Boirie <gregor.boirie@free.fr>
+ ******************************************************************************/
+
+#include "dpack/zstd.h"
+#include "dpack/scalar.h"
+#include <cute/cute.h>
+#include <cute/check.h>
+#include <cute/expect.h>
+#include "utest.h"
+#include <errno.h>
+#include <stdlib.h>
+
+/*
+ * Enough values so that decompressed data spans multiple decompressor output
+ * blocks.
+ */
+#define DPACKUT_ZSTD_VAL_NR   (65536U)
+/* Encoded size of values used below. */
+#define DPACKUT_ZSTD_VAL_SIZE (5U)
+#define DPACKUT_ZSTD_VAL_BASE (0x10000U)
+/* Repeating values so that data compresses well. */
+#define DPACKUT_ZSTD_VAL(_v)  (DPACKUT_ZSTD_VAL_BASE + ((_v) % 64U))
+#define DPACKUT_ZSTD_SIZE     (DPACKUT_ZSTD_VAL_NR * DPACKUT_ZSTD_VAL_SIZE)
+
+static uint8_t *
+dpackut_zstd_encode(int level, unsigned int wlog, size_t * size)
+{
+	uint8_t *                   buff;
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_zstd   enc;
+	unsigned int                v;
+
+	buff = malloc(DPACKUT_ZSTD_SIZE);
+	cute_check_ptr(buff, unequal, NULL);
+
+	dpack_encoder_init_buffer(&next, buff, DPACKUT_ZSTD_SIZE);
+	cute_check_sint(dpack_encoder_init_zstd(&enc, &next.base, level, wlog),
+	                equal,
+	                0);
+
+	for (v = 0; v < DPACKUT_ZSTD_VAL_NR; v++) {
+		uint32_t val = DPACKUT_ZSTD_VAL(v);
+
+		cute_check_sint(dpack_encode_uint32(&enc.base, val), equal, 0);
+	}
+	cute_check_uint(dpack_encoder_space_used(&enc.base),
+	                equal,
+	                DPACKUT_ZSTD_SIZE);
+
+	/* Compressed frame is terminated at finalization time. */
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+
+	*size = dpack_encoder_space_used(&next.base);
+	cute_check_uint(*size, greater, 0);
+	cute_check_uint(*size, lower, DPACKUT_ZSTD_SIZE / 4);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+
+	return buff;
+}
+
+CUTE_TEST(dpackut_zstd_decode)
+{
+	size_t                      size;
+	uint8_t *                   buff = dpackut_zstd_encode(0, 0, &size);
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_zstd   dec;
+	unsigned int                v;
+	uint32_t                    val;
+
+	dpack_decoder_init_buffer(&next, buff, size);
+	cute_check_sint(dpack_decoder_init_zstd(&dec, &next.base, 0),
+	                equal,
+	                0);
+
+	for (v = 0; v < DPACKUT_ZSTD_VAL_NR; v++) {
+		cute_check_uint(dpack_decoder_data_left(&dec.base), greater, 0);
+		cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+		cute_check_uint(val, equal, DPACKUT_ZSTD_VAL(v));
+	}
+
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, -ENODATA);
+
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&next.base);
+	free(buff);
+}
+
+CUTE_TEST(dpackut_zstd_skip)
+{
+	size_t                      size;
+	uint8_t *                   buff = dpackut_zstd_encode(1, 0, &size);
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_zstd   dec;
+	uint32_t                    val;
+
+	dpack_decoder_init_buffer(&next, buff, size);
+	cute_check_sint(dpack_decoder_init_zstd(&dec, &next.base, 0),
+	                equal,
+	                0);
+
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+	cute_check_uint(val, equal, DPACKUT_ZSTD_VAL_BASE);
+
+	/* Skipping across multiple decompressed blocks. */
+	cute_check_sint(dpack_decoder_skip(&dec.base,
+	                                   DPACKUT_ZSTD_SIZE -
+	                                   (2 * DPACKUT_ZSTD_VAL_SIZE)),
+	                equal,
+	                0);
+	cute_check_uint(dpack_decoder_data_left(&dec.base),
+	                equal,
+	                DPACKUT_ZSTD_VAL_SIZE);
+
+	cute_check_sint(dpack_decode_uint32(&dec.base, &val), equal, 0);
+	cute_check_uint(val, equal, DPACKUT_ZSTD_VAL(DPACKUT_ZSTD_VAL_NR - 1));
+	cute_check_sint(dpack_decoder_skip(&dec.base, 1), equal, -ENODATA);
+
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&next.base);
+	free(buff);
+}
+
+CUTE_TEST(dpackut_zstd_window)
+{
+	size_t                      size;
+	uint8_t *                   buff = dpackut_zstd_encode(3, 20, &size);
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_zstd   dec;
+
+	/* Refuse to allocate a window larger than 1 kB. */
+	dpack_decoder_init_buffer(&next, buff, size);
+	cute_check_sint(dpack_decoder_init_zstd(&dec, &next.base, 10),
+	                equal,
+	                -EMSGSIZE);
+	dpack_decoder_fini(&next.base);
+
+	free(buff);
+}
+
+CUTE_TEST(dpackut_zstd_trunc)
+{
+	size_t                      size;
+	uint8_t *                   buff = dpackut_zstd_encode(0, 0, &size);
+	struct dpack_decoder_buffer next;
+	struct dpack_decoder_zstd   dec;
+	unsigned int                v;
+	uint32_t                    val;
+	int                         err = 0;
+
+	/* Drop frame checksum. */
+	dpack_decoder_init_buffer(&next, buff, size - 4);
+	cute_check_sint(dpack_decoder_init_zstd(&dec, &next.base, 0),
+	                equal,
+	                0);
+
+	for (v = 0; (v < DPACKUT_ZSTD_VAL_NR) && !err; v++)
+		err = dpack_decode_uint32(&dec.base, &val);
+	cute_check_sint(err, equal, -ENODATA);
+
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&next.base);
+	free(buff);
+}
+
+CUTE_TEST(dpackut_zstd_empty)
+{
+	uint8_t                     buff[64];
+	struct dpack_encoder_buffer next;
+	struct dpack_encoder_zstd   enc;
+	struct dpack_decoder_buffer src;
+	struct dpack_decoder_zstd   dec;
+	size_t                      size;
+
+	dpack_encoder_init_buffer(&next, buff, sizeof(buff));
+	cute_check_sint(dpack_encoder_init_zstd(&enc, &next.base, 0, 0),
+	                equal,
+	                0);
+	cute_check_sint(dpack_encoder_fini(&enc.base), equal, 0);
+	size = dpack_encoder_space_used(&next.base);
+	cute_check_uint(size, greater, 0);
+	cute_check_sint(dpack_encoder_fini(&next.base), equal, 0);
+
+	dpack_decoder_init_buffer(&src, buff, size);
+	cute_check_sint(dpack_decoder_init_zstd(&dec, &src.base, 0),
+	                equal,
+	                0);
+	cute_check_uint(dpack_decoder_data_left(&dec.base), equal, 0);
+	dpack_decoder_fini(&dec.base);
+	dpack_decoder_fini(&src.base);
+}
+
+CUTE_GROUP(dpackut_zstd_group) = {
+	CUTE_REF(dpackut_zstd_decode),
+	CUTE_REF(dpackut_zstd_skip),
+	CUTE_REF(dpackut_zstd_window),
+	CUTE_REF(dpackut_zstd_trunc),
+	CUTE_REF(dpackut_zstd_empty)
+};
+
+CUTE_SUITE_EXTERN(dpackut_zstd_suite,
+                  dpackut_zstd_group,
+                  CUTE_NULL_SETUP,
+                  CUTE_NULL_TEARDOWN,
+                  CUTE_DFLT_TMOUT);